@@ -0,0 +1,151 @@
+/*
+
+  This benchmark compares decoding the delta encoded packed arrays used in
+  the DenseNodes messages of PBF files with the protozero iterators (one
+  varint at a time) against the batch decoder used by the PBF parser.
+
+  The node IDs and coordinates are read from the input file and encoded
+  into packed arrays of 8000 values each (the size of a PBF block). Then
+  the arrays are decoded several times with both methods.
+
+  Do not run this with very large input files! It will need about 30 bytes
+  of RAM per node.
+
+  The code in this file is released into the Public Domain.
+
+*/
+
+#include <osmium/handler.hpp>
+#include <osmium/io/any_input.hpp>
+#include <osmium/io/detail/packed_varint.hpp>
+#include <osmium/util/delta.hpp>
+#include <osmium/visitor.hpp>
+
+#include <protozero/pbf_reader.hpp>
+#include <protozero/pbf_writer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+static const std::size_t values_per_array = 8000;
+
+struct EncodeHandler : public osmium::handler::Handler {
+
+    std::vector<std::string> arrays;
+    std::vector<int64_t> ids;
+    std::vector<int64_t> lons;
+    std::vector<int64_t> lats;
+
+    void add_array(std::vector<int64_t>& values) {
+        std::string data;
+        protozero::pbf_writer writer{data};
+        osmium::DeltaEncode<int64_t> delta;
+        std::vector<int64_t> deltas;
+        deltas.reserve(values.size());
+        for (const auto value : values) {
+            deltas.push_back(delta.update(value));
+        }
+        writer.add_packed_sint64(1, deltas.cbegin(), deltas.cend());
+        arrays.push_back(std::move(data));
+        values.clear();
+    }
+
+    void flush() {
+        if (!ids.empty()) {
+            add_array(ids);
+            add_array(lons);
+            add_array(lats);
+        }
+    }
+
+    void node(const osmium::Node& node) {
+        ids.push_back(node.id());
+        lons.push_back(node.location().x());
+        lats.push_back(node.location().y());
+        if (ids.size() == values_per_array) {
+            flush();
+        }
+    }
+
+}; // struct EncodeHandler
+
+static int64_t decode_with_iterators(const std::vector<std::string>& arrays) {
+    int64_t sum = 0;
+    for (const auto& data : arrays) {
+        protozero::pbf_reader reader{data};
+        reader.next();
+        osmium::DeltaDecode<int64_t> delta;
+        for (const auto value : reader.get_packed_sint64()) {
+            sum += delta.update(value);
+        }
+    }
+    return sum;
+}
+
+static int64_t decode_with_batch_decoder(const std::vector<std::string>& arrays) {
+    int64_t sum = 0;
+    std::vector<int64_t> column;
+    for (const auto& data : arrays) {
+        protozero::pbf_reader reader{data};
+        reader.next();
+        const auto view = reader.get_view();
+        osmium::io::detail::decode_packed_sint64_delta(view.data(), view.data() + view.size(), column);
+        for (const auto value : column) {
+            sum += value;
+        }
+    }
+    return sum;
+}
+
+template <typename TFunc>
+static double run(const std::vector<std::string>& arrays, TFunc&& func, int64_t& result) {
+    const auto start = std::chrono::steady_clock::now();
+    result = func(arrays);
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " OSMFILE\n";
+        std::exit(1);
+    }
+
+    const std::string input_filename{argv[1]};
+
+    EncodeHandler handler;
+    osmium::io::Reader reader{input_filename, osmium::osm_entity_bits::node};
+    osmium::apply(reader, handler);
+    reader.close();
+    handler.flush();
+
+    const int runs = 10;
+
+    std::cout << "input: filename=" << input_filename << " arrays=" << handler.arrays.size() << "\n";
+    std::cout << "runs: " << runs << "\n";
+
+    double iterator_min = std::numeric_limits<double>::max();
+    double batch_min = std::numeric_limits<double>::max();
+
+    for (int i = 0; i < runs; ++i) {
+        int64_t iterator_result = 0;
+        int64_t batch_result = 0;
+
+        iterator_min = std::min(iterator_min, run(handler.arrays, decode_with_iterators, iterator_result));
+        batch_min = std::min(batch_min, run(handler.arrays, decode_with_batch_decoder, batch_result));
+
+        if (iterator_result != batch_result) {
+            std::cerr << "Results differ!\n";
+            std::exit(1);
+        }
+    }
+
+    std::cout << "iterators min=" << iterator_min << "ms\n";
+    std::cout << "batch     min=" << batch_min << "ms\n";
+}
@@ -0,0 +1,122 @@
+/*
+
+  This benchmark compares the mutex based osmium::thread::Queue with the
+  lock-free osmium::thread::MPMCQueue when several producer and consumer
+  threads use the same queue at the same time. It doesn't need any input
+  files.
+
+  Each producer pushes the same number of items, the consumers pop them
+  until they see an end marker. The queue is small like the queues in the
+  Reader and Writer so that producers often find it full and consumers
+  often find it empty.
+
+  The code in this file is released into the Public Domain.
+
+*/
+
+#include <osmium/thread/mpmc_queue.hpp>
+#include <osmium/thread/queue.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int items_per_producer = 200000;
+static const std::size_t queue_size = 20;
+
+template <typename TQueue>
+static double run(int num_producers, int num_consumers) {
+    TQueue queue{queue_size, "benchmark"};
+    std::vector<int64_t> sums(static_cast<std::size_t>(num_consumers), 0);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < num_consumers; ++c) {
+        consumers.emplace_back([&queue, &sums, c] {
+            int64_t sum = 0;
+            while (true) {
+                int value = 0;
+                queue.wait_and_pop(value);
+                if (value < 0) {
+                    break;
+                }
+                sum += value;
+            }
+            sums[static_cast<std::size_t>(c)] = sum;
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < num_producers; ++p) {
+        producers.emplace_back([&queue] {
+            for (int n = 1; n <= items_per_producer; ++n) {
+                queue.push(n);
+            }
+        });
+    }
+
+    for (auto& thread : producers) {
+        thread.join();
+    }
+    for (int c = 0; c < num_consumers; ++c) {
+        queue.push(-1);
+    }
+    for (auto& thread : consumers) {
+        thread.join();
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+
+    int64_t sum = 0;
+    for (const auto s : sums) {
+        sum += s;
+    }
+    if (sum != int64_t(num_producers) * items_per_producer * (items_per_producer + 1) / 2) {
+        std::cerr << "Wrong result!\n";
+        std::exit(1);
+    }
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 2) {
+        std::cerr << "Usage: " << argv[0] << " [MAX_THREADS]\n";
+        std::exit(1);
+    }
+
+    int max_threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (argc == 2) {
+        max_threads = std::atoi(argv[1]);
+    }
+    max_threads = std::max(max_threads, 2);
+
+    const int runs = 5;
+
+    std::cout << "items per producer: " << items_per_producer << " queue size: " << queue_size << "\n";
+    std::cout << "runs: " << runs << "\n";
+
+    for (int threads = 2; threads <= max_threads; threads *= 2) {
+        const int producers = threads / 2;
+        const int consumers = threads - producers;
+
+        double queue_min = std::numeric_limits<double>::max();
+        double mpmc_min = std::numeric_limits<double>::max();
+
+        for (int i = 0; i < runs; ++i) {
+            queue_min = std::min(queue_min, run<osmium::thread::Queue<int>>(producers, consumers));
+            mpmc_min = std::min(mpmc_min, run<osmium::thread::MPMCQueue<int>>(producers, consumers));
+        }
+
+        std::cout << "producers=" << producers << " consumers=" << consumers
+                  << " Queue min=" << queue_min << "ms"
+                  << " MPMCQueue min=" << mpmc_min << "ms\n";
+    }
+}
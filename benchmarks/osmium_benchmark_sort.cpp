@@ -0,0 +1,103 @@
+/*
+
+  This benchmark compares std::sort with the parallel radix sort used by
+  the sparse index maps and multimaps when sorting (id, value) pairs like
+  the ones in a sparse node location index. It doesn't need any input
+  files.
+
+  The ids are random in the range of current OSM node ids. Each sort is
+  run on a fresh copy of the same data.
+
+  The code in this file is released into the Public Domain.
+
+*/
+
+#include <osmium/index/detail/radix_sort.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using element_type = std::pair<uint64_t, uint64_t>;
+
+static std::vector<element_type> create_data(std::size_t size) {
+    std::vector<element_type> data;
+    data.reserve(size);
+    uint64_t n = 1;
+    for (std::size_t i = 0; i < size; ++i) {
+        n = n * 6364136223846793005ULL + 1442695040888963407ULL;
+        data.emplace_back((n >> 16U) % 12000000000ULL, n);
+    }
+    return data;
+}
+
+template <typename TFunc>
+static double run(const std::vector<element_type>& data, TFunc&& func) {
+    std::vector<element_type> copy{data};
+
+    const auto start = std::chrono::steady_clock::now();
+    func(copy);
+    const auto end = std::chrono::steady_clock::now();
+
+    if (!std::is_sorted(copy.cbegin(), copy.cend())) {
+        std::cerr << "Wrong result!\n";
+        std::exit(1);
+    }
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " [SIZE [MAX_THREADS]]\n";
+        std::exit(1);
+    }
+
+    std::size_t size = 50 * 1000 * 1000;
+    if (argc >= 2) {
+        size = static_cast<std::size_t>(std::atoll(argv[1]));
+    }
+
+    int max_threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (argc == 3) {
+        max_threads = std::atoi(argv[2]);
+    }
+    max_threads = std::max(max_threads, 1);
+
+    const int runs = 3;
+
+    std::cout << "elements: " << size << "\n";
+    std::cout << "runs: " << runs << "\n";
+
+    const std::vector<element_type> data{create_data(size)};
+
+    double std_sort_min = std::numeric_limits<double>::max();
+    for (int i = 0; i < runs; ++i) {
+        std_sort_min = std::min(std_sort_min, run(data, [](std::vector<element_type>& d) {
+            std::sort(d.begin(), d.end());
+        }));
+    }
+    std::cout << "std::sort min=" << std_sort_min << "ms\n";
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        osmium::thread::Pool pool{threads};
+
+        double radix_sort_min = std::numeric_limits<double>::max();
+        for (int i = 0; i < runs; ++i) {
+            radix_sort_min = std::min(radix_sort_min, run(data, [&pool](std::vector<element_type>& d) {
+                osmium::index::detail::radix_sort(d.begin(), d.end(), osmium::index::detail::sort_key_first{}, pool);
+            }));
+        }
+
+        std::cout << "threads=" << threads
+                  << " radix_sort min=" << radix_sort_min << "ms"
+                  << " speedup=" << std_sort_min / radix_sort_min << "\n";
+    }
+}
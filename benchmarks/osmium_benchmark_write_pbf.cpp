@@ -12,16 +12,28 @@
 #include <osmium/io/any_output.hpp>
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " INPUT-FILE OUTPUT-FILE\n";
+    if (argc < 3 || argc > 4) {
+        std::cerr << "Usage: " << argv[0] << " INPUT-FILE OUTPUT-FILE [COMPRESSION]\n"
+                  << "  COMPRESSION can be 'none', 'zlib' (default), 'lz4', or 'zstd'\n"
+                  << "  optionally followed by ':LEVEL', for instance 'zstd:19'\n";
         std::exit(1);
     }
 
     std::string input_filename{argv[1]};
     std::string output_filename{argv[2]};
 
+    std::string format{"pbf"};
+    if (argc == 4) {
+        const std::string compression{argv[3]};
+        const auto pos = compression.find(':');
+        format += ",pbf_compression=" + compression.substr(0, pos);
+        if (pos != std::string::npos) {
+            format += ",pbf_compression_level=" + compression.substr(pos + 1);
+        }
+    }
+
     osmium::io::Reader reader{input_filename};
-    osmium::io::File output_file{output_filename, "pbf"};
+    osmium::io::File output_file{output_filename, format};
     osmium::io::Header header;
     osmium::io::Writer writer{output_file, header, osmium::io::overwrite::allow};
 
@@ -0,0 +1,35 @@
+#!/bin/sh
+#
+#  run_benchmark_count_affinity.sh
+#
+#  Runs the count benchmark with different settings for the CPU affinity
+#  of the pool threads and I/O threads. On machines with several NUMA
+#  nodes "local" keeps all threads on the node of the main thread.
+#
+
+set -e
+
+BENCHMARK_NAME=count
+
+. @CMAKE_BINARY_DIR@/benchmarks/setup.sh
+
+CMD=$OB_DIR/osmium_benchmark_$BENCHMARK_NAME
+
+echo "# file size num mem time cpu_kernel cpu_user cpu_percent cmd options"
+for data in $OB_DATA_FILES; do
+    filename=`basename $data`
+    filesize=`stat --format="%s" --dereference $data`
+    for setting in none local; do
+        if [ $setting = none ]; then
+            unset OSMIUM_POOL_CPUS OSMIUM_IO_CPUS
+        else
+            export OSMIUM_POOL_CPUS=$setting
+            export OSMIUM_IO_CPUS=$setting
+        fi
+        echo "# affinity: $setting"
+        for n in $OB_SEQ; do
+            $OB_TIME_CMD -f "$filename $filesize $n $OB_TIME_FORMAT" $CMD $data 2>&1 >/dev/null | sed -e "s%$DATA_DIR/%%" | sed -e "s%$OB_DIR/%%"
+        done
+    done
+done
+
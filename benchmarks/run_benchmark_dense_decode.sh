@@ -0,0 +1,21 @@
+#!/bin/sh
+#
+#  run_benchmark_dense_decode.sh
+#
+
+set -e
+
+BENCHMARK_NAME=dense_decode
+
+. @CMAKE_BINARY_DIR@/benchmarks/setup.sh
+
+CMD=$OB_DIR/osmium_benchmark_$BENCHMARK_NAME
+
+for data in $OB_DATA_FILES; do
+    filesize=`stat --format="%s" --dereference $data`
+    if [ $filesize -lt 500000000 ]; then
+        echo "========================"
+        $CMD $data
+    fi
+done
+
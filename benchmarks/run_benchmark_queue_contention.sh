@@ -0,0 +1,15 @@
+#!/bin/sh
+#
+#  run_benchmark_queue_contention.sh
+#
+
+set -e
+
+BENCHMARK_NAME=queue_contention
+
+. @CMAKE_BINARY_DIR@/benchmarks/setup.sh
+
+CMD=$OB_DIR/osmium_benchmark_$BENCHMARK_NAME
+
+echo "========================"
+$CMD
@@ -0,0 +1,15 @@
+#!/bin/sh
+#
+#  run_benchmark_sort.sh
+#
+
+set -e
+
+BENCHMARK_NAME=sort
+
+. @CMAKE_BINARY_DIR@/benchmarks/setup.sh
+
+CMD=$OB_DIR/osmium_benchmark_$BENCHMARK_NAME
+
+echo "========================"
+$CMD
@@ -8,6 +8,16 @@
 #  subtract the times needed for the "count" benchmark to (roughly) get the
 #  write times.
 #
+#  The file is written once for each PBF blob compression listed in
+#  OB_PBF_COMPRESSIONS (default: "none zlib lz4 zstd"). Compressions not
+#  compiled into libosmium will fail. The compression is appended to the
+#  file name in the output.
+#
+#  Set OB_POOL_THREADS to a list of thread pool sizes (for instance
+#  "1 2 4 8") to run each benchmark with each of these sizes. The
+#  primitive blocks are encoded in the pool, so this shows how writing
+#  scales. The pool size is appended to the file name in the output.
+#
 
 set -e
 
@@ -17,12 +27,26 @@ BENCHMARK_NAME=write_pbf
 
 CMD=$OB_DIR/osmium_benchmark_$BENCHMARK_NAME
 
+OB_PBF_COMPRESSIONS=${OB_PBF_COMPRESSIONS:-"none zlib lz4 zstd"}
+OB_POOL_THREADS=${OB_POOL_THREADS:-"default"}
+
 echo "# file size num mem time cpu_kernel cpu_user cpu_percent cmd options"
 for data in $OB_DATA_FILES; do
     filename=`basename $data`
     filesize=`stat --format="%s" --dereference $data`
-    for n in $OB_SEQ; do
-        $OB_TIME_CMD -f "$filename $filesize $n $OB_TIME_FORMAT" $CMD $data /dev/null 2>&1 >/dev/null | sed -e "s%$DATA_DIR/%%" | sed -e "s%$OB_DIR/%%"
+    for compression in $OB_PBF_COMPRESSIONS; do
+        for threads in $OB_POOL_THREADS; do
+            if [ "$threads" = "default" ]; then
+                name="$filename:$compression"
+                unset OSMIUM_POOL_THREADS
+            else
+                name="$filename:$compression:$threads"
+                export OSMIUM_POOL_THREADS=$threads
+            fi
+            for n in $OB_SEQ; do
+                $OB_TIME_CMD -f "$name $filesize $n $OB_TIME_FORMAT" $CMD $data /dev/null $compression 2>&1 >/dev/null | sed -e "s%$DATA_DIR/%%" | sed -e "s%$OB_DIR/%%"
+            done
+        done
     done
 done
 
@@ -13,6 +13,7 @@
   * file input
   * location indexes and the NodeLocationsForWays handler
   * location indexes on disk
+  * reading only node locations from PBF files with the NodeLocationReader
 
   SIMPLER EXAMPLES you might want to understand first:
   * osmium_read
@@ -40,6 +41,9 @@
 // Allow any format of input files (XML, PBF, ...)
 #include <osmium/io/any_input.hpp>
 
+// For reading only the node locations from PBF files
+#include <osmium/io/node_location_reader.hpp>
+
 // For the location index. There are different types of index implementation
 // available. These implementations put the index on disk. See below.
 #include <osmium/index/map/dense_file_array.hpp>
@@ -68,9 +72,6 @@ int main(int argc, char* argv[]) {
     const std::string input_filename{argv[1]};
     const std::string cache_filename{argv[2]};
 
-    // Construct Reader reading only nodes
-    osmium::io::Reader reader{input_filename, osmium::osm_entity_bits::node};
-
     // Initialize location index on disk creating a new file.
     const int fd = ::open(cache_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666); // NOLINT(hicpp-signed-bitwise)
     if (fd == -1) {
@@ -85,10 +86,29 @@ int main(int argc, char* argv[]) {
     // The handler that stores all node locations in the index.
     location_handler_type location_handler{index};
 
-    // Feed all nodes through the location handler.
-    osmium::apply(reader, location_handler);
-
-    // Explicitly close input so we get notified of any errors.
-    reader.close();
+    const osmium::io::File input_file{input_filename};
+    if (input_file.format() == osmium::io::file_format::pbf &&
+        input_file.compression() == osmium::io::file_compression::none) {
+        // PBF files can be read much faster with the NodeLocationReader,
+        // which decodes only the IDs and locations of the nodes.
+        osmium::io::NodeLocationReader reader{input_filename};
+
+        osmium::NodeLocationBatch batch;
+        while (!(batch = reader.read()).empty()) {
+            location_handler.node_locations(batch);
+        }
+
+        // Explicitly close input so we get notified of any errors.
+        reader.close();
+    } else {
+        // Construct Reader reading only nodes
+        osmium::io::Reader reader{input_file, osmium::osm_entity_bits::node};
+
+        // Feed all nodes through the location handler.
+        osmium::apply(reader, location_handler);
+
+        // Explicitly close input so we get notified of any errors.
+        reader.close();
+    }
 }
 
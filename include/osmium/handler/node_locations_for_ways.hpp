@@ -37,14 +37,18 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/index/index.hpp>
 #include <osmium/index/map/dummy.hpp>
 #include <osmium/index/node_locations_map.hpp>
+#include <osmium/memory/buffer.hpp>
 #include <osmium/osm/location.hpp>
 #include <osmium/osm/node.hpp>
+#include <osmium/osm/node_location_batch.hpp>
 #include <osmium/osm/node_ref.hpp>
 #include <osmium/osm/types.hpp>
 #include <osmium/osm/way.hpp>
 
+#include <cstddef>
 #include <limits>
 #include <type_traits>
+#include <vector>
 
 namespace osmium {
 
@@ -88,6 +92,11 @@ namespace osmium {
 
             bool m_must_sort = false;
 
+            // Used in way() to look up all node locations of a way at once
+            // and in node_locations() to store a batch at once.
+            std::vector<osmium::unsigned_object_id_type> m_ids;
+            std::vector<osmium::Location> m_locations;
+
             // It is okay to have this static dummy instance, even when using several threads,
             // because it is read-only.
             static dummy_type& get_dummy() {
@@ -95,6 +104,35 @@ namespace osmium {
                 return instance;
             }
 
+            // Append the IDs of all node refs with non-negative IDs. Those
+            // are looked up in one batch, negative IDs are rare.
+            static void collect_ids(const osmium::WayNodeList& nodes, std::vector<osmium::unsigned_object_id_type>& ids) {
+                for (const auto& node_ref : nodes) {
+                    if (node_ref.ref() >= 0) {
+                        ids.push_back(node_ref.positive_ref());
+                    }
+                }
+            }
+
+            // Set the locations of all node refs. Locations for non-negative
+            // IDs are taken from the batch looked up for the IDs returned by
+            // collect_ids(), the location pointer is advanced accordingly.
+            // Returns false if any location was not found.
+            bool set_locations(osmium::WayNodeList& nodes, const osmium::Location*& location) const {
+                bool okay = true;
+                for (auto& node_ref : nodes) {
+                    if (node_ref.ref() >= 0) {
+                        node_ref.set_location(*location++);
+                    } else {
+                        node_ref.set_location(m_storage_neg.get_noexcept(node_ref.positive_ref()));
+                    }
+                    if (!node_ref.location()) {
+                        okay = false;
+                    }
+                }
+                return okay;
+            }
+
         public:
 
             explicit NodeLocationsForWays(TStoragePosIDs& storage_pos,
@@ -132,6 +170,41 @@ namespace osmium {
                 }
             }
 
+            /**
+             * Store the locations of all nodes in the batch. Does the same
+             * as calling node() for each of them. Use this together with
+             * the NodeLocationReader.
+             */
+            void node_locations(const osmium::NodeLocationBatch& batch) {
+                const auto& ids = batch.ids();
+                const auto& locations = batch.locations();
+
+                // Store runs of IDs with the same sign with one set_many()
+                // call each. Usually there is only one run.
+                std::size_t begin = 0;
+                while (begin < ids.size()) {
+                    const bool negative = ids[begin] < 0;
+                    m_ids.clear();
+                    std::size_t end = begin;
+                    for (; end < ids.size() && (ids[end] < 0) == negative; ++end) {
+                        const auto id = ids[end];
+                        const auto positive_id = static_cast<osmium::unsigned_object_id_type>(negative ? -id : id);
+                        if (positive_id < m_last_id) {
+                            m_must_sort = true;
+                        }
+                        m_last_id = positive_id;
+                        m_ids.push_back(positive_id);
+                    }
+
+                    if (negative) {
+                        m_storage_neg.set_many(m_ids.data(), locations.data() + begin, m_ids.size());
+                    } else {
+                        m_storage_pos.set_many(m_ids.data(), locations.data() + begin, m_ids.size());
+                    }
+                    begin = end;
+                }
+            }
+
             /**
              * Get location of node with given id.
              */
@@ -143,24 +216,67 @@ namespace osmium {
             }
 
             /**
-             * Retrieve locations of all nodes in the way from storage and add
-             * them to the way object.
+             * Sort the indexes if that is needed before looking up locations
+             * in them. This is done automatically by way(), but must be
+             * called once after all nodes have been stored before using
+             * add_locations_to_ways() from several threads.
              */
-            void way(osmium::Way& way) {
+            void prepare_for_lookup() {
                 if (m_must_sort) {
                     m_storage_pos.sort();
                     m_storage_neg.sort();
                     m_must_sort = false;
                     m_last_id = std::numeric_limits<osmium::unsigned_object_id_type>::max();
                 }
-                bool error = false;
-                for (auto& node_ref : way.nodes()) {
-                    node_ref.set_location(get_node_location(node_ref.ref()));
-                    if (!node_ref.location()) {
-                        error = true;
-                    }
+            }
+
+            /**
+             * Retrieve locations of all nodes in the way from storage and add
+             * them to the way object.
+             */
+            void way(osmium::Way& way) {
+                prepare_for_lookup();
+
+                m_ids.clear();
+                collect_ids(way.nodes(), m_ids);
+                m_locations.resize(m_ids.size());
+                m_storage_pos.get_many(m_ids.data(), m_locations.data(), m_ids.size());
+
+                const osmium::Location* location = m_locations.data();
+                if (!set_locations(way.nodes(), location) && !m_ignore_errors) {
+                    throw osmium::not_found{"location for one or more nodes not found in node location index"};
+                }
+            }
+
+            /**
+             * Retrieve locations of all nodes in all ways in the buffer from
+             * storage and add them to the way objects. Other objects in the
+             * buffer are ignored, node locations are not stored.
+             *
+             * This only reads from the indexes, so it can be called for
+             * different buffers from several threads at the same time as
+             * long as nobody changes the indexes. Call prepare_for_lookup()
+             * after all nodes have been stored and before calling this.
+             *
+             * @throws osmium::not_found If a location is missing and errors
+             *         are not ignored. Locations of all ways in the buffer
+             *         are still set in this case.
+             */
+            void add_locations_to_ways(osmium::memory::Buffer& buffer) const {
+                std::vector<osmium::unsigned_object_id_type> ids;
+                for (const auto& way : buffer.select<osmium::Way>()) {
+                    collect_ids(way.nodes(), ids);
+                }
+
+                std::vector<osmium::Location> locations(ids.size());
+                m_storage_pos.get_many(ids.data(), locations.data(), ids.size());
+
+                bool okay = true;
+                const osmium::Location* location = locations.data();
+                for (auto& way : buffer.select<osmium::Way>()) {
+                    okay &= set_locations(way.nodes(), location);
                 }
-                if (!m_ignore_errors && error) {
+                if (!okay && !m_ignore_errors) {
                     throw osmium::not_found{"location for one or more nodes not found in node location index"};
                 }
             }
@@ -0,0 +1,189 @@
+#ifndef OSMIUM_HANDLER_PARALLEL_NODE_LOCATIONS_FOR_WAYS_HPP
+#define OSMIUM_HANDLER_PARALLEL_NODE_LOCATIONS_FOR_WAYS_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <utility>
+
+namespace osmium {
+
+    namespace handler {
+
+        namespace detail {
+
+            template <typename TLocationHandler>
+            class add_locations_to_ways_task {
+
+                osmium::memory::Buffer m_buffer;
+                const TLocationHandler* m_handler;
+
+            public:
+
+                add_locations_to_ways_task(osmium::memory::Buffer&& buffer, const TLocationHandler& handler) :
+                    m_buffer(std::move(buffer)),
+                    m_handler(&handler) {
+                }
+
+                osmium::memory::Buffer operator()() {
+                    m_handler->add_locations_to_ways(m_buffer);
+                    return std::move(m_buffer);
+                }
+
+            }; // class add_locations_to_ways_task
+
+        } // namespace detail
+
+        /**
+         * Reads buffers from a source and adds node locations to all ways
+         * in them using several threads from the thread pool. The buffers
+         * are returned from read() in the same order they were read from
+         * the source, so they can be handed to handlers that depend on the
+         * order of the objects.
+         *
+         * This is for the second pass of a two-pass program: All node
+         * locations must already be stored in the index of the location
+         * handler, it is only read from here. Nodes in the buffers are
+         * not added to the index. If the location handler is set to
+         * ignore errors, missing locations are left undefined, otherwise
+         * read() throws osmium::not_found.
+         *
+         * @code
+         * osmium::io::Reader reader{"input.osm.pbf", osmium::osm_entity_bits::way};
+         * osmium::handler::ParallelNodeLocationsForWays<osmium::io::Reader, location_handler_type>
+         *     source{reader, location_handler};
+         * while (osmium::memory::Buffer buffer = source.read()) {
+         *     osmium::apply(buffer, handler);
+         * }
+         * @endcode
+         *
+         * The source, the location handler, and its indexes must not be
+         * used or changed by anybody else while this object exists.
+         *
+         * @tparam TSource Source with a read() function returning buffers
+         *                 (usually an osmium::io::Reader).
+         * @tparam TLocationHandler Usually an instantiation of the
+         *                          NodeLocationsForWays class.
+         */
+        template <typename TSource, typename TLocationHandler>
+        class ParallelNodeLocationsForWays {
+
+            TSource& m_source;
+            const TLocationHandler& m_handler;
+            osmium::thread::Pool& m_pool;
+            std::deque<std::future<osmium::memory::Buffer>> m_results;
+            std::size_t m_max_pending;
+            bool m_done = false;
+
+        public:
+
+            /**
+             * Construct the stage.
+             *
+             * @param source The source to read from.
+             * @param handler The location handler. Its indexes are sorted
+             *                if needed.
+             * @param pool The thread pool to use.
+             * @param max_pending Number of buffers being worked on at the
+             *                    same time. If this is 0, twice the number
+             *                    of threads in the pool is used.
+             */
+            ParallelNodeLocationsForWays(TSource& source,
+                                         TLocationHandler& handler,
+                                         osmium::thread::Pool& pool = osmium::thread::Pool::default_instance(),
+                                         std::size_t max_pending = 0) :
+                m_source(source),
+                m_handler(handler),
+                m_pool(pool),
+                m_results(),
+                m_max_pending(max_pending > 0 ? max_pending : 2 * static_cast<std::size_t>(pool.num_threads())) {
+                handler.prepare_for_lookup();
+            }
+
+            ParallelNodeLocationsForWays(const ParallelNodeLocationsForWays&) = delete;
+            ParallelNodeLocationsForWays& operator=(const ParallelNodeLocationsForWays&) = delete;
+
+            ParallelNodeLocationsForWays(ParallelNodeLocationsForWays&&) = delete;
+            ParallelNodeLocationsForWays& operator=(ParallelNodeLocationsForWays&&) = delete;
+
+            /**
+             * Waits for all outstanding tasks, because they reference the
+             * location handler.
+             */
+            ~ParallelNodeLocationsForWays() noexcept {
+                for (auto& result : m_results) {
+                    if (result.valid()) {
+                        result.wait();
+                    }
+                }
+            }
+
+            /**
+             * Get the next buffer with locations added to the ways. Returns
+             * an invalid buffer at the end of the data.
+             *
+             * @throws Any exception thrown by the source or
+             *         osmium::not_found if a location is missing.
+             */
+            osmium::memory::Buffer read() {
+                while (!m_done && m_results.size() < m_max_pending) {
+                    osmium::memory::Buffer buffer = m_source.read();
+                    if (!buffer) {
+                        m_done = true;
+                        break;
+                    }
+                    m_results.push_back(m_pool.submit(detail::add_locations_to_ways_task<TLocationHandler>{std::move(buffer), m_handler}));
+                }
+
+                if (m_results.empty()) {
+                    return osmium::memory::Buffer{};
+                }
+
+                std::future<osmium::memory::Buffer> result = std::move(m_results.front());
+                m_results.pop_front();
+                m_pool.wait(result);
+                return result.get();
+            }
+
+        }; // class ParallelNodeLocationsForWays
+
+    } // namespace handler
+
+} // namespace osmium
+
+#endif // OSMIUM_HANDLER_PARALLEL_NODE_LOCATIONS_FOR_WAYS_HPP
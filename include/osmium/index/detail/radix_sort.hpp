@@ -0,0 +1,414 @@
+#ifndef OSMIUM_INDEX_DETAIL_RADIX_SORT_HPP
+#define OSMIUM_INDEX_DETAIL_RADIX_SORT_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/thread/pool.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace osmium {
+
+    namespace index {
+
+        namespace detail {
+
+            /// Ranges smaller than this are sorted with std::sort.
+            constexpr const std::size_t min_radix_sort_size = 64UL * 1024UL;
+
+            /// Buckets smaller than this are sorted with std::sort.
+            constexpr const std::size_t min_radix_sort_bucket_size = 256;
+
+            /**
+             * Buckets larger than this are partitioned further in place
+             * instead of being sorted using a temporary buffer. This
+             * limits the temporary memory of each sort task to this many
+             * elements.
+             */
+            constexpr const std::size_t max_radix_sort_bucket_size = 1024UL * 1024UL;
+
+            constexpr const unsigned int radix_sort_digit_bits = 8;
+
+            constexpr const std::size_t radix_sort_num_buckets = std::size_t(1) << radix_sort_digit_bits;
+
+            /**
+             * Key function for radix_sort() on std::pair with an integer
+             * as first member. For signed integers the sign bit is
+             * flipped, so that negative ids are ordered before positive
+             * ones like operator< does.
+             */
+            struct sort_key_first {
+
+                template <typename T>
+                static uint64_t key(const T value, std::true_type /*is_signed*/) noexcept {
+                    return static_cast<uint64_t>(static_cast<int64_t>(value)) ^ (uint64_t(1) << 63U);
+                }
+
+                template <typename T>
+                static uint64_t key(const T value, std::false_type /*is_signed*/) noexcept {
+                    return static_cast<uint64_t>(value);
+                }
+
+                template <typename T>
+                uint64_t operator()(const T& value) const noexcept {
+                    using key_type = decltype(value.first);
+                    static_assert(std::is_integral<key_type>::value && sizeof(key_type) <= sizeof(uint64_t), "sort_key_first needs an integer with at most 64 bits as first member");
+                    return key(value.first, std::is_signed<key_type>{});
+                }
+
+            }; // struct sort_key_first
+
+            // Wait for all futures, even if some of them throw, because
+            // the tasks still work on the data. Rethrows the first
+            // exception (or the one given) afterwards. Runs other tasks
+            // from the pool while waiting, so this works in pool tasks.
+            inline void wait_for_sort_tasks(osmium::thread::Pool& pool, std::vector<std::future<void>>& futures, std::exception_ptr exception = nullptr) {
+                for (auto& future : futures) {
+                    try {
+                        pool.wait(future);
+                        future.get();
+                    } catch (...) {
+                        if (!exception) {
+                            exception = std::current_exception();
+                        }
+                    }
+                }
+                futures.clear();
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+            }
+
+            // Run func(begin, end) for num_chunks chunks of [0, size) in
+            // the pool and wait for all of them.
+            template <typename TFunc>
+            void for_each_sort_chunk(std::size_t size, std::size_t num_chunks, osmium::thread::Pool& pool, TFunc&& func) {
+                std::vector<std::future<void>> futures;
+                try {
+                    for (std::size_t i = 0; i < num_chunks; ++i) {
+                        const std::size_t begin = size * i / num_chunks;
+                        const std::size_t end = size * (i + 1) / num_chunks;
+                        futures.push_back(pool.submit([&func, i, begin, end]() {
+                            func(i, begin, end);
+                        }));
+                    }
+                } catch (...) {
+                    wait_for_sort_tasks(pool, futures, std::current_exception());
+                }
+                wait_for_sort_tasks(pool, futures);
+            }
+
+            using radix_sort_starts_type = std::array<std::size_t, radix_sort_num_buckets + 1>;
+
+            // Number of bits needed for the keys from min_key to max_key.
+            inline unsigned int radix_sort_key_bits(const uint64_t min_key, const uint64_t max_key) noexcept {
+                unsigned int bits = 0;
+                for (uint64_t range = max_key - min_key; range != 0; range >>= 1U) {
+                    ++bits;
+                }
+                return bits;
+            }
+
+            // Move the elements into the buckets given by digit() in
+            // place (American flag sort). Bucket b is [starts[b],
+            // starts[b + 1]).
+            template <typename TIterator, typename TDigit>
+            void radix_partition(TIterator first, const radix_sort_starts_type& starts, TDigit&& digit) {
+                std::array<std::size_t, radix_sort_num_buckets> next;
+                std::copy_n(starts.cbegin(), radix_sort_num_buckets, next.begin());
+                for (std::size_t b = 0; b < radix_sort_num_buckets; ++b) {
+                    while (next[b] < starts[b + 1]) {
+                        auto it = first + static_cast<std::ptrdiff_t>(next[b]);
+                        const std::size_t d = digit(*it);
+                        if (d == b) {
+                            ++next[b];
+                        } else {
+                            using std::swap;
+                            swap(*it, *(first + static_cast<std::ptrdiff_t>(next[d]++)));
+                        }
+                    }
+                }
+            }
+
+            // Sort runs of elements with the same key by their full order.
+            template <typename TIterator, typename TKey>
+            void sort_equal_key_runs(TIterator first, TIterator last, TKey& key) {
+                while (first != last) {
+                    const auto k = key(*first);
+                    TIterator end = std::next(first);
+                    while (end != last && key(*end) == k) {
+                        ++end;
+                    }
+                    if (std::distance(first, end) > 1) {
+                        std::sort(first, end);
+                    }
+                    first = end;
+                }
+            }
+
+            /**
+             * LSD radix sort of one bucket on the lower "bits" bits of
+             * (key - min_key). All higher bits are the same in a bucket.
+             * Buckets larger than max_radix_sort_bucket_size are first
+             * partitioned in place on the highest of these bits (MSD) and
+             * the parts are sorted recursively.
+             */
+            template <typename TIterator, typename TKey>
+            void radix_sort_bucket(TIterator first, TIterator last, TKey& key, const uint64_t min_key, const unsigned int bits) {
+                using value_type = typename std::iterator_traits<TIterator>::value_type;
+
+                const auto size = static_cast<std::size_t>(std::distance(first, last));
+                if (size < min_radix_sort_bucket_size) {
+                    std::sort(first, last);
+                    return;
+                }
+                if (bits == 0) {
+                    sort_equal_key_runs(first, last, key);
+                    return;
+                }
+
+                if (size > max_radix_sort_bucket_size) {
+                    const unsigned int shift = bits > radix_sort_digit_bits ? bits - radix_sort_digit_bits : 0;
+                    const auto digit = [&](const value_type& value) {
+                        return static_cast<std::size_t>(((key(value) - min_key) >> shift) & (radix_sort_num_buckets - 1));
+                    };
+
+                    radix_sort_starts_type starts{};
+                    for (auto it = first; it != last; ++it) {
+                        ++starts[digit(*it) + 1];
+                    }
+                    for (std::size_t b = 0; b < radix_sort_num_buckets; ++b) {
+                        starts[b + 1] += starts[b];
+                    }
+
+                    radix_partition(first, starts, digit);
+
+                    for (std::size_t b = 0; b < radix_sort_num_buckets; ++b) {
+                        radix_sort_bucket(first + static_cast<std::ptrdiff_t>(starts[b]),
+                                          first + static_cast<std::ptrdiff_t>(starts[b + 1]),
+                                          key, min_key, shift);
+                    }
+                    return;
+                }
+
+                // Find out which bits are different at all, digits where
+                // all keys are the same are skipped.
+                uint64_t all_or = 0;
+                uint64_t all_and = ~uint64_t(0);
+                for (auto it = first; it != last; ++it) {
+                    const uint64_t k = key(*it) - min_key;
+                    all_or |= k;
+                    all_and &= k;
+                }
+                const uint64_t varying = all_or ^ all_and;
+
+                std::vector<value_type> buffer(first, last);
+                bool in_buffer = true;
+
+                for (unsigned int shift = 0; shift < bits; shift += radix_sort_digit_bits) {
+                    if (((varying >> shift) & (radix_sort_num_buckets - 1)) == 0) {
+                        continue;
+                    }
+
+                    std::array<std::size_t, radix_sort_num_buckets> offsets{};
+                    const auto digit = [&](const value_type& value) {
+                        return static_cast<std::size_t>(((key(value) - min_key) >> shift) & (radix_sort_num_buckets - 1));
+                    };
+
+                    if (in_buffer) {
+                        for (const auto& value : buffer) {
+                            ++offsets[digit(value)];
+                        }
+                    } else {
+                        for (auto it = first; it != last; ++it) {
+                            ++offsets[digit(*it)];
+                        }
+                    }
+
+                    std::size_t sum = 0;
+                    for (auto& offset : offsets) {
+                        const std::size_t count = offset;
+                        offset = sum;
+                        sum += count;
+                    }
+
+                    if (in_buffer) {
+                        for (const auto& value : buffer) {
+                            *(first + static_cast<std::ptrdiff_t>(offsets[digit(value)]++)) = value;
+                        }
+                    } else {
+                        for (auto it = first; it != last; ++it) {
+                            buffer[offsets[digit(*it)]++] = *it;
+                        }
+                    }
+                    in_buffer = !in_buffer;
+                }
+
+                if (in_buffer) {
+                    std::copy(buffer.cbegin(), buffer.cend(), first);
+                }
+
+                sort_equal_key_runs(first, last, key);
+            }
+
+            /**
+             * Sort the range [first, last) using the threads in the pool.
+             * The elements are ordered by a 64 bit unsigned integer key
+             * returned by the key function. The operator< of the elements
+             * must order them by that key first, elements with the same
+             * key are sorted with std::sort, so the result is the same as
+             * from std::sort on the whole range.
+             *
+             * This is a radix sort: The range is first partitioned in
+             * place on the highest 8 bits of the key range (MSD). Then the
+             * 256 buckets are sorted in parallel on the remaining bits
+             * (LSD), each using temporary memory of the size of the
+             * bucket. Buckets with more than max_radix_sort_bucket_size
+             * elements are partitioned further in place first, so the
+             * extra memory needed is at most the number of threads times
+             * max_radix_sort_bucket_size elements. Digits where all keys
+             * are the same are skipped. Small ranges are sorted with
+             * std::sort in the calling thread.
+             *
+             * This can be called from a task running in the same pool,
+             * the calling thread runs other tasks while waiting.
+             */
+            template <typename TIterator, typename TKey>
+            void radix_sort(TIterator first, TIterator last, TKey&& key, osmium::thread::Pool& pool) {
+                const auto size = static_cast<std::size_t>(std::distance(first, last));
+                if (size < min_radix_sort_size) {
+                    std::sort(first, last);
+                    return;
+                }
+
+                const auto num_chunks = static_cast<std::size_t>(std::max(pool.num_threads(), 1));
+
+                // Key range
+                std::vector<std::pair<uint64_t, uint64_t>> min_max(num_chunks, std::make_pair(~uint64_t(0), uint64_t(0)));
+                for_each_sort_chunk(size, num_chunks, pool, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+                    auto& mm = min_max[chunk];
+                    for (auto it = first + static_cast<std::ptrdiff_t>(begin); it != first + static_cast<std::ptrdiff_t>(end); ++it) {
+                        const uint64_t k = key(*it);
+                        mm.first = std::min(mm.first, k);
+                        mm.second = std::max(mm.second, k);
+                    }
+                });
+                uint64_t min_key = ~uint64_t(0);
+                uint64_t max_key = 0;
+                for (const auto& mm : min_max) {
+                    min_key = std::min(min_key, mm.first);
+                    max_key = std::max(max_key, mm.second);
+                }
+
+                const unsigned int bits = radix_sort_key_bits(min_key, max_key);
+                const unsigned int shift = bits > radix_sort_digit_bits ? bits - radix_sort_digit_bits : 0;
+                const auto top_digit = [&](const typename std::iterator_traits<TIterator>::value_type& value) {
+                    return static_cast<std::size_t>((key(value) - min_key) >> shift);
+                };
+
+                // Histogram of the top digit
+                std::vector<std::array<std::size_t, radix_sort_num_buckets>> counts(num_chunks);
+                for_each_sort_chunk(size, num_chunks, pool, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+                    auto& count = counts[chunk];
+                    count.fill(0);
+                    for (auto it = first + static_cast<std::ptrdiff_t>(begin); it != first + static_cast<std::ptrdiff_t>(end); ++it) {
+                        ++count[top_digit(*it)];
+                    }
+                });
+
+                radix_sort_starts_type starts{};
+                for (std::size_t b = 0; b < radix_sort_num_buckets; ++b) {
+                    std::size_t count = 0;
+                    for (const auto& c : counts) {
+                        count += c[b];
+                    }
+                    starts[b + 1] = starts[b] + count;
+                }
+
+                radix_partition(first, starts, top_digit);
+
+                // Sort the buckets in parallel, largest first
+                std::vector<std::size_t> buckets;
+                for (std::size_t b = 0; b < radix_sort_num_buckets; ++b) {
+                    if (starts[b + 1] - starts[b] > 1) {
+                        buckets.push_back(b);
+                    }
+                }
+                std::sort(buckets.begin(), buckets.end(), [&starts](std::size_t a, std::size_t b) {
+                    return starts[a + 1] - starts[a] > starts[b + 1] - starts[b];
+                });
+
+                std::vector<std::future<void>> futures;
+                try {
+                    for (const auto b : buckets) {
+                        const TIterator begin = first + static_cast<std::ptrdiff_t>(starts[b]);
+                        const TIterator end = first + static_cast<std::ptrdiff_t>(starts[b + 1]);
+                        futures.push_back(pool.submit([&key, begin, end, min_key, shift]() {
+                            radix_sort_bucket(begin, end, key, min_key, shift);
+                        }));
+                    }
+                } catch (...) {
+                    wait_for_sort_tasks(pool, futures, std::current_exception());
+                }
+                wait_for_sort_tasks(pool, futures);
+            }
+
+            /**
+             * Same as above using the default pool. Small ranges are
+             * sorted without starting the default pool.
+             */
+            template <typename TIterator, typename TKey>
+            void radix_sort(TIterator first, TIterator last, TKey&& key) {
+                if (static_cast<std::size_t>(std::distance(first, last)) < min_radix_sort_size) {
+                    std::sort(first, last);
+                    return;
+                }
+                radix_sort(first, last, std::forward<TKey>(key), osmium::thread::Pool::default_instance());
+            }
+
+        } // namespace detail
+
+    } // namespace index
+
+} // namespace osmium
+
+#endif // OSMIUM_INDEX_DETAIL_RADIX_SORT_HPP
@@ -33,12 +33,15 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <osmium/index/detail/radix_sort.hpp>
 #include <osmium/index/index.hpp>
 #include <osmium/index/map.hpp>
 #include <osmium/io/detail/read_write.hpp>
+#include <osmium/util/compatibility.hpp>
 
 #include <algorithm>
 #include <cstddef>
+#include <functional>
 #include <utility>
 
 namespace osmium {
@@ -52,6 +55,12 @@ namespace osmium {
 
                 TVector m_vector;
 
+                // Size needed for the reservations made with reserve_for()
+                // since the last finish_reserved(). The vector can be
+                // larger while they are being filled.
+                std::size_t m_reserved_size = 0;
+                bool m_reserving = false;
+
             public:
 
                 using element_type   = TValue;
@@ -78,6 +87,53 @@ namespace osmium {
                     m_vector[id] = value;
                 }
 
+                void set_many(const TId* ids, const TValue* values, const std::size_t count) final {
+                    if (count == 0) {
+                        return;
+                    }
+                    const TId max_id = *std::max_element(ids, ids + count);
+                    if (size() <= max_id) {
+                        m_vector.resize(max_id + 1);
+                    }
+                    for (std::size_t i = 0; i < count; ++i) {
+                        m_vector[ids[i]] = values[i];
+                    }
+                }
+
+                bool reserve_for(const TId max_id, const std::size_t /*count*/, const std::function<void()>& wait_for_writers, std::size_t& position) final {
+                    position = 0;
+                    if (!m_reserving) {
+                        m_reserving = true;
+                        m_reserved_size = m_vector.size();
+                    }
+                    const std::size_t needed = static_cast<std::size_t>(max_id) + 1;
+                    if (needed > m_reserved_size) {
+                        m_reserved_size = needed;
+                        // The vector is only resized while no writers
+                        // are running. Growing it in larger steps means
+                        // they rarely have to be waited for.
+                        if (needed > m_vector.size()) {
+                            wait_for_writers();
+                            m_vector.resize(needed + needed / 8);
+                        }
+                    }
+                    return true;
+                }
+
+                void set_reserved(const std::size_t /*position*/, const TId* ids, const TValue* values, const std::size_t count) final {
+                    TValue* data = m_vector.data();
+                    for (std::size_t i = 0; i < count; ++i) {
+                        data[ids[i]] = values[i];
+                    }
+                }
+
+                void finish_reserved() final {
+                    if (m_reserving) {
+                        m_vector.resize(m_reserved_size);
+                        m_reserving = false;
+                    }
+                }
+
                 TValue get(const TId id) const final {
                     if (id >= m_vector.size()) {
                         throw osmium::not_found{id};
@@ -96,6 +152,24 @@ namespace osmium {
                     return m_vector[id];
                 }
 
+                void get_many(const TId* ids, TValue* values, const std::size_t count) const noexcept final {
+                    // How many lookups ahead the memory is prefetched.
+                    constexpr const std::size_t prefetch_distance = 16;
+
+                    const std::size_t size = m_vector.size();
+                    for (std::size_t i = 0; i < std::min(count, prefetch_distance); ++i) {
+                        if (ids[i] < size) {
+                            OSMIUM_PREFETCH(&m_vector[ids[i]]);
+                        }
+                    }
+                    for (std::size_t i = 0; i < count; ++i) {
+                        if (i + prefetch_distance < count && ids[i + prefetch_distance] < size) {
+                            OSMIUM_PREFETCH(&m_vector[ids[i + prefetch_distance]]);
+                        }
+                        values[i] = ids[i] < size ? m_vector[ids[i]] : osmium::index::empty_value<TValue>();
+                    }
+                }
+
                 std::size_t size() const final {
                     return m_vector.size();
                 }
@@ -158,6 +232,12 @@ namespace osmium {
 
                 vector_type m_vector;
 
+                // Number of elements used by the reservations made with
+                // reserve_for() since the last finish_reserved(). The
+                // vector can be larger while they are being filled.
+                std::size_t m_reserved_size = 0;
+                bool m_reserving = false;
+
                 typename vector_type::const_iterator find_id(const TId id) const noexcept {
                     const element_type element {
                         id,
@@ -168,6 +248,43 @@ namespace osmium {
                     });
                 }
 
+                // Maximum number of binary searches run at the same time.
+                static constexpr const std::size_t max_interleave = 16;
+
+                /**
+                 * Look up the ids in [ids, ids + count) with interleaved
+                 * branchless binary searches. All searches take the same
+                 * number of steps, so the memory accesses of one step can
+                 * all be in flight at the same time.
+                 */
+                void find_ids(const TId* ids, TValue* values, const std::size_t count) const noexcept {
+                    const element_type* const first = m_vector.data();
+                    const element_type* const last = first + m_vector.size();
+                    const element_type* pos[max_interleave];
+
+                    for (std::size_t i = 0; i < count; ++i) {
+                        pos[i] = first;
+                    }
+
+                    std::size_t len = m_vector.size();
+                    while (len > 1) {
+                        const std::size_t half = len / 2;
+                        for (std::size_t i = 0; i < count; ++i) {
+                            OSMIUM_PREFETCH(pos[i] + half / 2);
+                            OSMIUM_PREFETCH(pos[i] + half + half / 2);
+                        }
+                        for (std::size_t i = 0; i < count; ++i) {
+                            pos[i] = (pos[i][half].first < ids[i]) ? pos[i] + half : pos[i];
+                        }
+                        len -= half;
+                    }
+
+                    for (std::size_t i = 0; i < count; ++i) {
+                        const element_type* result = pos[i] + (pos[i]->first < ids[i]);
+                        values[i] = (result != last && result->first == ids[i]) ? result->second : osmium::index::empty_value<TValue>();
+                    }
+                }
+
             public:
 
                 VectorBasedSparseMap() :
@@ -182,6 +299,43 @@ namespace osmium {
                     m_vector.push_back(element_type(id, value));
                 }
 
+                void set_many(const TId* ids, const TValue* values, const std::size_t count) final {
+                    for (std::size_t i = 0; i < count; ++i) {
+                        m_vector.push_back(element_type(ids[i], values[i]));
+                    }
+                }
+
+                bool reserve_for(const TId /*max_id*/, const std::size_t count, const std::function<void()>& wait_for_writers, std::size_t& position) final {
+                    if (!m_reserving) {
+                        m_reserving = true;
+                        m_reserved_size = m_vector.size();
+                    }
+                    position = m_reserved_size;
+                    m_reserved_size += count;
+                    // The vector is only resized while no writers are
+                    // running. Growing it in larger steps means they
+                    // rarely have to be waited for.
+                    if (m_reserved_size > m_vector.size()) {
+                        wait_for_writers();
+                        m_vector.resize(std::max(m_reserved_size, m_vector.size() + m_vector.size() / 2));
+                    }
+                    return true;
+                }
+
+                void set_reserved(const std::size_t position, const TId* ids, const TValue* values, const std::size_t count) final {
+                    element_type* data = m_vector.data() + position;
+                    for (std::size_t i = 0; i < count; ++i) {
+                        data[i] = element_type(ids[i], values[i]);
+                    }
+                }
+
+                void finish_reserved() final {
+                    if (m_reserving) {
+                        m_vector.resize(m_reserved_size);
+                        m_reserving = false;
+                    }
+                }
+
                 TValue get(const TId id) const final {
                     const auto result = find_id(id);
                     if (result == m_vector.end() || result->first != id) {
@@ -200,6 +354,18 @@ namespace osmium {
                     return result->second;
                 }
 
+                void get_many(const TId* ids, TValue* values, const std::size_t count) const noexcept final {
+                    if (m_vector.empty()) {
+                        std::fill_n(values, count, osmium::index::empty_value<TValue>());
+                        return;
+                    }
+                    std::size_t i = 0;
+                    for (; i + max_interleave <= count; i += max_interleave) {
+                        find_ids(ids + i, values + i, max_interleave);
+                    }
+                    find_ids(ids + i, values + i, count - i);
+                }
+
                 std::size_t size() const final {
                     return m_vector.size();
                 }
@@ -217,8 +383,18 @@ namespace osmium {
                     m_vector.shrink_to_fit();
                 }
 
+                /**
+                 * Sort the data using the threads in the default pool.
+                 */
                 void sort() final {
-                    std::sort(m_vector.begin(), m_vector.end());
+                    osmium::index::detail::radix_sort(m_vector.begin(), m_vector.end(), osmium::index::detail::sort_key_first{});
+                }
+
+                /**
+                 * Sort the data using the threads in the given pool.
+                 */
+                void sort(osmium::thread::Pool& pool) final {
+                    osmium::index::detail::radix_sort(m_vector.begin(), m_vector.end(), osmium::index::detail::sort_key_first{}, pool);
                 }
 
                 void dump_as_list(const int fd) final {
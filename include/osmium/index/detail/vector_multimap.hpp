@@ -33,6 +33,7 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <osmium/index/detail/radix_sort.hpp>
 #include <osmium/index/index.hpp>
 #include <osmium/index/multimap.hpp>
 #include <osmium/io/detail/read_write.hpp>
@@ -120,8 +121,18 @@ namespace osmium {
                     m_vector.shrink_to_fit();
                 }
 
+                /**
+                 * Sort the data using the threads in the default pool.
+                 */
                 void sort() final {
-                    std::sort(m_vector.begin(), m_vector.end());
+                    osmium::index::detail::radix_sort(m_vector.begin(), m_vector.end(), osmium::index::detail::sort_key_first{});
+                }
+
+                /**
+                 * Sort the data using the threads in the given pool.
+                 */
+                void sort(osmium::thread::Pool& pool) final {
+                    osmium::index::detail::radix_sort(m_vector.begin(), m_vector.end(), osmium::index::detail::sort_key_first{}, pool);
                 }
 
                 void remove(const TId id, const TValue value) {
@@ -135,7 +146,7 @@ namespace osmium {
                 }
 
                 void consolidate() {
-                    std::sort(m_vector.begin(), m_vector.end());
+                    sort();
                 }
 
                 void erase_removed() {
@@ -47,6 +47,10 @@ DEALINGS IN THE SOFTWARE.
 
 namespace osmium {
 
+    namespace thread {
+        class Pool;
+    } // namespace thread
+
     struct map_factory_error : public std::runtime_error {
 
         explicit map_factory_error(const char* message) :
@@ -125,6 +129,74 @@ namespace osmium {
                 /// Set the field with id to value.
                 virtual void set(const TId id, const TValue value) = 0;
 
+                /**
+                 * Set the values for several ids at once. Does the same as
+                 * calling set() for each id, but some implementations can do
+                 * this faster, because they only have to grow once.
+                 *
+                 * @param ids Pointer to the ids.
+                 * @param values Pointer to the values in the same order.
+                 * @param count Number of ids and values.
+                 */
+                virtual void set_many(const TId* ids, const TValue* values, const std::size_t count) {
+                    for (std::size_t i = 0; i < count; ++i) {
+                        set(ids[i], values[i]);
+                    }
+                }
+
+                /**
+                 * Make room for count values with ids up to max_id to be
+                 * written later with set_reserved(). Together these allow
+                 * filling the map from several threads at the same time,
+                 * see the ParallelMapLoader class. Must not be called while
+                 * another thread is in reserve_for(). Call
+                 * finish_reserved() after the last set_reserved() call has
+                 * finished.
+                 *
+                 * If the map has to grow its storage, it calls
+                 * wait_for_writers first, which must wait until all
+                 * set_reserved() calls still running have finished. Maps
+                 * grow in larger steps than needed, so this is rarely
+                 * the case.
+                 *
+                 * @param max_id The largest id that will be set.
+                 * @param count Number of values that will be set.
+                 * @param wait_for_writers Called before data is moved.
+                 * @param position Set to the value that has to be handed
+                 *                 to set_reserved().
+                 * @returns False if the map doesn't support this. This is
+                 *          what the default implementation does.
+                 */
+                virtual bool reserve_for(const TId /*max_id*/, const std::size_t /*count*/, const std::function<void()>& /*wait_for_writers*/, std::size_t& /*position*/) {
+                    return false;
+                }
+
+                /**
+                 * Set the values for ids in space reserved with
+                 * reserve_for(). Can be called from several threads at the
+                 * same time with different reservations as long as no id
+                 * is set more than once.
+                 *
+                 * @param position The position returned by reserve_for().
+                 * @param ids Pointer to the ids.
+                 * @param values Pointer to the values in the same order.
+                 * @param count Number of ids and values. Must be the same
+                 *              as the count given to reserve_for().
+                 */
+                virtual void set_reserved(const std::size_t /*position*/, const TId* ids, const TValue* values, const std::size_t count) {
+                    set_many(ids, values, count);
+                }
+
+                /**
+                 * Give back the space reserved by reserve_for() but not
+                 * needed. Must be called after all set_reserved() calls
+                 * have finished and before the map is used in any other
+                 * way. The default implementation does nothing.
+                 */
+                virtual void finish_reserved() {
+                    // default implementation is empty
+                }
+
                 /**
                  * Retrieve value by id.
                  *
@@ -145,6 +217,25 @@ namespace osmium {
                  */
                 virtual TValue get_noexcept(const TId id) const noexcept = 0;
 
+                /**
+                 * Retrieve the values for several ids at once. Does the
+                 * same as calling get_noexcept() for each id, but some
+                 * implementations can do this faster, because they can
+                 * prefetch the memory for later ids or interleave the
+                 * lookups.
+                 *
+                 * @param ids Pointer to the ids to look for.
+                 * @param values Pointer to space for the values. The
+                 *               values not found are set to the empty
+                 *               value.
+                 * @param count Number of ids and values.
+                 */
+                virtual void get_many(const TId* ids, TValue* values, const std::size_t count) const noexcept {
+                    for (std::size_t i = 0; i < count; ++i) {
+                        values[i] = get_noexcept(ids[i]);
+                    }
+                }
+
                 /**
                  * Get the approximate number of items in the storage. The storage
                  * might allocate memory in blocks, so this size might not be
@@ -176,6 +267,14 @@ namespace osmium {
                     // default implementation is empty
                 }
 
+                /**
+                 * Sort data in map using the threads in the given pool.
+                 * The default implementation calls sort().
+                 */
+                virtual void sort(osmium::thread::Pool& /*pool*/) {
+                    sort();
+                }
+
                 // This function can usually be const in derived classes,
                 // but not always. It could, for instance, sort internal data.
                 // This is why it is not declared const here.
@@ -33,6 +33,7 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <osmium/index/detail/radix_sort.hpp>
 #include <osmium/index/index.hpp>
 #include <osmium/index/map.hpp>
 
@@ -229,7 +230,13 @@ namespace osmium {
                 }
 
                 void sort() final {
-                    std::sort(m_sparse_entries.begin(), m_sparse_entries.end());
+                    sort(osmium::thread::Pool::default_instance());
+                }
+
+                void sort(osmium::thread::Pool& pool) final {
+                    osmium::index::detail::radix_sort(m_sparse_entries.begin(), m_sparse_entries.end(), [](const entry& e) {
+                        return e.id;
+                    }, pool);
                 }
 
                 /**
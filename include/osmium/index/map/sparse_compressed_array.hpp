@@ -0,0 +1,380 @@
+#ifndef OSMIUM_INDEX_MAP_SPARSE_COMPRESSED_ARRAY_HPP
+#define OSMIUM_INDEX_MAP_SPARSE_COMPRESSED_ARRAY_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/index/detail/radix_sort.hpp>
+#include <osmium/index/index.hpp>
+#include <osmium/index/map.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define OSMIUM_HAS_INDEX_MAP_SPARSE_COMPRESSED_ARRAY
+
+namespace osmium {
+
+    namespace index {
+
+        namespace detail {
+
+            inline char* write_varint(char* out, uint64_t value) noexcept {
+                while (value >= 0x80U) {
+                    *out++ = static_cast<char>((value & 0x7fU) | 0x80U);
+                    value >>= 7U;
+                }
+                *out++ = static_cast<char>(value);
+                return out;
+            }
+
+            inline uint64_t read_varint(const char*& in) noexcept {
+                uint64_t value = 0;
+                unsigned int shift = 0;
+                while (true) {
+                    const auto byte = static_cast<uint8_t>(*in++);
+                    value |= static_cast<uint64_t>(byte & 0x7fU) << shift;
+                    if ((byte & 0x80U) == 0) {
+                        return value;
+                    }
+                    shift += 7;
+                }
+            }
+
+            inline constexpr uint64_t zigzag_encode(int64_t value) noexcept {
+                return (static_cast<uint64_t>(value) << 1U) ^ (static_cast<uint64_t>(value) >> 63U ? ~uint64_t(0) : uint64_t(0));
+            }
+
+            inline constexpr int64_t zigzag_decode(uint64_t value) noexcept {
+                return static_cast<int64_t>(value >> 1U) ^ -static_cast<int64_t>(value & 1U);
+            }
+
+        } // namespace detail
+
+        namespace map {
+
+            /**
+             * Sparse index for node locations that keeps the data
+             * compressed in memory. The entries are stored sorted by id in
+             * blocks of 128. For each block the first id and location is
+             * kept in an index which is searched with a binary search.
+             * The other entries in the block are stored as varint encoded
+             * differences to the previous id and location, which need only
+             * a few bytes if the ids are dense and neighbouring nodes are
+             * close together. A lookup decodes the block up to the id.
+             *
+             * This uses much less memory than the SparseMemArray (16 bytes
+             * per node) for extracts, but lookups are slower.
+             *
+             * Entries are compressed as they are added if the ids are
+             * added in order, as they are when reading an OSM file. Other
+             * entries are kept uncompressed until sort() is called, which
+             * then decompresses and recompresses all data. As with all
+             * sparse indexes, you have to call sort() before reading from
+             * the index if the ids were not in order.
+             *
+             * Only works with osmium::Location values.
+             */
+            template <typename TId, typename TValue>
+            class SparseCompressedArray : public osmium::index::map::Map<TId, TValue> {
+
+                static_assert(std::is_same<TValue, osmium::Location>::value, "SparseCompressedArray only works with osmium::Location values");
+
+                using element_type = std::pair<TId, TValue>;
+
+                // Number of entries in each compressed block.
+                enum constant_block_size : std::size_t {
+                    block_size = 128
+                };
+
+                // The compressed blocks are stored in chunks of memory
+                // which grow from this size...
+                enum constant_min_chunk_size : std::size_t {
+                    min_chunk_size = 16UL * 1024UL
+                };
+
+                // ...up to this size.
+                enum constant_max_chunk_size : std::size_t {
+                    max_chunk_size = 1024UL * 1024UL
+                };
+
+                // Largest possible size of a compressed block: Up to 10
+                // bytes each for the id and the two coordinates.
+                enum constant_max_block_bytes : std::size_t {
+                    max_block_bytes = block_size * 3 * 10
+                };
+
+                struct block_info {
+                    TId first_id;
+                    uint64_t position; // chunk number << 32 | offset in chunk
+                    int32_t x;
+                    int32_t y;
+                }; // struct block_info
+
+                std::vector<block_info> m_blocks;
+                std::vector<std::unique_ptr<char[]>> m_chunks;
+                std::size_t m_chunk_capacity = 0;
+                std::size_t m_chunk_used = 0;
+                std::size_t m_chunk_bytes = 0;
+
+                // Entries at the end which don't fill a block yet.
+                std::vector<element_type> m_tail;
+
+                // Entries added out of order, they are merged in sort().
+                std::vector<element_type> m_unsorted;
+
+                TId m_last_id = 0;
+
+                const char* block_data(const block_info& block) const noexcept {
+                    return m_chunks[block.position >> 32U].get() + (block.position & 0xffffffffU);
+                }
+
+                void compress_block(const element_type* entries) {
+                    char buffer[max_block_bytes];
+                    char* out = buffer;
+
+                    for (std::size_t i = 1; i < block_size; ++i) {
+                        out = osmium::index::detail::write_varint(out, entries[i].first - entries[i - 1].first);
+                        out = osmium::index::detail::write_varint(out, osmium::index::detail::zigzag_encode(int64_t(entries[i].second.x()) - entries[i - 1].second.x()));
+                        out = osmium::index::detail::write_varint(out, osmium::index::detail::zigzag_encode(int64_t(entries[i].second.y()) - entries[i - 1].second.y()));
+                    }
+
+                    const auto size = static_cast<std::size_t>(out - buffer);
+                    if (m_chunks.empty() || m_chunk_used + size > m_chunk_capacity) {
+                        const std::size_t capacity = m_chunks.empty() ? min_chunk_size : std::min(static_cast<std::size_t>(max_chunk_size), m_chunk_capacity * 2);
+                        std::unique_ptr<char[]> chunk{new char[capacity]};
+                        m_chunks.push_back(std::move(chunk));
+                        m_chunk_capacity = capacity;
+                        m_chunk_bytes += capacity;
+                        m_chunk_used = 0;
+                    }
+
+                    const uint64_t position = (static_cast<uint64_t>(m_chunks.size() - 1) << 32U) | m_chunk_used;
+                    std::memcpy(m_chunks.back().get() + m_chunk_used, buffer, size);
+                    m_chunk_used += size;
+
+                    m_blocks.push_back(block_info{entries[0].first, position, entries[0].second.x(), entries[0].second.y()});
+                }
+
+                void append(const TId id, const TValue value) {
+                    m_tail.emplace_back(id, value);
+                    m_last_id = id;
+                    if (m_tail.size() == block_size) {
+                        compress_block(m_tail.data());
+                        m_tail.clear();
+                    }
+                }
+
+                // Call func with each compressed entry in order.
+                template <typename TFunc>
+                void for_each_compressed(const block_info& block, TFunc&& func) const {
+                    TId id = block.first_id;
+                    int64_t x = block.x;
+                    int64_t y = block.y;
+                    func(id, TValue{static_cast<int32_t>(x), static_cast<int32_t>(y)});
+
+                    const char* in = block_data(block);
+                    for (std::size_t i = 1; i < block_size; ++i) {
+                        id += static_cast<TId>(osmium::index::detail::read_varint(in));
+                        x += osmium::index::detail::zigzag_decode(osmium::index::detail::read_varint(in));
+                        y += osmium::index::detail::zigzag_decode(osmium::index::detail::read_varint(in));
+                        func(id, TValue{static_cast<int32_t>(x), static_cast<int32_t>(y)});
+                    }
+                }
+
+                // Call func with all entries except the unsorted ones in order.
+                template <typename TFunc>
+                void for_each_entry(TFunc&& func) const {
+                    for (const auto& block : m_blocks) {
+                        for_each_compressed(block, func);
+                    }
+                    for (const auto& element : m_tail) {
+                        func(element.first, element.second);
+                    }
+                }
+
+                TValue find_in_block(const block_info& block, const TId id) const noexcept {
+                    TId current_id = block.first_id;
+                    int64_t x = block.x;
+                    int64_t y = block.y;
+
+                    const char* in = block_data(block);
+                    for (std::size_t i = 1; current_id < id && i < block_size; ++i) {
+                        current_id += static_cast<TId>(osmium::index::detail::read_varint(in));
+                        x += osmium::index::detail::zigzag_decode(osmium::index::detail::read_varint(in));
+                        y += osmium::index::detail::zigzag_decode(osmium::index::detail::read_varint(in));
+                    }
+
+                    if (current_id != id) {
+                        return osmium::index::empty_value<TValue>();
+                    }
+                    return TValue{static_cast<int32_t>(x), static_cast<int32_t>(y)};
+                }
+
+                TValue find(const TId id) const noexcept {
+                    if (!m_tail.empty() && id >= m_tail.front().first) {
+                        const auto it = std::lower_bound(m_tail.cbegin(), m_tail.cend(), id, [](const element_type& element, const TId i) {
+                            return element.first < i;
+                        });
+                        if (it == m_tail.cend() || it->first != id) {
+                            return osmium::index::empty_value<TValue>();
+                        }
+                        return it->second;
+                    }
+
+                    const auto it = std::upper_bound(m_blocks.cbegin(), m_blocks.cend(), id, [](const TId i, const block_info& block) {
+                        return i < block.first_id;
+                    });
+                    if (it == m_blocks.cbegin()) {
+                        return osmium::index::empty_value<TValue>();
+                    }
+                    return find_in_block(*std::prev(it), id);
+                }
+
+            public:
+
+                SparseCompressedArray() = default;
+
+                void set(const TId id, const TValue value) final {
+                    if (id < m_last_id) {
+                        m_unsorted.emplace_back(id, value);
+                    } else {
+                        append(id, value);
+                    }
+                }
+
+                TValue get(const TId id) const final {
+                    const TValue value = find(id);
+                    if (value == osmium::index::empty_value<TValue>()) {
+                        throw osmium::not_found{id};
+                    }
+                    return value;
+                }
+
+                TValue get_noexcept(const TId id) const noexcept final {
+                    return find(id);
+                }
+
+                std::size_t size() const noexcept final {
+                    return m_blocks.size() * block_size + m_tail.size() + m_unsorted.size();
+                }
+
+                std::size_t used_memory() const noexcept final {
+                    return m_chunk_bytes +
+                           m_chunks.capacity() * sizeof(std::unique_ptr<char[]>) +
+                           m_blocks.capacity() * sizeof(block_info) +
+                           m_tail.capacity() * sizeof(element_type) +
+                           m_unsorted.capacity() * sizeof(element_type);
+                }
+
+                void clear() final {
+                    m_blocks.clear();
+                    m_blocks.shrink_to_fit();
+                    m_chunks.clear();
+                    m_chunks.shrink_to_fit();
+                    m_chunk_capacity = 0;
+                    m_chunk_used = 0;
+                    m_chunk_bytes = 0;
+                    m_tail.clear();
+                    m_tail.shrink_to_fit();
+                    m_unsorted.clear();
+                    m_unsorted.shrink_to_fit();
+                    m_last_id = 0;
+                }
+
+                /**
+                 * Merge the entries added out of order. This needs memory
+                 * for all entries uncompressed for a short time. Does
+                 * nothing if all entries were added in order.
+                 */
+                void sort() final {
+                    sort(osmium::thread::Pool::default_instance());
+                }
+
+                /**
+                 * Same as sort() but sorts using the threads in the given
+                 * pool.
+                 */
+                void sort(osmium::thread::Pool& pool) final {
+                    if (m_unsorted.empty()) {
+                        return;
+                    }
+
+                    std::vector<element_type> elements;
+                    elements.reserve(size());
+                    for_each_entry([&elements](const TId id, const TValue value) {
+                        elements.emplace_back(id, value);
+                    });
+                    elements.insert(elements.end(), m_unsorted.cbegin(), m_unsorted.cend());
+
+                    clear();
+                    osmium::index::detail::radix_sort(elements.begin(), elements.end(), osmium::index::detail::sort_key_first{}, pool);
+
+                    m_blocks.reserve(elements.size() / block_size);
+                    for (const auto& element : elements) {
+                        append(element.first, element.second);
+                    }
+                }
+
+                void dump_as_list(const int fd) final {
+                    sort();
+                    std::vector<element_type> elements;
+                    elements.reserve(size());
+                    for_each_entry([&elements](const TId id, const TValue value) {
+                        elements.emplace_back(id, value);
+                    });
+                    osmium::io::detail::reliable_write(fd, reinterpret_cast<const char*>(elements.data()), sizeof(element_type) * elements.size());
+                }
+
+            }; // class SparseCompressedArray
+
+        } // namespace map
+
+    } // namespace index
+
+} // namespace osmium
+
+#ifdef OSMIUM_WANT_NODE_LOCATION_MAPS
+    REGISTER_MAP(osmium::unsigned_object_id_type, osmium::Location, osmium::index::map::SparseCompressedArray, sparse_compressed_array)
+#endif
+
+#endif // OSMIUM_INDEX_MAP_SPARSE_COMPRESSED_ARRAY_HPP
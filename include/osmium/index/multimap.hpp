@@ -40,6 +40,10 @@ DEALINGS IN THE SOFTWARE.
 
 namespace osmium {
 
+    namespace thread {
+        class Pool;
+    } // namespace thread
+
     namespace index {
 
         /**
@@ -112,6 +116,14 @@ namespace osmium {
                     // default implementation is empty
                 }
 
+                /**
+                 * Sort data in map using the threads in the given pool.
+                 * The default implementation calls sort().
+                 */
+                virtual void sort(osmium::thread::Pool& /*pool*/) {
+                    sort();
+                }
+
                 virtual void dump_as_list(const int /*fd*/) {
                     std::runtime_error("can't dump as list");
                 }
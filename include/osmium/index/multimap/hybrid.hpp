@@ -193,6 +193,10 @@ namespace osmium {
                     m_main.sort();
                 }
 
+                void sort(osmium::thread::Pool& pool) final {
+                    m_main.sort(pool);
+                }
+
             }; // class Hybrid
 
         } // namespace multimap
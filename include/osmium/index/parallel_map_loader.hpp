@@ -0,0 +1,298 @@
+#ifndef OSMIUM_INDEX_PARALLEL_MAP_LOADER_HPP
+#define OSMIUM_INDEX_PARALLEL_MAP_LOADER_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/index/map.hpp>
+#include <osmium/osm/node_location_batch.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <future>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace osmium {
+
+    namespace index {
+
+        namespace detail {
+
+            template <typename TId, typename TValue>
+            class set_reserved_task {
+
+                osmium::index::map::Map<TId, TValue>* m_map;
+                std::size_t m_position;
+                std::vector<TId> m_ids;
+                std::vector<TValue> m_values;
+
+            public:
+
+                set_reserved_task(osmium::index::map::Map<TId, TValue>& map, std::size_t position, std::vector<TId>&& ids, std::vector<TValue>&& values) :
+                    m_map(&map),
+                    m_position(position),
+                    m_ids(std::move(ids)),
+                    m_values(std::move(values)) {
+                }
+
+                void operator()() {
+                    m_map->set_reserved(m_position, m_ids.data(), m_values.data(), m_ids.size());
+                }
+
+            }; // class set_reserved_task
+
+            template <typename TId, typename TValue>
+            class set_reserved_batch_task {
+
+                osmium::index::map::Map<TId, TValue>* m_map;
+                std::size_t m_position;
+                osmium::NodeLocationBatch m_batch;
+
+            public:
+
+                set_reserved_batch_task(osmium::index::map::Map<TId, TValue>& map, std::size_t position, osmium::NodeLocationBatch&& batch) :
+                    m_map(&map),
+                    m_position(position),
+                    m_batch(std::move(batch)) {
+                }
+
+                void operator()() {
+                    const std::vector<TId> ids(m_batch.ids().cbegin(), m_batch.ids().cend());
+                    m_map->set_reserved(m_position, ids.data(), m_batch.locations().data(), ids.size());
+                }
+
+            }; // class set_reserved_batch_task
+
+        } // namespace detail
+
+        /**
+         * Fills a map using several threads from the thread pool. Each
+         * batch of ids and values given to add() is written to the map by
+         * a task in the pool while the calling thread can go on reading
+         * the next batch. This works for maps implementing the
+         * reserve_for() and set_reserved() functions, currently the dense
+         * and sparse maps based on vectors (DenseMemArray, DenseMmapArray,
+         * DenseFileArray, SparseMemArray, SparseMmapArray, and
+         * SparseFileArray). Other maps are filled in the calling thread.
+         *
+         * Dense maps are written directly at the positions given by the
+         * ids, different batches must not contain the same ids. Sparse
+         * maps get a separate range for each batch, they have to be
+         * sorted afterwards like always. finish_and_sort() does that
+         * using the threads in the same pool.
+         *
+         * @code
+         * osmium::io::NodeLocationReader reader{"input.osm.pbf"};
+         * osmium::index::ParallelMapLoader<osmium::unsigned_object_id_type, osmium::Location> loader{index, pool};
+         * osmium::NodeLocationBatch batch;
+         * while (!(batch = reader.read()).empty()) {
+         *     loader.add(std::move(batch));
+         * }
+         * loader.finish_and_sort(); // same as loader.finish(); index.sort(pool);
+         * @endcode
+         *
+         * The map must not be used by anybody else until finish() was
+         * called.
+         */
+        template <typename TId, typename TValue>
+        class ParallelMapLoader {
+
+            using map_type = osmium::index::map::Map<TId, TValue>;
+
+            map_type& m_map;
+            osmium::thread::Pool& m_pool;
+            std::deque<std::future<void>> m_futures;
+            std::size_t m_max_pending;
+
+            // Wait for all tasks to finish, rethrow the first exception.
+            void wait_for_writers() {
+                std::exception_ptr exception;
+                while (!m_futures.empty()) {
+                    std::future<void> future = std::move(m_futures.front());
+                    m_futures.pop_front();
+                    try {
+                        m_pool.wait(future);
+                        future.get();
+                    } catch (...) {
+                        if (!exception) {
+                            exception = std::current_exception();
+                        }
+                    }
+                }
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+            }
+
+            bool reserve(const TId max_id, const std::size_t count, std::size_t& position) {
+                return m_map.reserve_for(max_id, count, [this]() {
+                    wait_for_writers();
+                }, position);
+            }
+
+            template <typename TTask>
+            void submit(TTask&& task) {
+                while (m_futures.size() >= m_max_pending) {
+                    std::future<void> future = std::move(m_futures.front());
+                    m_futures.pop_front();
+                    m_pool.wait(future);
+                    future.get();
+                }
+                m_futures.push_back(m_pool.submit(std::forward<TTask>(task)));
+            }
+
+        public:
+
+            /**
+             * Construct a loader.
+             *
+             * @param map The map to fill.
+             * @param pool The thread pool to use.
+             * @param max_pending Maximum number of batches in the pool at
+             *                    the same time. If this is 0, twice the
+             *                    number of threads in the pool is used.
+             */
+            explicit ParallelMapLoader(map_type& map,
+                                       osmium::thread::Pool& pool = osmium::thread::Pool::default_instance(),
+                                       std::size_t max_pending = 0) :
+                m_map(map),
+                m_pool(pool),
+                m_futures(),
+                m_max_pending(max_pending > 0 ? max_pending : 2 * static_cast<std::size_t>(pool.num_threads())) {
+            }
+
+            ParallelMapLoader(const ParallelMapLoader&) = delete;
+            ParallelMapLoader& operator=(const ParallelMapLoader&) = delete;
+
+            ParallelMapLoader(ParallelMapLoader&&) = delete;
+            ParallelMapLoader& operator=(ParallelMapLoader&&) = delete;
+
+            ~ParallelMapLoader() noexcept {
+                try {
+                    finish();
+                } catch (...) {
+                    // Ignore any exceptions because destructor must not throw.
+                }
+            }
+
+            /**
+             * Add a batch of ids and values to the map.
+             *
+             * @throws std::invalid_argument If the vectors have different
+             *         sizes.
+             */
+            void add(std::vector<TId>&& ids, std::vector<TValue>&& values) {
+                if (ids.size() != values.size()) {
+                    throw std::invalid_argument{"ids and values must have the same size"};
+                }
+                if (ids.empty()) {
+                    return;
+                }
+
+                std::size_t position = 0;
+                if (!reserve(*std::max_element(ids.cbegin(), ids.cend()), ids.size(), position)) {
+                    m_map.set_many(ids.data(), values.data(), ids.size());
+                    return;
+                }
+                submit(detail::set_reserved_task<TId, TValue>{m_map, position, std::move(ids), std::move(values)});
+            }
+
+            /**
+             * Add the locations of all nodes in the batch to the map. Only
+             * available for maps from unsigned_object_id_type to Location.
+             *
+             * @throws std::invalid_argument If the batch contains a
+             *         negative id.
+             */
+            void add(osmium::NodeLocationBatch&& batch) {
+                if (batch.empty()) {
+                    return;
+                }
+
+                osmium::object_id_type max_id = 0;
+                for (const auto id : batch.ids()) {
+                    if (id < 0) {
+                        throw std::invalid_argument{"negative id in node location batch"};
+                    }
+                    max_id = std::max(max_id, id);
+                }
+
+                std::size_t position = 0;
+                if (!reserve(static_cast<TId>(max_id), batch.size(), position)) {
+                    const std::vector<TId> ids(batch.ids().cbegin(), batch.ids().cend());
+                    m_map.set_many(ids.data(), batch.locations().data(), ids.size());
+                    return;
+                }
+                submit(detail::set_reserved_batch_task<TId, TValue>{m_map, position, std::move(batch)});
+            }
+
+            /**
+             * Wait until all batches are written to the map. Call this
+             * before using the map.
+             *
+             * @throws Any exception thrown by a task.
+             */
+            void finish() {
+                try {
+                    wait_for_writers();
+                } catch (...) {
+                    m_map.finish_reserved();
+                    throw;
+                }
+                m_map.finish_reserved();
+            }
+
+            /**
+             * Wait until all batches are written to the map and sort it
+             * using the threads in the pool. Call this before using the
+             * map.
+             *
+             * @throws Any exception thrown by a task.
+             */
+            void finish_and_sort() {
+                finish();
+                m_map.sort(m_pool);
+            }
+
+        }; // class ParallelMapLoader
+
+    } // namespace index
+
+} // namespace osmium
+
+#endif // OSMIUM_INDEX_PARALLEL_MAP_LOADER_HPP
@@ -33,6 +33,7 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <osmium/index/detail/radix_sort.hpp>
 #include <osmium/osm/item_type.hpp>
 #include <osmium/osm/relation.hpp>
 #include <osmium/osm/types.hpp>
@@ -114,7 +115,13 @@ namespace osmium {
                 }
 
                 void sort_unique() {
-                    std::sort(m_map.begin(), m_map.end());
+                    sort_unique(osmium::thread::Pool::default_instance());
+                }
+
+                void sort_unique(osmium::thread::Pool& pool) {
+                    osmium::index::detail::radix_sort(m_map.begin(), m_map.end(), [](const kv_pair& p) {
+                        return static_cast<uint64_t>(p.key);
+                    }, pool);
                     const auto last = std::unique(m_map.begin(), m_map.end());
                     m_map.erase(last, m_map.end());
                 }
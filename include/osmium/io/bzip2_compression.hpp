@@ -47,16 +47,24 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/error.hpp>
 #include <osmium/io/file_compression.hpp>
 #include <osmium/io/writer_options.hpp>
+#include <osmium/thread/memory_budget.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/util/compatibility.hpp>
 
 #include <bzlib.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
+#include <cstddef>
 #include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
 #include <limits>
 #include <string>
 #include <system_error>
+#include <utility>
 
 #ifndef _MSC_VER
 # include <unistd.h>
@@ -252,6 +260,349 @@ namespace osmium {
 
         }; // class Bzip2Decompressor
 
+        namespace detail {
+
+            /**
+             * Find the start of a bzip2 stream in the data at or after
+             * the position pos. A stream starts with "BZh", the block size
+             * (a digit from 1 to 9) and the magic number of the first
+             * block. Returns std::string::npos if there is none.
+             */
+            inline std::size_t find_bzip2_stream(const std::string& data, std::size_t pos) {
+                static const char block_magic[] = "1AY&SY";
+                while (true) {
+                    pos = data.find("BZh", pos);
+                    if (pos == std::string::npos || pos + 10 > data.size()) {
+                        return std::string::npos;
+                    }
+                    if (data[pos + 3] >= '1' && data[pos + 3] <= '9' &&
+                        !std::memcmp(data.data() + pos + 4, block_magic, 6)) {
+                        return pos;
+                    }
+                    ++pos;
+                }
+            }
+
+            /**
+             * Get the block size in bytes from the header of the bzip2
+             * stream at the start of the data. No block of the stream
+             * decompresses to much more than this. Returns the maximum
+             * block size (900k) if there is no valid header.
+             */
+            inline std::size_t bzip2_block_size(const std::string& data) noexcept {
+                if (data.size() < 4 || data[3] < '1' || data[3] > '9') {
+                    return 900UL * 1000UL;
+                }
+                return static_cast<std::size_t>(data[3] - '0') * 100UL * 1000UL;
+            }
+
+            /**
+             * Task decompressing one or more complete bzip2 streams. Run in
+             * the thread pool by the ParallelBzip2Decompressor.
+             */
+            class DecompressBzip2Streams {
+
+                std::string m_input;
+
+            public:
+
+                explicit DecompressBzip2Streams(std::string&& input) :
+                    m_input(std::move(input)) {
+                }
+
+                std::string operator()() const {
+                    assert(m_input.size() < std::numeric_limits<unsigned int>::max());
+
+                    // Start with room for one block and grow as needed,
+                    // so the output is never more than twice as large as
+                    // the decompressed data.
+                    std::string output(bzip2_block_size(m_input), '\0');
+                    std::size_t output_size = 0;
+                    std::size_t input_pos = 0;
+
+                    while (input_pos < m_input.size()) {
+                        bz_stream stream{};
+                        int result = ::BZ2_bzDecompressInit(&stream, 0, 0);
+                        if (result != BZ_OK) {
+                            throw osmium::bzip2_error{"bzip2 error: decompression init failed", result};
+                        }
+
+                        stream.next_in = const_cast<char*>(m_input.data() + input_pos);
+                        stream.avail_in = static_cast<unsigned int>(m_input.size() - input_pos);
+
+                        do {
+                            if (output_size == output.size()) {
+                                output.resize(output.size() * 2);
+                            }
+                            stream.next_out = &output[output_size];
+                            stream.avail_out = static_cast<unsigned int>(std::min(output.size() - output_size,
+                                                                                  static_cast<std::size_t>(std::numeric_limits<unsigned int>::max())));
+                            result = ::BZ2_bzDecompress(&stream);
+                            output_size = static_cast<std::size_t>(stream.next_out - output.data());
+                            if (result == BZ_OK && stream.avail_in == 0 && stream.avail_out != 0) {
+                                result = BZ_UNEXPECTED_EOF;
+                            }
+                        } while (result == BZ_OK);
+
+                        input_pos = m_input.size() - stream.avail_in;
+                        ::BZ2_bzDecompressEnd(&stream);
+
+                        if (result != BZ_STREAM_END) {
+                            throw osmium::bzip2_error{"bzip2 error: decompress failed", result};
+                        }
+                    }
+
+                    output.resize(output_size);
+                    return output;
+                }
+
+            }; // class DecompressBzip2Streams
+
+        } // namespace detail
+
+        /**
+         * Bzip2 decompressor decompressing several streams of a multistream
+         * bzip2 file in parallel in the thread pool. Files created by
+         * pbzip2 and the OSM planet and history dumps are multistream
+         * files. Files created by bzip2 or lbzip2 contain a single stream.
+         *
+         * The input is split into segments of complete streams at the
+         * stream headers. Each segment is decompressed in its own task,
+         * the results are returned in the order of the input. If no stream
+         * header is found in a large chunk of the input, the file is
+         * probably a normal single stream bzip2 file and the rest of it is
+         * decompressed sequentially in the read thread.
+         *
+         * The compressed data of pending segments is charged to the
+         * default MemoryBudget. While the budget is exhausted, only one
+         * segment at a time is decompressed.
+         *
+         * The Reader uses this if the file option `parallel_decompression`
+         * is set to true.
+         */
+        class ParallelBzip2Decompressor : public Decompressor {
+
+            // Segments contain at least this much compressed data.
+            static constexpr std::size_t min_segment_size = 1024UL * 1024UL;
+
+            // If there is no stream header in this much data, switch to
+            // sequential decompression.
+            static constexpr std::size_t max_segment_size = 4UL * 1024UL * 1024UL;
+
+            osmium::thread::Pool& m_pool;
+            int m_fd;
+
+            // Compressed data read from the file but not used yet.
+            std::string m_input{};
+            bool m_input_done = false;
+
+            // Results of the tasks in the order of the input with the
+            // size of the compressed data.
+            std::deque<std::pair<std::future<std::string>, std::size_t>> m_results{};
+
+            // Number of compressed bytes decompressed so far.
+            std::size_t m_offset = 0;
+
+            // Number of bytes of pending segments charged to the budget.
+            std::size_t m_charged = 0;
+
+            // Used for sequential decompression only.
+            bool m_sequential = false;
+            bz_stream m_stream{};
+            bool m_stream_open = false;
+            std::size_t m_input_pos = 0;
+
+            std::size_t max_pending_segments() const noexcept {
+                return 2 * static_cast<std::size_t>(m_pool.num_threads()) + 2;
+            }
+
+            bool read_more_input() {
+                if (m_input_done) {
+                    return false;
+                }
+                std::string buffer(osmium::io::Decompressor::input_buffer_size, '\0');
+                const auto nread = detail::reliable_read(m_fd, &buffer[0], buffer.size());
+                if (nread == 0) {
+                    m_input_done = true;
+                    return false;
+                }
+                m_input.append(buffer, 0, static_cast<std::size_t>(nread));
+                return true;
+            }
+
+            /**
+             * Get the next segment of complete streams from the input.
+             * Returns false at the end of the input or if there are no
+             * stream headers and the decompressor switches to sequential
+             * mode.
+             */
+            bool next_segment(std::string& segment) {
+                std::size_t search_pos = min_segment_size;
+                while (true) {
+                    const std::size_t pos = detail::find_bzip2_stream(m_input, search_pos);
+                    if (pos != std::string::npos) {
+                        segment.assign(m_input, 0, pos);
+                        m_input.erase(0, pos);
+                        return true;
+                    }
+                    if (m_input.size() >= max_segment_size) {
+                        m_sequential = true;
+                        return false;
+                    }
+                    // a stream header can start in the old data and end
+                    // in the new data
+                    if (m_input.size() > search_pos + 10) {
+                        search_pos = m_input.size() - 10;
+                    }
+                    if (!read_more_input()) {
+                        if (m_input.empty()) {
+                            return false;
+                        }
+                        using std::swap;
+                        swap(segment, m_input);
+                        m_input.clear();
+                        return true;
+                    }
+                }
+            }
+
+            bool room_for_segment() const noexcept {
+                if (m_results.empty()) {
+                    return true;
+                }
+                return m_results.size() < max_pending_segments() &&
+                       !osmium::thread::MemoryBudget::default_instance().exhausted();
+            }
+
+            void release_segment(std::size_t size) {
+                m_charged -= size;
+                osmium::thread::MemoryBudget::default_instance().release(size);
+            }
+
+            void submit_segments() {
+                while (!m_sequential && room_for_segment()) {
+                    std::string segment;
+                    if (!next_segment(segment)) {
+                        return;
+                    }
+                    const std::size_t size = segment.size();
+                    m_results.emplace_back(m_pool.submit(detail::DecompressBzip2Streams{std::move(segment)}), size);
+                    m_charged += size;
+                    osmium::thread::MemoryBudget::default_instance().charge(size);
+                }
+            }
+
+            std::string read_sequential() {
+                std::string output;
+
+                while (output.empty()) {
+                    if (m_input_pos == m_input.size()) {
+                        m_offset += m_input.size();
+                        m_input.clear();
+                        m_input_pos = 0;
+                        if (!read_more_input()) {
+                            if (m_stream_open) {
+                                throw osmium::bzip2_error{"bzip2 error: decompress failed", BZ_UNEXPECTED_EOF};
+                            }
+                            break;
+                        }
+                    }
+
+                    if (!m_stream_open) {
+                        m_stream = bz_stream{};
+                        const int result = ::BZ2_bzDecompressInit(&m_stream, 0, 0);
+                        if (result != BZ_OK) {
+                            throw osmium::bzip2_error{"bzip2 error: decompression init failed", result};
+                        }
+                        m_stream_open = true;
+                    }
+
+                    output.resize(osmium::io::Decompressor::input_buffer_size);
+                    m_stream.next_in = &m_input[m_input_pos];
+                    m_stream.avail_in = static_cast<unsigned int>(m_input.size() - m_input_pos);
+                    m_stream.next_out = &output[0];
+                    m_stream.avail_out = static_cast<unsigned int>(output.size());
+
+                    const int result = ::BZ2_bzDecompress(&m_stream);
+                    m_input_pos = m_input.size() - m_stream.avail_in;
+                    output.resize(static_cast<std::size_t>(m_stream.next_out - output.data()));
+
+                    if (result == BZ_STREAM_END) {
+                        ::BZ2_bzDecompressEnd(&m_stream);
+                        m_stream_open = false;
+                    } else if (result != BZ_OK) {
+                        throw osmium::bzip2_error{"bzip2 error: decompress failed", result};
+                    }
+                }
+
+                set_offset(m_offset + m_input_pos);
+                return output;
+            }
+
+        public:
+
+            ParallelBzip2Decompressor(int fd, osmium::thread::Pool& pool) :
+                m_pool(pool),
+                m_fd(fd) {
+            }
+
+            ParallelBzip2Decompressor(const ParallelBzip2Decompressor&) = delete;
+            ParallelBzip2Decompressor& operator=(const ParallelBzip2Decompressor&) = delete;
+
+            ParallelBzip2Decompressor(ParallelBzip2Decompressor&&) = delete;
+            ParallelBzip2Decompressor& operator=(ParallelBzip2Decompressor&&) = delete;
+
+            ~ParallelBzip2Decompressor() noexcept final {
+                try {
+                    close();
+                } catch (...) {
+                    // Ignore any exceptions because destructor must not throw.
+                }
+            }
+
+            std::string read() final {
+                submit_segments();
+
+                while (!m_results.empty()) {
+                    std::future<std::string> future{std::move(m_results.front().first)};
+                    const std::size_t size = m_results.front().second;
+                    m_offset += size;
+                    m_results.pop_front();
+                    release_segment(size);
+
+                    std::string output{future.get()};
+                    submit_segments();
+                    if (!output.empty()) {
+                        set_offset(m_offset);
+                        return output;
+                    }
+                }
+
+                if (m_sequential) {
+                    return read_sequential();
+                }
+
+                return std::string{};
+            }
+
+            void close() final {
+                m_results.clear();
+                if (m_charged > 0) {
+                    release_segment(m_charged);
+                }
+                if (m_stream_open) {
+                    ::BZ2_bzDecompressEnd(&m_stream);
+                    m_stream_open = false;
+                }
+                if (m_fd >= 0) {
+                    const int fd = m_fd;
+                    m_fd = -1;
+                    osmium::io::detail::reliable_close(fd);
+                }
+            }
+
+        }; // class ParallelBzip2Decompressor
+
         class Bzip2BufferDecompressor : public Decompressor {
 
             const char* m_buffer;
@@ -335,6 +686,15 @@ namespace osmium {
                 return registered_bzip2_compression;
             }
 
+            const bool registered_parallel_bzip2_decompression = osmium::io::CompressionFactory::instance().register_parallel_decompressor(osmium::io::file_compression::bzip2,
+                [](int fd, osmium::thread::Pool& pool) { return new osmium::io::ParallelBzip2Decompressor{fd, pool}; }
+            );
+
+            // dummy function to silence the unused variable warning from above
+            inline bool get_registered_parallel_bzip2_decompression() noexcept {
+                return registered_parallel_bzip2_decompression;
+            }
+
         } // namespace detail
 
     } // namespace io
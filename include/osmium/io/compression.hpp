@@ -58,6 +58,10 @@ DEALINGS IN THE SOFTWARE.
 
 namespace osmium {
 
+    namespace thread {
+        class Pool;
+    } // namespace thread
+
     namespace io {
 
         class Compressor {
@@ -137,6 +141,13 @@ namespace osmium {
          *
          * For each algorithm we store two functions that construct
          * a compressor and decompressor object, respectively.
+         *
+         * Algorithms can also register a parallel compressor which uses
+         * the thread pool to compress several chunks of data at the same
+         * time. It is used by the Writer if the file option
+         * `parallel_compression` is set. The same goes for parallel
+         * decompressors, they are used by the Reader if the file option
+         * `parallel_decompression` is set.
          */
         class CompressionFactory {
 
@@ -145,6 +156,8 @@ namespace osmium {
             using create_compressor_type          = std::function<osmium::io::Compressor*(int, fsync)>;
             using create_decompressor_type_fd     = std::function<osmium::io::Decompressor*(int)>;
             using create_decompressor_type_buffer = std::function<osmium::io::Decompressor*(const char*, std::size_t)>;
+            using create_parallel_compressor_type = std::function<osmium::io::Compressor*(int, fsync, osmium::thread::Pool&)>;
+            using create_parallel_decompressor_type = std::function<osmium::io::Decompressor*(int, osmium::thread::Pool&)>;
 
         private:
 
@@ -156,6 +169,10 @@ namespace osmium {
 
             compression_map_type m_callbacks;
 
+            std::map<const osmium::io::file_compression, create_parallel_compressor_type> m_parallel_callbacks;
+
+            std::map<const osmium::io::file_compression, create_parallel_decompressor_type> m_parallel_decompressor_callbacks;
+
             CompressionFactory() = default;
 
             const callbacks_type& find_callbacks(osmium::io::file_compression compression) const {
@@ -200,12 +217,52 @@ namespace osmium {
                 return m_callbacks.insert(cc).second;
             }
 
+            bool register_parallel_compressor(
+                osmium::io::file_compression compression,
+                create_parallel_compressor_type create_parallel_compressor) {
+
+                return m_parallel_callbacks.emplace(compression, create_parallel_compressor).second;
+            }
+
+            /**
+             * Is there a parallel compressor for this compression?
+             */
+            bool has_parallel_compressor(osmium::io::file_compression compression) const {
+                return m_parallel_callbacks.count(compression) > 0;
+            }
+
+            bool register_parallel_decompressor(
+                osmium::io::file_compression compression,
+                create_parallel_decompressor_type create_parallel_decompressor) {
+
+                return m_parallel_decompressor_callbacks.emplace(compression, create_parallel_decompressor).second;
+            }
+
+            /**
+             * Is there a parallel decompressor for this compression?
+             */
+            bool has_parallel_decompressor(osmium::io::file_compression compression) const {
+                return m_parallel_decompressor_callbacks.count(compression) > 0;
+            }
+
             template <typename... TArgs>
             std::unique_ptr<osmium::io::Compressor> create_compressor(osmium::io::file_compression compression, TArgs&&... args) const {
                 const auto callbacks = find_callbacks(compression);
                 return std::unique_ptr<osmium::io::Compressor>(std::get<0>(callbacks)(std::forward<TArgs>(args)...));
             }
 
+            /**
+             * Create a parallel compressor. Falls back to the normal
+             * compressor if there is no parallel one for this compression.
+             */
+            std::unique_ptr<osmium::io::Compressor> create_parallel_compressor(osmium::io::file_compression compression, int fd, fsync sync, osmium::thread::Pool& pool) const {
+                const auto it = m_parallel_callbacks.find(compression);
+                if (it == m_parallel_callbacks.end()) {
+                    return create_compressor(compression, fd, sync);
+                }
+                return std::unique_ptr<osmium::io::Compressor>(it->second(fd, sync, pool));
+            }
+
             std::unique_ptr<osmium::io::Decompressor> create_decompressor(osmium::io::file_compression compression, int fd) const {
                 const auto callbacks = find_callbacks(compression);
                 auto p = std::unique_ptr<osmium::io::Decompressor>(std::get<1>(callbacks)(fd));
@@ -213,6 +270,21 @@ namespace osmium {
                 return p;
             }
 
+            /**
+             * Create a parallel decompressor. Falls back to the normal
+             * decompressor if there is no parallel one for this
+             * compression.
+             */
+            std::unique_ptr<osmium::io::Decompressor> create_parallel_decompressor(osmium::io::file_compression compression, int fd, osmium::thread::Pool& pool) const {
+                const auto it = m_parallel_decompressor_callbacks.find(compression);
+                if (it == m_parallel_decompressor_callbacks.end()) {
+                    return create_decompressor(compression, fd);
+                }
+                auto p = std::unique_ptr<osmium::io::Decompressor>(it->second(fd, pool));
+                p->set_file_size(osmium::file_size(fd));
+                return p;
+            }
+
             std::unique_ptr<osmium::io::Decompressor> create_decompressor(osmium::io::file_compression compression, const char* buffer, std::size_t size) const {
                 const auto callbacks = find_callbacks(compression);
                 return std::unique_ptr<osmium::io::Decompressor>(std::get<2>(callbacks)(buffer, size));
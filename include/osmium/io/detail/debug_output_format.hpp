@@ -578,7 +578,7 @@ namespace osmium {
                 }
 
                 void write_buffer(osmium::memory::Buffer&& buffer) final {
-                    m_output_queue.push(m_pool.submit(DebugOutputBlock{std::move(buffer), m_options}));
+                    send_to_output_queue_from_pool(DebugOutputBlock{std::move(buffer), m_options});
                 }
 
             }; // class DebugOutputFormat
@@ -38,17 +38,30 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/file.hpp>
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
+#include <osmium/io/metrics.hpp>
+#include <osmium/io/reader_options.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
 #include <osmium/osm/entity_bits.hpp>
+#include <osmium/thread/memory_budget.hpp>
 #include <osmium/thread/pool.hpp>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <deque>
 #include <exception>
 #include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace osmium {
 
@@ -56,6 +69,28 @@ namespace osmium {
 
         namespace detail {
 
+            /**
+             * Input data that is available in memory as a whole, for
+             * instance because the input file was memory mapped. Parsers
+             * supporting this read the data from here instead of getting
+             * it through the input queue.
+             */
+            struct mapped_input {
+
+                /// Pointer to the data (nullptr if there is no mapped input).
+                const char* data = nullptr;
+
+                /// Size of the data.
+                std::size_t size = 0;
+
+                /// Current read position in the data (set by the parser).
+                std::atomic<std::size_t> offset{0};
+
+                /// Set by the reader to tell the parser to stop.
+                std::atomic<bool> done{false};
+
+            }; // struct mapped_input
+
             struct parser_arguments {
                 osmium::thread::Pool& pool;
                 future_string_queue_type& input_queue;
@@ -63,8 +98,89 @@ namespace osmium {
                 std::promise<osmium::io::Header>& header_promise;
                 osmium::osm_entity_bits::type read_which_entities;
                 osmium::io::read_meta read_metadata;
+                const read_filter& filter;
+                mapped_input& input_mapping;
+                osmium::memory::BufferPool* buffer_pool;
+                osmium::io::ordered ordered_output;
+                reader_counters& counters;
             };
 
+            /**
+             * Hands the buffers created by tasks in the thread pool to the
+             * output queue in the order in which the tasks finish. The
+             * parser reserves a place in the queue before submitting a
+             * task and the task fills the oldest reserved place that is
+             * still empty. So tasks never have to wait for room in the
+             * queue, only the parser does.
+             */
+            class unordered_results {
+
+                std::mutex m_mutex;
+                std::deque<std::promise<osmium::memory::Buffer>> m_promises;
+
+                std::promise<osmium::memory::Buffer> next_promise() {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    assert(!m_promises.empty());
+                    std::promise<osmium::memory::Buffer> promise{std::move(m_promises.front())};
+                    m_promises.pop_front();
+                    return promise;
+                }
+
+            public:
+
+                unordered_results() = default;
+
+                std::future<osmium::memory::Buffer> reserve() {
+                    std::promise<osmium::memory::Buffer> promise;
+                    auto future = promise.get_future();
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    m_promises.push_back(std::move(promise));
+                    return future;
+                }
+
+                void set_value(osmium::memory::Buffer&& buffer) {
+                    next_promise().set_value(std::move(buffer));
+                }
+
+                void set_exception(std::exception_ptr&& exception) {
+                    next_promise().set_exception(std::move(exception));
+                }
+
+            }; // class unordered_results
+
+            /**
+             * Task run in the thread pool when buffers are returned in
+             * unordered mode. Runs the function and hands the resulting
+             * buffer (or the exception thrown) on as soon as it is
+             * available. This never blocks.
+             */
+            template <typename TFunction>
+            class unordered_output_task {
+
+                TFunction m_function;
+                unordered_results* m_results;
+
+            public:
+
+                unordered_output_task(TFunction&& function, unordered_results& results) :
+                    m_function(std::move(function)),
+                    m_results(&results) {
+                }
+
+                void operator()() {
+                    osmium::memory::Buffer buffer;
+                    try {
+                        buffer = m_function();
+                        osmium::thread::MemoryBudget::default_instance().charge(memory_usage(buffer));
+                    } catch (...) {
+                        m_results->set_exception(std::current_exception());
+                        return;
+                    }
+                    m_results->set_value(std::move(buffer));
+                }
+
+            }; // class unordered_output_task
+
             class Parser {
 
                 osmium::thread::Pool& m_pool;
@@ -73,8 +189,28 @@ namespace osmium {
                 queue_wrapper<std::string> m_input_queue;
                 osmium::osm_entity_bits::type m_read_which_entities;
                 osmium::io::read_meta m_read_metadata;
+                read_filter m_read_filter;
+                mapped_input& m_mapped_input;
+                osmium::memory::BufferPool* m_buffer_pool;
+                osmium::io::ordered m_ordered;
+                reader_counters& m_counters;
+                unordered_results m_unordered_results;
+                std::vector<std::future<void>> m_pending_tasks;
                 bool m_header_is_done;
 
+                void remove_finished_tasks() {
+                    m_pending_tasks.erase(std::remove_if(m_pending_tasks.begin(), m_pending_tasks.end(), [](const std::future<void>& task) {
+                        return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                    }), m_pending_tasks.end());
+                }
+
+                void wait_for_pending_tasks() {
+                    for (auto& task : m_pending_tasks) {
+                        task.wait();
+                    }
+                    m_pending_tasks.clear();
+                }
+
             protected:
 
                 osmium::thread::Pool& get_pool() {
@@ -89,6 +225,34 @@ namespace osmium {
                     return m_read_metadata;
                 }
 
+                const read_filter& filter() const noexcept {
+                    return m_read_filter;
+                }
+
+                bool has_mapped_input() const noexcept {
+                    return m_mapped_input.data != nullptr;
+                }
+
+                mapped_input& get_mapped_input() noexcept {
+                    return m_mapped_input;
+                }
+
+                /**
+                 * Pool with buffers that can be reused by the parser. Might
+                 * be nullptr.
+                 */
+                osmium::memory::BufferPool* get_buffer_pool() const noexcept {
+                    return m_buffer_pool;
+                }
+
+                /**
+                 * Counters for the metrics of the Reader. Parsers update
+                 * the counters for the work they do.
+                 */
+                reader_counters& counters() noexcept {
+                    return m_counters;
+                }
+
                 bool header_is_done() const noexcept {
                     return m_header_is_done;
                 }
@@ -109,15 +273,51 @@ namespace osmium {
 
                 /**
                  * Wrap the buffer into a future and add it to the output queue.
+                 * Waits first if the memory budget is exhausted.
                  */
                 void send_to_output_queue(osmium::memory::Buffer&& buffer) {
+                    wait_for_memory(m_output_queue);
+                    m_counters.buffers_produced.add();
                     add_to_queue(m_output_queue, std::move(buffer));
                 }
 
                 void send_to_output_queue(std::future<osmium::memory::Buffer>&& future) {
+                    m_counters.buffers_produced.add();
                     m_output_queue.push(std::move(future));
                 }
 
+                /**
+                 * Run the function, which must return a buffer, in the thread
+                 * pool and add the result to the output queue. If the buffers
+                 * are ordered, the results are added to the queue in the
+                 * order this function was called. Otherwise they are added
+                 * as soon as they are ready. Waits first if the memory budget
+                 * is exhausted.
+                 */
+                template <typename TFunction>
+                void send_to_output_queue_from_pool(TFunction&& function) {
+                    wait_for_memory(m_output_queue);
+
+                    if (m_ordered == osmium::io::ordered::yes) {
+                        using task_type = charged_task<typename std::decay<TFunction>::type>;
+                        send_to_output_queue(m_pool.submit(task_type{std::forward<TFunction>(function)}));
+                        return;
+                    }
+
+                    // Reserve the place in the output queue first, this is
+                    // where the parser waits if the queue is full.
+                    remove_finished_tasks();
+                    send_to_output_queue(m_unordered_results.reserve());
+                    using task_type = unordered_output_task<typename std::decay<TFunction>::type>;
+                    try {
+                        m_pending_tasks.push_back(m_pool.submit(task_type{std::forward<TFunction>(function), m_unordered_results}));
+                    } catch (...) {
+                        // Nobody else would fill the reserved place.
+                        m_unordered_results.set_exception(std::current_exception());
+                        throw;
+                    }
+                }
+
             public:
 
                 explicit Parser(parser_arguments& args) :
@@ -127,6 +327,13 @@ namespace osmium {
                     m_input_queue(args.input_queue),
                     m_read_which_entities(args.read_which_entities),
                     m_read_metadata(args.read_metadata),
+                    m_read_filter(args.filter),
+                    m_mapped_input(args.input_mapping),
+                    m_buffer_pool(args.buffer_pool),
+                    m_ordered(args.ordered_output),
+                    m_counters(args.counters),
+                    m_unordered_results(),
+                    m_pending_tasks(),
                     m_header_is_done(false) {
                 }
 
@@ -157,6 +364,10 @@ namespace osmium {
                         add_to_queue(m_output_queue, std::move(exception));
                     }
 
+                    // In unordered mode, tasks still running in the pool
+                    // need m_unordered_results, so wait for them.
+                    wait_for_pending_tasks();
+
                     add_end_of_data_to_queue(m_output_queue);
                 }
 
@@ -50,6 +50,7 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/osm/timestamp.hpp>
 #include <osmium/osm/types.hpp>
 #include <osmium/osm/way.hpp>
+#include <osmium/thread/affinity.hpp>
 #include <osmium/thread/util.hpp>
 #include <osmium/util/delta.hpp>
 
@@ -618,6 +619,7 @@ namespace osmium {
 
                 void run() final {
                     osmium::thread::set_thread_name("_osmium_o5m_in");
+                    osmium::thread::set_io_thread_affinity();
 
                     decode_header();
                     decode_data();
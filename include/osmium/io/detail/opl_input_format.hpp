@@ -38,6 +38,7 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/thread/affinity.hpp>
 #include <osmium/thread/util.hpp>
 
 #include <cstdint>
@@ -137,6 +138,7 @@ namespace osmium {
 
                 void run() final {
                     osmium::thread::set_thread_name("_osmium_opl_in");
+                    osmium::thread::set_io_thread_affinity();
 
                     line_by_line(*this);
 
@@ -295,7 +295,7 @@ namespace osmium {
                 }
 
                 void write_buffer(osmium::memory::Buffer&& buffer) final {
-                    m_output_queue.push(m_pool.submit(OPLOutputBlock{std::move(buffer), m_options}));
+                    send_to_output_queue_from_pool(OPLOutputBlock{std::move(buffer), m_options});
                 }
 
             }; // class OPLOutputFormat
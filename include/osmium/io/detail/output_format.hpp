@@ -38,6 +38,7 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/error.hpp>
 #include <osmium/io/file.hpp>
 #include <osmium/io/file_format.hpp>
+#include <osmium/io/metrics.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/thread/pool.hpp>
 
@@ -46,6 +47,7 @@ DEALINGS IN THE SOFTWARE.
 #include <functional>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <utility>
 
 namespace osmium {
@@ -97,6 +99,35 @@ namespace osmium {
 
             }; // class OutputBlock;
 
+            /**
+             * Wraps a function run in the thread pool and adds the time it
+             * takes to a timer (if there is one).
+             */
+            template <typename TFunction>
+            class timed_task {
+
+                TFunction m_function;
+                metrics_timer* m_timer;
+
+            public:
+
+                timed_task(TFunction&& function, metrics_timer* timer) :
+                    m_function(std::move(function)),
+                    m_timer(timer) {
+                }
+
+                auto operator()() -> decltype(std::declval<TFunction&>()()) {
+                    if (!m_timer) {
+                        return m_function();
+                    }
+                    const auto start = metrics_clock::now();
+                    auto result = m_function();
+                    m_timer->add_since(start);
+                    return result;
+                }
+
+            }; // class timed_task
+
             /**
              * Virtual base class for all classes writing OSM files in different
              * formats.
@@ -110,15 +141,32 @@ namespace osmium {
 
                 osmium::thread::Pool& m_pool;
                 future_string_queue_type& m_output_queue;
+                writer_counters* m_counters = nullptr;
 
                 /**
                  * Wrap the string into a future and add it to the output
-                 * queue.
+                 * queue. Waits first if the memory budget is exhausted.
                  */
                 void send_to_output_queue(std::string&& data) {
+                    wait_for_memory(m_output_queue);
                     add_to_queue(m_output_queue, std::move(data));
                 }
 
+                /**
+                 * Run the function, which must return a string, in the
+                 * thread pool and add the result to the output queue.
+                 * Waits first if the memory budget is exhausted. The time
+                 * the function takes is counted as encode time.
+                 */
+                template <typename TFunction>
+                void send_to_output_queue_from_pool(TFunction&& function) {
+                    wait_for_memory(m_output_queue);
+                    using timed_task_type = timed_task<typename std::decay<TFunction>::type>;
+                    using task_type = charged_task<timed_task_type>;
+                    m_output_queue.push(m_pool.submit(task_type{timed_task_type{std::forward<TFunction>(function),
+                                                                                m_counters ? &m_counters->encode_time : nullptr}}));
+                }
+
             public:
 
                 OutputFormat(osmium::thread::Pool& pool, future_string_queue_type& output_queue) noexcept :
@@ -134,11 +182,32 @@ namespace osmium {
 
                 virtual ~OutputFormat() noexcept = default;
 
+                /**
+                 * Set the counters for the metrics of the Writer. The
+                 * counters must outlive this object and all tasks it
+                 * submitted to the pool.
+                 */
+                void set_counters(writer_counters& counters) noexcept {
+                    m_counters = &counters;
+                }
+
                 virtual void write_header(const osmium::io::Header& /*header*/) {
                 }
 
                 virtual void write_buffer(osmium::memory::Buffer&& /*buffer*/) = 0;
 
+                /**
+                 * Write a raw blob (see osmium::io::pbf_blob) unchanged
+                 * after the data written so far. Only formats that have
+                 * blobs support this.
+                 *
+                 * @throws osmium::io_error If the format doesn't support
+                 *         raw blobs.
+                 */
+                virtual void write_raw_blob(std::string&& /*data*/) {
+                    throw osmium::io_error{"Writing raw blobs is only supported for PBF files"};
+                }
+
                 virtual void write_end() {
                 }
 
@@ -0,0 +1,146 @@
+#ifndef OSMIUM_IO_DETAIL_PACKED_VARINT_HPP
+#define OSMIUM_IO_DETAIL_PACKED_VARINT_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/io/detail/pbf.hpp>
+#include <osmium/util/endian.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            namespace packed {
+
+                inline int64_t decode_zigzag64(uint64_t value) noexcept {
+                    return static_cast<int64_t>(value >> 1U) ^ -static_cast<int64_t>(value & 1U);
+                }
+
+                /**
+                 * Decode one varint starting at *data and move *data past
+                 * it.
+                 *
+                 * @throws osmium::pbf_error If the varint is truncated or
+                 *         too long.
+                 */
+                inline uint64_t decode_varint(const char** data, const char* end) {
+                    const auto* it = reinterpret_cast<const uint8_t*>(*data);
+                    const auto* last = reinterpret_cast<const uint8_t*>(end);
+
+                    uint64_t value = 0;
+                    unsigned int shift = 0;
+                    while (it != last) {
+                        const uint64_t byte = *it++;
+                        value |= (byte & 0x7fU) << shift;
+                        if (!(byte & 0x80U)) {
+                            *data = reinterpret_cast<const char*>(it);
+                            return value;
+                        }
+                        shift += 7;
+                        if (shift >= 70) {
+                            throw osmium::pbf_error{"varint too long"};
+                        }
+                    }
+
+                    throw osmium::pbf_error{"truncated varint"};
+                }
+
+            } // namespace packed
+
+            /**
+             * Decode a packed field containing zigzag and delta encoded
+             * varints (like the sint64 and sint32 arrays in the DenseNodes
+             * and DenseInfo messages) into absolute values in one pass.
+             *
+             * This is the batch version of iterating over the field with
+             * protozero and doing the delta decoding for each element. It
+             * reads eight bytes at a time and decodes all of them at once
+             * if none has the continuation bit set, which is the common
+             * case for node IDs. Other values go through a tight scalar
+             * loop without the iterator overhead.
+             *
+             * @param data Start of the packed field data.
+             * @param end End of the packed field data.
+             * @param out The decoded values are written here. Any previous
+             *            content is removed.
+             * @throws osmium::pbf_error If the data is not valid.
+             */
+            inline void decode_packed_sint64_delta(const char* data, const char* end, std::vector<int64_t>& out) {
+                // Every varint needs at least one byte.
+                out.resize(static_cast<std::size_t>(end - data));
+                int64_t* it = out.data();
+
+                // Using unsigned arithmetic so that overflows in broken
+                // data are not undefined behaviour.
+                uint64_t value = 0;
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+                while (end - data >= 8) {
+                    uint64_t word;
+                    std::memcpy(&word, data, sizeof(word));
+                    if ((word & 0x8080808080808080ULL) == 0) {
+                        // eight single byte varints
+                        for (unsigned int i = 0; i < 8; ++i) {
+                            value += static_cast<uint64_t>(packed::decode_zigzag64((word >> (8U * i)) & 0xffU));
+                            *it++ = static_cast<int64_t>(value);
+                        }
+                        data += 8;
+                    } else {
+                        value += static_cast<uint64_t>(packed::decode_zigzag64(packed::decode_varint(&data, end)));
+                        *it++ = static_cast<int64_t>(value);
+                    }
+                }
+#endif
+
+                while (data != end) {
+                    value += static_cast<uint64_t>(packed::decode_zigzag64(packed::decode_varint(&data, end)));
+                    *it++ = static_cast<int64_t>(value);
+                }
+
+                out.resize(static_cast<std::size_t>(it - out.data()));
+            }
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DETAIL_PACKED_VARINT_HPP
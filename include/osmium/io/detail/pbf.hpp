@@ -73,6 +73,9 @@ namespace osmium {
 
             const int64_t resolution_convert = lonlat_resolution / osmium::detail::coordinate_precision;
 
+            // marks the data in the BlobHeader.indexdata field written by Osmium
+            constexpr const char* const blob_index_format = "OsmiumBlobIndex-V1";
+
         } // namespace detail
 
     } // namespace io
@@ -0,0 +1,270 @@
+#ifndef OSMIUM_IO_DETAIL_PBF_BLOB_SPLITTER_HPP
+#define OSMIUM_IO_DETAIL_PBF_BLOB_SPLITTER_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/io/detail/pbf.hpp>
+#include <osmium/io/detail/pbf_decoder.hpp>
+#include <osmium/io/detail/protobuf_tags.hpp>
+#include <osmium/io/error.hpp>
+
+#include <protozero/pbf_message.hpp>
+#include <protozero/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            /**
+             * Splits PBF data into blobs. For each blob it reads the size
+             * in front of the BlobHeader and the BlobHeader itself, checks
+             * them, and gives access to the blob data. This is used by
+             * all code reading PBF files blob by blob.
+             *
+             * The data either is in memory as a whole (for instance in a
+             * memory mapped file) or it comes in chunks from a function.
+             * Chunks are appended to an internal buffer. Data that was
+             * used is only removed from the front of the buffer once it
+             * is more than half of the buffer. So each byte is moved at
+             * most once on average.
+             */
+            class PBFBlobSplitter {
+
+                // Returns the next chunk of data or an empty string at
+                // the end of the input. Not set for in-memory data.
+                std::function<std::string()> m_get_input{};
+
+                // Chunks from the input. The data not used yet starts at
+                // m_offset.
+                std::string m_buffer{};
+
+                // In-memory data (if there is no m_get_input function).
+                const char* m_data = nullptr;
+                std::size_t m_size = 0;
+
+                std::size_t m_offset = 0;
+
+                // Number of bytes removed from the front of m_buffer.
+                std::size_t m_removed = 0;
+
+                // Size of the size field plus BlobHeader of the current
+                // blob and size of its data.
+                std::size_t m_header_size = 0;
+                std::size_t m_blob_size = 0;
+
+                bool m_input_done = false;
+
+                const char* data() const noexcept {
+                    return (m_get_input ? m_buffer.data() : m_data) + m_offset;
+                }
+
+                std::size_t available() const noexcept {
+                    return (m_get_input ? m_buffer.size() : m_size) - m_offset;
+                }
+
+                /**
+                 * Get the next chunk from the input. Returns false if the
+                 * input has ended.
+                 */
+                bool get_chunk() {
+                    if (!m_get_input || m_input_done) {
+                        return false;
+                    }
+
+                    std::string chunk{m_get_input()};
+                    if (chunk.empty()) {
+                        m_input_done = true;
+                        return false;
+                    }
+
+                    if (m_offset == m_buffer.size()) {
+                        m_removed += m_buffer.size();
+                        m_buffer = std::move(chunk);
+                        m_offset = 0;
+                        return true;
+                    }
+
+                    if (m_offset > m_buffer.size() / 2) {
+                        m_buffer.erase(0, m_offset);
+                        m_removed += m_offset;
+                        m_offset = 0;
+                    }
+                    m_buffer.append(chunk);
+
+                    return true;
+                }
+
+                /**
+                 * Make sure there are at least size bytes available.
+                 * Returns false if the input ends before that.
+                 */
+                bool fill(std::size_t size) {
+                    while (available() < size) {
+                        if (!get_chunk()) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+
+                /**
+                 * Move forward size bytes. Data that is not in the buffer
+                 * yet is read and thrown away without copying it.
+                 */
+                void advance(std::size_t size) {
+                    while (available() < size) {
+                        size -= available();
+                        m_offset += available();
+                        if (!get_chunk()) {
+                            throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                        }
+                    }
+                    m_offset += size;
+                }
+
+                void fill_blob() {
+                    if (!fill(m_header_size + m_blob_size)) {
+                        throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                    }
+                }
+
+            public:
+
+                /**
+                 * Split data coming from a function. The function must
+                 * return an empty string at the end of the input.
+                 */
+                explicit PBFBlobSplitter(std::function<std::string()>&& get_input) :
+                    m_get_input(std::move(get_input)) {
+                }
+
+                /**
+                 * Split data in memory. The data must be available as long
+                 * as this object is used.
+                 */
+                PBFBlobSplitter(const char* data, std::size_t size) noexcept :
+                    m_data(data),
+                    m_size(size) {
+                }
+
+                /**
+                 * Go to the next blob and read its BlobHeader. The BlobHeader
+                 * must be of the expected type. If there is index data in
+                 * the BlobHeader, it is decoded into index. The data of
+                 * the previous blob is skipped if it was not accessed.
+                 *
+                 * @returns The size of the blob data or 0 at the end of the
+                 *          input.
+                 * @throws osmium::pbf_error If the data is not valid PBF or
+                 *         it is truncated.
+                 */
+                std::size_t next(const char* expected_type, pbf_blob_index& index) {
+                    advance(m_header_size + m_blob_size);
+                    m_header_size = 0;
+                    m_blob_size = 0;
+
+                    if (!fill(sizeof(uint32_t))) {
+                        if (available() != 0) {
+                            throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                        }
+                        return 0;
+                    }
+
+                    const std::size_t header_size = sizeof(uint32_t) + decode_blob_header_size(data());
+                    if (!fill(header_size)) {
+                        throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                    }
+
+                    const protozero::data_view blob_header{data() + sizeof(uint32_t), header_size - sizeof(uint32_t)};
+                    const std::size_t size = decode_blob_header(protozero::pbf_message<FileFormat::BlobHeader>{blob_header}, expected_type, index);
+                    if (size > max_uncompressed_blob_size) {
+                        throw osmium::pbf_error{std::string{"invalid blob size: "} +
+                                                std::to_string(size)};
+                    }
+
+                    m_header_size = header_size;
+                    m_blob_size = size;
+
+                    return size;
+                }
+
+                /**
+                 * The data of the current blob. The view is valid until
+                 * the next call to next().
+                 *
+                 * @throws osmium::pbf_error If the data is truncated.
+                 */
+                protozero::data_view blob() {
+                    fill_blob();
+                    return {data() + m_header_size, m_blob_size};
+                }
+
+                /**
+                 * The current blob as it is in the input: The size of the
+                 * BlobHeader, the BlobHeader and the blob data. The view is
+                 * valid until the next call to next().
+                 *
+                 * @throws osmium::pbf_error If the data is truncated.
+                 */
+                protozero::data_view raw_blob() {
+                    fill_blob();
+                    return {data(), m_header_size + m_blob_size};
+                }
+
+                /// The size of the size field and the BlobHeader of the current blob.
+                std::size_t header_size() const noexcept {
+                    return m_header_size;
+                }
+
+                /// The offset in the input after the end of the current blob.
+                std::size_t offset() const noexcept {
+                    return m_removed + m_offset + m_header_size + m_blob_size;
+                }
+
+            }; // class PBFBlobSplitter
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DETAIL_PBF_BLOB_SPLITTER_HPP
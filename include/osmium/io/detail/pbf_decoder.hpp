@@ -34,17 +34,28 @@ DEALINGS IN THE SOFTWARE.
 */
 
 #include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/io/detail/packed_varint.hpp>
 #include <osmium/io/detail/pbf.hpp> // IWYU pragma: export
 #include <osmium/io/detail/protobuf_tags.hpp>
 #include <osmium/io/detail/zlib.hpp>
+#ifdef OSMIUM_WITH_LZ4
+# include <osmium/io/detail/lz4.hpp>
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+# include <osmium/io/detail/zstd.hpp>
+#endif
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
+#include <osmium/io/metrics.hpp>
+#include <osmium/io/reader_options.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
 #include <osmium/osm/box.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/item_type.hpp>
 #include <osmium/osm/location.hpp>
 #include <osmium/osm/node.hpp>
+#include <osmium/osm/node_location_batch.hpp>
 #include <osmium/osm/object.hpp>
 #include <osmium/osm/relation.hpp>
 #include <osmium/osm/timestamp.hpp>
@@ -52,10 +63,12 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/osm/way.hpp>
 #include <osmium/util/delta.hpp>
 
+#include <protozero/exception.hpp>
 #include <protozero/iterators.hpp>
 #include <protozero/pbf_message.hpp>
 #include <protozero/types.hpp>
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <limits>
@@ -78,6 +91,55 @@ namespace osmium {
             using protozero::data_view;
             using osm_string_len_type = std::pair<const char*, osmium::string_size_type>;
 
+            /**
+             * The settings in the PrimitiveBlock message that are needed
+             * to convert coordinates and timestamps of the objects in it.
+             */
+            struct pbf_block_settings {
+
+                int64_t lon_offset = 0;
+                int64_t lat_offset = 0;
+                int64_t date_factor = 1000;
+                int32_t granularity = 100;
+
+                /**
+                 * Decode the current field of the PrimitiveBlock message
+                 * if it is one of the settings. Returns false otherwise,
+                 * the field has to be handled by the caller then.
+                 */
+                bool decode(protozero::pbf_message<OSMFormat::PrimitiveBlock>& pbf_primitive_block) {
+                    switch (pbf_primitive_block.tag_and_type()) {
+                        case protozero::tag_and_type(OSMFormat::PrimitiveBlock::optional_int32_granularity, protozero::pbf_wire_type::varint):
+                            granularity = pbf_primitive_block.get_int32();
+                            return true;
+                        case protozero::tag_and_type(OSMFormat::PrimitiveBlock::optional_int32_date_granularity, protozero::pbf_wire_type::varint):
+                            date_factor = pbf_primitive_block.get_int32();
+                            return true;
+                        case protozero::tag_and_type(OSMFormat::PrimitiveBlock::optional_int64_lat_offset, protozero::pbf_wire_type::varint):
+                            lat_offset = pbf_primitive_block.get_int64();
+                            return true;
+                        case protozero::tag_and_type(OSMFormat::PrimitiveBlock::optional_int64_lon_offset, protozero::pbf_wire_type::varint):
+                            lon_offset = pbf_primitive_block.get_int64();
+                            return true;
+                        default:
+                            break;
+                    }
+                    return false;
+                }
+
+                osmium::Location location(int64_t lon, int64_t lat) const noexcept {
+                    return osmium::Location{
+                        int32_t((lon * granularity + lon_offset) / resolution_convert),
+                        int32_t((lat * granularity + lat_offset) / resolution_convert)
+                    };
+                }
+
+                int64_t timestamp(int64_t date) const noexcept {
+                    return date * date_factor / 1000;
+                }
+
+            }; // struct pbf_block_settings
+
             class PBFPrimitiveBlockDecoder {
 
                 static constexpr const size_t initial_buffer_size = 2 * 1024 * 1024;
@@ -85,17 +147,206 @@ namespace osmium {
                 data_view m_data;
                 std::vector<osm_string_len_type> m_stringtable;
 
-                int64_t m_lon_offset = 0;
-                int64_t m_lat_offset = 0;
-                int64_t m_date_factor = 1000;
-                int32_t m_granularity = 100;
+                pbf_block_settings m_settings;
 
                 osmium::osm_entity_bits::type m_read_types;
 
-                osmium::memory::Buffer m_buffer { initial_buffer_size };
+                osmium::memory::Buffer m_buffer;
 
                 osmium::io::read_meta m_read_metadata;
 
+                // Filter set by the user. Objects not matching it are
+                // skipped before they are built. Can be nullptr.
+                const osmium::io::detail::read_filter* m_filter;
+
+                // Only objects with a tag key matching this filter are
+                // decoded (if it is set and applies to the object type).
+                const osmium::io::key_filter* m_key_filter;
+
+                // Do objects of these types have to be checked against the
+                // filter?
+                bool m_check_nodes;
+                bool m_check_ways;
+                bool m_check_relations;
+
+                // For each entry in the string table: does it match the
+                // key filter? Empty if there is no key filter.
+                std::vector<bool> m_matching_keys;
+
+                // The delta encoded arrays of the DenseNodes and DenseInfo
+                // messages are decoded into these columns in one pass
+                // before the nodes are built. They are reused for all
+                // groups in a block.
+                std::vector<int64_t> m_dense_ids;
+                std::vector<int64_t> m_dense_lats;
+                std::vector<int64_t> m_dense_lons;
+                std::vector<int64_t> m_dense_timestamps;
+                std::vector<int64_t> m_dense_changesets;
+                std::vector<int64_t> m_dense_uids;
+                std::vector<int64_t> m_dense_user_sids;
+
+                static bool needs_check(const osmium::io::detail::read_filter* filter, osmium::item_type type) noexcept {
+                    if (!filter) {
+                        return false;
+                    }
+                    const auto& key_filter = filter->get_key_filter();
+                    if (key_filter && (key_filter->entities() & osmium::osm_entity_bits::from_item_type(type))) {
+                        return true;
+                    }
+                    if (filter->min_id(type) != std::numeric_limits<osmium::object_id_type>::min() ||
+                        filter->max_id(type) != std::numeric_limits<osmium::object_id_type>::max()) {
+                        return true;
+                    }
+                    return type == osmium::item_type::node && filter->box();
+                }
+
+                bool key_filter_applies(osmium::osm_entity_bits::type type) const noexcept {
+                    return m_key_filter && (m_key_filter->entities() & type);
+                }
+
+                bool key_matches(int64_t index) const {
+                    return index >= 0 && static_cast<std::size_t>(index) < m_matching_keys.size() && m_matching_keys[static_cast<std::size_t>(index)];
+                }
+
+                bool id_in_range(osmium::item_type type, int64_t id) const noexcept {
+                    return id >= m_filter->min_id(type) && id <= m_filter->max_id(type);
+                }
+
+                bool location_in_box(int64_t lon, int64_t lat) const noexcept {
+                    const auto& box = m_filter->box();
+                    return !box || box.contains(m_settings.location(lon, lat));
+                }
+
+                /**
+                 * Does the Node message match the filter? Only the ID,
+                 * the location, and the keys are looked at, the node is
+                 * not decoded.
+                 */
+                bool keep_node(const data_view& data) const {
+                    bool has_key = !key_filter_applies(osmium::osm_entity_bits::node);
+                    int64_t lon = std::numeric_limits<int64_t>::max();
+                    int64_t lat = std::numeric_limits<int64_t>::max();
+
+                    protozero::pbf_message<OSMFormat::Node> pbf_node{data};
+                    while (pbf_node.next()) {
+                        switch (pbf_node.tag_and_type()) {
+                            case protozero::tag_and_type(OSMFormat::Node::required_sint64_id, protozero::pbf_wire_type::varint):
+                                if (!id_in_range(osmium::item_type::node, pbf_node.get_sint64())) {
+                                    return false;
+                                }
+                                break;
+                            case protozero::tag_and_type(OSMFormat::Node::packed_uint32_keys, protozero::pbf_wire_type::length_delimited):
+                                if (has_key) {
+                                    pbf_node.skip();
+                                } else {
+                                    for (const auto key : pbf_node.get_packed_uint32()) {
+                                        if (key_matches(key)) {
+                                            has_key = true;
+                                            break;
+                                        }
+                                    }
+                                }
+                                break;
+                            case protozero::tag_and_type(OSMFormat::Node::required_sint64_lat, protozero::pbf_wire_type::varint):
+                                lat = pbf_node.get_sint64();
+                                break;
+                            case protozero::tag_and_type(OSMFormat::Node::required_sint64_lon, protozero::pbf_wire_type::varint):
+                                lon = pbf_node.get_sint64();
+                                break;
+                            default:
+                                pbf_node.skip();
+                        }
+                    }
+
+                    if (!has_key) {
+                        return false;
+                    }
+
+                    if (!m_filter->box()) {
+                        return true;
+                    }
+
+                    // nodes without location are never inside the box
+                    return lon != std::numeric_limits<int64_t>::max() &&
+                           lat != std::numeric_limits<int64_t>::max() &&
+                           location_in_box(lon, lat);
+                }
+
+                /**
+                 * Does the Way or Relation message match the filter? Only
+                 * the ID and the keys are looked at, the object is not
+                 * decoded.
+                 */
+                template <typename TMessage>
+                bool keep_way_or_relation(osmium::item_type type, const data_view& data) const {
+                    bool has_key = !key_filter_applies(osmium::osm_entity_bits::from_item_type(type));
+
+                    protozero::pbf_message<TMessage> message{data};
+                    while (message.next()) {
+                        switch (message.tag_and_type()) {
+                            case protozero::tag_and_type(TMessage::required_int64_id, protozero::pbf_wire_type::varint):
+                                if (!id_in_range(type, message.get_int64())) {
+                                    return false;
+                                }
+                                break;
+                            case protozero::tag_and_type(TMessage::packed_uint32_keys, protozero::pbf_wire_type::length_delimited):
+                                if (has_key) {
+                                    message.skip();
+                                } else {
+                                    for (const auto key : message.get_packed_uint32()) {
+                                        if (key_matches(key)) {
+                                            has_key = true;
+                                            break;
+                                        }
+                                    }
+                                }
+                                break;
+                            default:
+                                message.skip();
+                        }
+                    }
+
+                    return has_key;
+                }
+
+                /**
+                 * Do the tags of the dense node starting at it have a key
+                 * matching the key filter?
+                 */
+                bool dense_node_has_matching_key(protozero::pbf_reader::const_int32_iterator it, protozero::pbf_reader::const_int32_iterator last) const {
+                    while (it != last && *it != 0) {
+                        if (key_matches(*it)) {
+                            return true;
+                        }
+                        ++it;
+                        if (it == last) {
+                            break;
+                        }
+                        ++it;
+                    }
+                    return false;
+                }
+
+                /**
+                 * Does the dense node with the given (delta decoded) ID and
+                 * coordinates and the tags starting at tag_it match the
+                 * filter?
+                 */
+                bool keep_dense_node(int64_t id, int64_t lon, int64_t lat, protozero::pbf_reader::const_int32_iterator tag_it, protozero::pbf_reader::const_int32_iterator last) const {
+                    return id_in_range(osmium::item_type::node, id) &&
+                           location_in_box(lon, lat) &&
+                           (!key_filter_applies(osmium::osm_entity_bits::node) || dense_node_has_matching_key(tag_it, last));
+                }
+
+                static void skip_dense_node_tags(protozero::pbf_reader::const_int32_iterator& it, protozero::pbf_reader::const_int32_iterator last) {
+                    while (it != last && *it != 0) {
+                        ++it;
+                    }
+                    if (it != last) {
+                        ++it;
+                    }
+                }
+
                 void decode_stringtable(const data_view& data) {
                     if (!m_stringtable.empty()) {
                         throw osmium::pbf_error{"more than one stringtable in pbf file"};
@@ -109,6 +360,15 @@ namespace osmium {
                         }
                         m_stringtable.emplace_back(str_view.data(), osmium::string_size_type(str_view.size()));
                     }
+
+                    if (m_key_filter) {
+                        std::string key;
+                        m_matching_keys.reserve(m_stringtable.size());
+                        for (const auto& str : m_stringtable) {
+                            key.assign(str.first, str.second);
+                            m_matching_keys.push_back((*m_key_filter)(key.c_str()));
+                        }
+                    }
                 }
 
                 void decode_primitive_block_metadata() {
@@ -118,20 +378,10 @@ namespace osmium {
                             case protozero::tag_and_type(OSMFormat::PrimitiveBlock::required_StringTable_stringtable, protozero::pbf_wire_type::length_delimited):
                                 decode_stringtable(pbf_primitive_block.get_view());
                                 break;
-                            case protozero::tag_and_type(OSMFormat::PrimitiveBlock::optional_int32_granularity, protozero::pbf_wire_type::varint):
-                                m_granularity = pbf_primitive_block.get_int32();
-                                break;
-                            case protozero::tag_and_type(OSMFormat::PrimitiveBlock::optional_int32_date_granularity, protozero::pbf_wire_type::varint):
-                                m_date_factor = pbf_primitive_block.get_int32();
-                                break;
-                            case protozero::tag_and_type(OSMFormat::PrimitiveBlock::optional_int64_lat_offset, protozero::pbf_wire_type::varint):
-                                m_lat_offset = pbf_primitive_block.get_int64();
-                                break;
-                            case protozero::tag_and_type(OSMFormat::PrimitiveBlock::optional_int64_lon_offset, protozero::pbf_wire_type::varint):
-                                m_lon_offset = pbf_primitive_block.get_int64();
-                                break;
                             default:
-                                pbf_primitive_block.skip();
+                                if (!m_settings.decode(pbf_primitive_block)) {
+                                    pbf_primitive_block.skip();
+                                }
                         }
                     }
                 }
@@ -144,8 +394,11 @@ namespace osmium {
                             switch (pbf_primitive_group.tag_and_type()) {
                                 case protozero::tag_and_type(OSMFormat::PrimitiveGroup::repeated_Node_nodes, protozero::pbf_wire_type::length_delimited):
                                     if (m_read_types & osmium::osm_entity_bits::node) {
-                                        decode_node(pbf_primitive_group.get_view());
-                                        m_buffer.commit();
+                                        const auto data = pbf_primitive_group.get_view();
+                                        if (!m_check_nodes || keep_node(data)) {
+                                            decode_node(data);
+                                            m_buffer.commit();
+                                        }
                                     } else {
                                         pbf_primitive_group.skip();
                                     }
@@ -164,16 +417,22 @@ namespace osmium {
                                     break;
                                 case protozero::tag_and_type(OSMFormat::PrimitiveGroup::repeated_Way_ways, protozero::pbf_wire_type::length_delimited):
                                     if (m_read_types & osmium::osm_entity_bits::way) {
-                                        decode_way(pbf_primitive_group.get_view());
-                                        m_buffer.commit();
+                                        const auto data = pbf_primitive_group.get_view();
+                                        if (!m_check_ways || keep_way_or_relation<OSMFormat::Way>(osmium::item_type::way, data)) {
+                                            decode_way(data);
+                                            m_buffer.commit();
+                                        }
                                     } else {
                                         pbf_primitive_group.skip();
                                     }
                                     break;
                                 case protozero::tag_and_type(OSMFormat::PrimitiveGroup::repeated_Relation_relations, protozero::pbf_wire_type::length_delimited):
                                     if (m_read_types & osmium::osm_entity_bits::relation) {
-                                        decode_relation(pbf_primitive_group.get_view());
-                                        m_buffer.commit();
+                                        const auto data = pbf_primitive_group.get_view();
+                                        if (!m_check_relations || keep_way_or_relation<OSMFormat::Relation>(osmium::item_type::relation, data)) {
+                                            decode_relation(data);
+                                            m_buffer.commit();
+                                        }
                                     } else {
                                         pbf_primitive_group.skip();
                                     }
@@ -206,7 +465,7 @@ namespace osmium {
                                 }
                                 break;
                             case protozero::tag_and_type(OSMFormat::Info::optional_int64_timestamp, protozero::pbf_wire_type::varint):
-                                object.set_timestamp(pbf_info.get_int64() * m_date_factor / 1000);
+                                object.set_timestamp(m_settings.timestamp(pbf_info.get_int64()));
                                 break;
                             case protozero::tag_and_type(OSMFormat::Info::optional_int64_changeset, protozero::pbf_wire_type::varint):
                                 {
@@ -258,10 +517,6 @@ namespace osmium {
                     }
                 }
 
-                int32_t convert_pbf_coordinate(int64_t c) const noexcept {
-                    return int32_t((c * m_granularity + m_lon_offset) / resolution_convert);
-                }
-
                 void decode_node(const data_view& data) {
                     osmium::builder::NodeBuilder builder{m_buffer};
                     osmium::Node& node = builder.object();
@@ -308,10 +563,7 @@ namespace osmium {
                             lat == std::numeric_limits<int64_t>::max()) {
                             throw osmium::pbf_error{"illegal coordinate format"};
                         }
-                        node.set_location(osmium::Location{
-                                convert_pbf_coordinate(lon),
-                                convert_pbf_coordinate(lat)
-                        });
+                        node.set_location(m_settings.location(lon, lat));
                     }
 
                     builder.set_user(user.first, user.second);
@@ -378,8 +630,7 @@ namespace osmium {
                             while (!refs.empty() && !lons.empty() && !lats.empty()) {
                                 wnl_builder.add_node_ref(
                                     ref.update(refs.front()),
-                                    osmium::Location{convert_pbf_coordinate(lon.update(lons.front())),
-                                                     convert_pbf_coordinate(lat.update(lats.front()))}
+                                    m_settings.location(lon.update(lons.front()), lat.update(lats.front()))
                                 );
                                 refs.drop_front();
                                 lons.drop_front();
@@ -477,24 +728,28 @@ namespace osmium {
                     }
                 }
 
-                void decode_dense_nodes_without_metadata(const data_view& data) {
-                    protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> ids;
-                    protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> lats;
-                    protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> lons;
+                static void decode_dense_column(const data_view& data, std::vector<int64_t>& column) {
+                    decode_packed_sint64_delta(data.data(), data.data() + data.size(), column);
+                }
 
+                void decode_dense_nodes_without_metadata(const data_view& data) {
                     protozero::iterator_range<protozero::pbf_reader::const_int32_iterator>  tags;
 
+                    m_dense_ids.clear();
+                    m_dense_lats.clear();
+                    m_dense_lons.clear();
+
                     protozero::pbf_message<OSMFormat::DenseNodes> pbf_dense_nodes{data};
                     while (pbf_dense_nodes.next()) {
                         switch (pbf_dense_nodes.tag_and_type()) {
                             case protozero::tag_and_type(OSMFormat::DenseNodes::packed_sint64_id, protozero::pbf_wire_type::length_delimited):
-                                ids = pbf_dense_nodes.get_packed_sint64();
+                                decode_dense_column(pbf_dense_nodes.get_view(), m_dense_ids);
                                 break;
                             case protozero::tag_and_type(OSMFormat::DenseNodes::packed_sint64_lat, protozero::pbf_wire_type::length_delimited):
-                                lats = pbf_dense_nodes.get_packed_sint64();
+                                decode_dense_column(pbf_dense_nodes.get_view(), m_dense_lats);
                                 break;
                             case protozero::tag_and_type(OSMFormat::DenseNodes::packed_sint64_lon, protozero::pbf_wire_type::length_delimited):
-                                lons = pbf_dense_nodes.get_packed_sint64();
+                                decode_dense_column(pbf_dense_nodes.get_view(), m_dense_lons);
                                 break;
                             case protozero::tag_and_type(OSMFormat::DenseNodes::packed_int32_keys_vals, protozero::pbf_wire_type::length_delimited):
                                 tags = pbf_dense_nodes.get_packed_int32();
@@ -504,33 +759,29 @@ namespace osmium {
                         }
                     }
 
-                    osmium::DeltaDecode<int64_t> dense_id;
-                    osmium::DeltaDecode<int64_t> dense_latitude;
-                    osmium::DeltaDecode<int64_t> dense_longitude;
+                    if (m_dense_lons.size() < m_dense_ids.size() ||
+                        m_dense_lats.size() < m_dense_ids.size()) {
+                        // this is against the spec, must have same number of elements
+                        throw osmium::pbf_error{"PBF format error"};
+                    }
 
                     auto tag_it = tags.begin();
 
-                    while (!ids.empty()) {
-                        if (lons.empty() ||
-                            lats.empty()) {
-                            // this is against the spec, must have same number of elements
-                            throw osmium::pbf_error{"PBF format error"};
+                    for (std::size_t i = 0; i < m_dense_ids.size(); ++i) {
+                        const auto id = m_dense_ids[i];
+                        const auto lon = m_dense_lons[i];
+                        const auto lat = m_dense_lats[i];
+
+                        if (m_check_nodes && !keep_dense_node(id, lon, lat, tag_it, tags.end())) {
+                            skip_dense_node_tags(tag_it, tags.end());
+                            continue;
                         }
 
                         osmium::builder::NodeBuilder builder{m_buffer};
                         osmium::Node& node = builder.object();
 
-                        node.set_id(dense_id.update(ids.front()));
-                        ids.drop_front();
-
-                        const auto lon = dense_longitude.update(lons.front());
-                        lons.drop_front();
-                        const auto lat = dense_latitude.update(lats.front());
-                        lats.drop_front();
-                        builder.object().set_location(osmium::Location(
-                                convert_pbf_coordinate(lon),
-                                convert_pbf_coordinate(lat)
-                        ));
+                        node.set_id(id);
+                        builder.object().set_location(m_settings.location(lon, lat));
 
                         if (tag_it != tags.end()) {
                             build_tag_list_from_dense_nodes(builder, tag_it, tags.end());
@@ -542,24 +793,24 @@ namespace osmium {
                 void decode_dense_nodes(const data_view& data) {
                     bool has_info = false;
 
-                    protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> ids;
-                    protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> lats;
-                    protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> lons;
-
                     protozero::iterator_range<protozero::pbf_reader::const_int32_iterator>  tags;
 
                     protozero::iterator_range<protozero::pbf_reader::const_int32_iterator>  versions;
-                    protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> timestamps;
-                    protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> changesets;
-                    protozero::iterator_range<protozero::pbf_reader::const_sint32_iterator> uids;
-                    protozero::iterator_range<protozero::pbf_reader::const_sint32_iterator> user_sids;
                     protozero::iterator_range<protozero::pbf_reader::const_int32_iterator>  visibles;
 
+                    m_dense_ids.clear();
+                    m_dense_lats.clear();
+                    m_dense_lons.clear();
+                    m_dense_timestamps.clear();
+                    m_dense_changesets.clear();
+                    m_dense_uids.clear();
+                    m_dense_user_sids.clear();
+
                     protozero::pbf_message<OSMFormat::DenseNodes> pbf_dense_nodes{data};
                     while (pbf_dense_nodes.next()) {
                         switch (pbf_dense_nodes.tag_and_type()) {
                             case protozero::tag_and_type(OSMFormat::DenseNodes::packed_sint64_id, protozero::pbf_wire_type::length_delimited):
-                                ids = pbf_dense_nodes.get_packed_sint64();
+                                decode_dense_column(pbf_dense_nodes.get_view(), m_dense_ids);
                                 break;
                             case protozero::tag_and_type(OSMFormat::DenseNodes::optional_DenseInfo_denseinfo, protozero::pbf_wire_type::length_delimited):
                                 {
@@ -571,16 +822,16 @@ namespace osmium {
                                                 versions = pbf_dense_info.get_packed_int32();
                                                 break;
                                             case protozero::tag_and_type(OSMFormat::DenseInfo::packed_sint64_timestamp, protozero::pbf_wire_type::length_delimited):
-                                                timestamps = pbf_dense_info.get_packed_sint64();
+                                                decode_dense_column(pbf_dense_info.get_view(), m_dense_timestamps);
                                                 break;
                                             case protozero::tag_and_type(OSMFormat::DenseInfo::packed_sint64_changeset, protozero::pbf_wire_type::length_delimited):
-                                                changesets = pbf_dense_info.get_packed_sint64();
+                                                decode_dense_column(pbf_dense_info.get_view(), m_dense_changesets);
                                                 break;
                                             case protozero::tag_and_type(OSMFormat::DenseInfo::packed_sint32_uid, protozero::pbf_wire_type::length_delimited):
-                                                uids = pbf_dense_info.get_packed_sint32();
+                                                decode_dense_column(pbf_dense_info.get_view(), m_dense_uids);
                                                 break;
                                             case protozero::tag_and_type(OSMFormat::DenseInfo::packed_sint32_user_sid, protozero::pbf_wire_type::length_delimited):
-                                                user_sids = pbf_dense_info.get_packed_sint32();
+                                                decode_dense_column(pbf_dense_info.get_view(), m_dense_user_sids);
                                                 break;
                                             case protozero::tag_and_type(OSMFormat::DenseInfo::packed_bool_visible, protozero::pbf_wire_type::length_delimited):
                                                 visibles = pbf_dense_info.get_packed_bool();
@@ -592,10 +843,10 @@ namespace osmium {
                                 }
                                 break;
                             case protozero::tag_and_type(OSMFormat::DenseNodes::packed_sint64_lat, protozero::pbf_wire_type::length_delimited):
-                                lats = pbf_dense_nodes.get_packed_sint64();
+                                decode_dense_column(pbf_dense_nodes.get_view(), m_dense_lats);
                                 break;
                             case protozero::tag_and_type(OSMFormat::DenseNodes::packed_sint64_lon, protozero::pbf_wire_type::length_delimited):
-                                lons = pbf_dense_nodes.get_packed_sint64();
+                                decode_dense_column(pbf_dense_nodes.get_view(), m_dense_lons);
                                 break;
                             case protozero::tag_and_type(OSMFormat::DenseNodes::packed_int32_keys_vals, protozero::pbf_wire_type::length_delimited):
                                 tags = pbf_dense_nodes.get_packed_int32();
@@ -605,21 +856,33 @@ namespace osmium {
                         }
                     }
 
-                    osmium::DeltaDecode<int64_t> dense_id;
-                    osmium::DeltaDecode<int64_t> dense_latitude;
-                    osmium::DeltaDecode<int64_t> dense_longitude;
-                    osmium::DeltaDecode<int64_t> dense_uid;
-                    osmium::DeltaDecode<int64_t> dense_user_sid;
-                    osmium::DeltaDecode<int64_t> dense_changeset;
-                    osmium::DeltaDecode<int64_t> dense_timestamp;
+                    if (m_dense_lons.size() < m_dense_ids.size() ||
+                        m_dense_lats.size() < m_dense_ids.size()) {
+                        // this is against the spec, must have same number of elements
+                        throw osmium::pbf_error{"PBF format error"};
+                    }
 
                     auto tag_it = tags.begin();
 
-                    while (!ids.empty()) {
-                        if (lons.empty() ||
-                            lats.empty()) {
-                            // this is against the spec, must have same number of elements
-                            throw osmium::pbf_error{"PBF format error"};
+                    for (std::size_t i = 0; i < m_dense_ids.size(); ++i) {
+                        const auto id = m_dense_ids[i];
+
+                        // even if the node isn't visible, there's still a record
+                        // of its lat/lon in the dense arrays.
+                        const auto lon = m_dense_lons[i];
+                        const auto lat = m_dense_lats[i];
+
+                        if (m_check_nodes && !keep_dense_node(id, lon, lat, tag_it, tags.end())) {
+                            // The other arrays are not delta encoded and
+                            // must be advanced even if the node is not built.
+                            if (!versions.empty()) {
+                                versions.drop_front();
+                            }
+                            if (!visibles.empty()) {
+                                visibles.drop_front();
+                            }
+                            skip_dense_node_tags(tag_it, tags.end());
+                            continue;
                         }
 
                         bool visible = true;
@@ -627,8 +890,7 @@ namespace osmium {
                         osmium::builder::NodeBuilder builder{m_buffer};
                         osmium::Node& node = builder.object();
 
-                        node.set_id(dense_id.update(ids.front()));
-                        ids.drop_front();
+                        node.set_id(id);
 
                         if (has_info) {
                             if (!versions.empty()) {
@@ -645,9 +907,8 @@ namespace osmium {
                                 }
                             }
 
-                            if (!changesets.empty()) {
-                                const auto changeset_id = dense_changeset.update(changesets.front());
-                                changesets.drop_front();
+                            if (i < m_dense_changesets.size()) {
+                                const auto changeset_id = m_dense_changesets[i];
                                 if (changeset_id < -1 || changeset_id >= std::numeric_limits<changeset_id_type>::max()) {
                                     throw osmium::pbf_error{"object changeset_id must be between 0 and 2^32-1"};
                                 }
@@ -659,14 +920,12 @@ namespace osmium {
                                 }
                             }
 
-                            if (!timestamps.empty()) {
-                                node.set_timestamp(dense_timestamp.update(timestamps.front()) * m_date_factor / 1000);
-                                timestamps.drop_front();
+                            if (i < m_dense_timestamps.size()) {
+                                node.set_timestamp(m_settings.timestamp(m_dense_timestamps[i]));
                             }
 
-                            if (!uids.empty()) {
-                                node.set_uid_from_signed(static_cast<osmium::signed_user_id_type>(dense_uid.update(uids.front())));
-                                uids.drop_front();
+                            if (i < m_dense_uids.size()) {
+                                node.set_uid_from_signed(static_cast<osmium::signed_user_id_type>(m_dense_uids[i]));
                             }
 
                             if (!visibles.empty()) {
@@ -675,24 +934,14 @@ namespace osmium {
                             }
                             node.set_visible(visible);
 
-                            if (!user_sids.empty()) {
-                                const auto& u = m_stringtable.at(dense_user_sid.update(user_sids.front()));
-                                user_sids.drop_front();
+                            if (i < m_dense_user_sids.size()) {
+                                const auto& u = m_stringtable.at(m_dense_user_sids[i]);
                                 builder.set_user(u.first, u.second);
                             }
                         }
 
-                        // even if the node isn't visible, there's still a record
-                        // of its lat/lon in the dense arrays.
-                        const auto lon = dense_longitude.update(lons.front());
-                        lons.drop_front();
-                        const auto lat = dense_latitude.update(lats.front());
-                        lats.drop_front();
                         if (visible) {
-                            builder.object().set_location(osmium::Location{
-                                    convert_pbf_coordinate(lon),
-                                    convert_pbf_coordinate(lat)
-                            });
+                            builder.object().set_location(m_settings.location(lon, lat));
                         }
 
                         if (tag_it != tags.end()) {
@@ -704,10 +953,24 @@ namespace osmium {
 
             public:
 
-                PBFPrimitiveBlockDecoder(const data_view& data, osmium::osm_entity_bits::type read_types, osmium::io::read_meta read_metadata) :
+                PBFPrimitiveBlockDecoder(const data_view& data, osmium::osm_entity_bits::type read_types, osmium::io::read_meta read_metadata, osmium::memory::BufferPool* buffer_pool = nullptr, const osmium::io::detail::read_filter* filter = nullptr) :
                     m_data(data),
                     m_read_types(read_types),
-                    m_read_metadata(read_metadata) {
+                    m_buffer(buffer_pool ? buffer_pool->get(initial_buffer_size) : osmium::memory::Buffer{initial_buffer_size}),
+                    m_read_metadata(read_metadata),
+                    m_filter(filter),
+                    m_key_filter(filter ? filter->get_key_filter().get() : nullptr),
+                    m_check_nodes(needs_check(filter, osmium::item_type::node)),
+                    m_check_ways(needs_check(filter, osmium::item_type::way)),
+                    m_check_relations(needs_check(filter, osmium::item_type::relation)),
+                    m_matching_keys(),
+                    m_dense_ids(),
+                    m_dense_lats(),
+                    m_dense_lons(),
+                    m_dense_timestamps(),
+                    m_dense_changesets(),
+                    m_dense_uids(),
+                    m_dense_user_sids() {
                 }
 
                 PBFPrimitiveBlockDecoder(const PBFPrimitiveBlockDecoder&) = delete;
@@ -731,9 +994,10 @@ namespace osmium {
 
             }; // class PBFPrimitiveBlockDecoder
 
-            inline data_view decode_blob(const std::string& blob_data, std::string& output) {
+            inline data_view decode_blob(const data_view& blob_data, std::string& output) {
                 int32_t raw_size = 0;
-                protozero::data_view zlib_data;
+                protozero::data_view compressed_data;
+                FileFormat::Blob compression = FileFormat::Blob::optional_bytes_zlib_data;
 
                 protozero::pbf_message<FileFormat::Blob> pbf_blob{blob_data};
                 while (pbf_blob.next()) {
@@ -753,25 +1017,65 @@ namespace osmium {
                             }
                             break;
                         case protozero::tag_and_type(FileFormat::Blob::optional_bytes_zlib_data, protozero::pbf_wire_type::length_delimited):
-                            zlib_data = pbf_blob.get_view();
+                            compression = FileFormat::Blob::optional_bytes_zlib_data;
+                            compressed_data = pbf_blob.get_view();
                             break;
                         case protozero::tag_and_type(FileFormat::Blob::optional_bytes_lzma_data, protozero::pbf_wire_type::length_delimited):
                             throw osmium::pbf_error{"lzma blobs not implemented"};
+                        case protozero::tag_and_type(FileFormat::Blob::optional_bytes_lz4_data, protozero::pbf_wire_type::length_delimited):
+#ifdef OSMIUM_WITH_LZ4
+                            compression = FileFormat::Blob::optional_bytes_lz4_data;
+                            compressed_data = pbf_blob.get_view();
+                            break;
+#else
+                            throw osmium::pbf_error{"lz4 blobs not supported (compiled without lz4 support)"};
+#endif
+                        case protozero::tag_and_type(FileFormat::Blob::optional_bytes_zstd_data, protozero::pbf_wire_type::length_delimited):
+#ifdef OSMIUM_WITH_ZSTD
+                            compression = FileFormat::Blob::optional_bytes_zstd_data;
+                            compressed_data = pbf_blob.get_view();
+                            break;
+#else
+                            throw osmium::pbf_error{"zstd blobs not supported (compiled without zstd support)"};
+#endif
                         default:
                             throw osmium::pbf_error{"unknown compression"};
                     }
                 }
 
-                if (!zlib_data.empty() && raw_size != 0) {
-                    return osmium::io::detail::zlib_uncompress_string(
-                        zlib_data.data(),
-                        static_cast<unsigned long>(zlib_data.size()), // NOLINT(google-runtime-int)
-                        static_cast<unsigned long>(raw_size), // NOLINT(google-runtime-int)
-                        output
-                    );
+                if (compressed_data.empty() || raw_size == 0) {
+                    throw osmium::pbf_error{"blob contains no data"};
+                }
+
+                switch (compression) {
+#ifdef OSMIUM_WITH_LZ4
+                    case FileFormat::Blob::optional_bytes_lz4_data:
+                        return osmium::io::detail::lz4_uncompress_string(
+                            compressed_data.data(),
+                            compressed_data.size(),
+                            static_cast<std::size_t>(raw_size),
+                            output
+                        );
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+                    case FileFormat::Blob::optional_bytes_zstd_data:
+                        return osmium::io::detail::zstd_uncompress_string(
+                            compressed_data.data(),
+                            compressed_data.size(),
+                            static_cast<std::size_t>(raw_size),
+                            output
+                        );
+#endif
+                    default:
+                        break;
                 }
 
-                throw osmium::pbf_error{"blob contains no data"};
+                return osmium::io::detail::zlib_uncompress_string(
+                    compressed_data.data(),
+                    static_cast<unsigned long>(compressed_data.size()), // NOLINT(google-runtime-int)
+                    static_cast<unsigned long>(raw_size), // NOLINT(google-runtime-int)
+                    output
+                );
             }
 
             inline osmium::Box decode_header_bbox(const data_view& data) {
@@ -814,6 +1118,135 @@ namespace osmium {
                     return box;
             }
 
+            /**
+             * Information about the contents of an OSMData blob, stored in
+             * the BlobHeader.indexdata field. It allows readers to skip
+             * blobs without decompressing and decoding them.
+             */
+            struct pbf_blob_index {
+
+                /// The types of objects in the blob (nothing if unknown).
+                osmium::osm_entity_bits::type types = osmium::osm_entity_bits::nothing;
+
+                /// Smallest object ID in the blob.
+                osmium::object_id_type min_id = std::numeric_limits<osmium::object_id_type>::min();
+
+                /// Largest object ID in the blob.
+                osmium::object_id_type max_id = std::numeric_limits<osmium::object_id_type>::max();
+
+                /// Bounding box of all node locations (undefined if unknown).
+                osmium::Box bbox{};
+
+                /// Is there any information in this index?
+                bool valid() const noexcept {
+                    return types != osmium::osm_entity_bits::nothing;
+                }
+
+            }; // struct pbf_blob_index
+
+            /**
+             * Decode the index data from a BlobHeader. Index data not
+             * written by Osmium or broken index data is ignored, in which
+             * case an invalid index is returned.
+             */
+            inline pbf_blob_index decode_blob_index(const data_view& data) {
+                pbf_blob_index index;
+
+                try {
+                    bool format_ok = false;
+                    protozero::pbf_message<FileFormat::BlobIndex> pbf_index{data};
+                    while (pbf_index.next()) {
+                        switch (pbf_index.tag_and_type()) {
+                            case protozero::tag_and_type(FileFormat::BlobIndex::required_string_format, protozero::pbf_wire_type::length_delimited):
+                                {
+                                    const auto format = pbf_index.get_view();
+                                    format_ok = format.size() == std::strlen(blob_index_format) &&
+                                                !std::strncmp(blob_index_format, format.data(), format.size());
+                                }
+                                break;
+                            case protozero::tag_and_type(FileFormat::BlobIndex::optional_uint32_types, protozero::pbf_wire_type::varint):
+                                index.types = static_cast<osmium::osm_entity_bits::type>(pbf_index.get_uint32() & osmium::osm_entity_bits::nwr);
+                                break;
+                            case protozero::tag_and_type(FileFormat::BlobIndex::optional_sint64_min_id, protozero::pbf_wire_type::varint):
+                                index.min_id = pbf_index.get_sint64();
+                                break;
+                            case protozero::tag_and_type(FileFormat::BlobIndex::optional_sint64_max_id, protozero::pbf_wire_type::varint):
+                                index.max_id = pbf_index.get_sint64();
+                                break;
+                            case protozero::tag_and_type(FileFormat::BlobIndex::optional_HeaderBBox_bbox, protozero::pbf_wire_type::length_delimited):
+                                index.bbox = decode_header_bbox(pbf_index.get_view());
+                                break;
+                            default:
+                                pbf_index.skip();
+                        }
+                    }
+                    if (!format_ok) {
+                        return {};
+                    }
+                } catch (const protozero::exception&) {
+                    return {};
+                } catch (const osmium::pbf_error&) {
+                    return {};
+                }
+
+                return index;
+            }
+
+            /**
+             * Decode the size of the BlobHeader from the 4 bytes in network
+             * byte order in front of it.
+             */
+            inline uint32_t decode_blob_header_size(const char* d) {
+                // size is encoded in network byte order
+                const uint32_t size = (static_cast<uint32_t>(d[3])) |
+                                      (static_cast<uint32_t>(d[2]) << 8u) |
+                                      (static_cast<uint32_t>(d[1]) << 16u) |
+                                      (static_cast<uint32_t>(d[0]) << 24u);
+
+                if (size > static_cast<uint32_t>(max_blob_header_size)) {
+                    throw osmium::pbf_error{"invalid BlobHeader size (> max_blob_header_size)"};
+                }
+
+                return size;
+            }
+
+            /**
+             * Decode the BlobHeader. Make sure it contains the expected
+             * type. Return the size of the following Blob. If there is
+             * index data in the BlobHeader, it is decoded into index.
+             */
+            inline size_t decode_blob_header(protozero::pbf_message<FileFormat::BlobHeader>&& pbf_blob_header, const char* expected_type, pbf_blob_index& index) {
+                protozero::data_view blob_header_type;
+                size_t blob_header_datasize = 0;
+
+                while (pbf_blob_header.next()) {
+                    switch (pbf_blob_header.tag_and_type()) {
+                        case protozero::tag_and_type(FileFormat::BlobHeader::required_string_type, protozero::pbf_wire_type::length_delimited):
+                            blob_header_type = pbf_blob_header.get_view();
+                            break;
+                        case protozero::tag_and_type(FileFormat::BlobHeader::optional_bytes_indexdata, protozero::pbf_wire_type::length_delimited):
+                            index = decode_blob_index(pbf_blob_header.get_view());
+                            break;
+                        case protozero::tag_and_type(FileFormat::BlobHeader::required_int32_datasize, protozero::pbf_wire_type::varint):
+                            blob_header_datasize = pbf_blob_header.get_int32();
+                            break;
+                        default:
+                            pbf_blob_header.skip();
+                    }
+                }
+
+                if (blob_header_datasize == 0) {
+                    throw osmium::pbf_error{"PBF format error: BlobHeader.datasize missing or zero."};
+                }
+
+                if (std::strncmp(expected_type, blob_header_type.data(), blob_header_type.size()) != 0) {
+                    throw osmium::pbf_error{"blob does not have expected type (OSMHeader in first blob, OSMData in following blobs)"};
+                }
+
+                return blob_header_datasize;
+            }
+
+
             inline osmium::io::Header decode_header_block(const data_view& data) {
                 osmium::io::Header header;
                 int i = 0;
@@ -874,34 +1307,315 @@ namespace osmium {
              * @returns Header object
              * @throws osmium::pbf_error If there was a parsing error
              */
-            inline osmium::io::Header decode_header(const std::string& header_block_data) {
+            inline osmium::io::Header decode_header(const data_view& header_block_data) {
                 std::string output;
 
                 return decode_header_block(decode_blob(header_block_data, output));
             }
 
+            /**
+             * Find out which types of objects are in an OSMData blob. The
+             * blob is decompressed, but the objects are not decoded.
+             *
+             * @param blob_data Input data
+             * @returns The types of objects in the blob
+             * @throws osmium::pbf_error If there was a parsing error
+             */
+            inline osmium::osm_entity_bits::type decode_blob_entities(const data_view& blob_data) {
+                std::string output;
+                const auto data = decode_blob(blob_data, output);
+
+                osmium::osm_entity_bits::type entities = osmium::osm_entity_bits::nothing;
+
+                protozero::pbf_message<OSMFormat::PrimitiveBlock> pbf_primitive_block{data};
+                while (pbf_primitive_block.next(OSMFormat::PrimitiveBlock::repeated_PrimitiveGroup_primitivegroup, protozero::pbf_wire_type::length_delimited)) {
+                    protozero::pbf_message<OSMFormat::PrimitiveGroup> pbf_primitive_group = pbf_primitive_block.get_message();
+                    while (pbf_primitive_group.next()) {
+                        switch (pbf_primitive_group.tag()) {
+                            case OSMFormat::PrimitiveGroup::repeated_Node_nodes:
+                            case OSMFormat::PrimitiveGroup::optional_DenseNodes_dense:
+                                entities |= osmium::osm_entity_bits::node;
+                                break;
+                            case OSMFormat::PrimitiveGroup::repeated_Way_ways:
+                                entities |= osmium::osm_entity_bits::way;
+                                break;
+                            case OSMFormat::PrimitiveGroup::repeated_Relation_relations:
+                                entities |= osmium::osm_entity_bits::relation;
+                                break;
+                            default:
+                                break;
+                        }
+                        pbf_primitive_group.skip();
+                    }
+                }
+
+                return entities;
+            }
+
             class PBFDataBlobDecoder {
 
+                // Owns the input data if it was read from the input queue,
+                // empty if the data lives somewhere else (for instance in a
+                // memory mapped file).
                 std::shared_ptr<std::string> m_input_buffer;
+                data_view m_input_data;
                 osmium::osm_entity_bits::type m_read_types;
                 osmium::io::read_meta m_read_metadata;
+                osmium::memory::BufferPool* m_buffer_pool;
+                osmium::io::detail::read_filter m_filter;
+                reader_counters* m_counters;
+
+                // The per-thread scratch space is freed after blobs
+                // larger than this.
+                static constexpr const std::size_t max_scratch_size = 4UL * 1024UL * 1024UL;
+
+                data_view inflate(std::string& output) {
+                    if (!m_counters) {
+                        return decode_blob(m_input_data, output);
+                    }
+
+                    const auto start = metrics_clock::now();
+                    const auto data = decode_blob(m_input_data, output);
+                    if (data.data() == output.data()) {
+                        m_counters->inflate_time.add_since(start);
+                        m_counters->blobs_inflated.add();
+                    }
+                    return data;
+                }
+
+                osmium::memory::Buffer decode(const data_view& data, osmium::memory::BufferPool* buffer_pool) {
+                    PBFPrimitiveBlockDecoder decoder{data, m_read_types, m_read_metadata, buffer_pool, &m_filter};
+                    if (!m_counters) {
+                        return decoder();
+                    }
+
+                    const auto start = metrics_clock::now();
+                    osmium::memory::Buffer buffer{decoder()};
+                    m_counters->decode_time.add_since(start);
+                    return buffer;
+                }
 
             public:
 
-                PBFDataBlobDecoder(std::string&& input_buffer, osmium::osm_entity_bits::type read_types, osmium::io::read_meta read_metadata) :
+                PBFDataBlobDecoder(std::string&& input_buffer, osmium::osm_entity_bits::type read_types, osmium::io::read_meta read_metadata, osmium::memory::BufferPool* buffer_pool = nullptr, const osmium::io::detail::read_filter& filter = osmium::io::detail::read_filter{}, reader_counters* counters = nullptr) :
                     m_input_buffer(std::make_shared<std::string>(std::move(input_buffer))),
+                    m_input_data(*m_input_buffer),
+                    m_read_types(read_types),
+                    m_read_metadata(read_metadata),
+                    m_buffer_pool(buffer_pool),
+                    m_filter(filter),
+                    m_counters(counters) {
+                }
+
+                /**
+                 * Create a decoder for data not owned by the decoder. The
+                 * data must stay valid until the decoder has been run.
+                 */
+                PBFDataBlobDecoder(const data_view& input_data, osmium::osm_entity_bits::type read_types, osmium::io::read_meta read_metadata, osmium::memory::BufferPool* buffer_pool = nullptr, const osmium::io::detail::read_filter& filter = osmium::io::detail::read_filter{}, reader_counters* counters = nullptr) :
+                    m_input_buffer(),
+                    m_input_data(input_data),
                     m_read_types(read_types),
-                    m_read_metadata(read_metadata) {
+                    m_read_metadata(read_metadata),
+                    m_buffer_pool(buffer_pool),
+                    m_filter(filter),
+                    m_counters(counters) {
                 }
 
                 osmium::memory::Buffer operator()() {
-                    std::string output;
-                    PBFPrimitiveBlockDecoder decoder{decode_blob(*m_input_buffer, output), m_read_types, m_read_metadata};
-                    return decoder();
+                    if (!m_buffer_pool) {
+                        std::string output;
+                        return decode(inflate(output), nullptr);
+                    }
+
+                    // Scratch space for uncompressed data, reused by all
+                    // decoders running on the same thread.
+                    static thread_local std::string output;
+                    const auto capacity = output.capacity();
+
+                    const auto data = inflate(output);
+                    if (capacity > 0 && data.data() == output.data() && output.capacity() == capacity) {
+                        m_buffer_pool->add_avoided_allocation();
+                    }
+
+                    osmium::memory::Buffer buffer{decode(data, m_buffer_pool)};
+
+                    // Don't keep the memory of unusually large blobs
+                    // around for the life of the thread.
+                    if (output.capacity() > max_scratch_size) {
+                        std::string{}.swap(output);
+                    }
+
+                    return buffer;
                 }
 
             }; // class PBFDataBlobDecoder
 
+            /**
+             * Decodes only the IDs and locations of the nodes in an OSMData
+             * blob into a NodeLocationBatch. The string table, tags, and
+             * metadata are not looked at, groups with ways or relations
+             * are skipped.
+             */
+            class PBFNodeLocationDecoder {
+
+                std::string m_input_buffer;
+
+                std::vector<int64_t> m_ids{};
+                std::vector<int64_t> m_lats{};
+                std::vector<int64_t> m_lons{};
+
+                pbf_block_settings m_settings;
+
+                void decode_primitive_block_metadata(const data_view& data) {
+                    protozero::pbf_message<OSMFormat::PrimitiveBlock> pbf_primitive_block{data};
+                    while (pbf_primitive_block.next()) {
+                        if (!m_settings.decode(pbf_primitive_block)) {
+                            pbf_primitive_block.skip();
+                        }
+                    }
+                }
+
+                static bool decode_visible(const data_view& data) {
+                    protozero::pbf_message<OSMFormat::Info> pbf_info{data};
+                    if (pbf_info.next(OSMFormat::Info::optional_bool_visible, protozero::pbf_wire_type::varint)) {
+                        return pbf_info.get_bool();
+                    }
+                    return true;
+                }
+
+                void decode_node(const data_view& data, osmium::NodeLocationBatch& batch) const {
+                    osmium::object_id_type id = 0;
+                    int64_t lon = std::numeric_limits<int64_t>::max();
+                    int64_t lat = std::numeric_limits<int64_t>::max();
+                    bool visible = true;
+
+                    protozero::pbf_message<OSMFormat::Node> pbf_node{data};
+                    while (pbf_node.next()) {
+                        switch (pbf_node.tag_and_type()) {
+                            case protozero::tag_and_type(OSMFormat::Node::required_sint64_id, protozero::pbf_wire_type::varint):
+                                id = pbf_node.get_sint64();
+                                break;
+                            case protozero::tag_and_type(OSMFormat::Node::required_sint64_lat, protozero::pbf_wire_type::varint):
+                                lat = pbf_node.get_sint64();
+                                break;
+                            case protozero::tag_and_type(OSMFormat::Node::required_sint64_lon, protozero::pbf_wire_type::varint):
+                                lon = pbf_node.get_sint64();
+                                break;
+                            case protozero::tag_and_type(OSMFormat::Node::optional_Info_info, protozero::pbf_wire_type::length_delimited):
+                                visible = decode_visible(pbf_node.get_view());
+                                break;
+                            default:
+                                pbf_node.skip();
+                        }
+                    }
+
+                    // deleted nodes in history files have no location
+                    if (visible &&
+                        lon != std::numeric_limits<int64_t>::max() &&
+                        lat != std::numeric_limits<int64_t>::max()) {
+                        batch.add(id, m_settings.location(lon, lat));
+                    }
+                }
+
+                void decode_dense_nodes(const data_view& data, osmium::NodeLocationBatch& batch) {
+                    m_ids.clear();
+                    m_lats.clear();
+                    m_lons.clear();
+
+                    protozero::iterator_range<protozero::pbf_reader::const_int32_iterator> visibles;
+
+                    protozero::pbf_message<OSMFormat::DenseNodes> pbf_dense_nodes{data};
+                    while (pbf_dense_nodes.next()) {
+                        switch (pbf_dense_nodes.tag_and_type()) {
+                            case protozero::tag_and_type(OSMFormat::DenseNodes::packed_sint64_id, protozero::pbf_wire_type::length_delimited):
+                                {
+                                    const auto view = pbf_dense_nodes.get_view();
+                                    decode_packed_sint64_delta(view.data(), view.data() + view.size(), m_ids);
+                                }
+                                break;
+                            case protozero::tag_and_type(OSMFormat::DenseNodes::packed_sint64_lat, protozero::pbf_wire_type::length_delimited):
+                                {
+                                    const auto view = pbf_dense_nodes.get_view();
+                                    decode_packed_sint64_delta(view.data(), view.data() + view.size(), m_lats);
+                                }
+                                break;
+                            case protozero::tag_and_type(OSMFormat::DenseNodes::packed_sint64_lon, protozero::pbf_wire_type::length_delimited):
+                                {
+                                    const auto view = pbf_dense_nodes.get_view();
+                                    decode_packed_sint64_delta(view.data(), view.data() + view.size(), m_lons);
+                                }
+                                break;
+                            case protozero::tag_and_type(OSMFormat::DenseNodes::optional_DenseInfo_denseinfo, protozero::pbf_wire_type::length_delimited):
+                                {
+                                    protozero::pbf_message<OSMFormat::DenseInfo> pbf_dense_info{pbf_dense_nodes.get_message()};
+                                    if (pbf_dense_info.next(OSMFormat::DenseInfo::packed_bool_visible, protozero::pbf_wire_type::length_delimited)) {
+                                        visibles = pbf_dense_info.get_packed_bool();
+                                    }
+                                }
+                                break;
+                            default:
+                                pbf_dense_nodes.skip();
+                        }
+                    }
+
+                    if (m_lons.size() < m_ids.size() ||
+                        m_lats.size() < m_ids.size()) {
+                        // this is against the spec, must have same number of elements
+                        throw osmium::pbf_error{"PBF format error"};
+                    }
+
+                    batch.reserve(batch.size() + m_ids.size());
+                    for (std::size_t i = 0; i < m_ids.size(); ++i) {
+                        // deleted nodes in history files have no location
+                        if (!visibles.empty()) {
+                            const bool visible = visibles.front() != 0;
+                            visibles.drop_front();
+                            if (!visible) {
+                                continue;
+                            }
+                        }
+                        batch.add(m_ids[i], m_settings.location(m_lons[i], m_lats[i]));
+                    }
+                }
+
+                osmium::NodeLocationBatch decode(const data_view& data) {
+                    osmium::NodeLocationBatch batch;
+
+                    decode_primitive_block_metadata(data);
+
+                    protozero::pbf_message<OSMFormat::PrimitiveBlock> pbf_primitive_block{data};
+                    while (pbf_primitive_block.next(OSMFormat::PrimitiveBlock::repeated_PrimitiveGroup_primitivegroup, protozero::pbf_wire_type::length_delimited)) {
+                        protozero::pbf_message<OSMFormat::PrimitiveGroup> pbf_primitive_group = pbf_primitive_block.get_message();
+                        while (pbf_primitive_group.next()) {
+                            switch (pbf_primitive_group.tag_and_type()) {
+                                case protozero::tag_and_type(OSMFormat::PrimitiveGroup::repeated_Node_nodes, protozero::pbf_wire_type::length_delimited):
+                                    decode_node(pbf_primitive_group.get_view(), batch);
+                                    break;
+                                case protozero::tag_and_type(OSMFormat::PrimitiveGroup::optional_DenseNodes_dense, protozero::pbf_wire_type::length_delimited):
+                                    decode_dense_nodes(pbf_primitive_group.get_view(), batch);
+                                    break;
+                                default:
+                                    pbf_primitive_group.skip();
+                            }
+                        }
+                    }
+
+                    return batch;
+                }
+
+            public:
+
+                explicit PBFNodeLocationDecoder(std::string&& input_buffer) :
+                    m_input_buffer(std::move(input_buffer)) {
+                }
+
+                osmium::NodeLocationBatch operator()() {
+                    std::string output;
+                    return decode(decode_blob(m_input_buffer, output));
+                }
+
+            }; // class PBFNodeLocationDecoder
+
         } // namespace detail
 
     } // namespace io
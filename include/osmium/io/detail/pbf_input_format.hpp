@@ -35,11 +35,13 @@ DEALINGS IN THE SOFTWARE.
 
 #include <osmium/io/detail/input_format.hpp>
 #include <osmium/io/detail/pbf.hpp> // IWYU pragma: export
+#include <osmium/io/detail/pbf_blob_splitter.hpp>
 #include <osmium/io/detail/pbf_decoder.hpp>
 #include <osmium/io/detail/protobuf_tags.hpp>
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/osm/entity_bits.hpp>
+#include <osmium/thread/affinity.hpp>
 #include <osmium/thread/pool.hpp>
 #include <osmium/thread/util.hpp>
 #include <osmium/util/config.hpp>
@@ -64,129 +66,91 @@ namespace osmium {
 
             class PBFParser : public Parser {
 
-                std::string m_input_buffer{};
+                PBFBlobSplitter m_splitter;
 
-                /**
-                 * Read the given number of bytes from the input queue.
-                 *
-                 * @param size Number of bytes to read
-                 * @returns String with the data
-                 * @throws osmium::pbf_error If size bytes can't be read
-                 */
-                std::string read_from_input_queue(size_t size) {
-                    while (m_input_buffer.size() < size) {
-                        const std::string new_data{get_input()};
-                        if (input_done()) {
-                            throw osmium::pbf_error{"truncated data (EOF encountered)"};
-                        }
-                        m_input_buffer += new_data;
+                PBFBlobSplitter create_splitter() {
+                    if (has_mapped_input()) {
+                        const auto& input = get_mapped_input();
+                        return PBFBlobSplitter{input.data, input.size};
                     }
-
-                    std::string output{m_input_buffer.substr(size)};
-                    m_input_buffer.resize(size);
-
-                    using std::swap;
-                    swap(output, m_input_buffer);
-
-                    return output;
+                    return PBFBlobSplitter{[this]() {
+                        return get_input();
+                    }};
                 }
 
                 /**
-                 * Read 4 bytes in network byte order from file. They contain
-                 * the length of the following BlobHeader.
+                 * Check the index of a blob (if there is one) against the
+                 * types we want to read and the filter set by the user.
+                 * Returns true if the blob can be skipped without decoding
+                 * it.
                  */
-                uint32_t read_blob_header_size_from_file() {
-                    uint32_t size;
-
-                    try {
-                        // size is encoded in network byte order
-                        const std::string input_data{read_from_input_queue(sizeof(size))};
-                        const char* d = input_data.data();
-                        size = (static_cast<uint32_t>(d[3])) |
-                               (static_cast<uint32_t>(d[2]) << 8u) |
-                               (static_cast<uint32_t>(d[1]) << 16u) |
-                               (static_cast<uint32_t>(d[0]) << 24u);
-                    } catch (const osmium::pbf_error&) {
-                        return 0; // EOF
+                bool can_skip_blob(const pbf_blob_index& index) const noexcept {
+                    if (!index.valid()) {
+                        return false;
                     }
 
-                    if (size > static_cast<uint32_t>(max_blob_header_size)) {
-                        throw osmium::pbf_error{"invalid BlobHeader size (> max_blob_header_size)"};
+                    if (!(index.types & read_types())) {
+                        return true;
                     }
 
-                    return size;
+                    return !filter().empty() &&
+                           !filter().may_match(index.types & read_types(), index.min_id, index.max_id, index.bbox);
                 }
 
                 /**
-                 * Decode the BlobHeader. Make sure it contains the expected
-                 * type. Return the size of the following Blob.
+                 * Go to the next blob. Returns the size of the blob data or
+                 * 0 at the end of the input or if the reader was closed.
                  */
-                size_t decode_blob_header(protozero::pbf_message<FileFormat::BlobHeader>&& pbf_blob_header, const char* expected_type) {
-                    protozero::data_view blob_header_type;
-                    size_t blob_header_datasize = 0;
-
-                    while (pbf_blob_header.next()) {
-                        switch (pbf_blob_header.tag_and_type()) {
-                            case protozero::tag_and_type(FileFormat::BlobHeader::required_string_type, protozero::pbf_wire_type::length_delimited):
-                                blob_header_type = pbf_blob_header.get_view();
-                                break;
-                            case protozero::tag_and_type(FileFormat::BlobHeader::required_int32_datasize, protozero::pbf_wire_type::varint):
-                                blob_header_datasize = pbf_blob_header.get_int32();
-                                break;
-                            default:
-                                pbf_blob_header.skip();
+                std::size_t next_blob(const char* expected_type, pbf_blob_index& index) {
+                    if (has_mapped_input()) {
+                        auto& input = get_mapped_input();
+                        if (input.done) {
+                            return 0;
                         }
+                        const auto size = m_splitter.next(expected_type, index);
+                        input.offset = m_splitter.offset();
+                        return size;
                     }
-
-                    if (blob_header_datasize == 0) {
-                        throw osmium::pbf_error{"PBF format error: BlobHeader.datasize missing or zero."};
-                    }
-
-                    if (std::strncmp(expected_type, blob_header_type.data(), blob_header_type.size()) != 0) {
-                        throw osmium::pbf_error{"blob does not have expected type (OSMHeader in first blob, OSMData in following blobs)"};
-                    }
-
-                    return blob_header_datasize;
+                    return m_splitter.next(expected_type, index);
                 }
 
-                size_t check_type_and_get_blob_size(const char* expected_type) {
-                    assert(expected_type);
-
-                    const auto size = read_blob_header_size_from_file();
-                    if (size == 0) { // EOF
-                        return 0;
+                // Parse the header in the PBF OSMHeader blob.
+                void parse_header_blob() {
+                    pbf_blob_index index;
+                    if (next_blob("OSMHeader", index) == 0) {
+                        throw osmium::pbf_error{"truncated data (EOF encountered)"};
                     }
-
-                    const std::string blob_header{read_from_input_queue(size)};
-
-                    return decode_blob_header(protozero::pbf_message<FileFormat::BlobHeader>(blob_header), expected_type);
+                    osmium::io::Header header{decode_header(m_splitter.blob())};
+                    set_header_value(header);
                 }
 
-                std::string read_from_input_queue_with_check(size_t size) {
-                    if (size > max_uncompressed_blob_size) {
-                        throw osmium::pbf_error{std::string{"invalid blob size: "} +
-                                                std::to_string(size)};
+                void decode_data_blob(PBFDataBlobDecoder&& data_blob_parser) {
+                    if (osmium::config::use_pool_threads_for_pbf_parsing()) {
+                        send_to_output_queue_from_pool(std::move(data_blob_parser));
+                    } else {
+                        send_to_output_queue(data_blob_parser());
                     }
-                    return read_from_input_queue(size);
-                }
-
-                // Parse the header in the PBF OSMHeader blob.
-                void parse_header_blob() {
-                    const auto size = check_type_and_get_blob_size("OSMHeader");
-                    osmium::io::Header header{decode_header(read_from_input_queue_with_check(size))};
-                    set_header_value(header);
                 }
 
                 void parse_data_blobs() {
-                    while (const auto size = check_type_and_get_blob_size("OSMData")) {
-                        std::string input_buffer{read_from_input_queue_with_check(size)};
+                    while (true) {
+                        pbf_blob_index index;
+                        if (next_blob("OSMData", index) == 0) { // EOF
+                            break;
+                        }
 
-                        PBFDataBlobDecoder data_blob_parser{std::move(input_buffer), read_types(), read_metadata()};
+                        if (can_skip_blob(index)) {
+                            counters().blobs_skipped.add();
+                            continue;
+                        }
 
-                        if (osmium::config::use_pool_threads_for_pbf_parsing()) {
-                            send_to_output_queue(get_pool().submit(std::move(data_blob_parser)));
+                        const auto data = m_splitter.blob();
+                        if (has_mapped_input()) {
+                            // The mapping outlives the decoder, so no copy
+                            // is needed.
+                            decode_data_blob(PBFDataBlobDecoder{data, read_types(), read_metadata(), get_buffer_pool(), filter(), &counters()});
                         } else {
-                            send_to_output_queue(data_blob_parser());
+                            decode_data_blob(PBFDataBlobDecoder{std::string{data.data(), data.size()}, read_types(), read_metadata(), get_buffer_pool(), filter(), &counters()});
                         }
                     }
                 }
@@ -194,7 +158,8 @@ namespace osmium {
             public:
 
                 explicit PBFParser(parser_arguments& args) :
-                    Parser(args) {
+                    Parser(args),
+                    m_splitter(create_splitter()) {
                 }
 
                 PBFParser(const PBFParser&) = delete;
@@ -207,6 +172,7 @@ namespace osmium {
 
                 void run() final {
                     osmium::thread::set_thread_name("_osmium_pbf_in");
+                    osmium::thread::set_io_thread_affinity();
 
                     parse_header_blob();
 
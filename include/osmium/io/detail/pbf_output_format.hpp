@@ -40,12 +40,19 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/detail/queue_util.hpp>
 #include <osmium/io/detail/string_table.hpp>
 #include <osmium/io/detail/zlib.hpp>
+#ifdef OSMIUM_WITH_LZ4
+# include <osmium/io/detail/lz4.hpp>
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+# include <osmium/io/detail/zstd.hpp>
+#endif
 #include <osmium/io/file.hpp>
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/memory/item_iterator.hpp>
 #include <osmium/osm/box.hpp>
+#include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/item_type.hpp>
 #include <osmium/osm/location.hpp>
 #include <osmium/osm/metadata_options.hpp>
@@ -70,7 +77,9 @@ DEALINGS IN THE SOFTWARE.
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <limits>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
@@ -81,6 +90,86 @@ namespace osmium {
 
         namespace detail {
 
+            /**
+             * Compression used for the blobs in PBF files.
+             */
+            enum class pbf_compression {
+                none = 0,
+                zlib = 1,
+                lz4  = 2,
+                zstd = 3
+            };
+
+            /**
+             * Get compression type from the value of the "pbf_compression"
+             * file option.
+             *
+             * @throws std::invalid_argument If the compression is unknown
+             *         or if support for it was not compiled in.
+             */
+            inline pbf_compression get_pbf_compression(const std::string& value) {
+                if (value.empty() || value == "true" || value == "yes" || value == "zlib") {
+                    return pbf_compression::zlib;
+                }
+                if (value == "none" || value == "false" || value == "no") {
+                    return pbf_compression::none;
+                }
+                if (value == "lz4") {
+#ifdef OSMIUM_WITH_LZ4
+                    return pbf_compression::lz4;
+#else
+                    throw std::invalid_argument{"PBF compression 'lz4' not available (compiled without lz4 support)"};
+#endif
+                }
+                if (value == "zstd") {
+#ifdef OSMIUM_WITH_ZSTD
+                    return pbf_compression::zstd;
+#else
+                    throw std::invalid_argument{"PBF compression 'zstd' not available (compiled without zstd support)"};
+#endif
+                }
+                throw std::invalid_argument{"Unknown value for pbf_compression option: '" + value + "'"};
+            }
+
+            /**
+             * Get compression level from the value of the
+             * "pbf_compression_level" file option. Returns -1 (meaning the
+             * default level of the compression library) if the value is
+             * empty.
+             *
+             * @throws std::invalid_argument If the level is not valid for
+             *         the compression type.
+             */
+            inline int get_pbf_compression_level(pbf_compression compression, const std::string& value) {
+                if (value.empty()) {
+                    return -1;
+                }
+
+                char* end = nullptr;
+                const auto level = std::strtol(value.c_str(), &end, 10);
+
+                int max_level = 0;
+                switch (compression) {
+                    case pbf_compression::zlib:
+                        max_level = 9;
+                        break;
+                    case pbf_compression::lz4:
+                        max_level = 12;
+                        break;
+                    case pbf_compression::zstd:
+                        max_level = 22;
+                        break;
+                    default:
+                        break;
+                }
+
+                if (end == value.c_str() || *end != '\0' || level < 0 || level > max_level) {
+                    throw std::invalid_argument{"Invalid value for pbf_compression_level option: '" + value + "'"};
+                }
+
+                return static_cast<int>(level);
+            }
+
             struct pbf_output_options {
 
                 /// Which metadata of objects should be added?
@@ -90,14 +179,22 @@ namespace osmium {
                 bool use_dense_nodes = true;
 
                 /**
-                 * Should the PBF blobs contain zlib compressed data?
+                 * How should the PBF blobs be compressed?
                  *
-                 * The zlib compression is optional, it's possible to store the
+                 * The compression is optional, it's possible to store the
                  * blobs in raw format. Disabling the compression can improve
                  * the writing speed a little but the output will be 2x to 3x
-                 * bigger.
+                 * bigger. Zlib is the default and the only compression all
+                 * PBF readers understand. Lz4 and zstd are much faster to
+                 * decompress, but need support compiled in.
+                 */
+                pbf_compression compression = pbf_compression::zlib;
+
+                /**
+                 * Compression level. -1 means the default level of the
+                 * compression library.
                  */
-                bool use_compression = true;
+                int compression_level = -1;
 
                 /// Add the "HistoricalInformation" header flag.
                 bool add_historical_information_flag = false;
@@ -108,6 +205,14 @@ namespace osmium {
                 /// Should node locations be added to ways?
                 bool locations_on_ways = false;
 
+                /**
+                 * Should an index with the object types, the ID range, and
+                 * (for nodes) the bounding box be added to the BlobHeader
+                 * of each data blob? Readers can use it to skip blobs they
+                 * are not interested in without decompressing them.
+                 */
+                bool add_blob_index = true;
+
             }; // struct pbf_output_options
 
             /**
@@ -142,9 +247,41 @@ namespace osmium {
 
                 std::string m_msg;
 
+                std::string m_index_data;
+
                 pbf_blob_type m_blob_type;
 
-                bool m_use_compression;
+                pbf_compression m_compression;
+
+                int m_compression_level;
+
+                std::string compress() const {
+                    switch (m_compression) {
+#ifdef OSMIUM_WITH_LZ4
+                        case pbf_compression::lz4:
+                            return osmium::io::detail::lz4_compress(m_msg, m_compression_level < 0 ? 0 : m_compression_level);
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+                        case pbf_compression::zstd:
+                            return osmium::io::detail::zstd_compress(m_msg, m_compression_level < 0 ? 3 : m_compression_level);
+#endif
+                        default:
+                            break;
+                    }
+                    return osmium::io::detail::zlib_compress(m_msg, m_compression_level);
+                }
+
+                FileFormat::Blob compressed_data_tag() const noexcept {
+                    switch (m_compression) {
+                        case pbf_compression::lz4:
+                            return FileFormat::Blob::optional_bytes_lz4_data;
+                        case pbf_compression::zstd:
+                            return FileFormat::Blob::optional_bytes_zstd_data;
+                        default:
+                            break;
+                    }
+                    return FileFormat::Blob::optional_bytes_zlib_data;
+                }
 
             public:
 
@@ -153,13 +290,18 @@ namespace osmium {
                  *
                  * @param msg Protobuf-message containing the blob data
                  * @param type Type of blob.
-                 * @param use_compression Should the output be compressed using
-                 *        zlib?
+                 * @param compression Compression to use for the output.
+                 * @param compression_level Compression level (-1 for
+                 *        the default level).
+                 * @param index_data Data for the indexdata field of the
+                 *        BlobHeader. Not written if empty.
                  */
-                SerializeBlob(std::string&& msg, pbf_blob_type type, bool use_compression) :
+                SerializeBlob(std::string&& msg, pbf_blob_type type, pbf_compression compression, int compression_level, std::string&& index_data = std::string{}) :
                     m_msg(std::move(msg)),
+                    m_index_data(std::move(index_data)),
                     m_blob_type(type),
-                    m_use_compression(use_compression) {
+                    m_compression(compression),
+                    m_compression_level(compression_level) {
                 }
 
                 /**
@@ -173,9 +315,9 @@ namespace osmium {
                     std::string blob_data;
                     protozero::pbf_builder<FileFormat::Blob> pbf_blob{blob_data};
 
-                    if (m_use_compression) {
+                    if (m_compression != pbf_compression::none) {
                         pbf_blob.add_int32(FileFormat::Blob::optional_int32_raw_size, int32_t(m_msg.size()));
-                        pbf_blob.add_bytes(FileFormat::Blob::optional_bytes_zlib_data, osmium::io::detail::zlib_compress(m_msg));
+                        pbf_blob.add_bytes(compressed_data_tag(), compress());
                     } else {
                         pbf_blob.add_bytes(FileFormat::Blob::optional_bytes_raw, m_msg);
                     }
@@ -185,11 +327,16 @@ namespace osmium {
 
                     pbf_blob_header.add_string(FileFormat::BlobHeader::required_string_type, m_blob_type == pbf_blob_type::data ? "OSMData" : "OSMHeader");
 
+                    if (!m_index_data.empty()) {
+                        pbf_blob_header.add_bytes(FileFormat::BlobHeader::optional_bytes_indexdata, m_index_data);
+                    }
+
                     // The static_cast is okay, because the size can never
                     // be much larger than max_uncompressed_blob_size. This
-                    // is due to the assert above and the fact that the zlib
-                    // library will not grow deflated data beyond the original
-                    // data plus a few header bytes (https://zlib.net/zlib_tech.html).
+                    // is due to the assert above and the fact that the
+                    // compression libraries will not grow compressed data
+                    // beyond the original data plus a small overhead
+                    // (https://zlib.net/zlib_tech.html).
                     pbf_blob_header.add_int32(FileFormat::BlobHeader::required_int32_datasize, static_cast<int32_t>(blob_data.size()));
 
                     const auto size = static_cast<uint32_t>(blob_header_data.size());
@@ -215,8 +362,8 @@ namespace osmium {
              * structure.
              *
              * Because this needs to allocate a lot of memory on the heap,
-             * only one object of this class will be created and then re-used
-             * after calling clear() on it.
+             * only one object of this class will be created for each
+             * encoder and then re-used after calling clear() on it.
              */
             class DenseNodes {
 
@@ -240,7 +387,6 @@ namespace osmium {
                 osmium::DeltaEncode<uint32_t, int64_t> m_delta_timestamp;
                 osmium::DeltaEncode<changeset_id_type, int64_t> m_delta_changeset;
                 osmium::DeltaEncode<user_id_type, int32_t> m_delta_uid;
-                osmium::DeltaEncode<int32_t, int32_t> m_delta_user_sid;
 
                 osmium::DeltaEncode<int64_t, int64_t> m_delta_lat;
                 osmium::DeltaEncode<int64_t, int64_t> m_delta_lon;
@@ -274,7 +420,6 @@ namespace osmium {
                     m_delta_timestamp.clear();
                     m_delta_changeset.clear();
                     m_delta_uid.clear();
-                    m_delta_user_sid.clear();
 
                     m_delta_lat.clear();
                     m_delta_lon.clear();
@@ -301,7 +446,7 @@ namespace osmium {
                         m_uids.push_back(m_delta_uid.update(node.uid()));
                     }
                     if (m_options.add_metadata.user()) {
-                        m_user_sids.push_back(m_delta_user_sid.update(m_stringtable.add(node.user())));
+                        m_user_sids.push_back(m_stringtable.add(node.user()));
                     }
                     if (m_options.add_visible_flag) {
                         m_visibles.push_back(node.visible());
@@ -338,7 +483,11 @@ namespace osmium {
                             pbf_dense_info.add_packed_sint32(OSMFormat::DenseInfo::packed_sint32_uid, m_uids.cbegin(), m_uids.cend());
                         }
                         if (m_options.add_metadata.user()) {
-                            pbf_dense_info.add_packed_sint32(OSMFormat::DenseInfo::packed_sint32_user_sid, m_user_sids.cbegin(), m_user_sids.cend());
+                            osmium::DeltaEncode<int32_t, int32_t> delta_user_sid;
+                            protozero::packed_field_sint32 field{pbf_dense_info, protozero::pbf_tag_type(OSMFormat::DenseInfo::packed_sint32_user_sid)};
+                            for (const auto user_sid : m_user_sids) {
+                                field.add_element(delta_user_sid.update(m_stringtable.index(user_sid)));
+                            }
                         }
                         if (m_options.add_visible_flag) {
                             pbf_dense_info.add_packed_bool(OSMFormat::DenseInfo::packed_bool_visible, m_visibles.cbegin(), m_visibles.cend());
@@ -348,7 +497,12 @@ namespace osmium {
                     pbf_dense_nodes.add_packed_sint64(OSMFormat::DenseNodes::packed_sint64_lat, m_lats.cbegin(), m_lats.cend());
                     pbf_dense_nodes.add_packed_sint64(OSMFormat::DenseNodes::packed_sint64_lon, m_lons.cbegin(), m_lons.cend());
 
-                    pbf_dense_nodes.add_packed_int32(OSMFormat::DenseNodes::packed_int32_keys_vals, m_tags.cbegin(), m_tags.cend());
+                    {
+                        protozero::packed_field_int32 field{pbf_dense_nodes, protozero::pbf_tag_type(OSMFormat::DenseNodes::packed_int32_keys_vals)};
+                        for (const auto tag : m_tags) {
+                            field.add_element(m_stringtable.index(tag));
+                        }
+                    }
 
                     return data;
                 }
@@ -364,6 +518,22 @@ namespace osmium {
                 OSMFormat::PrimitiveGroup m_type = OSMFormat::PrimitiveGroup::unknown;
                 int m_count = 0;
 
+                // Nodes (if not using DenseNodes), ways and relations are
+                // only encoded when the block is complete, because the
+                // final string table indexes are not known before that.
+                // Until then we keep pointers to the objects, the indexes
+                // returned by the string table for their strings (in the
+                // order they will be needed when encoding) and an upper
+                // bound for the size of the encoded objects.
+                std::vector<const osmium::OSMObject*> m_objects;
+                std::vector<int32_t> m_string_ids;
+                std::size_t m_next_string_id = 0;
+                std::size_t m_objects_size = 0;
+
+                osmium::object_id_type m_min_id = std::numeric_limits<osmium::object_id_type>::max();
+                osmium::object_id_type m_max_id = std::numeric_limits<osmium::object_id_type>::min();
+                osmium::Box m_bbox{};
+
             public:
 
                 explicit PrimitiveBlock(const pbf_output_options& options) :
@@ -384,16 +554,90 @@ namespace osmium {
                     m_dense_nodes.clear();
                     m_type = type;
                     m_count = 0;
+                    m_objects.clear();
+                    m_string_ids.clear();
+                    m_next_string_id = 0;
+                    m_objects_size = 0;
+                    m_min_id = std::numeric_limits<osmium::object_id_type>::max();
+                    m_max_id = std::numeric_limits<osmium::object_id_type>::min();
+                    m_bbox = osmium::Box{};
+                }
+
+                /// Remember ID of an object added to this block for the index.
+                void update_index(osmium::object_id_type id) noexcept {
+                    if (id < m_min_id) {
+                        m_min_id = id;
+                    }
+                    if (id > m_max_id) {
+                        m_max_id = id;
+                    }
+                }
+
+                /// Remember ID and location of a node added to this block for the index.
+                void update_index(osmium::object_id_type id, const osmium::Location& location) noexcept {
+                    update_index(id);
+                    m_bbox.extend(location);
+                }
+
+                /**
+                 * Serialize the index for this block to be written into the
+                 * indexdata field of the BlobHeader.
+                 */
+                std::string index_data() const {
+                    std::string data;
+                    protozero::pbf_builder<FileFormat::BlobIndex> pbf_blob_index{data};
+
+                    pbf_blob_index.add_string(FileFormat::BlobIndex::required_string_format, blob_index_format);
+
+                    osmium::osm_entity_bits::type types = osmium::osm_entity_bits::nothing;
+                    switch (m_type) {
+                        case OSMFormat::PrimitiveGroup::repeated_Node_nodes:
+                        case OSMFormat::PrimitiveGroup::optional_DenseNodes_dense:
+                            types = osmium::osm_entity_bits::node;
+                            break;
+                        case OSMFormat::PrimitiveGroup::repeated_Way_ways:
+                            types = osmium::osm_entity_bits::way;
+                            break;
+                        case OSMFormat::PrimitiveGroup::repeated_Relation_relations:
+                            types = osmium::osm_entity_bits::relation;
+                            break;
+                        default:
+                            break;
+                    }
+                    pbf_blob_index.add_uint32(FileFormat::BlobIndex::optional_uint32_types, types);
+
+                    if (m_count > 0) {
+                        pbf_blob_index.add_sint64(FileFormat::BlobIndex::optional_sint64_min_id, m_min_id);
+                        pbf_blob_index.add_sint64(FileFormat::BlobIndex::optional_sint64_max_id, m_max_id);
+                    }
+
+                    if (m_bbox) {
+                        protozero::pbf_builder<OSMFormat::HeaderBBox> pbf_bbox{pbf_blob_index, FileFormat::BlobIndex::optional_HeaderBBox_bbox};
+                        pbf_bbox.add_sint64(OSMFormat::HeaderBBox::required_sint64_left,   int64_t(m_bbox.bottom_left().x()) * resolution_convert);
+                        pbf_bbox.add_sint64(OSMFormat::HeaderBBox::required_sint64_right,  int64_t(m_bbox.top_right().x())   * resolution_convert);
+                        pbf_bbox.add_sint64(OSMFormat::HeaderBBox::required_sint64_top,    int64_t(m_bbox.top_right().y())   * resolution_convert);
+                        pbf_bbox.add_sint64(OSMFormat::HeaderBBox::required_sint64_bottom, int64_t(m_bbox.bottom_left().y()) * resolution_convert);
+                    }
+
+                    return data;
+                }
+
+                /**
+                 * Give the most often used strings the smallest indexes.
+                 * Must be called after the last object was added and
+                 * before the objects are encoded.
+                 */
+                void reorder_stringtable() {
+                    m_stringtable.reorder_by_frequency();
                 }
 
                 void write_stringtable(protozero::pbf_builder<OSMFormat::StringTable>& pbf_string_table) {
-                    for (const char* s : m_stringtable) {
-                        pbf_string_table.add_bytes(OSMFormat::StringTable::repeated_bytes_s, s);
+                    for (auto it = m_stringtable.begin(); it != m_stringtable.end(); ++it) {
+                        pbf_string_table.add_bytes(OSMFormat::StringTable::repeated_bytes_s, *it, it.length());
                     }
                 }
 
                 protozero::pbf_builder<OSMFormat::PrimitiveGroup>& group() noexcept {
-                    ++m_count;
                     return m_pbf_primitive_group;
                 }
 
@@ -402,18 +646,41 @@ namespace osmium {
                     ++m_count;
                 }
 
-                // There are two functions store_in_stringtable(_unsigned)
-                // here because of an inconsistency in the OSMPBF format
+                /**
+                 * Add an object to be encoded later. Its strings must
+                 * have been stored with store_in_stringtable() before.
+                 */
+                void add_object(const osmium::OSMObject& object, std::size_t max_size) {
+                    m_objects.push_back(&object);
+                    m_objects_size += max_size;
+                    ++m_count;
+                }
+
+                const std::vector<const osmium::OSMObject*>& objects() const noexcept {
+                    return m_objects;
+                }
+
+                void store_in_stringtable(const char* s) {
+                    m_string_ids.push_back(m_stringtable.add(s));
+                }
+
+                // There are two functions next_string_id(_unsigned) here
+                // because of an inconsistency in the OSMPBF format
                 // specification. Both uint32 and sint32 types are used in
                 // the format for essentially the same thing.
 
-                int32_t store_in_stringtable(const char* s) {
-                    return m_stringtable.add(s);
+                /**
+                 * The final string table index of the next string stored
+                 * with store_in_stringtable().
+                 */
+                int32_t next_string_id() noexcept {
+                    assert(m_next_string_id < m_string_ids.size());
+                    return m_stringtable.index(m_string_ids[m_next_string_id++]);
                 }
 
-                uint32_t store_in_stringtable_unsigned(const char* s) {
-                    // static_cast okay, because result of add is always >= 0
-                    return static_cast<uint32_t>(m_stringtable.add(s));
+                uint32_t next_string_id_unsigned() noexcept {
+                    // static_cast okay, because string table indexes are always >= 0
+                    return static_cast<uint32_t>(next_string_id());
                 }
 
                 int count() const noexcept {
@@ -425,7 +692,7 @@ namespace osmium {
                 }
 
                 std::size_t size() const noexcept {
-                    return m_pbf_primitive_group_data.size() + m_stringtable.size() + m_dense_nodes.size();
+                    return m_pbf_primitive_group_data.size() + m_stringtable.size() + m_dense_nodes.size() + m_objects_size;
                 }
 
                 /**
@@ -448,17 +715,52 @@ namespace osmium {
 
             }; // class PrimitiveBlock
 
-            class PBFOutputFormat : public osmium::io::detail::OutputFormat, public osmium::handler::Handler {
+            /**
+             * Encodes OSM objects into PrimitiveBlocks and serializes each
+             * block into a blob. The serialized blobs are collected in one
+             * string.
+             *
+             * Nodes (if not using DenseNodes), ways and relations are only
+             * encoded when their block is complete, so the objects must
+             * stay valid until finish() is called.
+             */
+            class PrimitiveBlockEncoder : public osmium::handler::Handler {
+
+                // Upper bound for the size of one encoded varint.
+                constexpr static std::size_t max_varint_size = 10;
+
+                // Upper bound for the size of the ID, the metadata and the
+                // protobuf framing of one object.
+                constexpr static std::size_t max_object_overhead = 20 * max_varint_size;
 
                 pbf_output_options m_options;
 
                 PrimitiveBlock m_primitive_block;
 
+                std::string m_output;
+
                 void store_primitive_block() {
                     if (m_primitive_block.count() == 0) {
                         return;
                     }
 
+                    m_primitive_block.reorder_stringtable();
+                    for (const auto* object : m_primitive_block.objects()) {
+                        switch (object->type()) {
+                            case osmium::item_type::node:
+                                encode_node(static_cast<const osmium::Node&>(*object));
+                                break;
+                            case osmium::item_type::way:
+                                encode_way(static_cast<const osmium::Way&>(*object));
+                                break;
+                            case osmium::item_type::relation:
+                                encode_relation(static_cast<const osmium::Relation&>(*object));
+                                break;
+                            default:
+                                break;
+                        }
+                    }
+
                     std::string primitive_block_data;
                     protozero::pbf_builder<OSMFormat::PrimitiveBlock> primitive_block{primitive_block_data};
 
@@ -469,26 +771,48 @@ namespace osmium {
 
                     primitive_block.add_message(OSMFormat::PrimitiveBlock::repeated_PrimitiveGroup_primitivegroup, m_primitive_block.group_data());
 
-                    m_output_queue.push(m_pool.submit(
-                        SerializeBlob{std::move(primitive_block_data),
-                                      pbf_blob_type::data,
-                                      m_options.use_compression}
-                    ));
+                    m_output += SerializeBlob{std::move(primitive_block_data),
+                                              pbf_blob_type::data,
+                                              m_options.compression,
+                                              m_options.compression_level,
+                                              m_options.add_blob_index ? m_primitive_block.index_data() : std::string{}}();
+                }
+
+                /**
+                 * Store the tags and the user name of the object in the
+                 * string table in the order add_meta() needs them.
+                 *
+                 * @returns Upper bound for the encoded size of the object
+                 *          without its nodes or members.
+                 */
+                std::size_t store_strings(const osmium::OSMObject& object) {
+                    std::size_t size = max_object_overhead;
+                    for (const auto& tag : object.tags()) {
+                        m_primitive_block.store_in_stringtable(tag.key());
+                        size += 2 * max_varint_size;
+                    }
+                    for (const auto& tag : object.tags()) {
+                        m_primitive_block.store_in_stringtable(tag.value());
+                    }
+                    if (m_options.add_metadata.user()) {
+                        m_primitive_block.store_in_stringtable(object.user());
+                    }
+                    return size;
                 }
 
                 template <typename T>
                 void add_meta(const osmium::OSMObject& object, T& pbf_object) {
                     {
                         protozero::packed_field_uint32 field{pbf_object, protozero::pbf_tag_type(T::enum_type::packed_uint32_keys)};
-                        for (const auto& tag : object.tags()) {
-                            field.add_element(m_primitive_block.store_in_stringtable_unsigned(tag.key()));
+                        for (auto it = object.tags().cbegin(); it != object.tags().cend(); ++it) {
+                            field.add_element(m_primitive_block.next_string_id_unsigned());
                         }
                     }
 
                     {
                         protozero::packed_field_uint32 field{pbf_object, protozero::pbf_tag_type(T::enum_type::packed_uint32_vals)};
-                        for (const auto& tag : object.tags()) {
-                            field.add_element(m_primitive_block.store_in_stringtable_unsigned(tag.value()));
+                        for (auto it = object.tags().cbegin(); it != object.tags().cend(); ++it) {
+                            field.add_element(m_primitive_block.next_string_id_unsigned());
                         }
                     }
 
@@ -510,7 +834,7 @@ namespace osmium {
                             pbf_info.add_int32(OSMFormat::Info::optional_int32_uid, static_cast<int32_t>(object.uid()));
                         }
                         if (m_options.add_metadata.user()) {
-                            pbf_info.add_uint32(OSMFormat::Info::optional_uint32_user_sid, m_primitive_block.store_in_stringtable_unsigned(object.user()));
+                            pbf_info.add_uint32(OSMFormat::Info::optional_uint32_user_sid, m_primitive_block.next_string_id_unsigned());
                         }
                         if (m_options.add_visible_flag) {
                             pbf_info.add_bool(OSMFormat::Info::optional_bool_visible, object.visible());
@@ -525,22 +849,237 @@ namespace osmium {
                     }
                 }
 
+                void encode_node(const osmium::Node& node) {
+                    protozero::pbf_builder<OSMFormat::Node> pbf_node{m_primitive_block.group(), OSMFormat::PrimitiveGroup::repeated_Node_nodes};
+
+                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_id, node.id());
+                    add_meta(node, pbf_node);
+
+                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_lat, lonlat2int(node.location().lat_without_check()));
+                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_lon, lonlat2int(node.location().lon_without_check()));
+                }
+
+                void encode_way(const osmium::Way& way) {
+                    protozero::pbf_builder<OSMFormat::Way> pbf_way{m_primitive_block.group(), OSMFormat::PrimitiveGroup::repeated_Way_ways};
+
+                    pbf_way.add_int64(OSMFormat::Way::required_int64_id, way.id());
+                    add_meta(way, pbf_way);
+
+                    {
+                        osmium::DeltaEncode<object_id_type, int64_t> delta_id;
+                        protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_refs)};
+                        for (const auto& node_ref : way.nodes()) {
+                            field.add_element(delta_id.update(node_ref.ref()));
+                        }
+                    }
+
+                    if (m_options.locations_on_ways) {
+                        {
+                            osmium::DeltaEncode<int64_t, int64_t> delta_id;
+                            protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_lon)};
+                            for (const auto& node_ref : way.nodes()) {
+                                field.add_element(delta_id.update(lonlat2int(node_ref.location().lon_without_check())));
+                            }
+                        }
+                        {
+                            osmium::DeltaEncode<int64_t, int64_t> delta_id;
+                            protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_lat)};
+                            for (const auto& node_ref : way.nodes()) {
+                                field.add_element(delta_id.update(lonlat2int(node_ref.location().lat_without_check())));
+                            }
+                        }
+                    }
+                }
+
+                void encode_relation(const osmium::Relation& relation) {
+                    protozero::pbf_builder<OSMFormat::Relation> pbf_relation{m_primitive_block.group(), OSMFormat::PrimitiveGroup::repeated_Relation_relations};
+
+                    pbf_relation.add_int64(OSMFormat::Relation::required_int64_id, relation.id());
+                    add_meta(relation, pbf_relation);
+
+                    {
+                        protozero::packed_field_int32 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_int32_roles_sid)};
+                        for (auto it = relation.members().cbegin(); it != relation.members().cend(); ++it) {
+                            field.add_element(m_primitive_block.next_string_id());
+                        }
+                    }
+
+                    {
+                        osmium::DeltaEncode<object_id_type, int64_t> delta_id;
+                        protozero::packed_field_sint64 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_sint64_memids)};
+                        for (const auto& member : relation.members()) {
+                            field.add_element(delta_id.update(member.ref()));
+                        }
+                    }
+
+                    {
+                        protozero::packed_field_int32 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_MemberType_types)};
+                        for (const auto& member : relation.members()) {
+                            field.add_element(int32_t(osmium::item_type_to_nwr_index(member.type())));
+                        }
+                    }
+                }
+
             public:
 
-                PBFOutputFormat(osmium::thread::Pool& pool, const osmium::io::File& file, future_string_queue_type& output_queue) :
-                    OutputFormat(pool, output_queue),
+                explicit PrimitiveBlockEncoder(const pbf_output_options& options) :
+                    m_options(options),
                     m_primitive_block(m_options) {
+                }
+
+                /**
+                 * Write out the last block and return all serialized blobs.
+                 */
+                std::string finish() {
+                    store_primitive_block();
+                    return std::move(m_output);
+                }
+
+                void node(const osmium::Node& node) {
+                    if (m_options.use_dense_nodes) {
+                        switch_primitive_block_type(OSMFormat::PrimitiveGroup::optional_DenseNodes_dense);
+                        m_primitive_block.add_dense_node(node);
+                        m_primitive_block.update_index(node.id(), node.location());
+                        return;
+                    }
+
+                    switch_primitive_block_type(OSMFormat::PrimitiveGroup::repeated_Node_nodes);
+                    m_primitive_block.update_index(node.id(), node.location());
+                    m_primitive_block.add_object(node, store_strings(node));
+                }
+
+                void way(const osmium::Way& way) {
+                    switch_primitive_block_type(OSMFormat::PrimitiveGroup::repeated_Way_ways);
+                    m_primitive_block.update_index(way.id());
+                    const std::size_t values_per_node = m_options.locations_on_ways ? 3 : 1;
+                    m_primitive_block.add_object(way, store_strings(way) + way.nodes().size() * values_per_node * max_varint_size);
+                }
+
+                void relation(const osmium::Relation& relation) {
+                    switch_primitive_block_type(OSMFormat::PrimitiveGroup::repeated_Relation_relations);
+                    m_primitive_block.update_index(relation.id());
+                    std::size_t size = store_strings(relation);
+                    for (const auto& member : relation.members()) {
+                        m_primitive_block.store_in_stringtable(member.role());
+                        size += 3 * max_varint_size;
+                    }
+                    m_primitive_block.add_object(relation, size);
+                }
+
+            }; // class PrimitiveBlockEncoder
+
+            /**
+             * A range of items in a buffer that will be encoded into a PBF
+             * block together with the items in other segments.
+             */
+            struct pbf_input_segment {
+                std::shared_ptr<const osmium::memory::Buffer> buffer;
+                std::size_t begin;
+                std::size_t end;
+            }; // struct pbf_input_segment
+
+            /**
+             * Encodes a slice of the input data, which can span several
+             * buffers, into PrimitiveBlocks. Runs in the thread pool, so
+             * that several slices are encoded in parallel.
+             */
+            class EncodePrimitiveBlocks {
+
+                std::vector<pbf_input_segment> m_segments;
+
+                pbf_output_options m_options;
+
+            public:
+
+                EncodePrimitiveBlocks(std::vector<pbf_input_segment>&& segments, const pbf_output_options& options) :
+                    m_segments(std::move(segments)),
+                    m_options(options) {
+                }
+
+                std::string operator()() {
+                    PrimitiveBlockEncoder encoder{m_options};
+                    for (const auto& segment : m_segments) {
+                        const unsigned char* data = segment.buffer->data();
+                        using iterator = osmium::memory::Buffer::const_iterator;
+                        osmium::apply(iterator{data + segment.begin, data + segment.end},
+                                      iterator{data + segment.end, data + segment.end},
+                                      encoder);
+                    }
+                    return encoder.finish();
+                }
+
+            }; // class EncodePrimitiveBlocks
+
+            class PBFOutputFormat : public osmium::io::detail::OutputFormat {
+
+                pbf_output_options m_options;
+
+                // The slice of the input collected for the next block(s).
+                std::vector<pbf_input_segment> m_slice;
+                OSMFormat::PrimitiveGroup m_slice_type = OSMFormat::PrimitiveGroup::unknown;
+                int m_slice_count = 0;
+                std::size_t m_slice_size = 0;
+
+                OSMFormat::PrimitiveGroup group_type(osmium::item_type type) const noexcept {
+                    switch (type) {
+                        case osmium::item_type::node:
+                            return m_options.use_dense_nodes ? OSMFormat::PrimitiveGroup::optional_DenseNodes_dense
+                                                             : OSMFormat::PrimitiveGroup::repeated_Node_nodes;
+                        case osmium::item_type::way:
+                            return OSMFormat::PrimitiveGroup::repeated_Way_ways;
+                        case osmium::item_type::relation:
+                            return OSMFormat::PrimitiveGroup::repeated_Relation_relations;
+                        default:
+                            break;
+                    }
+                    return OSMFormat::PrimitiveGroup::unknown;
+                }
+
+                /**
+                 * Can an object of the given type be added to the current
+                 * slice? This mirrors PrimitiveBlock::can_add() using the
+                 * size of the objects in the buffer as an estimate for
+                 * the size of the encoded data. The encoder checks the
+                 * real size and starts a new block if needed.
+                 */
+                bool slice_can_add(OSMFormat::PrimitiveGroup type) const noexcept {
+                    return type == m_slice_type &&
+                           m_slice_count < max_entities_per_block &&
+                           m_slice_size < PrimitiveBlock::max_used_blob_size;
+                }
+
+                void add_to_slice(const std::shared_ptr<const osmium::memory::Buffer>& buffer, std::size_t begin, std::size_t end) {
+                    if (begin != end) {
+                        m_slice.push_back(pbf_input_segment{buffer, begin, end});
+                    }
+                }
+
+                void store_slice() {
+                    if (m_slice_count > 0) {
+                        send_to_output_queue_from_pool(EncodePrimitiveBlocks{std::move(m_slice), m_options});
+                    }
+                    m_slice.clear();
+                    m_slice_count = 0;
+                    m_slice_size = 0;
+                }
+
+            public:
+
+                PBFOutputFormat(osmium::thread::Pool& pool, const osmium::io::File& file, future_string_queue_type& output_queue) :
+                    OutputFormat(pool, output_queue) {
 
                     if (!file.get("pbf_add_metadata").empty()) {
                         throw std::invalid_argument{"The 'pbf_add_metadata' option is deprecated. Please use 'add_metadata' instead."};
                     }
 
                     m_options.use_dense_nodes = file.is_not_false("pbf_dense_nodes");
-                    m_options.use_compression = file.get("pbf_compression") != "none" && file.is_not_false("pbf_compression");
+                    m_options.compression = get_pbf_compression(file.get("pbf_compression"));
+                    m_options.compression_level = get_pbf_compression_level(m_options.compression, file.get("pbf_compression_level"));
                     m_options.add_metadata = osmium::metadata_options{file.get("add_metadata")};
                     m_options.add_historical_information_flag = file.has_multiple_object_versions();
                     m_options.add_visible_flag = file.has_multiple_object_versions();
                     m_options.locations_on_ways = file.is_true("locations_on_ways");
+                    m_options.add_blob_index = file.is_not_false("pbf_blob_index");
                 }
 
                 void write_header(const osmium::io::Header& header) final {
@@ -589,99 +1128,52 @@ namespace osmium {
                         pbf_header_block.add_string(OSMFormat::HeaderBlock::optional_string_osmosis_replication_base_url, osmosis_replication_base_url);
                     }
 
-                    m_output_queue.push(m_pool.submit(
+                    send_to_output_queue_from_pool(
                         SerializeBlob{std::move(data),
                                       pbf_blob_type::header,
-                                      m_options.use_compression}
-                        ));
+                                      m_options.compression,
+                                      m_options.compression_level}
+                    );
                 }
 
+                /**
+                 * Cut the buffer into slices of about the size of a
+                 * PrimitiveBlock and encode them in the thread pool. The
+                 * last slice is kept open and continued with the next
+                 * buffer, so the blocks are as full as if the data was
+                 * encoded in one go.
+                 */
                 void write_buffer(osmium::memory::Buffer&& buffer) final {
-                    osmium::apply(buffer.cbegin(), buffer.cend(), *this);
-                }
-
-                void write_end() final {
-                    store_primitive_block();
-                }
-
-                void node(const osmium::Node& node) {
-                    if (m_options.use_dense_nodes) {
-                        switch_primitive_block_type(OSMFormat::PrimitiveGroup::optional_DenseNodes_dense);
-                        m_primitive_block.add_dense_node(node);
-                        return;
-                    }
-
-                    switch_primitive_block_type(OSMFormat::PrimitiveGroup::repeated_Node_nodes);
-                    protozero::pbf_builder<OSMFormat::Node> pbf_node{m_primitive_block.group(), OSMFormat::PrimitiveGroup::repeated_Node_nodes};
-
-                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_id, node.id());
-                    add_meta(node, pbf_node);
-
-                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_lat, lonlat2int(node.location().lat_without_check()));
-                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_lon, lonlat2int(node.location().lon_without_check()));
-                }
-
-                void way(const osmium::Way& way) {
-                    switch_primitive_block_type(OSMFormat::PrimitiveGroup::repeated_Way_ways);
-                    protozero::pbf_builder<OSMFormat::Way> pbf_way{m_primitive_block.group(), OSMFormat::PrimitiveGroup::repeated_Way_ways};
-
-                    pbf_way.add_int64(OSMFormat::Way::required_int64_id, way.id());
-                    add_meta(way, pbf_way);
-
-                    {
-                        osmium::DeltaEncode<object_id_type, int64_t> delta_id;
-                        protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_refs)};
-                        for (const auto& node_ref : way.nodes()) {
-                            field.add_element(delta_id.update(node_ref.ref()));
+                    const std::shared_ptr<const osmium::memory::Buffer> input = std::make_shared<osmium::memory::Buffer>(std::move(buffer));
+                    const unsigned char* data = input->data();
+
+                    std::size_t begin = 0;
+                    for (auto it = input->cbegin(); it != input->cend(); ++it) {
+                        const auto type = group_type(it->type());
+                        if (type == OSMFormat::PrimitiveGroup::unknown) {
+                            continue;
                         }
-                    }
-
-                    if (m_options.locations_on_ways) {
-                        {
-                            osmium::DeltaEncode<int64_t, int64_t> delta_id;
-                            protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_lon)};
-                            for (const auto& node_ref : way.nodes()) {
-                                field.add_element(delta_id.update(lonlat2int(node_ref.location().lon_without_check())));
-                            }
-                        }
-                        {
-                            osmium::DeltaEncode<int64_t, int64_t> delta_id;
-                            protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_lat)};
-                            for (const auto& node_ref : way.nodes()) {
-                                field.add_element(delta_id.update(lonlat2int(node_ref.location().lat_without_check())));
-                            }
+                        if (!slice_can_add(type)) {
+                            const auto offset = static_cast<std::size_t>(it.data() - data);
+                            add_to_slice(input, begin, offset);
+                            store_slice();
+                            m_slice_type = type;
+                            begin = offset;
                         }
+                        ++m_slice_count;
+                        m_slice_size += it->byte_size();
                     }
-                }
 
-                void relation(const osmium::Relation& relation) {
-                    switch_primitive_block_type(OSMFormat::PrimitiveGroup::repeated_Relation_relations);
-                    protozero::pbf_builder<OSMFormat::Relation> pbf_relation{m_primitive_block.group(), OSMFormat::PrimitiveGroup::repeated_Relation_relations};
-
-                    pbf_relation.add_int64(OSMFormat::Relation::required_int64_id, relation.id());
-                    add_meta(relation, pbf_relation);
-
-                    {
-                        protozero::packed_field_int32 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_int32_roles_sid)};
-                        for (const auto& member : relation.members()) {
-                            field.add_element(m_primitive_block.store_in_stringtable(member.role()));
-                        }
-                    }
+                    add_to_slice(input, begin, input->committed());
+                }
 
-                    {
-                        osmium::DeltaEncode<object_id_type, int64_t> delta_id;
-                        protozero::packed_field_sint64 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_sint64_memids)};
-                        for (const auto& member : relation.members()) {
-                            field.add_element(delta_id.update(member.ref()));
-                        }
-                    }
+                void write_raw_blob(std::string&& data) final {
+                    store_slice();
+                    send_to_output_queue(std::move(data));
+                }
 
-                    {
-                        protozero::packed_field_int32 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_MemberType_types)};
-                        for (const auto& member : relation.members()) {
-                            field.add_element(int32_t(osmium::item_type_to_nwr_index(member.type())));
-                        }
-                    }
+                void write_end() final {
+                    store_slice();
                 }
 
             }; // class PBFOutputFormat
@@ -50,7 +50,10 @@ namespace osmium {
                     optional_bytes_raw       = 1,
                     optional_int32_raw_size  = 2,
                     optional_bytes_zlib_data = 3,
-                    optional_bytes_lzma_data = 4
+                    optional_bytes_lzma_data = 4,
+                    optional_bytes_OBSOLETE_bzip2_data = 5,
+                    optional_bytes_lz4_data  = 6,
+                    optional_bytes_zstd_data = 7
                 };
 
                 enum class BlobHeader : protozero::pbf_tag_type {
@@ -59,6 +62,17 @@ namespace osmium {
                     required_int32_datasize  = 3
                 };
 
+                // Not part of the official format. This is the content of
+                // the BlobHeader.indexdata field written by Osmium. The
+                // bbox uses the HeaderBBox message.
+                enum class BlobIndex : protozero::pbf_tag_type {
+                    required_string_format     = 1,
+                    optional_uint32_types      = 2,
+                    optional_sint64_min_id     = 3,
+                    optional_sint64_max_id     = 4,
+                    optional_HeaderBBox_bbox   = 5
+                };
+
             } // namespace FileFormat
 
             // directly translated from
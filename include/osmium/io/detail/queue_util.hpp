@@ -33,10 +33,14 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <osmium/io/metrics.hpp>
 #include <osmium/memory/buffer.hpp>
-#include <osmium/thread/queue.hpp>
+#include <osmium/thread/memory_budget.hpp>
+#include <osmium/thread/mpmc_queue.hpp>
 
 #include <cassert>
+#include <chrono>
+#include <cstddef>
 #include <exception>
 #include <future>
 #include <string>
@@ -49,7 +53,7 @@ namespace osmium {
         namespace detail {
 
             template <typename T>
-            using future_queue_type = osmium::thread::Queue<std::future<T>>;
+            using future_queue_type = osmium::thread::pipeline_queue<std::future<T>>;
 
             /**
              * This type of queue contains buffers with OSM data in them.
@@ -70,8 +74,32 @@ namespace osmium {
              */
             using future_string_queue_type = future_queue_type<std::string>;
 
+            /**
+             * The number of bytes charged to the memory budget for data in
+             * a queue.
+             */
+            inline std::size_t memory_usage(const std::string& data) noexcept {
+                return data.size();
+            }
+
+            inline std::size_t memory_usage(const osmium::memory::Buffer& buffer) noexcept {
+                return buffer.capacity();
+            }
+
+            /**
+             * Wait until there is room in the memory budget for more data
+             * or the queue is empty.
+             */
+            template <typename T>
+            inline void wait_for_memory(const future_queue_type<T>& queue) {
+                osmium::thread::MemoryBudget::default_instance().wait_for_room([&queue] {
+                    return !queue.empty();
+                });
+            }
+
             template <typename T>
             inline void add_to_queue(future_queue_type<T>& queue, T&& data) {
+                osmium::thread::MemoryBudget::default_instance().charge(memory_usage(data));
                 std::promise<T> promise;
                 queue.push(promise.get_future());
                 promise.set_value(std::forward<T>(data));
@@ -97,12 +125,41 @@ namespace osmium {
                 return !buffer;
             }
 
+            /**
+             * Wraps a function run in the thread pool whose result is added
+             * to a queue. Charges the memory budget with the result before
+             * it becomes visible to the consumer.
+             */
+            template <typename TFunction>
+            class charged_task {
+
+                TFunction m_function;
+
+            public:
+
+                explicit charged_task(TFunction&& function) :
+                    m_function(std::move(function)) {
+                }
+
+                auto operator()() -> decltype(std::declval<TFunction&>()()) {
+                    auto result = m_function();
+                    osmium::thread::MemoryBudget::default_instance().charge(memory_usage(result));
+                    return result;
+                }
+
+            }; // class charged_task
+
             template <typename T>
             class queue_wrapper {
 
                 future_queue_type<T>& m_queue;
                 bool m_has_reached_end_of_data;
 
+                // Waits in pop() for futures taken from the queue that
+                // were not ready yet.
+                metrics_counter m_future_waits{};
+                metrics_timer m_future_wait_time{};
+
             public:
 
                 explicit queue_wrapper(future_queue_type<T>& queue) :
@@ -134,13 +191,41 @@ namespace osmium {
                     return m_has_reached_end_of_data;
                 }
 
+                /**
+                 * The statistics of the queue. Waiting in pop() for the
+                 * result in a future taken from the queue counts as being
+                 * blocked on the empty queue. Can be called from any
+                 * thread.
+                 */
+                osmium::thread::queue_stats stats() const noexcept {
+                    osmium::thread::queue_stats result = m_queue.stats();
+                    result.empty += m_future_waits.get();
+                    result.pop_wait += m_future_wait_time.get();
+                    return result;
+                }
+
                 T pop() {
                     T data;
                     if (!m_has_reached_end_of_data) {
                         std::future<T> data_future;
                         m_queue.wait_and_pop(data_future);
                         assert(data_future.valid());
-                        data = std::move(data_future.get());
+                        if (data_future.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                            const auto start = metrics_clock::now();
+                            data_future.wait();
+                            m_future_waits.add();
+                            m_future_wait_time.add_since(start);
+                        }
+                        auto& budget = osmium::thread::MemoryBudget::default_instance();
+                        try {
+                            data = std::move(data_future.get());
+                        } catch (...) {
+                            // Wake up producers waiting for the queue to
+                            // become empty.
+                            budget.release(0);
+                            throw;
+                        }
+                        budget.release(memory_usage(data));
                         if (at_end_of_data(data)) {
                             m_has_reached_end_of_data = true;
                         }
@@ -35,9 +35,14 @@ DEALINGS IN THE SOFTWARE.
 
 #include <osmium/io/compression.hpp>
 #include <osmium/io/detail/queue_util.hpp>
+#include <osmium/io/metrics.hpp>
+#include <osmium/thread/affinity.hpp>
+#include <osmium/thread/memory_budget.hpp>
 #include <osmium/thread/util.hpp>
+#include <osmium/util/config.hpp>
 
 #include <atomic>
+#include <cstddef>
 #include <exception>
 #include <string>
 #include <thread>
@@ -49,6 +54,11 @@ namespace osmium {
 
         namespace detail {
 
+            inline std::size_t get_input_queue_size() noexcept {
+                const std::size_t n = osmium::config::get_max_queue_size("INPUT", 20);
+                return n > 2 ? n : 2;
+            }
+
             /**
              * This code uses an internally managed thread to read data from
              * the input file and (optionally) decompress it. The result is
@@ -60,6 +70,7 @@ namespace osmium {
                 // only used in the sub-thread
                 osmium::io::Decompressor& m_decompressor;
                 future_string_queue_type& m_queue;
+                reader_counters& m_counters;
 
                 // used in both threads
                 std::atomic<bool> m_done;
@@ -69,13 +80,20 @@ namespace osmium {
 
                 void run_in_thread() {
                     osmium::thread::set_thread_name("_osmium_read");
+                    osmium::thread::set_io_thread_affinity();
 
                     try {
                         while (!m_done) {
+                            const auto start = metrics_clock::now();
                             std::string data {m_decompressor.read()};
+                            m_counters.read_time.add_since(start);
                             if (at_end_of_data(data)) {
                                 break;
                             }
+                            m_counters.bytes_read.add(data.size());
+                            osmium::thread::MemoryBudget::default_instance().wait_for_room([this] {
+                                return !m_done && !m_queue.empty();
+                            });
                             add_to_queue(m_queue, std::move(data));
                         }
 
@@ -90,9 +108,11 @@ namespace osmium {
             public:
 
                 ReadThreadManager(osmium::io::Decompressor& decompressor,
-                                  future_string_queue_type& queue) :
+                                  future_string_queue_type& queue,
+                                  reader_counters& counters) :
                     m_decompressor(decompressor),
                     m_queue(queue),
+                    m_counters(counters),
                     m_done(false),
                     m_thread(std::thread(&ReadThreadManager::run_in_thread, this)) {
                 }
@@ -113,6 +133,12 @@ namespace osmium {
 
                 void stop() noexcept {
                     m_done = true;
+                    try {
+                        // wake up the thread if it waits for memory
+                        osmium::thread::MemoryBudget::default_instance().release(0);
+                    } catch (...) {
+                        // Ignore any exceptions.
+                    }
                 }
 
                 void close() {
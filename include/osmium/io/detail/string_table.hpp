@@ -35,15 +35,15 @@ DEALINGS IN THE SOFTWARE.
 
 #include <osmium/io/detail/pbf.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <iterator>
-#include <list>
 #include <string>
-#include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace osmium {
 
@@ -52,71 +52,194 @@ namespace osmium {
         namespace detail {
 
             /**
-             * class StringStore
+             * The string table of a PBF primitive block.
              *
-             * Storage of lots of strings (const char *). Memory is allocated in chunks.
-             * If a string is added and there is no space in the current chunk, a new
-             * chunk will be allocated. Strings added to the store must not be larger
-             * than the chunk size.
-             *
-             * All memory is released when the destructor is called. There is no other way
-             * to release all or part of the memory.
+             * The strings are stored one after the other (null terminated)
+             * in one contiguous arena and found through an open addressing
+             * hash table with linear probing. Index 0 is reserved for the
+             * empty string as required by the PBF format.
              *
+             * Strings get their index in the order they are added. Call
+             * reorder_by_frequency() after the last string was added to
+             * give the most often used strings the smallest indexes, so
+             * that they need only one byte when encoded as varints. Use
+             * index() to map the indexes returned by add() to the final
+             * indexes after that.
              */
-            class StringStore {
+            class StringTable {
+
+                // This is the maximum number of entries in a string table.
+                // This should never be reached in practice but we better
+                // make sure it doesn't. If we had max_uncompressed_blob_size
+                // many entries, we are sure they would never fit into a PBF
+                // Blob.
+                static constexpr const int32_t max_entries = static_cast<int32_t>(max_uncompressed_blob_size);
+
+                // There is one string table per PBF primitive block. Most of
+                // them are really small, because most blocks are full of nodes
+                // with no tags. But string tables can get really large for
+                // ways with many tags or for large relations.
+                // The chosen initial arena size is enough so that 99% of all
+                // string tables in typical OSM files will never have to grow
+                // the arena.
+                static constexpr const size_t default_arena_size = 100 * 1024;
+
+                // Initial number of slots in the hash table. Must be a
+                // power of two.
+                static constexpr const std::size_t initial_slots = 1024;
+
+                struct entry {
+                    std::size_t offset;
+                    std::size_t length;
+                    uint64_t hash;
+                    uint32_t count;
+                };
+
+                std::string m_arena;
+
+                // Entry 0 is the empty string at the start of the arena.
+                std::vector<entry> m_entries;
+
+                // Hash table with the entry numbers, 0 marks an empty slot.
+                std::vector<int32_t> m_slots;
+
+                // Entry numbers in the order they will be written out and
+                // the final index for each entry number.
+                std::vector<int32_t> m_order;
+                std::vector<int32_t> m_index;
+
+                static uint64_t hash_string(const char* str, std::size_t* length) noexcept {
+                    // FNV-1a, the length is calculated on the way
+                    uint64_t hash = 14695981039346656037ULL;
+                    const char* s = str;
+                    for (; *s; ++s) {
+                        hash ^= static_cast<unsigned char>(*s);
+                        hash *= 1099511628211ULL;
+                    }
+                    *length = static_cast<std::size_t>(s - str);
+                    return hash;
+                }
+
+                std::size_t mask() const noexcept {
+                    return m_slots.size() - 1;
+                }
+
+                void insert_slot(int32_t n) noexcept {
+                    std::size_t pos = static_cast<std::size_t>(m_entries[n].hash) & mask();
+                    while (m_slots[pos] != 0) {
+                        pos = (pos + 1) & mask();
+                    }
+                    m_slots[pos] = n;
+                }
 
-                size_t m_chunk_size;
+                void grow() {
+                    m_slots.assign(m_slots.size() * 2, 0);
+                    for (int32_t n = 1; n < static_cast<int32_t>(m_entries.size()); ++n) {
+                        insert_slot(n);
+                    }
+                }
 
-                std::list<std::string> m_chunks;
+                void add_entry(const char* s, std::size_t length, uint64_t hash) {
+                    m_entries.push_back(entry{m_arena.size(), length, hash, 1});
+                    m_arena.append(s, length);
+                    m_arena.append(1, '\0');
+                }
 
-                void add_chunk() {
-                    m_chunks.emplace_back();
-                    m_chunks.back().reserve(m_chunk_size);
+                void init() {
+                    add_entry("", 0, 0);
+                    m_order.push_back(0);
                 }
 
             public:
 
-                explicit StringStore(size_t chunk_size) :
-                    m_chunk_size(chunk_size) {
-                    add_chunk();
+                explicit StringTable(size_t size = default_arena_size) :
+                    m_slots(initial_slots, 0) {
+                    m_arena.reserve(size);
+                    init();
+                }
+
+                void clear() {
+                    m_arena.clear();
+                    m_entries.clear();
+                    std::fill(m_slots.begin(), m_slots.end(), 0);
+                    m_order.clear();
+                    m_index.clear();
+                    init();
                 }
 
-                void clear() noexcept {
-                    assert(!m_chunks.empty());
-                    m_chunks.erase(std::next(m_chunks.begin()), m_chunks.end());
-                    m_chunks.front().clear();
+                int32_t size() const noexcept {
+                    return static_cast<int32_t>(m_entries.size());
                 }
 
                 /**
-                 * Add a null terminated string to the store. This will
-                 * automatically get more memory if we are out.
-                 * Returns a pointer to the copy of the string we have
-                 * allocated.
+                 * Add a string to the table if it isn't there already.
+                 *
+                 * @returns Index of the string in the order strings were
+                 *          added.
                  */
-                const char* add(const char* string) {
-                    const size_t len = std::strlen(string) + 1;
+                int32_t add(const char* s) {
+                    assert(m_index.empty() && "add() called after reorder_by_frequency()");
+
+                    std::size_t length = 0;
+                    const uint64_t hash = hash_string(s, &length);
+
+                    std::size_t pos = static_cast<std::size_t>(hash) & mask();
+                    while (m_slots[pos] != 0) {
+                        entry& e = m_entries[m_slots[pos]];
+                        if (e.hash == hash && e.length == length &&
+                            std::memcmp(m_arena.data() + e.offset, s, length) == 0) {
+                            ++e.count;
+                            return m_slots[pos];
+                        }
+                        pos = (pos + 1) & mask();
+                    }
+
+                    const auto n = static_cast<int32_t>(m_entries.size());
+                    if (n > max_entries) {
+                        throw osmium::pbf_error{"string table has too many entries"};
+                    }
 
-                    assert(len <= m_chunk_size);
+                    add_entry(s, length, hash);
+                    m_order.push_back(n);
+                    m_slots[pos] = n;
 
-                    size_t chunk_len = m_chunks.back().size();
-                    if (chunk_len + len > m_chunks.back().capacity()) {
-                        add_chunk();
-                        chunk_len = 0;
+                    // keep the load factor below 50%
+                    if (m_entries.size() * 2 > m_slots.size()) {
+                        grow();
                     }
 
-                    m_chunks.back().append(string);
-                    m_chunks.back().append(1, '\0');
+                    return n;
+                }
 
-                    return m_chunks.back().c_str() + chunk_len;
+                /**
+                 * Sort the strings by how often they were added, most
+                 * often used first. Strings used equally often stay in
+                 * the order they were added. No strings can be added
+                 * after this until clear() is called.
+                 */
+                void reorder_by_frequency() {
+                    std::stable_sort(std::next(m_order.begin()), m_order.end(), [this](int32_t a, int32_t b) {
+                        return m_entries[a].count > m_entries[b].count;
+                    });
+                    m_index.resize(m_order.size());
+                    for (std::size_t i = 0; i < m_order.size(); ++i) {
+                        m_index[m_order[i]] = static_cast<int32_t>(i);
+                    }
                 }
 
-                class const_iterator {
+                /**
+                 * The final index of the string with the given index as
+                 * returned by add().
+                 */
+                int32_t index(int32_t n) const noexcept {
+                    assert(n >= 0 && n < size());
+                    return m_index.empty() ? n : m_index[n];
+                }
 
-                    using it_type = std::list<std::string>::const_iterator;
+                class const_iterator {
 
-                    it_type m_it;
-                    const it_type m_last;
-                    const char* m_pos;
+                    const StringTable* m_table;
+                    std::vector<int32_t>::const_iterator m_it;
 
                 public:
 
@@ -126,29 +249,13 @@ namespace osmium {
                     using pointer           = value_type*;
                     using reference         = value_type&;
 
-                    const_iterator(it_type it, it_type last) :
-                        m_it(it),
-                        m_last(last),
-                        m_pos(it == last ? nullptr : m_it->c_str()) {
+                    const_iterator(const StringTable* table, std::vector<int32_t>::const_iterator it) :
+                        m_table(table),
+                        m_it(it) {
                     }
 
                     const_iterator& operator++() {
-                        assert(m_it != m_last);
-                        const auto last_pos = m_it->c_str() + m_it->size();
-                        while (m_pos != last_pos && *m_pos) {
-                            ++m_pos;
-                        }
-                        if (m_pos != last_pos) {
-                            ++m_pos;
-                        }
-                        if (m_pos == last_pos) {
-                            ++m_it;
-                            if (m_it != m_last) {
-                                m_pos = m_it->c_str();
-                            } else {
-                                m_pos = nullptr;
-                            }
-                        }
+                        ++m_it;
                         return *this;
                     }
 
@@ -159,7 +266,7 @@ namespace osmium {
                     }
 
                     bool operator==(const const_iterator& rhs) const {
-                        return m_it == rhs.m_it && m_pos == rhs.m_pos;
+                        return m_it == rhs.m_it;
                     }
 
                     bool operator!=(const const_iterator& rhs) const {
@@ -167,125 +274,26 @@ namespace osmium {
                     }
 
                     const char* operator*() const {
-                        assert(m_it != m_last);
-                        assert(m_pos != nullptr);
-                        return m_pos;
+                        return m_table->m_arena.data() + m_table->m_entries[*m_it].offset;
+                    }
+
+                    /// Length of the current string.
+                    std::size_t length() const {
+                        return m_table->m_entries[*m_it].length;
                     }
 
                 }; // class const_iterator
 
+                /**
+                 * Iterate over the strings in index order (after
+                 * reorder_by_frequency() in the new order).
+                 */
                 const_iterator begin() const {
-                    if (m_chunks.front().empty()) {
-                        return end();
-                    }
-                    return {m_chunks.begin(), m_chunks.end()};
+                    return {this, m_order.cbegin()};
                 }
 
                 const_iterator end() const {
-                    return {m_chunks.end(), m_chunks.end()};
-                }
-
-                // These functions get you some idea how much memory was
-                // used.
-                size_t get_chunk_size() const noexcept {
-                    return m_chunk_size;
-                }
-
-                size_t get_chunk_count() const noexcept {
-                    return m_chunks.size();
-                }
-
-                size_t get_used_bytes_in_last_chunk() const noexcept {
-                    return m_chunks.back().size();
-                }
-
-            }; // class StringStore
-
-            struct str_equal {
-
-                bool operator()(const char* lhs, const char* rhs) const noexcept {
-                    return lhs == rhs || std::strcmp(lhs, rhs) == 0;
-                }
-
-            }; // struct str_equal
-
-            struct djb2_hash {
-
-                std::size_t operator()(const char* str) const noexcept {
-                    std::size_t hash = 5381;
-                    int c;
-
-                    while ((c = *str++)) {
-                        hash = ((hash << 5u) + hash) + c; /* hash * 33 + c */
-                    }
-
-                    return hash;
-                }
-
-            }; // struct djb2_hash
-
-            class StringTable {
-
-                // This is the maximum number of entries in a string table.
-                // This should never be reached in practice but we better
-                // make sure it doesn't. If we had max_uncompressed_blob_size
-                // many entries, we are sure they would never fit into a PBF
-                // Blob.
-                static constexpr const int32_t max_entries = static_cast<int32_t>(max_uncompressed_blob_size);
-
-                // There is one string table per PBF primitive block. Most of
-                // them are really small, because most blocks are full of nodes
-                // with no tags. But string tables can get really large for
-                // ways with many tags or for large relations.
-                // The chosen size is enough so that 99% of all string tables
-                // in typical OSM files will only need a single memory
-                // allocation.
-                static constexpr const size_t default_stringtable_chunk_size = 100 * 1024;
-
-                StringStore m_strings;
-                std::unordered_map<const char*, int32_t, djb2_hash, str_equal> m_index;
-                int32_t m_size = 0;
-
-            public:
-
-                explicit StringTable(size_t size = default_stringtable_chunk_size) :
-                    m_strings(size) {
-                    m_strings.add("");
-                }
-
-                void clear() {
-                    m_strings.clear();
-                    m_index.clear();
-                    m_size = 0;
-                    m_strings.add("");
-                }
-
-                int32_t size() const noexcept {
-                    return m_size + 1;
-                }
-
-                int32_t add(const char* s) {
-                    const auto f = m_index.find(s);
-                    if (f != m_index.end()) {
-                        return f->second;
-                    }
-
-                    const char* cs = m_strings.add(s);
-                    m_index[cs] = ++m_size;
-
-                    if (m_size > max_entries) {
-                        throw osmium::pbf_error{"string table has too many entries"};
-                    }
-
-                    return m_size;
-                }
-
-                StringStore::const_iterator begin() const {
-                    return m_strings.begin();
-                }
-
-                StringStore::const_iterator end() const {
-                    return m_strings.end();
+                    return {this, m_order.cend()};
                 }
 
             }; // class StringTable
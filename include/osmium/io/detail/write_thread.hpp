@@ -35,6 +35,8 @@ DEALINGS IN THE SOFTWARE.
 
 #include <osmium/io/compression.hpp>
 #include <osmium/io/detail/queue_util.hpp>
+#include <osmium/io/metrics.hpp>
+#include <osmium/thread/affinity.hpp>
 #include <osmium/thread/util.hpp>
 
 #include <exception>
@@ -59,15 +61,18 @@ namespace osmium {
                 queue_wrapper<std::string> m_queue;
                 std::unique_ptr<osmium::io::Compressor> m_compressor;
                 std::promise<bool> m_promise;
+                writer_counters& m_counters;
 
             public:
 
                 WriteThread(future_string_queue_type& input_queue,
                             std::unique_ptr<osmium::io::Compressor>&& compressor,
-                            std::promise<bool>&& promise) :
+                            std::promise<bool>&& promise,
+                            writer_counters& counters) :
                     m_queue(input_queue),
                     m_compressor(std::move(compressor)),
-                    m_promise(std::move(promise)) {
+                    m_promise(std::move(promise)),
+                    m_counters(counters) {
                 }
 
                 WriteThread(const WriteThread&) = delete;
@@ -80,6 +85,7 @@ namespace osmium {
 
                 void operator()() {
                     osmium::thread::set_thread_name("_osmium_write");
+                    osmium::thread::set_io_thread_affinity();
 
                     try {
                         while (true) {
@@ -87,9 +93,14 @@ namespace osmium {
                             if (at_end_of_data(data)) {
                                 break;
                             }
+                            const auto start = metrics_clock::now();
                             m_compressor->write(data);
+                            m_counters.write_time.add_since(start);
+                            m_counters.bytes_written.add(data.size());
                         }
+                        const auto start = metrics_clock::now();
                         m_compressor->close();
+                        m_counters.write_time.add_since(start);
                         m_promise.set_value(true);
                     } catch (...) {
                         m_promise.set_exception(std::current_exception());
@@ -54,6 +54,7 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/osm/types.hpp>
 #include <osmium/osm/types_from_string.hpp>
 #include <osmium/osm/way.hpp>
+#include <osmium/thread/affinity.hpp>
 #include <osmium/thread/util.hpp>
 
 #include <expat.h>
@@ -721,6 +722,7 @@ namespace osmium {
 
                 void run() final {
                     osmium::thread::set_thread_name("_osmium_xml_in");
+                    osmium::thread::set_io_thread_affinity();
 
                     ExpatXMLParser parser{this};
 
@@ -464,7 +464,7 @@ namespace osmium {
                 }
 
                 void write_buffer(osmium::memory::Buffer&& buffer) final {
-                    m_output_queue.push(m_pool.submit(XMLOutputBlock{std::move(buffer), m_options}));
+                    send_to_output_queue_from_pool(XMLOutputBlock{std::move(buffer), m_options});
                 }
 
                 void write_end() final {
@@ -47,15 +47,22 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/error.hpp>
 #include <osmium/io/file_compression.hpp>
 #include <osmium/io/writer_options.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/util/compatibility.hpp>
 
 #include <zlib.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
 #include <limits>
 #include <string>
+#include <utility>
 
 #ifndef _MSC_VER
 # include <unistd.h>
@@ -155,6 +162,260 @@ namespace osmium {
 
         }; // class GzipCompressor
 
+        namespace detail {
+
+            /**
+             * A chunk of data compressed by the ParallelGzipCompressor.
+             */
+            struct gzip_chunk {
+
+                /// Raw deflate data.
+                std::string data;
+
+                /// CRC32 of the uncompressed data.
+                uLong crc = 0;
+
+                /// Size of the uncompressed data.
+                std::size_t size = 0;
+
+            }; // struct gzip_chunk
+
+            /**
+             * Task compressing a chunk of data into raw deflate data. Run
+             * in the thread pool by the ParallelGzipCompressor.
+             *
+             * The deflate stream is primed with the end of the previous
+             * chunk so that matches can reach back into it. Unless this is
+             * the last chunk, the output ends with a sync flush so that it
+             * ends on a byte boundary and can be concatenated with the
+             * data for the next chunk.
+             */
+            class DeflateChunk {
+
+                std::string m_input;
+                std::string m_dictionary;
+                int m_level;
+                bool m_last;
+
+            public:
+
+                DeflateChunk(std::string&& input, std::string&& dictionary, int level, bool last) :
+                    m_input(std::move(input)),
+                    m_dictionary(std::move(dictionary)),
+                    m_level(level),
+                    m_last(last) {
+                }
+
+                gzip_chunk operator()() const {
+                    assert(m_input.size() < std::numeric_limits<unsigned int>::max());
+
+                    z_stream stream{};
+                    int result = ::deflateInit2(&stream, m_level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY); // NOLINT(hicpp-signed-bitwise)
+                    if (result != Z_OK) {
+                        throw osmium::gzip_error{"gzip error: compression init failed", result};
+                    }
+
+                    if (!m_dictionary.empty()) {
+                        result = ::deflateSetDictionary(&stream,
+                                                        reinterpret_cast<const unsigned char*>(m_dictionary.data()),
+                                                        static_cast<unsigned int>(m_dictionary.size()));
+                        if (result != Z_OK) {
+                            ::deflateEnd(&stream);
+                            throw osmium::gzip_error{"gzip error: setting compression dictionary failed", result};
+                        }
+                    }
+
+                    gzip_chunk chunk;
+                    chunk.data.resize(::deflateBound(&stream, static_cast<uLong>(m_input.size())) + 16);
+
+                    stream.next_in = reinterpret_cast<unsigned char*>(const_cast<char*>(m_input.data()));
+                    stream.avail_in = static_cast<unsigned int>(m_input.size());
+
+                    const int flush = m_last ? Z_FINISH : Z_SYNC_FLUSH;
+                    while (true) {
+                        stream.next_out = reinterpret_cast<unsigned char*>(&chunk.data[stream.total_out]);
+                        stream.avail_out = static_cast<unsigned int>(chunk.data.size() - stream.total_out);
+                        result = ::deflate(&stream, flush);
+                        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+                            ::deflateEnd(&stream);
+                            throw osmium::gzip_error{"gzip error: compression failed", result};
+                        }
+                        if (stream.avail_out != 0) {
+                            break;
+                        }
+                        chunk.data.resize(chunk.data.size() * 2);
+                    }
+
+                    chunk.data.resize(stream.total_out);
+                    ::deflateEnd(&stream);
+
+                    chunk.crc = ::crc32(0, reinterpret_cast<const unsigned char*>(m_input.data()), static_cast<unsigned int>(m_input.size()));
+                    chunk.size = m_input.size();
+
+                    return chunk;
+                }
+
+            }; // class DeflateChunk
+
+        } // namespace detail
+
+        /**
+         * Gzip compressor compressing chunks of data in parallel in the
+         * thread pool, similar to what pigz does. Each chunk is compressed
+         * into raw deflate data with the last 32 kByte of the previous
+         * chunk as dictionary, so the compression ratio is nearly the same
+         * as with the GzipCompressor. The results are written in order,
+         * framed by a gzip header and trailer, as one standard gzip member.
+         *
+         * The Writer uses this if the file option `parallel_compression`
+         * is set.
+         */
+        class ParallelGzipCompressor : public Compressor {
+
+            // Size of the chunks of input data compressed in one task.
+            static constexpr std::size_t chunk_size = 128UL * 1024UL;
+
+            // The size of the deflate window.
+            static constexpr std::size_t dictionary_size = 32UL * 1024UL;
+
+            osmium::thread::Pool& m_pool;
+            int m_fd;
+            int m_level;
+
+            // Input data not yet handed to a task.
+            std::string m_input{};
+
+            // The end of the data handed to the last task.
+            std::string m_dictionary{};
+
+            // Results of the tasks in the order of the input data.
+            std::deque<std::future<detail::gzip_chunk>> m_chunks{};
+
+            uLong m_crc;
+            uint32_t m_size = 0;
+
+            std::size_t max_pending_chunks() const noexcept {
+                return 2 * static_cast<std::size_t>(m_pool.num_threads()) + 2;
+            }
+
+            void write_raw(const std::string& data) {
+                osmium::io::detail::reliable_write(m_fd, data.data(), data.size());
+            }
+
+            void write_uint32(uint32_t value) {
+                const char data[4] = {
+                    static_cast<char>(value & 0xffU),
+                    static_cast<char>((value >> 8U) & 0xffU),
+                    static_cast<char>((value >> 16U) & 0xffU),
+                    static_cast<char>((value >> 24U) & 0xffU)
+                };
+                osmium::io::detail::reliable_write(m_fd, data, sizeof(data));
+            }
+
+            void write_next_chunk() {
+                std::future<detail::gzip_chunk> future{std::move(m_chunks.front())};
+                m_chunks.pop_front();
+                const detail::gzip_chunk chunk{future.get()};
+                write_raw(chunk.data);
+                m_crc = ::crc32_combine(m_crc, chunk.crc, static_cast<z_off_t>(chunk.size));
+                m_size += static_cast<uint32_t>(chunk.size);
+            }
+
+            void submit(std::string&& input, bool last) {
+                std::string dictionary{m_dictionary};
+                if (input.size() >= dictionary_size) {
+                    m_dictionary.assign(input, input.size() - dictionary_size, dictionary_size);
+                } else {
+                    m_dictionary.append(input);
+                    if (m_dictionary.size() > dictionary_size) {
+                        m_dictionary.erase(0, m_dictionary.size() - dictionary_size);
+                    }
+                }
+
+                m_chunks.push_back(m_pool.submit(detail::DeflateChunk{std::move(input), std::move(dictionary), m_level, last}));
+
+                // write out all chunks that are done, wait if too many
+                // are pending
+                while (!m_chunks.empty() &&
+                       (m_chunks.size() > max_pending_chunks() ||
+                        m_chunks.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+                    write_next_chunk();
+                }
+            }
+
+        public:
+
+            ParallelGzipCompressor(int fd, fsync sync, osmium::thread::Pool& pool, int level = Z_DEFAULT_COMPRESSION) :
+                Compressor(sync),
+                m_pool(pool),
+                m_fd(fd),
+                m_level(level),
+                m_crc(::crc32(0, nullptr, 0)) {
+                // gzip header: magic, deflate, no flags, no mtime,
+                // no extra flags, OS unix (same as zlib writes)
+                static const char header[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+                osmium::io::detail::reliable_write(m_fd, header, sizeof(header));
+            }
+
+            ParallelGzipCompressor(const ParallelGzipCompressor&) = delete;
+            ParallelGzipCompressor& operator=(const ParallelGzipCompressor&) = delete;
+
+            ParallelGzipCompressor(ParallelGzipCompressor&&) = delete;
+            ParallelGzipCompressor& operator=(ParallelGzipCompressor&&) = delete;
+
+            ~ParallelGzipCompressor() noexcept final {
+                try {
+                    close();
+                } catch (...) {
+                    // Ignore any exceptions because destructor must not throw.
+                }
+            }
+
+            void write(const std::string& data) final {
+                std::size_t offset = 0;
+                if (!m_input.empty()) {
+                    offset = std::min(chunk_size - m_input.size(), data.size());
+                    m_input.append(data, 0, offset);
+                    if (m_input.size() < chunk_size) {
+                        return;
+                    }
+                    submit(std::move(m_input), false);
+                    m_input.clear();
+                }
+
+                for (; data.size() - offset >= chunk_size; offset += chunk_size) {
+                    submit(data.substr(offset, chunk_size), false);
+                }
+
+                m_input.assign(data, offset, std::string::npos);
+            }
+
+            void close() final {
+                if (m_fd >= 0) {
+                    const int fd = m_fd;
+                    try {
+                        submit(std::move(m_input), true);
+                        while (!m_chunks.empty()) {
+                            write_next_chunk();
+                        }
+                        write_uint32(static_cast<uint32_t>(m_crc));
+                        write_uint32(m_size);
+                    } catch (...) {
+                        m_fd = -1;
+                        m_chunks.clear();
+                        osmium::io::detail::reliable_close(fd);
+                        throw;
+                    }
+                    m_fd = -1;
+                    if (do_fsync()) {
+                        osmium::io::detail::reliable_fsync(fd);
+                    }
+                    osmium::io::detail::reliable_close(fd);
+                }
+            }
+
+        }; // class ParallelGzipCompressor
+
         class GzipDecompressor : public Decompressor {
 
             gzFile m_gzfile;
@@ -297,6 +558,15 @@ namespace osmium {
                 return registered_gzip_compression;
             }
 
+            const bool registered_parallel_gzip_compression = osmium::io::CompressionFactory::instance().register_parallel_compressor(osmium::io::file_compression::gzip,
+                [](int fd, fsync sync, osmium::thread::Pool& pool) { return new osmium::io::ParallelGzipCompressor{fd, sync, pool}; }
+            );
+
+            // dummy function to silence the unused variable warning from above
+            inline bool get_registered_parallel_gzip_compression() noexcept {
+                return registered_parallel_gzip_compression;
+            }
+
         } // namespace detail
 
     } // namespace io
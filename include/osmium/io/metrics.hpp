@@ -0,0 +1,220 @@
+#ifndef OSMIUM_IO_METRICS_HPP
+#define OSMIUM_IO_METRICS_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/thread/queue.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace osmium {
+
+    namespace io {
+
+        /**
+         * Metrics about the work done by a Reader so far. Returned by
+         * Reader::metrics(). Times are summed up over all threads doing
+         * the work, so they can be larger than the wall clock time.
+         */
+        struct reader_metrics {
+
+            /// Number of bytes of input data read. If the input file is
+            /// compressed, this is the size after decompression.
+            uint64_t bytes_read = 0;
+
+            /// Time spent in the read thread reading (and decompressing)
+            /// the input file.
+            std::chrono::nanoseconds read_time{0};
+
+            /// Number of PBF blobs decompressed.
+            uint64_t blobs_inflated = 0;
+
+            /// Number of PBF blobs skipped because of their blob index.
+            uint64_t blobs_skipped = 0;
+
+            /// Time spent decompressing PBF blobs.
+            std::chrono::nanoseconds inflate_time{0};
+
+            /// Time spent decoding PBF blocks into buffers.
+            std::chrono::nanoseconds decode_time{0};
+
+            /// Number of buffers sent by the parser to the user.
+            uint64_t buffers_produced = 0;
+
+            /// Queue between the read thread and the parser. Time blocked
+            /// pushing into it means the parser can't keep up, time
+            /// blocked popping means the input is the bottleneck.
+            osmium::thread::queue_stats input_queue{};
+
+            /// Queue between the parser and Reader::read(). Time blocked
+            /// pushing into it means the user code can't keep up, time
+            /// blocked popping means the user code waits for the parser.
+            /// Popping includes waiting for the parser to finish the
+            /// buffer at the front of the queue.
+            osmium::thread::queue_stats output_queue{};
+
+        }; // struct reader_metrics
+
+        /**
+         * Metrics about the work done by a Writer so far. Returned by
+         * Writer::metrics(). Times are summed up over all threads doing
+         * the work, so they can be larger than the wall clock time.
+         */
+        struct writer_metrics {
+
+            /// Number of buffers given to the output format for encoding.
+            uint64_t buffers_written = 0;
+
+            /// Time spent encoding buffers in the thread pool.
+            std::chrono::nanoseconds encode_time{0};
+
+            /// Number of bytes of encoded data written. If the output file
+            /// is compressed, this is the size before compression.
+            uint64_t bytes_written = 0;
+
+            /// Time spent in the write thread (compressing and) writing the
+            /// output file.
+            std::chrono::nanoseconds write_time{0};
+
+            /// Queue between the output format and the write thread. Time
+            /// blocked pushing into it means the output is the bottleneck.
+            osmium::thread::queue_stats output_queue{};
+
+        }; // struct writer_metrics
+
+        namespace detail {
+
+            using metrics_clock = std::chrono::steady_clock;
+
+            /**
+             * A counter that can be updated from several threads and read
+             * from any thread. Uses relaxed atomic operations only, so it
+             * is cheap enough to be always on.
+             */
+            class metrics_counter {
+
+                std::atomic<uint64_t> m_value{0};
+
+            public:
+
+                void add(uint64_t value = 1) noexcept {
+                    m_value.fetch_add(value, std::memory_order_relaxed);
+                }
+
+                uint64_t get() const noexcept {
+                    return m_value.load(std::memory_order_relaxed);
+                }
+
+            }; // class metrics_counter
+
+            /**
+             * Like metrics_counter, but for time durations.
+             */
+            class metrics_timer {
+
+                std::atomic<int64_t> m_nanoseconds{0};
+
+            public:
+
+                void add(metrics_clock::duration duration) noexcept {
+                    m_nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), std::memory_order_relaxed);
+                }
+
+                /// Add the time since start.
+                void add_since(metrics_clock::time_point start) noexcept {
+                    add(metrics_clock::now() - start);
+                }
+
+                std::chrono::nanoseconds get() const noexcept {
+                    return std::chrono::nanoseconds{m_nanoseconds.load(std::memory_order_relaxed)};
+                }
+
+            }; // class metrics_timer
+
+            /**
+             * The counters updated by the different stages of a Reader.
+             */
+            struct reader_counters {
+
+                metrics_counter bytes_read;
+                metrics_timer read_time;
+                metrics_counter blobs_inflated;
+                metrics_counter blobs_skipped;
+                metrics_timer inflate_time;
+                metrics_timer decode_time;
+                metrics_counter buffers_produced;
+
+                reader_metrics get() const noexcept {
+                    reader_metrics metrics;
+                    metrics.bytes_read = bytes_read.get();
+                    metrics.read_time = read_time.get();
+                    metrics.blobs_inflated = blobs_inflated.get();
+                    metrics.blobs_skipped = blobs_skipped.get();
+                    metrics.inflate_time = inflate_time.get();
+                    metrics.decode_time = decode_time.get();
+                    metrics.buffers_produced = buffers_produced.get();
+                    return metrics;
+                }
+
+            }; // struct reader_counters
+
+            /**
+             * The counters updated by the different stages of a Writer.
+             */
+            struct writer_counters {
+
+                metrics_counter buffers_written;
+                metrics_timer encode_time;
+                metrics_counter bytes_written;
+                metrics_timer write_time;
+
+                writer_metrics get() const noexcept {
+                    writer_metrics metrics;
+                    metrics.buffers_written = buffers_written.get();
+                    metrics.encode_time = encode_time.get();
+                    metrics.bytes_written = bytes_written.get();
+                    metrics.write_time = write_time.get();
+                    return metrics;
+                }
+
+            }; // struct writer_counters
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_METRICS_HPP
@@ -0,0 +1,236 @@
+#ifndef OSMIUM_IO_NODE_LOCATION_READER_HPP
+#define OSMIUM_IO_NODE_LOCATION_READER_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/io/detail/pbf.hpp>
+#include <osmium/io/detail/pbf_blob_splitter.hpp>
+#include <osmium/io/detail/pbf_decoder.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/node_location_batch.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <string>
+#include <utility>
+
+namespace osmium {
+
+    namespace io {
+
+        /**
+         * Reads only the IDs and locations of the nodes in a PBF file.
+         * This is much faster than reading the file with the Reader class
+         * if you only want to build a location index, because no Node
+         * objects are built and the string tables, tags, and metadata are
+         * never looked at. Blobs which, according to their blob index,
+         * don't contain nodes are not even decompressed.
+         *
+         * The blobs are decoded in the thread pool. read() returns the
+         * nodes of one blob at a time in the order of the file.
+         *
+         * Usage:
+         * @code
+         * osmium::io::NodeLocationReader reader{"input.osm.pbf"};
+         * osmium::NodeLocationBatch batch;
+         * while (!(batch = reader.read()).empty()) {
+         *     location_handler.node_locations(batch);
+         * }
+         * reader.close();
+         * @endcode
+         *
+         * Only works with PBF files.
+         */
+        class NodeLocationReader {
+
+            int m_fd;
+
+            osmium::thread::Pool* m_pool;
+
+            std::deque<std::future<osmium::NodeLocationBatch>> m_batches{};
+
+            std::size_t m_max_pending_batches;
+
+            bool m_input_done = false;
+
+            osmium::io::detail::PBFBlobSplitter m_splitter;
+
+            // Size of the chunks read from the file.
+            static constexpr const std::size_t chunk_size = 1024 * 1024;
+
+            /**
+             * Read the next chunk from the file. Returns an empty string
+             * on EOF.
+             */
+            std::string read_chunk() {
+                std::string data(chunk_size, '\0');
+                std::size_t done = 0;
+                while (done < chunk_size) {
+                    const auto nread = osmium::io::detail::reliable_read(m_fd, &*data.begin() + done, static_cast<unsigned int>(chunk_size - done));
+                    if (nread == 0) {
+                        break;
+                    }
+                    done += static_cast<std::size_t>(nread);
+                }
+                data.resize(done);
+                return data;
+            }
+
+            void read_header_blob() {
+                osmium::io::detail::pbf_blob_index index;
+                if (m_splitter.next("OSMHeader", index) == 0) {
+                    throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                }
+
+                // Decoded only to check the required features.
+                osmium::io::detail::decode_header(m_splitter.blob());
+            }
+
+            void submit_next_blob() {
+                while (true) {
+                    osmium::io::detail::pbf_blob_index index;
+                    if (m_splitter.next("OSMData", index) == 0) {
+                        m_input_done = true;
+                        return;
+                    }
+
+                    if (index.valid() && !(index.types & osmium::osm_entity_bits::node)) {
+                        continue;
+                    }
+
+                    const auto data = m_splitter.blob();
+                    m_batches.push_back(m_pool->submit(osmium::io::detail::PBFNodeLocationDecoder{std::string{data.data(), data.size()}}));
+                    return;
+                }
+            }
+
+        public:
+
+            /**
+             * Open a PBF file for reading the node locations.
+             *
+             * @param filename Name of the file. Use "-" for stdin.
+             * @param pool The thread pool used for decoding.
+             * @throws osmium::pbf_error If the file is not a valid PBF file.
+             * @throws std::system_error If the file could not be opened.
+             */
+            explicit NodeLocationReader(const std::string& filename, osmium::thread::Pool& pool = osmium::thread::Pool::default_instance()) :
+                m_fd(osmium::io::detail::open_for_reading(filename)),
+                m_pool(&pool),
+                m_max_pending_batches(static_cast<std::size_t>(pool.num_threads()) * 2),
+                m_splitter([this]() {
+                    return read_chunk();
+                }) {
+                try {
+                    read_header_blob();
+                } catch (...) {
+                    close();
+                    throw;
+                }
+            }
+
+            NodeLocationReader(const NodeLocationReader&) = delete;
+            NodeLocationReader& operator=(const NodeLocationReader&) = delete;
+
+            NodeLocationReader(NodeLocationReader&&) = delete;
+            NodeLocationReader& operator=(NodeLocationReader&&) = delete;
+
+            ~NodeLocationReader() noexcept {
+                try {
+                    close();
+                } catch (...) {
+                    // Ignore any exceptions because destructor must not throw.
+                }
+            }
+
+            /**
+             * Close the file. Batches not read yet are discarded. Called
+             * automatically by the destructor.
+             *
+             * @throws std::system_error If closing the file failed.
+             */
+            void close() {
+                m_input_done = true;
+                m_batches.clear();
+                if (m_fd >= 0) {
+                    const int fd = m_fd;
+                    m_fd = -1;
+                    osmium::io::detail::reliable_close(fd);
+                }
+            }
+
+            /**
+             * Have all batches been read?
+             */
+            bool eof() const noexcept {
+                return m_input_done && m_batches.empty();
+            }
+
+            /**
+             * Get the IDs and locations of the nodes in the next blob
+             * containing any nodes.
+             *
+             * @returns The next batch or an empty batch at the end of the
+             *          file.
+             * @throws osmium::pbf_error If there was an error decoding the
+             *         file.
+             */
+            osmium::NodeLocationBatch read() {
+                while (true) {
+                    while (!m_input_done && m_batches.size() < m_max_pending_batches) {
+                        submit_next_blob();
+                    }
+
+                    if (m_batches.empty()) {
+                        return osmium::NodeLocationBatch{};
+                    }
+
+                    auto future = std::move(m_batches.front());
+                    m_batches.pop_front();
+                    osmium::NodeLocationBatch batch{future.get()};
+                    if (!batch.empty()) {
+                        return batch;
+                    }
+                }
+            }
+
+        }; // class NodeLocationReader
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_NODE_LOCATION_READER_HPP
@@ -0,0 +1,119 @@
+#ifndef OSMIUM_IO_PBF_BLOB_HPP
+#define OSMIUM_IO_PBF_BLOB_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/osm/entity_bits.hpp>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+namespace osmium {
+
+    namespace io {
+
+        /**
+         * An OSMData blob from a PBF file together with the BlobHeader in
+         * front of it, exactly as it is stored in the file. Read them with
+         * the osmium::io::PBFBlobReader and write them unchanged into
+         * another PBF file with the osmium::io::Writer. This way blocks
+         * can be copied from one file to another without decompressing
+         * and decoding them.
+         */
+        class pbf_blob {
+
+            std::string m_data{};
+            osmium::osm_entity_bits::type m_entities = osmium::osm_entity_bits::nothing;
+
+        public:
+
+            /// Create an empty blob (used to signal the end of the input).
+            pbf_blob() = default;
+
+            /**
+             * Create a blob.
+             *
+             * @param data The complete blob as stored in a PBF file: The 4
+             *             byte size of the BlobHeader, the BlobHeader and
+             *             the Blob.
+             * @param entities The types of objects in the blob (nothing
+             *                 if not known).
+             */
+            pbf_blob(std::string&& data, osmium::osm_entity_bits::type entities) :
+                m_data(std::move(data)),
+                m_entities(entities) {
+            }
+
+            /// The data of this blob including the BlobHeader.
+            const std::string& data() const noexcept {
+                return m_data;
+            }
+
+            /**
+             * Move the data out of this blob. The blob is empty
+             * afterwards.
+             */
+            std::string release_data() noexcept {
+                std::string data;
+                using std::swap;
+                swap(data, m_data);
+                m_entities = osmium::osm_entity_bits::nothing;
+                return data;
+            }
+
+            /// The size of the blob in bytes including the BlobHeader.
+            std::size_t size() const noexcept {
+                return m_data.size();
+            }
+
+            /**
+             * The types of objects in this blob. This is
+             * osmium::osm_entity_bits::nothing if it is not known.
+             */
+            osmium::osm_entity_bits::type entities() const noexcept {
+                return m_entities;
+            }
+
+            /// A blob is valid if it is not empty.
+            explicit operator bool() const noexcept {
+                return !m_data.empty();
+            }
+
+        }; // class pbf_blob
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_PBF_BLOB_HPP
@@ -0,0 +1,234 @@
+#ifndef OSMIUM_IO_PBF_BLOB_READER_HPP
+#define OSMIUM_IO_PBF_BLOB_READER_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/io/compression.hpp>
+#include <osmium/io/detail/pbf.hpp>
+#include <osmium/io/detail/pbf_blob_splitter.hpp>
+#include <osmium/io/detail/pbf_decoder.hpp>
+#include <osmium/io/detail/queue_util.hpp>
+#include <osmium/io/detail/read_thread.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/error.hpp>
+#include <osmium/io/file.hpp>
+#include <osmium/io/file_format.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/io/metrics.hpp>
+#include <osmium/io/pbf_blob.hpp>
+#include <osmium/osm/entity_bits.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace osmium {
+
+    namespace io {
+
+        /**
+         * PBFBlobReader option: Should the types of objects in blobs
+         * without an index in their BlobHeader be found out by
+         * decompressing the blob? If not, pbf_blob::entities() returns
+         * osmium::osm_entity_bits::nothing for those blobs.
+         */
+        enum class detect_entities : bool {
+            no  = false,
+            yes = true
+        };
+
+        /**
+         * Reads the blobs from a PBF file without decoding them. Use this
+         * together with the Writer to copy data from one PBF file to
+         * another without decompressing, decoding, encoding and
+         * compressing it again, for instance to concatenate PBF files or
+         * to split them by object type.
+         *
+         * The header of the file is decoded when the PBFBlobReader is
+         * created, it is available from header(). Call read() in a loop
+         * until it returns an invalid blob to get all OSMData blobs.
+         *
+         * The data is read in a separate thread like in the Reader.
+         */
+        class PBFBlobReader {
+
+            osmium::io::File m_file;
+
+            detail::reader_counters m_counters{};
+
+            detail::future_string_queue_type m_input_queue;
+
+            std::unique_ptr<osmium::io::Decompressor> m_decompressor{};
+
+            std::unique_ptr<osmium::io::detail::ReadThreadManager> m_read_thread_manager{};
+
+            detail::queue_wrapper<std::string> m_input_queue_wrapper;
+
+            detail::PBFBlobSplitter m_splitter;
+
+            osmium::io::Header m_header{};
+
+            detect_entities m_detect_entities;
+
+            void open_input() {
+                auto& factory = osmium::io::CompressionFactory::instance();
+                if (m_file.buffer()) {
+                    m_decompressor = factory.create_decompressor(m_file.compression(), m_file.buffer(), m_file.buffer_size());
+                } else {
+                    m_decompressor = factory.create_decompressor(m_file.compression(), osmium::io::detail::open_for_reading(m_file.filename()));
+                }
+                m_read_thread_manager.reset(new osmium::io::detail::ReadThreadManager{*m_decompressor, m_input_queue, m_counters});
+            }
+
+            void read_header() {
+                detail::pbf_blob_index index;
+                if (m_splitter.next("OSMHeader", index) == 0) {
+                    throw osmium::pbf_error{"missing OSMHeader blob"};
+                }
+                m_header = detail::decode_header(m_splitter.blob());
+            }
+
+        public:
+
+            /**
+             * Open the file and read its header.
+             *
+             * @param file The PBF file to read.
+             * @param detect Find out which types of objects are in blobs
+             *               that don't have an index?
+             *
+             * @throws osmium::io_error If the file is not a PBF file.
+             * @throws osmium::pbf_error If the header can't be read.
+             * @throws std::system_error If the file could not be opened.
+             */
+            explicit PBFBlobReader(const osmium::io::File& file, detect_entities detect = detect_entities::no) :
+                m_file(file.check()),
+                m_input_queue(detail::get_input_queue_size(), "raw_input"),
+                m_input_queue_wrapper(m_input_queue),
+                m_splitter([this]() {
+                    return m_input_queue_wrapper.pop();
+                }),
+                m_detect_entities(detect) {
+                try {
+                    if (m_file.format() != osmium::io::file_format::pbf) {
+                        throw osmium::io_error{"PBFBlobReader can only read PBF files"};
+                    }
+
+                    open_input();
+                } catch (...) {
+                    // There is no read thread, so nobody else will end
+                    // the input queue.
+                    detail::add_end_of_data_to_queue(m_input_queue);
+                    throw;
+                }
+
+                try {
+                    read_header();
+                } catch (...) {
+                    close();
+                    throw;
+                }
+            }
+
+            explicit PBFBlobReader(const std::string& filename, detect_entities detect = detect_entities::no) :
+                PBFBlobReader(osmium::io::File{filename}, detect) {
+            }
+
+            PBFBlobReader(const PBFBlobReader&) = delete;
+            PBFBlobReader& operator=(const PBFBlobReader&) = delete;
+
+            PBFBlobReader(PBFBlobReader&&) = delete;
+            PBFBlobReader& operator=(PBFBlobReader&&) = delete;
+
+            ~PBFBlobReader() noexcept {
+                try {
+                    close();
+                } catch (...) {
+                    // Ignore any exceptions because destructor must not throw.
+                }
+            }
+
+            /**
+             * Close the file. Stops the read thread. There is no need to
+             * call this, the destructor will do it.
+             */
+            void close() {
+                if (m_read_thread_manager) {
+                    m_read_thread_manager->stop();
+                }
+
+                m_input_queue_wrapper.drain();
+
+                if (m_read_thread_manager) {
+                    m_read_thread_manager->close();
+                }
+            }
+
+            /// The header of the file.
+            const osmium::io::Header& header() const noexcept {
+                return m_header;
+            }
+
+            /**
+             * Read the next OSMData blob.
+             *
+             * @returns The blob or an invalid blob at the end of the file.
+             * @throws osmium::pbf_error If the data is not valid PBF.
+             */
+            osmium::io::pbf_blob read() {
+                detail::pbf_blob_index index;
+                if (m_splitter.next("OSMData", index) == 0) {
+                    return osmium::io::pbf_blob{};
+                }
+
+                osmium::osm_entity_bits::type entities = index.types;
+                if (!index.valid() && m_detect_entities == detect_entities::yes) {
+                    entities = detail::decode_blob_entities(m_splitter.blob());
+                }
+
+                const auto data = m_splitter.raw_blob();
+                return osmium::io::pbf_blob{std::string{data.data(), data.size()}, entities};
+            }
+
+            /// The number of bytes read from the file so far.
+            uint64_t bytes_read() const noexcept {
+                return m_counters.bytes_read.get();
+            }
+
+        }; // class PBFBlobReader
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_PBF_BLOB_READER_HPP
@@ -41,13 +41,20 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/error.hpp>
 #include <osmium/io/file.hpp>
 #include <osmium/io/header.hpp>
+#include <osmium/io/metrics.hpp>
+#include <osmium/io/reader_options.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
+#include <osmium/osm/box.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/thread/pool.hpp>
 #include <osmium/thread/util.hpp>
 #include <osmium/util/config.hpp>
+#include <osmium/util/file.hpp>
+#include <osmium/util/memory_mapping.hpp>
 
 #include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #include <fcntl.h>
 #include <future>
@@ -71,11 +78,6 @@ namespace osmium {
 
         namespace detail {
 
-            inline std::size_t get_input_queue_size() noexcept {
-                const std::size_t n = osmium::config::get_max_queue_size("INPUT", 20);
-                return n > 2 ? n : 2;
-            }
-
             inline std::size_t get_osmdata_queue_size() noexcept {
                 const std::size_t n = osmium::config::get_max_queue_size("OSMDATA", 20);
                 return n > 2 ? n : 2;
@@ -106,11 +108,22 @@ namespace osmium {
 
             int m_childpid = 0;
 
+            // Must outlive all threads and tasks of the reader.
+            detail::reader_counters m_counters{};
+
             detail::future_string_queue_type m_input_queue;
 
             std::unique_ptr<osmium::io::Decompressor> m_decompressor;
 
-            osmium::io::detail::ReadThreadManager m_read_thread_manager;
+            std::unique_ptr<osmium::io::detail::ReadThreadManager> m_read_thread_manager;
+
+            // Only used if the input file is memory mapped. In that case
+            // there is no decompressor and no read thread.
+            std::unique_ptr<osmium::util::MemoryMapping> m_mapping;
+            detail::mapped_input m_mapped_input;
+
+            // Buffers given back by the user through recycle().
+            osmium::memory::BufferPool m_buffer_pool;
 
             detail::future_buffer_queue_type m_osmdata_queue;
             detail::queue_wrapper<osmium::memory::Buffer> m_osmdata_queue_wrapper;
@@ -125,6 +138,12 @@ namespace osmium {
             osmium::osm_entity_bits::type m_read_which_entities = osmium::osm_entity_bits::all;
             osmium::io::read_meta m_read_metadata = osmium::io::read_meta::yes;
 
+            detail::read_filter m_read_filter{};
+
+            osmium::io::use_mmap m_use_mmap = osmium::io::use_mmap::no;
+
+            osmium::io::ordered m_ordered = osmium::io::ordered::yes;
+
             void set_option(osmium::thread::Pool& pool) noexcept {
                 m_pool = &pool;
             }
@@ -137,6 +156,26 @@ namespace osmium {
                 m_read_metadata = value;
             }
 
+            void set_option(const osmium::io::id_range& range) noexcept {
+                m_read_filter.add_id_range(range);
+            }
+
+            void set_option(const osmium::Box& box) noexcept {
+                m_read_filter.set_box(box);
+            }
+
+            void set_option(osmium::io::use_mmap value) noexcept {
+                m_use_mmap = value;
+            }
+
+            void set_option(osmium::io::ordered value) noexcept {
+                m_ordered = value;
+            }
+
+            void set_option(const osmium::io::key_filter& filter) {
+                m_read_filter.set_key_filter(filter);
+            }
+
             // This function will run in a separate thread.
             static void parser_thread(osmium::thread::Pool& pool,
                                       const detail::ParserFactory::create_parser_type& creator,
@@ -144,7 +183,12 @@ namespace osmium {
                                       detail::future_buffer_queue_type& osmdata_queue,
                                       std::promise<osmium::io::Header>&& header_promise,
                                       osmium::osm_entity_bits::type read_which_entities,
-                                      osmium::io::read_meta read_metadata) {
+                                      osmium::io::read_meta read_metadata,
+                                      const detail::read_filter& filter,
+                                      detail::mapped_input& input_mapping,
+                                      osmium::memory::BufferPool* buffer_pool,
+                                      osmium::io::ordered ordered_output,
+                                      detail::reader_counters& counters) {
                 std::promise<osmium::io::Header> promise{std::move(header_promise)};
                 osmium::io::detail::parser_arguments args = {
                     pool,
@@ -152,7 +196,12 @@ namespace osmium {
                     osmdata_queue,
                     promise,
                     read_which_entities,
-                    read_metadata
+                    read_metadata,
+                    filter,
+                    input_mapping,
+                    buffer_pool,
+                    ordered_output,
+                    counters
                 };
                 creator(args)->parse();
             }
@@ -226,6 +275,80 @@ namespace osmium {
                 return osmium::io::detail::open_for_reading(filename);
             }
 
+            /**
+             * Can this file be memory mapped? Only uncompressed PBF files
+             * that are real files (not buffers, stdin or URLs) can be.
+             */
+            static bool can_be_mapped(const osmium::io::File& file) {
+                if (file.format() != osmium::io::file_format::pbf ||
+                    file.compression() != osmium::io::file_compression::none ||
+                    file.buffer() ||
+                    file.filename().empty() ||
+                    file.filename() == "-") {
+                    return false;
+                }
+                const std::string protocol{file.filename().substr(0, file.filename().find_first_of(':'))};
+                return protocol != "http" && protocol != "https" && protocol != "ftp" && protocol != "file";
+            }
+
+            /**
+             * Create the decompressor for reading from the file descriptor.
+             * A parallel decompressor is used if the file option
+             * `parallel_decompression` is set to true and there is one for
+             * the compression of the file.
+             */
+            std::unique_ptr<osmium::io::Decompressor> create_decompressor(int fd) const {
+                auto& factory = osmium::io::CompressionFactory::instance();
+                if (m_file.is_true("parallel_decompression")) {
+                    return factory.create_parallel_decompressor(m_file.compression(), fd, *m_pool);
+                }
+                return factory.create_decompressor(m_file.compression(), fd);
+            }
+
+            /**
+             * Open the input. If use_mmap is set and the input can be mapped,
+             * the file is memory mapped. Otherwise a decompressor and the
+             * read thread are created.
+             *
+             * @throws std::system_error if a system call fails.
+             */
+            void open_input() {
+                auto& factory = osmium::io::CompressionFactory::instance();
+
+                if (m_file.buffer()) {
+                    m_decompressor = factory.create_decompressor(m_file.compression(), m_file.buffer(), m_file.buffer_size());
+                } else if (m_use_mmap == osmium::io::use_mmap::yes && can_be_mapped(m_file)) {
+                    const int fd = osmium::io::detail::open_for_reading(m_file.filename());
+                    const std::size_t size = osmium::util::file_size(fd);
+                    if (size == 0) {
+                        // Not a regular file or empty, read it normally.
+                        m_decompressor = create_decompressor(fd);
+                    } else {
+                        try {
+                            m_mapping.reset(new osmium::util::MemoryMapping{size, osmium::util::MemoryMapping::mapping_mode::readonly, fd});
+                        } catch (...) {
+                            ::close(fd);
+                            throw;
+                        }
+                        osmium::io::detail::reliable_close(fd);
+
+                        m_mapped_input.data = m_mapping->get_addr<char>();
+                        m_mapped_input.size = size;
+                        m_file_size = size;
+
+                        // The parser doesn't read from the input queue, but
+                        // it might drain it.
+                        detail::add_end_of_data_to_queue(m_input_queue);
+                        return;
+                    }
+                } else {
+                    m_decompressor = create_decompressor(open_input_file_or_url(m_file.filename(), &m_childpid));
+                }
+
+                m_read_thread_manager.reset(new osmium::io::detail::ReadThreadManager{*m_decompressor, m_input_queue, m_counters});
+                m_file_size = m_decompressor->file_size();
+            }
+
         public:
 
             /**
@@ -247,6 +370,40 @@ namespace osmium {
              *      etc.) is not read possibly speeding up the read. Not all
              *      file formats use this setting.
              *
+             * * osmium::io::id_range: Only read objects of the given type(s)
+             *      with IDs in the given range. Can be given several times.
+             *      Only the PBF parser uses this setting. It skips blocks
+             *      of data that can't contain matching objects and checks
+             *      the ID of each object before decoding it.
+             *
+             * * osmium::Box: Only read nodes inside this bounding box. Only
+             *      the PBF parser uses this setting. It skips blocks of
+             *      data that can't contain matching nodes and checks the
+             *      location of each node before decoding it. Nodes without
+             *      location are not read. Ways and relations are not
+             *      affected.
+             *
+             * * osmium::io::use_mmap: Memory map the input file instead of
+             *      reading it in a separate thread. This avoids copying the
+             *      data and can be faster for large files. Only used for
+             *      uncompressed PBF files that are real files, otherwise
+             *      it is silently ignored. Default is
+             *      osmium::io::use_mmap::no.
+             *
+             * * osmium::io::ordered: Return the buffers in the order of the
+             *      data in the file (osmium::io::ordered::yes, the default)
+             *      or as soon as they are ready (osmium::io::ordered::no).
+             *      Unordered reading is faster on machines with many cores,
+             *      but you can only use it if your code doesn't depend on
+             *      the order of the objects. Currently only the PBF parser
+             *      uses this setting.
+             *
+             * * osmium::io::key_filter: Only read objects with at least one
+             *      tag whose key matches the filter function. Objects
+             *      without tags are not read. Only the PBF parser uses
+             *      this setting, it checks the keys before building the
+             *      objects.
+             *
              * @throws osmium::io_error If there was an error.
              * @throws std::system_error If the file could not be opened.
              */
@@ -255,13 +412,9 @@ namespace osmium {
                 m_file(file.check()),
                 m_creator(detail::ParserFactory::instance().get_creator_function(m_file)),
                 m_input_queue(detail::get_input_queue_size(), "raw_input"),
-                m_decompressor(m_file.buffer() ?
-                    osmium::io::CompressionFactory::instance().create_decompressor(file.compression(), m_file.buffer(), m_file.buffer_size()) :
-                    osmium::io::CompressionFactory::instance().create_decompressor(file.compression(), open_input_file_or_url(m_file.filename(), &m_childpid))),
-                m_read_thread_manager(*m_decompressor, m_input_queue),
+                m_buffer_pool(detail::get_osmdata_queue_size()),
                 m_osmdata_queue(detail::get_osmdata_queue_size(), "parser_results"),
-                m_osmdata_queue_wrapper(m_osmdata_queue),
-                m_file_size(m_decompressor->file_size()) {
+                m_osmdata_queue_wrapper(m_osmdata_queue) {
 
                 (void)std::initializer_list<int>{
                     (set_option(args), 0)...
@@ -271,9 +424,18 @@ namespace osmium {
                     m_pool = &thread::Pool::default_instance();
                 }
 
+                try {
+                    open_input();
+                } catch (...) {
+                    // There is no parser thread yet, so nobody would
+                    // ever mark the end of the data for the queue wrapper.
+                    detail::add_end_of_data_to_queue(m_osmdata_queue);
+                    throw;
+                }
+
                 std::promise<osmium::io::Header> header_promise;
                 m_header_future = header_promise.get_future();
-                m_thread = osmium::thread::thread_handler{parser_thread, std::ref(*m_pool), std::ref(m_creator), std::ref(m_input_queue), std::ref(m_osmdata_queue), std::move(header_promise), m_read_which_entities, m_read_metadata};
+                m_thread = osmium::thread::thread_handler{parser_thread, std::ref(*m_pool), std::ref(m_creator), std::ref(m_input_queue), std::ref(m_osmdata_queue), std::move(header_promise), m_read_which_entities, m_read_metadata, m_read_filter, std::ref(m_mapped_input), &m_buffer_pool, m_ordered, std::ref(m_counters)};
             }
 
             template <typename... TArgs>
@@ -311,12 +473,17 @@ namespace osmium {
             void close() {
                 m_status = status::closed;
 
-                m_read_thread_manager.stop();
+                if (m_read_thread_manager) {
+                    m_read_thread_manager->stop();
+                }
+                m_mapped_input.done = true;
 
                 m_osmdata_queue_wrapper.drain();
 
                 try {
-                    m_read_thread_manager.close();
+                    if (m_read_thread_manager) {
+                        m_read_thread_manager->close();
+                    }
                 } catch (...) {
                     // Ignore any exceptions.
                 }
@@ -389,7 +556,9 @@ namespace osmium {
                         buffer = m_osmdata_queue_wrapper.pop();
                         if (detail::at_end_of_data(buffer)) {
                             m_status = status::eof;
-                            m_read_thread_manager.close();
+                            if (m_read_thread_manager) {
+                                m_read_thread_manager->close();
+                            }
                             return buffer;
                         }
                         if (buffer.committed() > 0) {
@@ -403,6 +572,50 @@ namespace osmium {
                 }
             }
 
+            /**
+             * Give a buffer you got from read() back to the Reader after you
+             * are done with it. Its memory will then be reused for new data
+             * instead of allocating new buffers. This is optional, if you
+             * don't call it, the buffers are simply freed when they go out
+             * of scope. Currently only the PBF parser reuses buffers.
+             *
+             * Buffers that can't be reused (for instance because they don't
+             * manage their own memory) are freed.
+             */
+            void recycle(osmium::memory::Buffer&& buffer) {
+                m_buffer_pool.put(std::move(buffer));
+            }
+
+            /**
+             * Returns the number of memory allocations that could be avoided
+             * so far by reusing buffers given back through recycle() and by
+             * reusing scratch space in the decoder threads.
+             */
+            uint64_t allocations_avoided() const noexcept {
+                return m_buffer_pool.allocations_avoided();
+            }
+
+            /**
+             * Get the metrics of this reader: counters and timings of the
+             * different stages of the input pipeline and statistics of its
+             * queues. This is cheap and can be called from any thread while
+             * the reader is in use, for instance to find out whether a job
+             * is bound by I/O, decompression, decoding or the user code.
+             *
+             * If the input file is memory mapped, there is no read thread.
+             * In that case bytes_read is the number of bytes the parser
+             * has looked at and read_time is always 0.
+             */
+            reader_metrics metrics() const noexcept {
+                reader_metrics result = m_counters.get();
+                if (m_mapping) {
+                    result.bytes_read = m_mapped_input.offset;
+                }
+                result.input_queue = m_input_queue.stats();
+                result.output_queue = m_osmdata_queue_wrapper.stats();
+                return result;
+            }
+
             /**
              * Has the end of file been reached? This is set after the last
              * data has been read. It is also set by calling close().
@@ -434,7 +647,10 @@ namespace osmium {
              * do an expensive system call.
              */
             std::size_t offset() const noexcept {
-                return m_decompressor->offset();
+                if (m_decompressor) {
+                    return m_decompressor->offset();
+                }
+                return m_mapped_input.offset;
             }
 
         }; // class Reader
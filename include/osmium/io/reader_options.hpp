@@ -0,0 +1,259 @@
+#ifndef OSMIUM_IO_READER_OPTIONS_HPP
+#define OSMIUM_IO_READER_OPTIONS_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <array>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+
+namespace osmium {
+
+    namespace io {
+
+        /**
+         * Reader option: Only read objects of the given type(s) with IDs in
+         * the closed interval [first, last]. This option can be given
+         * several times, for instance with different ranges for nodes, ways
+         * and relations. If it is given several times for the same type,
+         * the intersection of the ranges is used.
+         *
+         * Not all file formats use this setting. For formats that do, whole
+         * blocks of data that can not contain any object in the range are
+         * skipped without decoding them.
+         */
+        struct id_range {
+
+            osmium::osm_entity_bits::type entities;
+            osmium::object_id_type first;
+            osmium::object_id_type last;
+
+            constexpr id_range(osmium::osm_entity_bits::type e, osmium::object_id_type f, osmium::object_id_type l) noexcept :
+                entities(e),
+                first(f),
+                last(l) {
+            }
+
+        }; // struct id_range
+
+        /**
+         * Reader option: Should the input file be memory mapped instead of
+         * being read through a separate read thread? This only works for
+         * uncompressed local PBF files, for all other inputs this option
+         * is ignored. The data is then given to the decoder directly from
+         * the mapped memory without copying it.
+         *
+         * Do not use this if the file might be changed or truncated while
+         * it is being read.
+         */
+        enum class use_mmap : bool {
+            no  = false,
+            yes = true
+        };
+
+        /**
+         * Reader option: Should the buffers be returned in the order of the
+         * data in the file? If this is set to osmium::io::ordered::no, the
+         * buffers are returned as soon as they are decoded, so a slow
+         * buffer doesn't hold up all buffers after it. Only use this if
+         * your code doesn't care about the order of the objects. Not all
+         * file formats use this setting.
+         */
+        enum class ordered : bool {
+            no  = false,
+            yes = true
+        };
+
+        /**
+         * Reader option: Only read objects that have at least one tag with
+         * a key for which the given function returns true. The function is
+         * called with the (zero-terminated) key. It only applies to objects
+         * of the given types, all other objects are read normally.
+         *
+         * Not all file formats use this setting. The PBF parser calls the
+         * function only once for each string in the string table of a
+         * block and doesn't build objects that don't match. Objects without
+         * any tags never match.
+         *
+         * The function is called from several threads at the same time,
+         * so it must not change any shared state.
+         */
+        class key_filter {
+
+            std::function<bool(const char*)> m_function;
+            osmium::osm_entity_bits::type m_entities;
+
+        public:
+
+            explicit key_filter(std::function<bool(const char*)> function, osmium::osm_entity_bits::type entities = osmium::osm_entity_bits::nwr) :
+                m_function(std::move(function)),
+                m_entities(entities) {
+            }
+
+            /// The types of objects this filter applies to.
+            osmium::osm_entity_bits::type entities() const noexcept {
+                return m_entities;
+            }
+
+            bool operator()(const char* key) const {
+                return m_function(key);
+            }
+
+        }; // class key_filter
+
+        namespace detail {
+
+            /**
+             * Collects the id_range, osmium::Box, and key_filter options given to the
+             * Reader so that the parsers can check whether data can be
+             * skipped.
+             */
+            class read_filter {
+
+                using range_type = std::array<osmium::object_id_type, 2>;
+
+                std::array<range_type, 3> m_id_ranges{{
+                    range_type{{std::numeric_limits<osmium::object_id_type>::min(), std::numeric_limits<osmium::object_id_type>::max()}},
+                    range_type{{std::numeric_limits<osmium::object_id_type>::min(), std::numeric_limits<osmium::object_id_type>::max()}},
+                    range_type{{std::numeric_limits<osmium::object_id_type>::min(), std::numeric_limits<osmium::object_id_type>::max()}}
+                }};
+
+                osmium::Box m_box{};
+
+                // shared, because decoders running in the thread pool might
+                // need it after the parser is gone
+                std::shared_ptr<const key_filter> m_key_filter{};
+
+                bool m_has_id_ranges = false;
+
+                static bool intersects(const osmium::Box& a, const osmium::Box& b) noexcept {
+                    return a.bottom_left().x() <= b.top_right().x() &&
+                           a.bottom_left().y() <= b.top_right().y() &&
+                           b.bottom_left().x() <= a.top_right().x() &&
+                           b.bottom_left().y() <= a.top_right().y();
+                }
+
+            public:
+
+                void add_id_range(const id_range& range) noexcept {
+                    for (unsigned int i = 0; i < 3; ++i) {
+                        if (range.entities & osmium::osm_entity_bits::from_item_type(osmium::nwr_index_to_item_type(i))) {
+                            auto& r = m_id_ranges[i];
+                            if (range.first > r[0]) {
+                                r[0] = range.first;
+                            }
+                            if (range.last < r[1]) {
+                                r[1] = range.last;
+                            }
+                            m_has_id_ranges = true;
+                        }
+                    }
+                }
+
+                void set_box(const osmium::Box& box) noexcept {
+                    m_box = box;
+                }
+
+                void set_key_filter(const key_filter& filter) {
+                    m_key_filter = std::make_shared<const key_filter>(filter);
+                }
+
+                /// The key filter or nullptr if there is none.
+                const std::shared_ptr<const key_filter>& get_key_filter() const noexcept {
+                    return m_key_filter;
+                }
+
+                /// Is there any filter set at all?
+                bool empty() const noexcept {
+                    return !m_has_id_ranges && !m_box;
+                }
+
+                bool has_id_ranges() const noexcept {
+                    return m_has_id_ranges;
+                }
+
+                const osmium::Box& box() const noexcept {
+                    return m_box;
+                }
+
+                osmium::object_id_type min_id(osmium::item_type type) const noexcept {
+                    return m_id_ranges[osmium::item_type_to_nwr_index(type)][0];
+                }
+
+                osmium::object_id_type max_id(osmium::item_type type) const noexcept {
+                    return m_id_ranges[osmium::item_type_to_nwr_index(type)][1];
+                }
+
+                /**
+                 * Can a block of data containing objects of the given
+                 * types with IDs in the range [min_id, max_id] and (for
+                 * nodes) locations inside the given bounding box contain
+                 * anything matching this filter? The bounding box can be
+                 * undefined if it is not known.
+                 */
+                bool may_match(osmium::osm_entity_bits::type types,
+                               osmium::object_id_type min_id,
+                               osmium::object_id_type max_id,
+                               const osmium::Box& bbox) const noexcept {
+                    for (unsigned int i = 0; i < 3; ++i) {
+                        const auto type = osmium::nwr_index_to_item_type(i);
+                        if (!(types & osmium::osm_entity_bits::from_item_type(type))) {
+                            continue;
+                        }
+                        if (max_id < m_id_ranges[i][0] || min_id > m_id_ranges[i][1]) {
+                            continue;
+                        }
+                        if (type == osmium::item_type::node && m_box && bbox && !intersects(m_box, bbox)) {
+                            continue;
+                        }
+                        return true;
+                    }
+                    return false;
+                }
+
+            }; // class read_filter
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_READER_OPTIONS_HPP
@@ -41,6 +41,8 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/error.hpp>
 #include <osmium/io/file.hpp>
 #include <osmium/io/header.hpp>
+#include <osmium/io/metrics.hpp>
+#include <osmium/io/pbf_blob.hpp>
 #include <osmium/io/writer_options.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/thread/pool.hpp>
@@ -104,6 +106,9 @@ namespace osmium {
 
             osmium::io::File m_file;
 
+            // Must outlive the write thread and the encoding tasks.
+            detail::writer_counters m_counters{};
+
             detail::future_string_queue_type m_output_queue{detail::get_output_queue_size(), "raw_output"};
 
             std::unique_ptr<osmium::io::detail::OutputFormat> m_output{nullptr};
@@ -125,15 +130,18 @@ namespace osmium {
             // This function will run in a separate thread.
             static void write_thread(detail::future_string_queue_type& output_queue,
                                      std::unique_ptr<osmium::io::Compressor>&& compressor,
-                                     std::promise<bool>&& write_promise) {
+                                     std::promise<bool>&& write_promise,
+                                     detail::writer_counters& counters) {
                 detail::WriteThread write_thread{output_queue,
                                                  std::move(compressor),
-                                                 std::move(write_promise)};
+                                                 std::move(write_promise),
+                                                 counters};
                 write_thread();
             }
 
             void do_write(osmium::memory::Buffer&& buffer) {
                 if (buffer && buffer.committed() > 0) {
+                    m_counters.buffers_written.add();
                     m_output->write_buffer(std::move(buffer));
                 }
             }
@@ -146,6 +154,7 @@ namespace osmium {
                     using std::swap;
                     swap(m_buffer, buffer);
 
+                    m_counters.buffers_written.add();
                     m_output->write_buffer(std::move(buffer));
                 }
             }
@@ -240,19 +249,31 @@ namespace osmium {
                 }
 
                 m_output = osmium::io::detail::OutputFormatFactory::instance().create_output(*options.pool, m_file, m_output_queue);
+                m_output->set_counters(m_counters);
 
                 if (options.header.get("generator").empty()) {
                     options.header.set("generator", "libosmium/" LIBOSMIUM_VERSION_STRING);
                 }
 
-                std::unique_ptr<osmium::io::Compressor> compressor =
-                    CompressionFactory::instance().create_compressor(file.compression(),
-                                                                     osmium::io::detail::open_for_writing(m_file.filename(), options.allow_overwrite),
-                                                                     options.sync);
+                const int fd = osmium::io::detail::open_for_writing(m_file.filename(), options.allow_overwrite);
+                std::unique_ptr<osmium::io::Compressor> compressor;
+                try {
+                    if (m_file.is_true("parallel_compression")) {
+                        compressor = CompressionFactory::instance().create_parallel_compressor(file.compression(), fd, options.sync, *options.pool);
+                    } else {
+                        compressor = CompressionFactory::instance().create_compressor(file.compression(), fd, options.sync);
+                    }
+                } catch (...) {
+                    // The compressor didn't take over the file descriptor.
+                    if (fd != 1) {
+                        ::close(fd);
+                    }
+                    throw;
+                }
 
                 std::promise<bool> write_promise;
                 m_write_future = write_promise.get_future();
-                m_thread = osmium::thread::thread_handler{write_thread, std::ref(m_output_queue), std::move(compressor), std::move(write_promise)};
+                m_thread = osmium::thread::thread_handler{write_thread, std::ref(m_output_queue), std::move(compressor), std::move(write_promise), std::ref(m_counters)};
 
                 ensure_cleanup([&](){
                     m_output->write_header(options.header);
@@ -298,6 +319,19 @@ namespace osmium {
                 m_buffer_size = size;
             }
 
+            /**
+             * Get the metrics of this writer: counters and timings of the
+             * different stages of the output pipeline and statistics of
+             * its queue. This is cheap and can be called from any thread
+             * while the writer is in use, for instance to find out whether
+             * the encoding or the writing of the data is the bottleneck.
+             */
+            writer_metrics metrics() const noexcept {
+                writer_metrics result = m_counters.get();
+                result.output_queue = m_output_queue.stats();
+                return result;
+            }
+
             /**
              * Flush the internal buffer if it contains any data. This is
              * usually not needed as the buffer gets flushed on close()
@@ -348,6 +382,29 @@ namespace osmium {
                 });
             }
 
+            /**
+             * Write a raw blob read with the osmium::io::PBFBlobReader
+             * unchanged to the output file after the data written so far
+             * (the internal buffer is flushed first). This only works for
+             * PBF output. The blob is moved into this function and will
+             * be empty afterwards.
+             *
+             * The data in the blob is not checked in any way, so make
+             * sure it fits the header of the output file.
+             *
+             * @param blob Blob that is being written out.
+             * @throws osmium::io_error If the output format is not PBF
+             *         or there is some other problem.
+             */
+            void operator()(osmium::io::pbf_blob&& blob) {
+                ensure_cleanup([&](){
+                    do_flush();
+                    if (blob) {
+                        m_output->write_raw_blob(blob.release_data());
+                    }
+                });
+            }
+
             /**
              * Flushes internal buffer and closes output file. If you do not
              * call this, the destructor of Writer will also do the same
@@ -271,6 +271,16 @@ namespace osmium {
                 return m_written;
             }
 
+            /**
+             * Can this buffer be reused for new data after calling clear()?
+             * This is true for valid buffers that use internal memory
+             * management, grow automatically, and don't have a full
+             * callback set.
+             */
+            bool is_reusable() const noexcept {
+                return m_memory && m_auto_grow == auto_grow::yes && !m_full;
+            }
+
             /**
              * This tests if the current state of the buffer is aligned
              * properly. Can be used for asserts.
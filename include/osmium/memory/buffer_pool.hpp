@@ -0,0 +1,160 @@
+#ifndef OSMIUM_MEMORY_BUFFER_POOL_HPP
+#define OSMIUM_MEMORY_BUFFER_POOL_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace osmium {
+
+    namespace memory {
+
+        /**
+         * A thread-safe pool of empty buffers that can be reused instead of
+         * allocating new ones. Buffers you are done with are put() into the
+         * pool, get() hands them out again.
+         *
+         * The pool only keeps buffers that manage their own memory and grow
+         * automatically (see Buffer::is_reusable()). All other buffers,
+         * buffers that have grown larger than the maximum capacity, and
+         * buffers not fitting into the pool any more are freed.
+         */
+        class BufferPool {
+
+            mutable std::mutex m_mutex;
+            std::vector<Buffer> m_buffers;
+            std::size_t m_max_buffers;
+            std::size_t m_max_capacity;
+            std::atomic<uint64_t> m_allocations_avoided{0};
+
+        public:
+
+            /// Default maximum capacity of buffers kept in the pool.
+            static constexpr const std::size_t default_max_capacity = 16UL * 1024UL * 1024UL;
+
+            /**
+             * Create a buffer pool.
+             *
+             * @param max_buffers The maximum number of buffers kept in the
+             *                    pool.
+             * @param max_capacity Buffers with a larger capacity are not
+             *                     kept in the pool.
+             */
+            explicit BufferPool(std::size_t max_buffers = 16, std::size_t max_capacity = default_max_capacity) :
+                m_max_buffers(max_buffers),
+                m_max_capacity(max_capacity) {
+            }
+
+            BufferPool(const BufferPool&) = delete;
+            BufferPool& operator=(const BufferPool&) = delete;
+
+            BufferPool(BufferPool&&) = delete;
+            BufferPool& operator=(BufferPool&&) = delete;
+
+            ~BufferPool() noexcept = default;
+
+            /**
+             * Put a buffer into the pool. The buffer is cleared. If it
+             * can't be reused, is too large, or the pool is full, it is
+             * freed.
+             */
+            void put(Buffer&& buffer) {
+                if (!buffer.is_reusable() || buffer.capacity() > m_max_capacity) {
+                    return;
+                }
+
+                Buffer tmp{std::move(buffer)};
+                tmp.clear();
+
+                std::lock_guard<std::mutex> lock{m_mutex};
+                if (m_buffers.size() < m_max_buffers) {
+                    m_buffers.push_back(std::move(tmp));
+                }
+            }
+
+            /**
+             * Get an empty buffer from the pool. If there is no buffer in
+             * the pool, a new one with the given capacity is allocated.
+             *
+             * @param capacity Capacity of newly allocated buffers.
+             */
+            Buffer get(std::size_t capacity) {
+                {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    if (!m_buffers.empty()) {
+                        Buffer buffer{std::move(m_buffers.back())};
+                        m_buffers.pop_back();
+                        ++m_allocations_avoided;
+                        return buffer;
+                    }
+                }
+
+                return Buffer{capacity, Buffer::auto_grow::yes};
+            }
+
+            /**
+             * Count an allocation that was avoided by reusing memory in some
+             * other way than taking a buffer from this pool.
+             */
+            void add_avoided_allocation() noexcept {
+                ++m_allocations_avoided;
+            }
+
+            /**
+             * The number of memory allocations avoided so far, because
+             * buffers (or other memory) were reused.
+             */
+            uint64_t allocations_avoided() const noexcept {
+                return m_allocations_avoided;
+            }
+
+            /// The number of buffers currently in the pool.
+            std::size_t size() const {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                return m_buffers.size();
+            }
+
+        }; // class BufferPool
+
+    } // namespace memory
+
+} // namespace osmium
+
+#endif // OSMIUM_MEMORY_BUFFER_POOL_HPP
@@ -0,0 +1,108 @@
+#ifndef OSMIUM_OSM_NODE_LOCATION_BATCH_HPP
+#define OSMIUM_OSM_NODE_LOCATION_BATCH_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace osmium {
+
+    /**
+     * A batch of node IDs and locations in struct-of-arrays layout. This
+     * is what you need to build a location index and it is much cheaper
+     * to create than complete Node objects. See the NodeLocationReader
+     * class.
+     */
+    class NodeLocationBatch {
+
+        std::vector<osmium::object_id_type> m_ids;
+        std::vector<osmium::Location> m_locations;
+
+    public:
+
+        NodeLocationBatch() = default;
+
+        /// The number of nodes in this batch.
+        std::size_t size() const noexcept {
+            return m_ids.size();
+        }
+
+        bool empty() const noexcept {
+            return m_ids.empty();
+        }
+
+        void reserve(std::size_t size) {
+            m_ids.reserve(size);
+            m_locations.reserve(size);
+        }
+
+        void clear() noexcept {
+            m_ids.clear();
+            m_locations.clear();
+        }
+
+        void add(osmium::object_id_type id, const osmium::Location& location) {
+            m_ids.push_back(id);
+            m_locations.push_back(location);
+        }
+
+        /// The IDs of all nodes in this batch.
+        const std::vector<osmium::object_id_type>& ids() const noexcept {
+            return m_ids;
+        }
+
+        /// The locations of all nodes in this batch in the same order as the IDs.
+        const std::vector<osmium::Location>& locations() const noexcept {
+            return m_locations;
+        }
+
+        osmium::object_id_type id(std::size_t n) const noexcept {
+            assert(n < size());
+            return m_ids[n];
+        }
+
+        const osmium::Location& location(std::size_t n) const noexcept {
+            assert(n < size());
+            return m_locations[n];
+        }
+
+    }; // class NodeLocationBatch
+
+} // namespace osmium
+
+#endif // OSMIUM_OSM_NODE_LOCATION_BATCH_HPP
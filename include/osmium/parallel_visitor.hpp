@@ -0,0 +1,241 @@
+#ifndef OSMIUM_PARALLEL_VISITOR_HPP
+#define OSMIUM_PARALLEL_VISITOR_HPP
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/visitor.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace osmium {
+
+    namespace detail {
+
+        /**
+         * Keeps track of which handlers are currently in use by tasks
+         * in the thread pool. Each handler is used by at most one task
+         * at a time.
+         */
+        class apply_parallel_slots {
+
+            std::mutex m_mutex;
+            std::condition_variable m_cv;
+            std::vector<std::size_t> m_free;
+            std::size_t m_size;
+            std::exception_ptr m_exception;
+
+        public:
+
+            explicit apply_parallel_slots(std::size_t size) :
+                m_free(),
+                m_size(size),
+                m_exception() {
+                m_free.reserve(size);
+                for (std::size_t i = size; i > 0; --i) {
+                    m_free.push_back(i - 1);
+                }
+            }
+
+            /// Wait until a handler is free and return its index.
+            std::size_t acquire() {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_cv.wait(lock, [this]() {
+                    return !m_free.empty();
+                });
+                const std::size_t slot = m_free.back();
+                m_free.pop_back();
+                return slot;
+            }
+
+            /// Mark handler as free, remember the first exception.
+            void release(std::size_t slot, const std::exception_ptr& exception = nullptr) {
+                // Notify while holding the lock: Once the last slot is free,
+                // wait_for_all() can return and this object is destroyed.
+                std::lock_guard<std::mutex> lock{m_mutex};
+                m_free.push_back(slot);
+                if (exception && !m_exception) {
+                    m_exception = exception;
+                }
+                m_cv.notify_all();
+            }
+
+            bool has_exception() {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                return bool(m_exception);
+            }
+
+            /// Wait until all handlers are free again.
+            void wait_for_all() {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_cv.wait(lock, [this]() {
+                    return m_free.size() == m_size;
+                });
+            }
+
+            void rethrow_if_exception() {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                if (m_exception) {
+                    std::rethrow_exception(m_exception);
+                }
+            }
+
+        }; // class apply_parallel_slots
+
+        template <typename THandler>
+        class apply_parallel_task {
+
+            // shared_ptr because tasks in the pool must be copyable
+            std::shared_ptr<osmium::memory::Buffer> m_buffer;
+            THandler* m_handler;
+            apply_parallel_slots* m_slots;
+            std::size_t m_slot;
+
+        public:
+
+            apply_parallel_task(osmium::memory::Buffer&& buffer, THandler& handler, apply_parallel_slots& slots, std::size_t slot) :
+                m_buffer(std::make_shared<osmium::memory::Buffer>(std::move(buffer))),
+                m_handler(&handler),
+                m_slots(&slots),
+                m_slot(slot) {
+            }
+
+            void operator()() {
+                std::exception_ptr exception;
+                try {
+                    osmium::apply(*m_buffer, *m_handler);
+                } catch (...) {
+                    exception = std::current_exception();
+                }
+                m_buffer.reset();
+                m_slots->release(m_slot, exception);
+            }
+
+        }; // class apply_parallel_task
+
+    } // namespace detail
+
+    /**
+     * Apply handlers to all buffers read from the source using several
+     * threads from the thread pool.
+     *
+     * The factory is called num_handlers times to create that many handler
+     * instances. Each buffer read from the source is then given to one of
+     * those handlers running in the thread pool. A handler sees only one
+     * buffer at a time, but different buffers will be handled by different
+     * handler instances in no particular order. At the end, reduce is
+     * called with each handler (in the calling thread) to merge their
+     * results.
+     *
+     * This is useful for order-insensitive work like counting objects or
+     * collecting tag statistics or IDs, where the handler does a lot of work
+     * compared to the decoding of the data. Handlers must not depend on the
+     * order of the objects or share state without synchronization.
+     *
+     * @code
+     * osmium::io::Reader reader{"input.osm.pbf"};
+     * uint64_t nodes = 0;
+     * osmium::apply_parallel(reader,
+     *     []() { return CountHandler{}; },
+     *     [&](const CountHandler& handler) { nodes += handler.nodes; });
+     * @endcode
+     *
+     * @tparam TSource Source with a read() function returning buffers
+     *                 (usually an osmium::io::Reader).
+     * @param source The source to read from.
+     * @param factory Function returning a new handler.
+     * @param reduce Function called with each handler at the end.
+     * @param pool The thread pool to use.
+     * @param num_handlers Number of handler instances. If this is 0, the
+     *                     number of threads in the pool is used.
+     * @throws Any exception thrown while reading or by a handler. The
+     *         reduce function is not called in that case.
+     */
+    template <typename TSource, typename THandlerFactory, typename TReduce>
+    inline void apply_parallel(TSource& source,
+                               THandlerFactory&& factory,
+                               TReduce&& reduce,
+                               osmium::thread::Pool& pool = osmium::thread::Pool::default_instance(),
+                               std::size_t num_handlers = 0) {
+        using handler_type = typename std::decay<decltype(factory())>::type;
+
+        if (num_handlers == 0) {
+            num_handlers = static_cast<std::size_t>(pool.num_threads());
+        }
+
+        std::vector<handler_type> handlers;
+        handlers.reserve(num_handlers);
+        for (std::size_t i = 0; i < num_handlers; ++i) {
+            handlers.push_back(factory());
+        }
+
+        detail::apply_parallel_slots slots{num_handlers};
+
+        try {
+            while (osmium::memory::Buffer buffer = source.read()) {
+                const std::size_t slot = slots.acquire();
+                if (slots.has_exception()) {
+                    slots.release(slot);
+                    break;
+                }
+                try {
+                    pool.submit_detached(detail::apply_parallel_task<handler_type>{std::move(buffer), handlers[slot], slots, slot});
+                } catch (...) {
+                    slots.release(slot);
+                    throw;
+                }
+            }
+        } catch (...) {
+            slots.wait_for_all();
+            throw;
+        }
+
+        slots.wait_for_all();
+        slots.rethrow_if_exception();
+
+        for (auto& handler : handlers) {
+            reduce(handler);
+        }
+    }
+
+} // namespace osmium
+
+#endif // OSMIUM_PARALLEL_VISITOR_HPP
@@ -0,0 +1,266 @@
+#ifndef OSMIUM_THREAD_AFFINITY_HPP
+#define OSMIUM_THREAD_AFFINITY_HPP
+
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/util/config.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+# include <sched.h>
+# include <sys/resource.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+namespace osmium {
+
+    namespace thread {
+
+        /**
+         * Parse a list of CPU numbers in the format used by Linux (for
+         * instance in /sys/devices/system/node/node0/cpulist or by
+         * "taskset -c"): Comma separated numbers or ranges of numbers
+         * like "0-3,8,10-11". Whitespace at the end is ignored.
+         *
+         * @returns Sorted list of CPU numbers.
+         * @throws std::invalid_argument if the list can't be parsed.
+         */
+        inline std::vector<int> parse_cpu_list(const std::string& str) {
+            std::vector<int> cpus;
+
+            const char* s = str.c_str();
+            while (*s != '\0' && *s != '\n' && *s != ' ') {
+                char* end = nullptr;
+                const long first = std::strtol(s, &end, 10);
+                if (end == s || first < 0) {
+                    throw std::invalid_argument{"invalid CPU list: '" + str + "'"};
+                }
+                long last = first;
+                s = end;
+                if (*s == '-') {
+                    ++s;
+                    last = std::strtol(s, &end, 10);
+                    if (end == s || last < first) {
+                        throw std::invalid_argument{"invalid CPU list: '" + str + "'"};
+                    }
+                    s = end;
+                }
+                for (long cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(static_cast<int>(cpu));
+                }
+                if (*s == ',') {
+                    ++s;
+                } else if (*s != '\0' && *s != '\n' && *s != ' ') {
+                    throw std::invalid_argument{"invalid CPU list: '" + str + "'"};
+                }
+            }
+
+            std::sort(cpus.begin(), cpus.end());
+            cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+
+            return cpus;
+        }
+
+        namespace detail {
+
+            inline std::string read_first_line(const std::string& filename) {
+                std::ifstream file{filename};
+                std::string line;
+                std::getline(file, line);
+                return line;
+            }
+
+        } // namespace detail
+
+        /**
+         * Get the number of the CPU the current thread is running on.
+         * This only works on Linux.
+         *
+         * @returns CPU number or -1 if unknown.
+         */
+        inline int current_cpu() noexcept {
+#ifdef __linux__
+            return sched_getcpu();
+#else
+            return -1;
+#endif
+        }
+
+        /**
+         * Get the CPUs of a NUMA node. This only works on Linux, it reads
+         * the information from /sys.
+         *
+         * @returns Sorted list of CPU numbers, empty if unknown.
+         */
+        inline std::vector<int> numa_node_cpus(int node) {
+            if (node < 0) {
+                return {};
+            }
+            const std::string line = detail::read_first_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            try {
+                return parse_cpu_list(line);
+            } catch (const std::invalid_argument&) {
+                return {};
+            }
+        }
+
+        /**
+         * Get the NUMA node the given CPU belongs to. This only works on
+         * Linux, it reads the information from /sys.
+         *
+         * @returns NUMA node number or -1 if unknown.
+         */
+        inline int numa_node_of_cpu(int cpu) {
+            if (cpu < 0) {
+                return -1;
+            }
+            std::vector<int> nodes;
+            try {
+                nodes = parse_cpu_list(detail::read_first_line("/sys/devices/system/node/possible"));
+            } catch (const std::invalid_argument&) {
+                return -1;
+            }
+            for (const int node : nodes) {
+                const auto cpus = numa_node_cpus(node);
+                if (std::binary_search(cpus.begin(), cpus.end(), cpu)) {
+                    return node;
+                }
+            }
+            return -1;
+        }
+
+        /**
+         * Turn a CPU setting as used in the OSMIUM_POOL_CPUS and
+         * OSMIUM_IO_CPUS environment variables into a list of CPUs.
+         * The setting can be
+         *
+         * * empty: No CPUs, ie. don't change the affinity.
+         * * "local": The CPUs of the NUMA node the current thread is
+         *   running on.
+         * * "nodeN": The CPUs of NUMA node N.
+         * * A list of CPUs as described in parse_cpu_list().
+         *
+         * @returns Sorted list of CPU numbers.
+         * @throws std::invalid_argument if the setting can't be parsed.
+         */
+        inline std::vector<int> resolve_cpu_setting(const std::string& setting) {
+            if (setting.empty()) {
+                return {};
+            }
+            if (setting == "local") {
+                return numa_node_cpus(numa_node_of_cpu(current_cpu()));
+            }
+            if (setting.compare(0, 4, "node") == 0) {
+                char* end = nullptr;
+                const long node = std::strtol(setting.c_str() + 4, &end, 10);
+                if (end == setting.c_str() + 4 || *end != '\0' || node < 0) {
+                    throw std::invalid_argument{"invalid NUMA node: '" + setting + "'"};
+                }
+                return numa_node_cpus(static_cast<int>(node));
+            }
+            return parse_cpu_list(setting);
+        }
+
+        /**
+         * Restrict the current thread to run on the given CPUs. This only
+         * works on Linux. Nothing is done if the list is empty.
+         *
+         * @returns true if the affinity was set, false otherwise.
+         */
+        inline bool set_thread_affinity(const std::vector<int>& cpus) noexcept {
+#ifdef __linux__
+            if (cpus.empty()) {
+                return false;
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (const int cpu : cpus) {
+                if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+            (void)cpus;
+            return false;
+#endif
+        }
+
+        /**
+         * Set the nice value (priority) of the current thread. This only
+         * works on Linux where each thread has its own nice value.
+         * Nothing is done if the value is 0.
+         *
+         * @returns true if the nice value was set, false otherwise.
+         */
+        inline bool set_thread_nice(int nice) noexcept {
+#ifdef __linux__
+            if (nice == 0) {
+                return false;
+            }
+            const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+            return setpriority(PRIO_PROCESS, tid, nice) == 0;
+#else
+            (void)nice;
+            return false;
+#endif
+        }
+
+        /**
+         * Restrict the current thread to the CPUs set in the
+         * OSMIUM_IO_CPUS environment variable (see resolve_cpu_setting()
+         * for the format). This is called by the threads reading,
+         * parsing and writing data in the Reader and Writer. Invalid
+         * settings are ignored.
+         */
+        inline void set_io_thread_affinity() noexcept {
+            try {
+                set_thread_affinity(resolve_cpu_setting(osmium::config::get_cpus("IO")));
+            } catch (...) {
+                // Ignore any errors, this is only an optimization.
+            }
+        }
+
+    } // namespace thread
+
+} // namespace osmium
+
+#endif // OSMIUM_THREAD_AFFINITY_HPP
@@ -33,7 +33,9 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
-#include <memory>
+#include <cstddef>
+#include <new>
+#include <type_traits>
 #include <utility>
 
 namespace osmium {
@@ -43,85 +45,185 @@ namespace osmium {
         /**
          * This function wrapper can collect move-only functions unlike
          * std::function which needs copyable functions.
-         * Taken from the book "C++ Concurrency in Action".
+         * Originally taken from the book "C++ Concurrency in Action".
+         *
+         * Small functions (up to inline_size bytes, which is enough for a
+         * std::packaged_task or a lambda capturing a few pointers) are
+         * stored inside the wrapper itself, only larger functions are
+         * allocated on the heap.
          */
         class function_wrapper {
 
-            struct impl_base {
+        public:
 
-                impl_base() noexcept = default;
+            /// Functions up to this size are stored without allocation.
+            static constexpr const std::size_t inline_size = 6 * sizeof(void*);
 
-                impl_base(const impl_base&) noexcept = default;
-                impl_base& operator=(const impl_base&) noexcept = default;
+        private:
 
-                impl_base(impl_base&&) noexcept = default;
-                impl_base& operator=(impl_base&&) noexcept = default;
+            using storage_type = typename std::aligned_storage<inline_size, alignof(std::max_align_t)>::type;
 
-                virtual ~impl_base() noexcept = default;
+            // Hand-made "vtable" for the stored function.
+            struct operations {
+                bool (*call)(void* storage);
+                void (*move)(void* from, void* to) noexcept;
+                void (*destroy)(void* storage) noexcept;
+            };
 
-                virtual bool call() {
-                    return true;
+            template <typename F>
+            struct use_inline_storage : std::integral_constant<bool,
+                sizeof(F) <= inline_size &&
+                alignof(storage_type) % alignof(F) == 0 &&
+                std::is_nothrow_move_constructible<F>::value> {
+            };
+
+            template <typename F>
+            struct inline_operations {
+
+                static bool call(void* storage) {
+                    (*static_cast<F*>(storage))();
+                    return false;
+                }
+
+                static void move(void* from, void* to) noexcept {
+                    new (to) F(std::move(*static_cast<F*>(from)));
+                    static_cast<F*>(from)->~F();
+                }
+
+                static void destroy(void* storage) noexcept {
+                    static_cast<F*>(storage)->~F();
                 }
 
-            }; // struct impl_base
+                static const operations* get() noexcept {
+                    static const operations ops = {call, move, destroy};
+                    return &ops;
+                }
 
-            std::unique_ptr<impl_base> impl;
+            }; // struct inline_operations
 
             template <typename F>
-            struct impl_type : impl_base {
+            struct heap_operations {
 
-                F m_functor;
+                static bool call(void* storage) {
+                    (**static_cast<F**>(storage))();
+                    return false;
+                }
 
-                explicit impl_type(F&& functor) :
-                    m_functor(std::forward<F>(functor)) {
+                static void move(void* from, void* to) noexcept {
+                    *static_cast<F**>(to) = *static_cast<F**>(from);
                 }
 
-                bool call() override {
-                    m_functor();
-                    return false;
+                static void destroy(void* storage) noexcept {
+                    delete *static_cast<F**>(storage);
                 }
 
-            }; // struct impl_type
+                static const operations* get() noexcept {
+                    static const operations ops = {call, move, destroy};
+                    return &ops;
+                }
+
+            }; // struct heap_operations
+
+            // Operations for the special function wrapper that makes the
+            // worker thread shut down.
+            struct shutdown_operations {
+
+                static bool call(void* /*storage*/) {
+                    return true;
+                }
+
+                static void move(void* /*from*/, void* /*to*/) noexcept {
+                }
+
+                static void destroy(void* /*storage*/) noexcept {
+                }
+
+                static const operations* get() noexcept {
+                    static const operations ops = {call, move, destroy};
+                    return &ops;
+                }
+
+            }; // struct shutdown_operations
+
+            storage_type m_storage;
+            const operations* m_ops = nullptr;
+
+            template <typename F, typename TFunction>
+            void init(TFunction&& f, std::true_type /*inline*/) {
+                new (&m_storage) F(std::forward<TFunction>(f));
+                m_ops = inline_operations<F>::get();
+            }
+
+            template <typename F, typename TFunction>
+            void init(TFunction&& f, std::false_type /*inline*/) {
+                *reinterpret_cast<F**>(&m_storage) = new F(std::forward<TFunction>(f));
+                m_ops = heap_operations<F>::get();
+            }
+
+            void reset() noexcept {
+                if (m_ops) {
+                    m_ops->destroy(&m_storage);
+                    m_ops = nullptr;
+                }
+            }
 
         public:
 
             // Constructor must not be "explicit" for wrapper
             // to work seemlessly.
-            template <typename TFunction>
+            template <typename TFunction, typename F = typename std::decay<TFunction>::type,
+                      typename std::enable_if<!std::is_same<F, function_wrapper>::value, int>::type = 0>
             // cppcheck-suppress noExplicitConstructor
-            function_wrapper(TFunction&& f) : // NOLINT(google-explicit-constructor, hicpp-explicit-conversions, misc-forwarding-reference-overload)
-                impl(new impl_type<TFunction>(std::forward<TFunction>(f))) {
+            function_wrapper(TFunction&& f) { // NOLINT(google-explicit-constructor, hicpp-explicit-conversions, misc-forwarding-reference-overload)
+                init<F>(std::forward<TFunction>(f), use_inline_storage<F>{});
             }
 
             // The integer parameter is only used to signal that we want
             // the special function wrapper that makes the worker thread
             // shut down.
-            explicit function_wrapper(int /*dummy*/) :
-                impl(new impl_base()) {
+            explicit function_wrapper(int /*dummy*/) noexcept :
+                m_ops(shutdown_operations::get()) {
             }
 
+            /**
+             * Call the wrapped function. Returns true only for the special
+             * function wrapper that makes the worker thread shut down.
+             */
             bool operator()() {
-                return impl->call();
+                return m_ops->call(&m_storage);
             }
 
-            function_wrapper() = default;
+            function_wrapper() noexcept = default;
 
             function_wrapper(const function_wrapper&) = delete;
             function_wrapper& operator=(const function_wrapper&) = delete;
 
             function_wrapper(function_wrapper&& other) noexcept :
-                impl(std::move(other.impl)) {
+                m_ops(other.m_ops) {
+                if (m_ops) {
+                    m_ops->move(&other.m_storage, &m_storage);
+                    other.m_ops = nullptr;
+                }
             }
 
             function_wrapper& operator=(function_wrapper&& other) noexcept {
-                impl = std::move(other.impl);
+                if (this != &other) {
+                    reset();
+                    if (other.m_ops) {
+                        other.m_ops->move(&other.m_storage, &m_storage);
+                        m_ops = other.m_ops;
+                        other.m_ops = nullptr;
+                    }
+                }
                 return *this;
             }
 
-            ~function_wrapper() = default;
+            ~function_wrapper() noexcept {
+                reset();
+            }
 
-            explicit operator bool() const {
-                return static_cast<bool>(impl);
+            explicit operator bool() const noexcept {
+                return m_ops != nullptr;
             }
 
         }; // class function_wrapper
@@ -0,0 +1,170 @@
+#ifndef OSMIUM_THREAD_MEMORY_BUDGET_HPP
+#define OSMIUM_THREAD_MEMORY_BUDGET_HPP
+
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/util/config.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace osmium {
+
+    namespace thread {
+
+        /**
+         * Keeps track of the number of bytes of data waiting in queues
+         * between threads and makes producers wait if there is too much
+         * of it.
+         *
+         * Producers charge the budget when they add data to a queue,
+         * consumers release the bytes again when they take the data out.
+         * Before producing more data, producers call wait_for_room(). It
+         * blocks while the budget is exhausted, but only as long as the
+         * given condition is true. This is usually "the queue I am adding
+         * to is not empty", which guarantees that the consumer will
+         * release some memory eventually. A producer whose queue is empty
+         * is never blocked, otherwise the pipeline could deadlock.
+         *
+         * The Reader and Writer use the budget from default_instance().
+         * Its limit is read from the OSMIUM_MEMORY_BUDGET_MB environment
+         * variable or can be set with set_limit(). A limit of 0 (the
+         * default) means there is no limit.
+         */
+        class MemoryBudget {
+
+            std::atomic<std::size_t> m_limit;
+            std::atomic<std::size_t> m_used{0};
+            std::atomic<int> m_waiting{0};
+            std::mutex m_mutex{};
+            std::condition_variable m_room_available{};
+
+            void notify_waiting() {
+                // The counters are sequentially consistent atomics, so
+                // either a waiting thread sees our change or we see the
+                // waiting thread here.
+                if (m_waiting > 0) {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    m_room_available.notify_all();
+                }
+            }
+
+        public:
+
+            /**
+             * Create a memory budget.
+             *
+             * @param limit Maximum number of bytes. 0 means no limit.
+             */
+            explicit MemoryBudget(std::size_t limit = 0) noexcept :
+                m_limit(limit) {
+            }
+
+            MemoryBudget(const MemoryBudget&) = delete;
+            MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+            MemoryBudget(MemoryBudget&&) = delete;
+            MemoryBudget& operator=(MemoryBudget&&) = delete;
+
+            ~MemoryBudget() noexcept = default;
+
+            /**
+             * The memory budget used by the Reader and Writer.
+             */
+            static MemoryBudget& default_instance() {
+                static MemoryBudget budget{osmium::config::get_memory_budget()};
+                return budget;
+            }
+
+            std::size_t limit() const noexcept {
+                return m_limit;
+            }
+
+            /**
+             * Set the maximum number of bytes. 0 means no limit.
+             */
+            void set_limit(std::size_t limit) {
+                m_limit = limit;
+                notify_waiting();
+            }
+
+            /// The number of bytes currently charged.
+            std::size_t used() const noexcept {
+                return m_used;
+            }
+
+            bool exhausted() const noexcept {
+                const std::size_t limit = m_limit;
+                return limit != 0 && m_used >= limit;
+            }
+
+            /// Charge the budget with the given number of bytes.
+            void charge(std::size_t bytes) noexcept {
+                m_used += bytes;
+            }
+
+            /// Give back the given number of bytes charged earlier.
+            void release(std::size_t bytes) {
+                m_used -= bytes;
+                notify_waiting();
+            }
+
+            /**
+             * Wait until the budget is not exhausted any more or the
+             * condition returns false. The condition must only change
+             * from true to false when release() is called afterwards
+             * (usually because data was taken out of a queue).
+             */
+            template <typename TCondition>
+            void wait_for_room(TCondition&& condition) {
+                if (!exhausted()) {
+                    return;
+                }
+                std::unique_lock<std::mutex> lock{m_mutex};
+                ++m_waiting;
+                m_room_available.wait(lock, [this, &condition] {
+                    return !exhausted() || !condition();
+                });
+                --m_waiting;
+            }
+
+        }; // class MemoryBudget
+
+    } // namespace thread
+
+} // namespace osmium
+
+#endif // OSMIUM_THREAD_MEMORY_BUDGET_HPP
@@ -0,0 +1,353 @@
+#ifndef OSMIUM_THREAD_MPMC_QUEUE_HPP
+#define OSMIUM_THREAD_MPMC_QUEUE_HPP
+
+
+/*
+
+This file is part of Osmium (https://osmcode.org/libosmium).
+
+Copyright 2013-2018 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <osmium/thread/queue.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace osmium {
+
+    namespace thread {
+
+        /**
+         * A bounded thread-safe multi-producer multi-consumer queue.
+         *
+         * It has the same interface as osmium::thread::Queue, but pushing
+         * and popping don't need a lock as long as the queue is neither
+         * full nor empty. The elements are stored in a ring buffer of
+         * cells, each with a sequence number telling producers and
+         * consumers whether the cell is free or filled (the algorithm by
+         * Dmitry Vyukov).
+         *
+         * Threads that find the queue full (on push) or empty (on pop)
+         * spin for a short while and then block on a condition variable.
+         * They are woken up as soon as there is space or data available.
+         * The mutex is only taken if there are blocked threads.
+         *
+         * Unlike Queue this queue always has a maximum size. If 0 is
+         * given as max_size, default_max_size is used.
+         *
+         * T must be default constructible and move assignable.
+         */
+        template <typename T>
+        class MPMCQueue {
+
+            struct cell {
+                std::atomic<std::size_t> sequence{0};
+                T value{};
+            };
+
+            // Padding is used to keep the positions on different cache
+            // lines so that producers and consumers don't disturb each
+            // other.
+            static constexpr const std::size_t cache_line_size = 64;
+
+            struct padded_position {
+                std::atomic<std::size_t> pos{0};
+                char padding[cache_line_size - sizeof(std::atomic<std::size_t>)];
+            };
+
+            // Number of times a thread retries before blocking.
+            static constexpr const int spin_count = 64;
+
+            // Reading the size means reading the position of the other
+            // side, so it is only done every this many pushes for the
+            // statistics.
+            static constexpr const std::size_t size_sample_interval = 64;
+
+            const std::size_t m_max_size;
+
+            const std::string m_name;
+
+            std::unique_ptr<cell[]> m_cells;
+
+            padded_position m_enqueue{};
+
+            padded_position m_dequeue{};
+
+            std::atomic<int> m_waiting_producers{0};
+            std::atomic<int> m_waiting_consumers{0};
+
+            std::mutex m_mutex;
+
+            /// Used to signal consumers when data is available in the queue.
+            std::condition_variable m_data_available;
+
+            /// Used to signal producers when queue is not full.
+            std::condition_variable m_space_available;
+
+            detail::queue_counters m_counters;
+
+            bool has_space() const noexcept {
+                const std::size_t pos = m_enqueue.pos.load(std::memory_order_relaxed);
+                return m_cells[pos % m_max_size].sequence.load(std::memory_order_acquire) >= pos;
+            }
+
+            bool has_data() const noexcept {
+                const std::size_t pos = m_dequeue.pos.load(std::memory_order_relaxed);
+                return m_cells[pos % m_max_size].sequence.load(std::memory_order_acquire) >= pos + 1;
+            }
+
+            void wake_up(const std::atomic<int>& waiting, std::condition_variable& condition) {
+                // Pairs with the fence in block_until(): Either the waiting
+                // thread sees our change of the queue or we see the thread
+                // waiting.
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (waiting.load(std::memory_order_relaxed) > 0) {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    condition.notify_one();
+                }
+            }
+
+            template <typename TOperation, typename TReady>
+            void block_until(std::atomic<int>& waiting, std::condition_variable& condition, TOperation&& try_op, TReady&& ready) {
+                for (int i = 0; i < spin_count; ++i) {
+                    if (try_op()) {
+                        return;
+                    }
+                    std::this_thread::yield();
+                }
+
+                while (!try_op()) {
+                    std::unique_lock<std::mutex> lock{m_mutex};
+                    waiting.fetch_add(1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    condition.wait(lock, ready);
+                    waiting.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+
+            bool do_try_push(T& value) {
+                std::size_t pos = m_enqueue.pos.load(std::memory_order_relaxed);
+                while (true) {
+                    cell& c = m_cells[pos % m_max_size];
+                    const std::size_t seq = c.sequence.load(std::memory_order_acquire);
+                    if (seq == pos) {
+                        if (m_enqueue.pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            c.value = std::move(value);
+                            c.sequence.store(pos + 1, std::memory_order_release);
+                            wake_up(m_waiting_consumers, m_data_available);
+                            if (pos % size_sample_interval == 0) {
+                                m_counters.update_largest_size(size());
+                            }
+                            return true;
+                        }
+                    } else if (seq < pos) {
+                        // The cell still contains the element from the
+                        // last round, so the queue is full.
+                        return false;
+                    } else {
+                        pos = m_enqueue.pos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool do_try_pop(T& value) {
+                std::size_t pos = m_dequeue.pos.load(std::memory_order_relaxed);
+                while (true) {
+                    cell& c = m_cells[pos % m_max_size];
+                    const std::size_t seq = c.sequence.load(std::memory_order_acquire);
+                    if (seq == pos + 1) {
+                        if (m_dequeue.pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            value = std::move(c.value);
+                            c.sequence.store(pos + m_max_size, std::memory_order_release);
+                            wake_up(m_waiting_producers, m_space_available);
+                            return true;
+                        }
+                    } else if (seq < pos + 1) {
+                        // Nothing has been written into this cell yet, so
+                        // the queue is empty.
+                        return false;
+                    } else {
+                        pos = m_dequeue.pos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+        public:
+
+            static constexpr const std::size_t default_max_size = 1024;
+
+            /**
+             * Construct a multithreaded queue.
+             *
+             * @param max_size Maximum number of elements in the queue. Set to
+             *                 0 for the default_max_size.
+             * @param name Optional name for this queue. (Used for debugging.)
+             */
+            explicit MPMCQueue(std::size_t max_size = 0, std::string name = "") :
+                m_max_size(max_size > 0 ? max_size : default_max_size),
+                m_name(std::move(name)),
+                m_cells(new cell[m_max_size]) {
+                for (std::size_t i = 0; i < m_max_size; ++i) {
+                    m_cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            MPMCQueue(const MPMCQueue&) = delete;
+            MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+            MPMCQueue(MPMCQueue&&) = delete;
+            MPMCQueue& operator=(MPMCQueue&&) = delete;
+
+#ifdef OSMIUM_DEBUG_QUEUE_SIZE
+            ~MPMCQueue() {
+                detail::print_queue_stats(m_name, m_max_size, stats());
+            }
+#else
+            ~MPMCQueue() = default;
+#endif
+
+            /**
+             * Try to push an element onto the queue. Never blocks.
+             *
+             * @returns true if the element was pushed, false if the queue
+             *          was full. In that case value is unchanged.
+             */
+            bool try_push(T& value) {
+                return do_try_push(value);
+            }
+
+            /**
+             * Push an element onto the queue. This call will block if the
+             * queue is full.
+             */
+            void push(T value) {
+                if (!do_try_push(value)) {
+                    const auto start = m_counters.start_push_wait();
+                    block_until(m_waiting_producers, m_space_available, [this, &value] {
+                        return do_try_push(value);
+                    }, [this] {
+                        return has_space();
+                    });
+                    m_counters.end_push_wait(start);
+                    m_counters.update_largest_size(m_max_size);
+                }
+            }
+
+            /**
+             * Try to pop an element from the queue. Never blocks.
+             *
+             * @returns true if an element was popped into value, false if
+             *          the queue was empty.
+             */
+            bool try_pop(T& value) {
+                return do_try_pop(value);
+            }
+
+            /**
+             * Pop an element from the queue. This call will block if the
+             * queue is empty.
+             */
+            void wait_and_pop(T& value) {
+                if (!do_try_pop(value)) {
+                    const auto start = m_counters.start_pop_wait();
+                    block_until(m_waiting_consumers, m_data_available, [this, &value] {
+                        return do_try_pop(value);
+                    }, [this] {
+                        return has_data();
+                    });
+                    m_counters.end_pop_wait(start);
+                }
+            }
+
+            /**
+             * The number of elements in the queue. This is only a snapshot
+             * if other threads are using the queue at the same time.
+             */
+            std::size_t size() const noexcept {
+                const std::size_t dequeue_pos = m_dequeue.pos.load(std::memory_order_relaxed);
+                const std::size_t enqueue_pos = m_enqueue.pos.load(std::memory_order_relaxed);
+                return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+            }
+
+            bool empty() const noexcept {
+                return size() == 0;
+            }
+
+            std::size_t max_size() const noexcept {
+                return m_max_size;
+            }
+
+            const std::string& name() const noexcept {
+                return m_name;
+            }
+
+            /**
+             * Statistics about the use of this queue so far. Can be called
+             * from any thread while the queue is in use.
+             */
+            queue_stats stats() const noexcept {
+                // The positions count the successful pushes and pops, so
+                // there is no need for extra counters.
+                queue_stats result = m_counters.get();
+                result.pushes = m_enqueue.pos.load(std::memory_order_relaxed);
+                result.pops = m_dequeue.pos.load(std::memory_order_relaxed);
+                return result;
+            }
+
+        }; // class MPMCQueue
+
+        template <typename T>
+        constexpr const std::size_t MPMCQueue<T>::default_max_size;
+
+        /**
+         * The queue type used for the work queue of the thread pool and
+         * for the queues between the stages of the Reader and Writer.
+         * This is osmium::thread::Queue, unless OSMIUM_USE_MPMC_QUEUE is
+         * defined before including any Osmium header, in which case it
+         * is osmium::thread::MPMCQueue.
+         */
+#ifdef OSMIUM_USE_MPMC_QUEUE
+        template <typename T>
+        using pipeline_queue = MPMCQueue<T>;
+#else
+        template <typename T>
+        using pipeline_queue = Queue<T>;
+#endif
+
+    } // namespace thread
+
+} // namespace osmium
+
+#endif // OSMIUM_THREAD_MPMC_QUEUE_HPP
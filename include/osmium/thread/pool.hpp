@@ -33,13 +33,21 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <osmium/thread/affinity.hpp>
 #include <osmium/thread/function_wrapper.hpp>
-#include <osmium/thread/queue.hpp>
+#include <osmium/thread/mpmc_queue.hpp>
 #include <osmium/thread/util.hpp>
 #include <osmium/util/config.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <deque>
 #include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <thread>
 #include <type_traits>
 #include <utility>
@@ -76,15 +84,64 @@ namespace osmium {
                 return num_threads;
             }
 
+            inline std::vector<int> get_pool_cpus() {
+                try {
+                    return resolve_cpu_setting(osmium::config::get_cpus("POOL"));
+                } catch (const std::invalid_argument&) {
+                    return {};
+                }
+            }
+
             inline std::size_t get_work_queue_size() noexcept {
                 const std::size_t n = osmium::config::get_max_queue_size("WORK", 10);
                 return n > 2 ? n : 2;
             }
 
+            /**
+             * Wrapper for tasks submitted with Pool::submit_detached().
+             * There is nobody to report exceptions to, so they are
+             * ignored.
+             */
+            template <typename TFunction>
+            class detached_task {
+
+                TFunction m_function;
+
+            public:
+
+                explicit detached_task(TFunction&& function) :
+                    m_function(std::move(function)) {
+                }
+
+                void operator()() noexcept {
+                    try {
+                        m_function();
+                    } catch (...) {
+                        // Ignore any exceptions.
+                    }
+                }
+
+            }; // class detached_task
+
         } // namespace detail
 
         /**
-         *  Thread pool.
+         * Thread pool.
+         *
+         * Each worker thread has its own deque of tasks. Tasks submitted
+         * from a worker thread (for instance a task creating more tasks)
+         * go into the deque of that worker, it takes them from the back
+         * (last in, first out), which keeps data in the cache. Tasks
+         * submitted from other threads go into a shared work queue with
+         * a maximum size, so that producers can't run too far ahead of
+         * the workers. Workers without tasks in their own deque take
+         * tasks from the shared queue, or steal them from the front of
+         * the deques of other workers. Idle workers sleep until a new
+         * task is submitted.
+         *
+         * Tasks waiting for the results of other tasks in the same pool
+         * must do that with wait(), which runs queued tasks while
+         * waiting. Otherwise the pool deadlocks if all workers wait.
          */
         class Pool {
 
@@ -118,16 +175,128 @@ namespace osmium {
 
             }; // class thread_joiner
 
-            osmium::thread::Queue<function_wrapper> m_work_queue;
+            // The deque of tasks of one worker thread.
+            struct worker_queue {
+                std::mutex mutex;
+                std::deque<function_wrapper> tasks;
+            };
+
+            // Identifies the pool and the index of the worker thread the
+            // current thread belongs to, if any.
+            struct worker_id {
+                const Pool* pool;
+                std::size_t index;
+            };
+
+            static worker_id& current_worker() noexcept {
+                static thread_local worker_id id{nullptr, 0};
+                return id;
+            }
+
+            osmium::thread::pipeline_queue<function_wrapper> m_work_queue;
+            std::vector<std::unique_ptr<worker_queue>> m_worker_queues{};
+
+            // Number of tasks in all queues that haven't been taken by a
+            // worker yet.
+            std::atomic<std::size_t> m_pending_tasks{0};
+
+            // Idle workers wait on this condition variable.
+            std::atomic<int> m_idle_workers{0};
+            std::mutex m_idle_mutex{};
+            std::condition_variable m_work_available{};
+
             std::vector<std::thread> m_threads{};
             thread_joiner m_joiner;
             int m_num_threads;
 
-            void worker_thread() {
+            // CPUs the workers run on (empty if not restricted) and their
+            // nice value.
+            std::vector<int> m_cpus;
+            int m_nice;
+
+            bool pop_own_task(std::size_t index, function_wrapper& task) {
+                worker_queue& queue = *m_worker_queues[index];
+                std::lock_guard<std::mutex> lock{queue.mutex};
+                if (queue.tasks.empty()) {
+                    return false;
+                }
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                return true;
+            }
+
+            bool steal_task(std::size_t index, function_wrapper& task) {
+                const std::size_t size = m_worker_queues.size();
+                for (std::size_t n = 1; n < size; ++n) {
+                    worker_queue& queue = *m_worker_queues[(index + n) % size];
+                    std::lock_guard<std::mutex> lock{queue.mutex};
+                    if (!queue.tasks.empty()) {
+                        task = std::move(queue.tasks.front());
+                        queue.tasks.pop_front();
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool find_task(std::size_t index, function_wrapper& task) {
+                if (pop_own_task(index, task) ||
+                    m_work_queue.try_pop(task) ||
+                    steal_task(index, task)) {
+                    --m_pending_tasks;
+                    return true;
+                }
+                return false;
+            }
+
+            void wait_for_work() {
+                std::unique_lock<std::mutex> lock{m_idle_mutex};
+                ++m_idle_workers;
+                m_work_available.wait(lock, [this] {
+                    return m_pending_tasks > 0;
+                });
+                --m_idle_workers;
+            }
+
+            // Must be called after new tasks have been added to a queue.
+            // The counters are sequentially consistent atomics, so either
+            // an idle worker sees the new tasks before going to sleep or
+            // we see the idle worker here.
+            void tasks_added(std::size_t count) {
+                m_pending_tasks += count;
+                if (m_idle_workers > 0) {
+                    std::lock_guard<std::mutex> lock{m_idle_mutex};
+                    if (count == 1) {
+                        m_work_available.notify_one();
+                    } else {
+                        m_work_available.notify_all();
+                    }
+                }
+            }
+
+            void add_task(function_wrapper&& task) {
+                const worker_id& worker = current_worker();
+                if (worker.pool == this) {
+                    worker_queue& queue = *m_worker_queues[worker.index];
+                    std::lock_guard<std::mutex> lock{queue.mutex};
+                    queue.tasks.push_back(std::move(task));
+                } else {
+                    m_work_queue.push(std::move(task));
+                }
+                tasks_added(1);
+            }
+
+            void worker_thread(std::size_t index) {
                 osmium::thread::set_thread_name("_osmium_worker");
+                osmium::thread::set_thread_affinity(m_cpus);
+                osmium::thread::set_thread_nice(m_nice);
+                current_worker() = worker_id{this, index};
                 while (true) {
                     function_wrapper task;
-                    m_work_queue.wait_and_pop(task);
+                    if (!find_task(index, task)) {
+                        wait_for_work();
+                        continue;
+                    }
                     if (task && task()) {
                         // The called tasks returns true only when the
                         // worker thread should shut down.
@@ -155,15 +324,38 @@ namespace osmium {
              *
              * If max_queue_size is 0, the queue size is read from
              * the environment variable OSMIUM_MAX_WORK_QUEUE_SIZE.
+             *
+             * If cpus is empty, the CPU setting is read from the
+             * environment variable OSMIUM_POOL_CPUS (see
+             * resolve_cpu_setting() for the format). If the resulting
+             * list is not empty, all worker threads are restricted to
+             * run on those CPUs. Use "local" to keep them on the NUMA
+             * node of the thread creating the pool, so that the memory
+             * they allocate (like the buffers decoded from PBF files)
+             * is on the same node as the thread consuming it. Invalid
+             * settings in the environment variable are ignored.
+             *
+             * If nice is 0, the nice value of the worker threads is read
+             * from the environment variable OSMIUM_POOL_NICE. Only works
+             * on Linux.
              */
-            explicit Pool(int num_threads = default_num_threads, std::size_t max_queue_size = default_queue_size) :
+            explicit Pool(int num_threads = default_num_threads,
+                          std::size_t max_queue_size = default_queue_size,
+                          const std::vector<int>& cpus = std::vector<int>{},
+                          int nice = 0) :
                 m_work_queue(max_queue_size > 0 ? max_queue_size : detail::get_work_queue_size(), "work"),
                 m_joiner(m_threads),
-                m_num_threads(detail::get_pool_size(num_threads, osmium::config::get_pool_threads(), std::thread::hardware_concurrency())) {
+                m_num_threads(detail::get_pool_size(num_threads, osmium::config::get_pool_threads(), std::thread::hardware_concurrency())),
+                m_cpus(cpus.empty() ? detail::get_pool_cpus() : cpus),
+                m_nice(nice != 0 ? nice : osmium::config::get_pool_nice()) {
+
+                for (int i = 0; i < m_num_threads; ++i) {
+                    m_worker_queues.emplace_back(new worker_queue{});
+                }
 
                 try {
                     for (int i = 0; i < m_num_threads; ++i) {
-                        m_threads.emplace_back(&Pool::worker_thread, this);
+                        m_threads.emplace_back(&Pool::worker_thread, this, static_cast<std::size_t>(i));
                     }
                 } catch (...) {
                     shutdown_all_workers();
@@ -180,6 +372,7 @@ namespace osmium {
                 for (int i = 0; i < m_num_threads; ++i) {
                     // The special function wrapper makes a worker shut down.
                     m_work_queue.push(function_wrapper{0});
+                    tasks_added(1);
                 }
             }
 
@@ -197,25 +390,131 @@ namespace osmium {
                 return m_num_threads;
             }
 
-            std::size_t queue_size() const {
-                return m_work_queue.size();
+            /**
+             * The CPUs the worker threads are restricted to. Empty if
+             * they are not restricted.
+             */
+            const std::vector<int>& cpus() const noexcept {
+                return m_cpus;
+            }
+
+            /**
+             * The number of tasks waiting to be run.
+             */
+            std::size_t queue_size() const noexcept {
+                return m_pending_tasks;
             }
 
-            bool queue_empty() const {
-                return m_work_queue.empty();
+            bool queue_empty() const noexcept {
+                return m_pending_tasks == 0;
             }
 
+            /**
+             * Submit a function to be run in the pool.
+             *
+             * A task running in this pool that waits for the returned
+             * future must use wait(), not the wait() or get() functions
+             * of the future, otherwise the pool can deadlock.
+             *
+             * @returns A future for the result of the function or the
+             *          exception thrown by it.
+             */
             template <typename TFunction>
             std::future<typename std::result_of<TFunction()>::type> submit(TFunction&& func) {
                 using result_type = typename std::result_of<TFunction()>::type;
 
                 std::packaged_task<result_type()> task{std::forward<TFunction>(func)};
                 std::future<result_type> future_result{task.get_future()};
-                m_work_queue.push(std::move(task));
+                add_task(std::move(task));
 
                 return future_result;
             }
 
+            /**
+             * Submit a function to be run in the pool without creating a
+             * future for it. This avoids the allocation of the shared
+             * state of the future. Use it if you don't need the result
+             * or know when the function has finished in some other way.
+             * Exceptions thrown by the function are ignored, so it
+             * should handle them itself.
+             */
+            template <typename TFunction>
+            void submit_detached(TFunction&& func) {
+                using function_type = typename std::decay<TFunction>::type;
+                add_task(detail::detached_task<function_type>{function_type(std::forward<TFunction>(func))});
+            }
+
+            /**
+             * Submit all functions in the range [first, last) to be run
+             * in the pool without creating futures for them. The
+             * functions are moved out of the range. See the other
+             * version of submit_detached() for details.
+             *
+             * If this is called from a worker thread of this pool, all
+             * functions are added to its deque in one go and the other
+             * workers can steal them from there.
+             */
+            template <typename TIterator>
+            void submit_detached(TIterator first, TIterator last) {
+                using function_type = typename std::decay<decltype(*first)>::type;
+                const worker_id& worker = current_worker();
+                if (worker.pool != this) {
+                    for (; first != last; ++first) {
+                        submit_detached(std::move(*first));
+                    }
+                    return;
+                }
+
+                std::size_t count = 0;
+                {
+                    worker_queue& queue = *m_worker_queues[worker.index];
+                    std::lock_guard<std::mutex> lock{queue.mutex};
+                    for (; first != last; ++first) {
+                        queue.tasks.emplace_back(detail::detached_task<function_type>{std::move(*first)});
+                        ++count;
+                    }
+                }
+                if (count > 0) {
+                    tasks_added(count);
+                }
+            }
+
+            /**
+             * Wait until the future is ready. If this is called from a
+             * worker thread of this pool, the worker runs other tasks from
+             * the pool (its own ones first, then ones from the shared
+             * queue and ones stolen from other workers) until the future
+             * is ready, so tasks can wait for tasks they have submitted
+             * even in a pool with only one thread. From other threads
+             * this is the same as future.wait().
+             *
+             * @tparam TFuture std::future or std::shared_future
+             */
+            template <typename TFuture>
+            void wait(const TFuture& future) {
+                const worker_id& worker = current_worker();
+                if (worker.pool != this) {
+                    future.wait();
+                    return;
+                }
+
+                while (future.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                    function_wrapper task;
+                    if (!find_task(worker.index, task)) {
+                        // The tasks we are waiting for are running in
+                        // other workers, but they might submit more.
+                        future.wait_for(std::chrono::milliseconds{1});
+                        continue;
+                    }
+                    if (task && task()) {
+                        // This was the shutdown marker meant for a worker
+                        // not busy waiting, put it back for that one.
+                        m_work_queue.push(function_wrapper{0});
+                        tasks_added(1);
+                    }
+                }
+            }
+
         }; // class Pool
 
     } // namespace thread
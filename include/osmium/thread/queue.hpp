@@ -33,16 +33,17 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <utility> // IWYU pragma: keep
 
 #ifdef OSMIUM_DEBUG_QUEUE_SIZE
-# include <atomic>
 # include <iostream>
 #endif
 
@@ -50,6 +51,146 @@ namespace osmium {
 
     namespace thread {
 
+        /**
+         * Statistics about the use of a queue. Returned by the stats()
+         * function of the queues.
+         */
+        struct queue_stats {
+
+            /// The number of elements pushed onto the queue.
+            uint64_t pushes = 0;
+
+            /// The number of times the queue was full and a thread pushing
+            /// to the queue was blocked.
+            uint64_t full = 0;
+
+            /// The number of elements popped from the queue.
+            uint64_t pops = 0;
+
+            /// The number of times the queue was empty and a thread popping
+            /// from the queue was blocked.
+            uint64_t empty = 0;
+
+            /// The largest size the queue has been so far. The MPMCQueue
+            /// only samples the size, so this can be smaller than the real
+            /// value unless the queue was full at some point.
+            std::size_t largest_size = 0;
+
+            /// Time threads were blocked pushing to the full queue.
+            std::chrono::nanoseconds push_wait{0};
+
+            /// Time threads were blocked popping from the empty queue.
+            std::chrono::nanoseconds pop_wait{0};
+
+        }; // struct queue_stats
+
+        namespace detail {
+
+            /**
+             * The counters behind queue_stats. They are updated with
+             * relaxed atomic operations, so they can be read from any
+             * thread at any time. The counters changed by producers and
+             * consumers are on different cache lines. Only successful
+             * operations are counted, failed try_push() or try_pop() calls
+             * don't touch the counters. The clock is only read when a
+             * thread actually blocks.
+             */
+            class queue_counters {
+
+            public:
+
+                using clock = std::chrono::steady_clock;
+
+            private:
+
+                static constexpr const std::size_t cache_line_size = 64;
+
+                struct side_counters {
+                    std::atomic<uint64_t> count{0};
+                    std::atomic<uint64_t> waits{0};
+                    std::atomic<int64_t> wait_time{0};
+                    char padding[cache_line_size];
+                };
+
+                char m_padding[cache_line_size];
+                std::atomic<std::size_t> m_largest_size{0};
+                side_counters m_push{};
+                side_counters m_pop{};
+
+                static clock::time_point start_wait(side_counters& counters) noexcept {
+                    counters.waits.fetch_add(1, std::memory_order_relaxed);
+                    return clock::now();
+                }
+
+                static void end_wait(side_counters& counters, clock::time_point start) noexcept {
+                    const auto duration = clock::now() - start;
+                    counters.wait_time.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), std::memory_order_relaxed);
+                }
+
+            public:
+
+                void add_push() noexcept {
+                    m_push.count.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                void add_pop() noexcept {
+                    m_pop.count.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                /// Call when a push has to wait, returns the start time.
+                clock::time_point start_push_wait() noexcept {
+                    return start_wait(m_push);
+                }
+
+                void end_push_wait(clock::time_point start) noexcept {
+                    end_wait(m_push, start);
+                }
+
+                /// Call when a pop has to wait, returns the start time.
+                clock::time_point start_pop_wait() noexcept {
+                    return start_wait(m_pop);
+                }
+
+                void end_pop_wait(clock::time_point start) noexcept {
+                    end_wait(m_pop, start);
+                }
+
+                void update_largest_size(std::size_t size) noexcept {
+                    std::size_t largest = m_largest_size.load(std::memory_order_relaxed);
+                    while (largest < size &&
+                           !m_largest_size.compare_exchange_weak(largest, size, std::memory_order_relaxed)) {
+                    }
+                }
+
+                queue_stats get() const noexcept {
+                    queue_stats stats;
+                    stats.pushes = m_push.count.load(std::memory_order_relaxed);
+                    stats.full = m_push.waits.load(std::memory_order_relaxed);
+                    stats.pops = m_pop.count.load(std::memory_order_relaxed);
+                    stats.empty = m_pop.waits.load(std::memory_order_relaxed);
+                    stats.largest_size = m_largest_size.load(std::memory_order_relaxed);
+                    stats.push_wait = std::chrono::nanoseconds{m_push.wait_time.load(std::memory_order_relaxed)};
+                    stats.pop_wait = std::chrono::nanoseconds{m_pop.wait_time.load(std::memory_order_relaxed)};
+                    return stats;
+                }
+
+            }; // class queue_counters
+
+#ifdef OSMIUM_DEBUG_QUEUE_SIZE
+            inline void print_queue_stats(const std::string& name, std::size_t max_size, const queue_stats& stats) {
+                std::cerr << "queue '" << name
+                          << "' with max_size=" << max_size
+                          << " had largest size " << stats.largest_size
+                          << " and was full " << stats.full
+                          << " times in " << stats.pushes
+                          << " push() calls and was empty " << stats.empty
+                          << " times in " << stats.pops
+                          << " pop() calls\n";
+            }
+#endif
+
+        } // namespace detail
+
         /**
          *  A thread-safe queue.
          */
@@ -73,27 +214,7 @@ namespace osmium {
             /// Used to signal producers when queue is not full.
             std::condition_variable m_space_available;
 
-#ifdef OSMIUM_DEBUG_QUEUE_SIZE
-            /// The largest size the queue has been so far.
-            std::size_t m_largest_size;
-
-            /// The number of times push() was called on the queue.
-            std::atomic<int> m_push_counter;
-
-            /// The number of times the queue was full and a thread pushing
-            /// to the queue was blocked.
-            std::atomic<int> m_full_counter;
-
-            /**
-             * The number of times wait_and_pop(with_timeout)() was called
-             * on the queue.
-             */
-            std::atomic<int> m_pop_counter;
-
-            /// The number of times the queue was full and a thread pushing
-            /// to the queue was blocked.
-            std::atomic<int> m_empty_counter;
-#endif
+            detail::queue_counters m_counters;
 
         public:
 
@@ -107,16 +228,7 @@ namespace osmium {
             explicit Queue(std::size_t max_size = 0, std::string name = "") :
                 m_max_size(max_size),
                 m_name(std::move(name)),
-                m_queue()
-#ifdef OSMIUM_DEBUG_QUEUE_SIZE
-                ,
-                m_largest_size(0),
-                m_push_counter(0),
-                m_full_counter(0),
-                m_pop_counter(0),
-                m_empty_counter(0)
-#endif
-            {
+                m_queue() {
             }
 
             Queue(const Queue&) = delete;
@@ -127,14 +239,7 @@ namespace osmium {
 
 #ifdef OSMIUM_DEBUG_QUEUE_SIZE
             ~Queue() {
-                std::cerr << "queue '" << m_name
-                          << "' with max_size=" << m_max_size
-                          << " had largest size " << m_largest_size
-                          << " and was full " << m_full_counter
-                          << " times in " << m_push_counter
-                          << " push() calls and was empty " << m_empty_counter
-                          << " times in " << m_pop_counter
-                          << " pop() calls\n";
+                detail::print_queue_stats(m_name, m_max_size, stats());
             }
 #else
             ~Queue() = default;
@@ -145,68 +250,48 @@ namespace osmium {
              * this call will block if the queue is full.
              */
             void push(T value) {
-                constexpr const std::chrono::milliseconds max_wait{10};
-#ifdef OSMIUM_DEBUG_QUEUE_SIZE
-                ++m_push_counter;
-#endif
-                if (m_max_size) {
-                    while (size() >= m_max_size) {
-                        std::unique_lock<std::mutex> lock{m_mutex};
-                        m_space_available.wait_for(lock, max_wait, [this] {
-                            return m_queue.size() < m_max_size;
-                        });
-#ifdef OSMIUM_DEBUG_QUEUE_SIZE
-                        ++m_full_counter;
-#endif
-                    }
+                std::unique_lock<std::mutex> lock{m_mutex};
+                if (m_max_size && m_queue.size() >= m_max_size) {
+                    const auto start = m_counters.start_push_wait();
+                    m_space_available.wait(lock, [this] {
+                        return m_queue.size() < m_max_size;
+                    });
+                    m_counters.end_push_wait(start);
                 }
-                std::lock_guard<std::mutex> lock{m_mutex};
                 m_queue.push(std::move(value));
-#ifdef OSMIUM_DEBUG_QUEUE_SIZE
-                if (m_largest_size < m_queue.size()) {
-                    m_largest_size = m_queue.size();
-                }
-#endif
+                m_counters.add_push();
+                m_counters.update_largest_size(m_queue.size());
+                lock.unlock();
                 m_data_available.notify_one();
             }
 
             void wait_and_pop(T& value) {
-#ifdef OSMIUM_DEBUG_QUEUE_SIZE
-                ++m_pop_counter;
-#endif
                 std::unique_lock<std::mutex> lock{m_mutex};
-#ifdef OSMIUM_DEBUG_QUEUE_SIZE
                 if (m_queue.empty()) {
-                    ++m_empty_counter;
+                    const auto start = m_counters.start_pop_wait();
+                    m_data_available.wait(lock, [this] {
+                        return !m_queue.empty();
+                    });
+                    m_counters.end_pop_wait(start);
                 }
-#endif
-                m_data_available.wait(lock, [this] {
-                    return !m_queue.empty();
-                });
-                if (!m_queue.empty()) {
-                    value = std::move(m_queue.front());
-                    m_queue.pop();
-                    lock.unlock();
-                    if (m_max_size) {
-                        m_space_available.notify_one();
-                    }
+                value = std::move(m_queue.front());
+                m_queue.pop();
+                m_counters.add_pop();
+                lock.unlock();
+                if (m_max_size) {
+                    m_space_available.notify_one();
                 }
             }
 
             bool try_pop(T& value) {
-#ifdef OSMIUM_DEBUG_QUEUE_SIZE
-                ++m_pop_counter;
-#endif
                 {
                     std::lock_guard<std::mutex> lock{m_mutex};
                     if (m_queue.empty()) {
-#ifdef OSMIUM_DEBUG_QUEUE_SIZE
-                        ++m_empty_counter;
-#endif
                         return false;
                     }
                     value = std::move(m_queue.front());
                     m_queue.pop();
+                    m_counters.add_pop();
                 }
                 if (m_max_size) {
                     m_space_available.notify_one();
@@ -224,6 +309,14 @@ namespace osmium {
                 return m_queue.size();
             }
 
+            /**
+             * Statistics about the use of this queue so far. Can be called
+             * from any thread while the queue is in use.
+             */
+            queue_stats stats() const noexcept {
+                return m_counters.get();
+            }
+
         }; // class Queue
 
     } // namespace thread
@@ -93,6 +93,50 @@ namespace osmium {
             return default_value;
         }
 
+        /**
+         * Get the CPU setting for a group of threads from the environment
+         * variable OSMIUM_{group}_CPUS. Returns an empty string if the
+         * variable is not set. See osmium::thread::resolve_cpu_setting()
+         * for the format.
+         */
+        inline std::string get_cpus(const char* group) {
+            assert(group);
+            std::string name{"OSMIUM_"};
+            name += group;
+            name += "_CPUS";
+            auto env = osmium::detail::getenv_wrapper(name.c_str());
+            if (env) {
+                return env;
+            }
+            return "";
+        }
+
+        /**
+         * Get the nice value for the pool threads from the environment
+         * variable OSMIUM_POOL_NICE. Returns 0 if it is not set.
+         */
+        inline int get_pool_nice() noexcept {
+            auto env = osmium::detail::getenv_wrapper("OSMIUM_POOL_NICE");
+            if (env) {
+                return osmium::detail::str_to_int<int>(env);
+            }
+            return 0;
+        }
+
+        /**
+         * Get the memory budget for the data in the queues of the Reader
+         * and Writer from the environment variable OSMIUM_MEMORY_BUDGET_MB
+         * (in megabytes). Returns the budget in bytes or 0 if it is not
+         * set (which means no limit).
+         */
+        inline std::size_t get_memory_budget() noexcept {
+            auto env = osmium::detail::getenv_wrapper("OSMIUM_MEMORY_BUDGET_MB");
+            if (env) {
+                return osmium::detail::str_to_int<std::size_t>(env) * 1024 * 1024;
+            }
+            return 0;
+        }
+
     } // namespace config
 
 } // namespace osmium
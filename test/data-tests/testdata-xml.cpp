@@ -82,6 +82,9 @@ static header_buffer_type parse_xml(std::string input) {
     osmium::io::detail::future_buffer_queue_type output_queue;
     std::promise<osmium::io::Header> header_promise;
     std::future<osmium::io::Header> header_future = header_promise.get_future();
+    osmium::io::detail::read_filter filter;
+    osmium::io::detail::mapped_input input_mapping;
+    osmium::io::detail::reader_counters counters;
 
     osmium::io::detail::add_to_queue(input_queue, std::move(input));
     osmium::io::detail::add_to_queue(input_queue, std::string{});
@@ -92,7 +95,12 @@ static header_buffer_type parse_xml(std::string input) {
         output_queue,
         header_promise,
         osmium::osm_entity_bits::all,
-        osmium::io::read_meta::yes
+        osmium::io::read_meta::yes,
+        filter,
+        input_mapping,
+        nullptr,
+        osmium::io::ordered::yes,
+        counters
     };
     osmium::io::detail::XMLParser parser{args};
     parser.parse();
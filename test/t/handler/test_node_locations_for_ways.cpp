@@ -0,0 +1,135 @@
+#include "catch.hpp"
+
+#include <osmium/handler/node_locations_for_ways.hpp>
+#include <osmium/index/map/dense_mem_array.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/opl.hpp>
+#include <osmium/osm/node_location_batch.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/visitor.hpp>
+
+#include <stdexcept>
+
+using sparse_index_type = osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location>;
+using dense_index_type = osmium::index::map::DenseMemArray<osmium::unsigned_object_id_type, osmium::Location>;
+
+static const osmium::Way& way_by_id(const osmium::memory::Buffer& buffer, osmium::object_id_type id) {
+    for (const auto& way : buffer.select<osmium::Way>()) {
+        if (way.id() == id) {
+            return way;
+        }
+    }
+    throw std::runtime_error{"way not found"};
+}
+
+TEST_CASE("NodeLocationsForWays adds locations to ways") {
+    osmium::memory::Buffer buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+
+    REQUIRE(osmium::opl_parse("n-2 x5 y6", buffer));
+    REQUIRE(osmium::opl_parse("n1 x1 y2", buffer));
+    REQUIRE(osmium::opl_parse("n3 x3 y4", buffer));
+    REQUIRE(osmium::opl_parse("n4 x7 y8", buffer));
+    REQUIRE(osmium::opl_parse("w1 Nn1,n3,n4,n1", buffer));
+    REQUIRE(osmium::opl_parse("w2 Nn3,n-2,n4", buffer));
+
+    sparse_index_type index_pos;
+    dense_index_type index_neg;
+    osmium::handler::NodeLocationsForWays<sparse_index_type, dense_index_type> handler{index_pos, index_neg};
+    osmium::apply(buffer, handler);
+
+    const auto& way1 = way_by_id(buffer, 1);
+    REQUIRE(way1.nodes()[0].location() == osmium::Location(1.0, 2.0));
+    REQUIRE(way1.nodes()[1].location() == osmium::Location(3.0, 4.0));
+    REQUIRE(way1.nodes()[2].location() == osmium::Location(7.0, 8.0));
+    REQUIRE(way1.nodes()[3].location() == osmium::Location(1.0, 2.0));
+
+    const auto& way2 = way_by_id(buffer, 2);
+    REQUIRE(way2.nodes()[0].location() == osmium::Location(3.0, 4.0));
+    REQUIRE(way2.nodes()[1].location() == osmium::Location(5.0, 6.0));
+    REQUIRE(way2.nodes()[2].location() == osmium::Location(7.0, 8.0));
+}
+
+TEST_CASE("NodeLocationsForWays with missing locations") {
+    osmium::memory::Buffer buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+
+    REQUIRE(osmium::opl_parse("n1 x1 y2", buffer));
+    REQUIRE(osmium::opl_parse("w1 Nn1,n2", buffer));
+
+    sparse_index_type index;
+    osmium::handler::NodeLocationsForWays<sparse_index_type> handler{index};
+
+    SECTION("throws by default") {
+        REQUIRE_THROWS_AS(osmium::apply(buffer, handler), const osmium::not_found&);
+    }
+
+    SECTION("leaves locations undefined when errors are ignored") {
+        handler.ignore_errors();
+        osmium::apply(buffer, handler);
+
+        const auto& way = way_by_id(buffer, 1);
+        REQUIRE(way.nodes()[0].location() == osmium::Location(1.0, 2.0));
+        REQUIRE_FALSE(way.nodes()[1].location());
+    }
+}
+
+TEST_CASE("NodeLocationsForWays adds locations to all ways in a buffer") {
+    osmium::memory::Buffer nodes{1024, osmium::memory::Buffer::auto_grow::yes};
+    REQUIRE(osmium::opl_parse("n-2 x5 y6", nodes));
+    REQUIRE(osmium::opl_parse("n3 x3 y4", nodes));
+    REQUIRE(osmium::opl_parse("n1 x1 y2", nodes));
+
+    osmium::memory::Buffer ways{1024, osmium::memory::Buffer::auto_grow::yes};
+    REQUIRE(osmium::opl_parse("w1 Nn1,n3", ways));
+    REQUIRE(osmium::opl_parse("n4 x7 y8", ways));
+    REQUIRE(osmium::opl_parse("w2 Nn3,n-2,n5", ways));
+
+    sparse_index_type index_pos;
+    dense_index_type index_neg;
+    osmium::handler::NodeLocationsForWays<sparse_index_type, dense_index_type> handler{index_pos, index_neg};
+    osmium::apply(nodes, handler);
+    handler.prepare_for_lookup();
+
+    SECTION("throws on missing location") {
+        REQUIRE_THROWS_AS(handler.add_locations_to_ways(ways), const osmium::not_found&);
+    }
+
+    SECTION("leaves locations undefined when errors are ignored") {
+        handler.ignore_errors();
+        handler.add_locations_to_ways(ways);
+    }
+
+    const auto& way1 = way_by_id(ways, 1);
+    REQUIRE(way1.nodes()[0].location() == osmium::Location(1.0, 2.0));
+    REQUIRE(way1.nodes()[1].location() == osmium::Location(3.0, 4.0));
+
+    const auto& way2 = way_by_id(ways, 2);
+    REQUIRE(way2.nodes()[0].location() == osmium::Location(3.0, 4.0));
+    REQUIRE(way2.nodes()[1].location() == osmium::Location(5.0, 6.0));
+    REQUIRE_FALSE(way2.nodes()[2].location());
+
+    // nodes in the buffer are not stored
+    REQUIRE_FALSE(handler.get_node_location(4));
+}
+
+TEST_CASE("NodeLocationsForWays stores node location batches") {
+    osmium::NodeLocationBatch batch;
+    batch.add(1, osmium::Location{1.0, 2.0});
+    batch.add(3, osmium::Location{3.0, 4.0});
+    batch.add(-2, osmium::Location{5.0, 6.0});
+    batch.add(-5, osmium::Location{9.0, 9.0});
+    batch.add(2, osmium::Location{7.0, 8.0});
+
+    sparse_index_type index_pos;
+    dense_index_type index_neg;
+    osmium::handler::NodeLocationsForWays<sparse_index_type, dense_index_type> handler{index_pos, index_neg};
+    handler.node_locations(batch);
+    handler.prepare_for_lookup();
+
+    REQUIRE(index_pos.size() == 3);
+    REQUIRE(handler.get_node_location(1) == osmium::Location(1.0, 2.0));
+    REQUIRE(handler.get_node_location(2) == osmium::Location(7.0, 8.0));
+    REQUIRE(handler.get_node_location(3) == osmium::Location(3.0, 4.0));
+    REQUIRE(handler.get_node_location(-2) == osmium::Location(5.0, 6.0));
+    REQUIRE(handler.get_node_location(-5) == osmium::Location(9.0, 9.0));
+}
@@ -0,0 +1,133 @@
+#include "catch.hpp"
+
+#include <osmium/builder/attr.hpp>
+#include <osmium/handler/node_locations_for_ways.hpp>
+#include <osmium/handler/parallel_node_locations_for_ways.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+
+using index_type = osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location>;
+using location_handler_type = osmium::handler::NodeLocationsForWays<index_type>;
+
+namespace {
+
+    class BufferSource {
+
+        std::deque<osmium::memory::Buffer> m_buffers;
+
+    public:
+
+        explicit BufferSource(int num_buffers, int ways_per_buffer, int max_node_id) {
+            int id = 1;
+            for (int b = 0; b < num_buffers; ++b) {
+                osmium::memory::Buffer buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+                for (int w = 0; w < ways_per_buffer; ++w, ++id) {
+                    osmium::builder::add_way(buffer,
+                        osmium::builder::attr::_id(id),
+                        osmium::builder::attr::_nodes({id % max_node_id + 1, (id * 7) % max_node_id + 1, id % max_node_id + 2})
+                    );
+                }
+                m_buffers.push_back(std::move(buffer));
+            }
+        }
+
+        osmium::memory::Buffer read() {
+            if (m_buffers.empty()) {
+                return osmium::memory::Buffer{};
+            }
+            osmium::memory::Buffer buffer{std::move(m_buffers.front())};
+            m_buffers.pop_front();
+            return buffer;
+        }
+
+    }; // class BufferSource
+
+    osmium::Location location_for(osmium::object_id_type id) {
+        return osmium::Location{static_cast<int32_t>(id * 10), static_cast<int32_t>(id * 20)};
+    }
+
+    void fill_index(location_handler_type& handler, int max_node_id) {
+        osmium::memory::Buffer buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+        // add in reverse order so the index has to be sorted
+        for (int id = max_node_id; id > 0; --id) {
+            osmium::builder::add_node(buffer,
+                osmium::builder::attr::_id(id),
+                osmium::builder::attr::_location(location_for(id))
+            );
+        }
+        for (const auto& node : buffer.select<osmium::Node>()) {
+            handler.node(node);
+        }
+    }
+
+} // anonymous namespace
+
+TEST_CASE("Add locations to ways in parallel keeping buffer order") {
+    osmium::thread::Pool pool{4};
+    index_type index;
+    location_handler_type handler{index};
+    fill_index(handler, 1001);
+
+    BufferSource source{50, 100, 1000};
+    osmium::handler::ParallelNodeLocationsForWays<BufferSource, location_handler_type> stage{source, handler, pool};
+
+    osmium::object_id_type expected_id = 1;
+    std::size_t buffers = 0;
+    while (osmium::memory::Buffer buffer = stage.read()) {
+        ++buffers;
+        for (const auto& way : buffer.select<osmium::Way>()) {
+            REQUIRE(way.id() == expected_id);
+            ++expected_id;
+            for (const auto& node_ref : way.nodes()) {
+                REQUIRE(node_ref.location() == location_for(node_ref.ref()));
+            }
+        }
+    }
+
+    REQUIRE(buffers == 50);
+    REQUIRE(expected_id == 5001);
+    REQUIRE_FALSE(stage.read());
+}
+
+TEST_CASE("Add locations to ways in parallel with missing locations") {
+    osmium::thread::Pool pool{4};
+    index_type index;
+    location_handler_type handler{index};
+    fill_index(handler, 500);
+
+    BufferSource source{20, 100, 1000};
+
+    SECTION("throws by default") {
+        osmium::handler::ParallelNodeLocationsForWays<BufferSource, location_handler_type> stage{source, handler, pool, 3};
+        REQUIRE_THROWS_AS([&]() {
+            while (stage.read()) {
+            }
+        }(), const osmium::not_found&);
+    }
+
+    SECTION("leaves locations undefined when errors are ignored") {
+        handler.ignore_errors();
+        osmium::handler::ParallelNodeLocationsForWays<BufferSource, location_handler_type> stage{source, handler, pool, 3};
+
+        std::size_t ways = 0;
+        while (osmium::memory::Buffer buffer = stage.read()) {
+            for (const auto& way : buffer.select<osmium::Way>()) {
+                ++ways;
+                for (const auto& node_ref : way.nodes()) {
+                    if (node_ref.ref() <= 500) {
+                        REQUIRE(node_ref.location() == location_for(node_ref.ref()));
+                    } else {
+                        REQUIRE_FALSE(node_ref.location());
+                    }
+                }
+            }
+        }
+        REQUIRE(ways == 2000);
+    }
+}
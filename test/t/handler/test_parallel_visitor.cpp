@@ -0,0 +1,123 @@
+#include "catch.hpp"
+
+#include <osmium/builder/attr.hpp>
+#include <osmium/handler.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/parallel_visitor.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace osmium::builder::attr; // NOLINT(google-build-using-namespace)
+
+class BufferSource {
+
+    std::vector<osmium::memory::Buffer> m_buffers;
+    std::size_t m_next = 0;
+
+public:
+
+    explicit BufferSource(int num_buffers) {
+        int id = 1;
+        for (int i = 0; i < num_buffers; ++i) {
+            m_buffers.emplace_back(1024);
+            for (int j = 0; j < 10; ++j) {
+                osmium::builder::add_node(m_buffers.back(), _id(id++));
+            }
+            osmium::builder::add_way(m_buffers.back(), _id(i + 1));
+        }
+    }
+
+    osmium::memory::Buffer read() {
+        if (m_next < m_buffers.size()) {
+            return std::move(m_buffers[m_next++]);
+        }
+        return osmium::memory::Buffer{};
+    }
+
+}; // class BufferSource
+
+struct SumHandler : public osmium::handler::Handler {
+
+    uint64_t nodes = 0;
+    uint64_t ways = 0;
+    int64_t id_sum = 0;
+
+    void node(const osmium::Node& node) {
+        ++nodes;
+        id_sum += node.id();
+    }
+
+    void way(const osmium::Way& /*way*/) {
+        ++ways;
+    }
+
+}; // struct SumHandler
+
+TEST_CASE("apply_parallel with several handlers") {
+    osmium::thread::Pool pool{4};
+    BufferSource source{100};
+
+    int handlers = 0;
+    SumHandler result;
+    osmium::apply_parallel(source,
+        []() { return SumHandler{}; },
+        [&](const SumHandler& handler) {
+            ++handlers;
+            result.nodes += handler.nodes;
+            result.ways += handler.ways;
+            result.id_sum += handler.id_sum;
+        },
+        pool);
+
+    REQUIRE(handlers == 4);
+    REQUIRE(result.nodes == 1000);
+    REQUIRE(result.ways == 100);
+    REQUIRE(result.id_sum == 1000 * 1001 / 2);
+}
+
+TEST_CASE("apply_parallel with given number of handlers") {
+    osmium::thread::Pool pool{2};
+    BufferSource source{10};
+
+    int handlers = 0;
+    uint64_t nodes = 0;
+    osmium::apply_parallel(source,
+        []() { return SumHandler{}; },
+        [&](const SumHandler& handler) {
+            ++handlers;
+            nodes += handler.nodes;
+        },
+        pool, 7);
+
+    REQUIRE(handlers == 7);
+    REQUIRE(nodes == 100);
+}
+
+struct ThrowingHandler : public osmium::handler::Handler {
+
+    void way(const osmium::Way& /*way*/) {
+        throw std::runtime_error{"way"};
+    }
+
+}; // struct ThrowingHandler
+
+TEST_CASE("apply_parallel with handler throwing exception") {
+    osmium::thread::Pool pool{2};
+    BufferSource source{10};
+
+    bool reduced = false;
+    REQUIRE_THROWS_AS(osmium::apply_parallel(source,
+        []() { return ThrowingHandler{}; },
+        [&](const ThrowingHandler& /*handler*/) {
+            reduced = true;
+        },
+        pool), const std::runtime_error&);
+
+    REQUIRE_FALSE(reduced);
+}
@@ -5,6 +5,7 @@
 #include <osmium/index/map/dense_mmap_array.hpp>
 #include <osmium/index/map/dummy.hpp>
 #include <osmium/index/map/flex_mem.hpp>
+#include <osmium/index/map/sparse_compressed_array.hpp>
 #include <osmium/index/map/sparse_file_array.hpp>
 #include <osmium/index/map/sparse_mem_array.hpp>
 #include <osmium/index/map/sparse_mem_map.hpp>
@@ -14,6 +15,8 @@
 #include <osmium/osm/location.hpp>
 #include <osmium/osm/types.hpp>
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -75,6 +78,15 @@ void test_func_real(TIndex& index) {
     REQUIRE(index.get_noexcept(5) == osmium::Location{});
     REQUIRE(index.get_noexcept(100) == osmium::Location{});
 
+    const osmium::unsigned_object_id_type ids[] = {id1, 0, id2, 100, id1};
+    osmium::Location locations[5];
+    index.get_many(ids, locations, 5);
+    REQUIRE(locations[0] == loc1);
+    REQUIRE(locations[1] == osmium::Location{});
+    REQUIRE(locations[2] == loc2);
+    REQUIRE(locations[3] == osmium::Location{});
+    REQUIRE(locations[4] == loc1);
+
     index.clear();
 
     REQUIRE_THROWS_AS(index.get(id1), const osmium::not_found&);
@@ -91,6 +103,11 @@ void test_func_real(TIndex& index) {
     REQUIRE(index.get_noexcept(1) == osmium::Location{});
     REQUIRE(index.get_noexcept(5) == osmium::Location{});
     REQUIRE(index.get_noexcept(100) == osmium::Location{});
+
+    index.get_many(ids, locations, 5);
+    for (const auto& location : locations) {
+        REQUIRE(location == osmium::Location{});
+    }
 }
 
 TEST_CASE("Map Id to location: Dummy") {
@@ -183,6 +200,22 @@ TEST_CASE("Map Id to location: SparseMemArray") {
     test_func_real<index_type>(index2);
 }
 
+TEST_CASE("Map Id to location: SparseCompressedArray") {
+    using index_type = osmium::index::map::SparseCompressedArray<osmium::unsigned_object_id_type, osmium::Location>;
+
+    index_type index1;
+
+    REQUIRE(0 == index1.size());
+    REQUIRE(0 == index1.used_memory());
+
+    test_func_all<index_type>(index1);
+
+    REQUIRE(2 == index1.size());
+
+    index_type index2;
+    test_func_real<index_type>(index2);
+}
+
 TEST_CASE("Map Id to location: FlexMem sparse") {
     using index_type = osmium::index::map::FlexMem<osmium::unsigned_object_id_type, osmium::Location>;
 
@@ -258,3 +291,33 @@ TEST_CASE("Map Id to location: Dynamic map choice") {
     }
 }
 
+
+TEST_CASE("Map Id to location: get_many with many ids") {
+    using map_type = osmium::index::map::Map<osmium::unsigned_object_id_type, osmium::Location>;
+    const auto& map_factory = osmium::index::MapFactory<osmium::unsigned_object_id_type, osmium::Location>::instance();
+
+    for (const auto& map_type_name : map_factory.map_types()) {
+        std::unique_ptr<map_type> index = map_factory.create_map(map_type_name);
+        for (osmium::unsigned_object_id_type id = 1; id <= 3000; id += 3) {
+            index->set(id, osmium::Location{static_cast<int32_t>(id), 1});
+        }
+        index->sort();
+
+        std::vector<osmium::unsigned_object_id_type> ids;
+        for (osmium::unsigned_object_id_type n = 0; n < 1000; ++n) {
+            ids.push_back((n * 7919) % 3100);
+        }
+
+        std::vector<osmium::Location> locations(ids.size());
+        index->get_many(ids.data(), locations.data(), ids.size());
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            REQUIRE(locations[i] == index->get_noexcept(ids[i]));
+        }
+
+        // fewer ids than are looked up at the same time
+        index->get_many(ids.data(), locations.data(), 3);
+        for (std::size_t i = 0; i < 3; ++i) {
+            REQUIRE(locations[i] == index->get_noexcept(ids[i]));
+        }
+    }
+}
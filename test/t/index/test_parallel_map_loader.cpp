@@ -0,0 +1,161 @@
+#include "catch.hpp"
+
+#include <osmium/index/map/dense_mem_array.hpp>
+#include <osmium/index/map/dense_mmap_array.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+#include <osmium/index/map/sparse_mem_map.hpp>
+#include <osmium/index/map/sparse_mmap_array.hpp>
+#include <osmium/index/parallel_map_loader.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/node_location_batch.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using id_type = osmium::unsigned_object_id_type;
+using loader_type = osmium::index::ParallelMapLoader<id_type, osmium::Location>;
+
+namespace {
+
+    osmium::Location location_for(id_type id) {
+        return osmium::Location{static_cast<int32_t>(id % 1000), static_cast<int32_t>(id / 1000)};
+    }
+
+    // Ids 1..num_batches*batch_size, odd ids only, batches in shuffled order.
+    template <typename TFunc>
+    void for_each_batch(std::size_t num_batches, std::size_t batch_size, TFunc&& func) {
+        for (std::size_t n = 0; n < num_batches; ++n) {
+            const std::size_t b = (n * 7) % num_batches;
+            std::vector<id_type> ids;
+            std::vector<osmium::Location> locations;
+            for (std::size_t i = 0; i < batch_size; ++i) {
+                const id_type id = (b * batch_size + i) * 2 + 1;
+                ids.push_back(id);
+                locations.push_back(location_for(id));
+            }
+            func(std::move(ids), std::move(locations));
+        }
+    }
+
+    template <typename TIndex>
+    void load_and_check(TIndex& index) {
+        osmium::thread::Pool pool{4};
+        {
+            loader_type loader{index, pool, 3};
+            for_each_batch(100, 1000, [&](std::vector<id_type>&& ids, std::vector<osmium::Location>&& locations) {
+                loader.add(std::move(ids), std::move(locations));
+            });
+            loader.finish_and_sort();
+        }
+
+        for (id_type id = 1; id < 200000; id += 2) {
+            REQUIRE(index.get(id) == location_for(id));
+            REQUIRE_FALSE(index.get_noexcept(id + 1));
+        }
+        REQUIRE_FALSE(index.get_noexcept(200001));
+    }
+
+} // anonymous namespace
+
+TEST_CASE("Parallel map loader with DenseMemArray") {
+    osmium::index::map::DenseMemArray<id_type, osmium::Location> index;
+    load_and_check(index);
+    REQUIRE(index.size() == 200000);
+}
+
+TEST_CASE("Parallel map loader with DenseMmapArray") {
+    osmium::index::map::DenseMmapArray<id_type, osmium::Location> index;
+    load_and_check(index);
+    REQUIRE(index.size() == 200000);
+}
+
+TEST_CASE("Parallel map loader with SparseMemArray") {
+    osmium::index::map::SparseMemArray<id_type, osmium::Location> index;
+    load_and_check(index);
+    REQUIRE(index.size() == 100000);
+}
+
+TEST_CASE("Parallel map loader with SparseMmapArray") {
+    osmium::index::map::SparseMmapArray<id_type, osmium::Location> index;
+    load_and_check(index);
+    REQUIRE(index.size() == 100000);
+}
+
+TEST_CASE("Parallel map loader with map without concurrent writes") {
+    osmium::index::map::SparseMemMap<id_type, osmium::Location> index;
+    load_and_check(index);
+    REQUIRE(index.size() == 100000);
+}
+
+TEST_CASE("Parallel map loader with node location batches") {
+    osmium::thread::Pool pool{4};
+    osmium::index::map::DenseMemArray<id_type, osmium::Location> index;
+    loader_type loader{index, pool};
+
+    osmium::NodeLocationBatch batch;
+    batch.add(5, location_for(5));
+    batch.add(3, location_for(3));
+
+    SECTION("adds locations") {
+        loader.add(std::move(batch));
+        loader.finish();
+        REQUIRE(index.get(3) == location_for(3));
+        REQUIRE(index.get(5) == location_for(5));
+    }
+
+    SECTION("throws on negative ids") {
+        batch.add(-1, location_for(1));
+        REQUIRE_THROWS_AS(loader.add(std::move(batch)), const std::invalid_argument&);
+    }
+}
+
+TEST_CASE("Parallel map loader checks sizes") {
+    osmium::index::map::DenseMemArray<id_type, osmium::Location> index;
+    loader_type loader{index};
+    REQUIRE_THROWS_AS(loader.add(std::vector<id_type>{1, 2}, std::vector<osmium::Location>{osmium::Location{}}), const std::invalid_argument&);
+}
+
+TEST_CASE("Map set_many") {
+    const std::vector<id_type> ids{7, 2, 9};
+    const std::vector<osmium::Location> locations{location_for(7), location_for(2), location_for(9)};
+
+    osmium::index::map::DenseMemArray<id_type, osmium::Location> dense;
+    osmium::index::map::SparseMemArray<id_type, osmium::Location> sparse;
+    osmium::index::map::SparseMemMap<id_type, osmium::Location> map;
+
+    for (osmium::index::map::Map<id_type, osmium::Location>* index : {static_cast<osmium::index::map::Map<id_type, osmium::Location>*>(&dense),
+                                                                      static_cast<osmium::index::map::Map<id_type, osmium::Location>*>(&sparse),
+                                                                      static_cast<osmium::index::map::Map<id_type, osmium::Location>*>(&map)}) {
+        index->set_many(ids.data(), locations.data(), ids.size());
+        index->set_many(ids.data(), locations.data(), 0);
+        index->sort();
+        REQUIRE(index->get(2) == location_for(2));
+        REQUIRE(index->get(7) == location_for(7));
+        REQUIRE(index->get(9) == location_for(9));
+        REQUIRE_FALSE(index->get_noexcept(8));
+    }
+}
+
+TEST_CASE("Sort large sparse map in parallel") {
+    osmium::thread::Pool pool{3};
+    osmium::index::map::SparseMemArray<id_type, osmium::Location> index;
+
+    const id_type num = 3 * 1024 * 1024 / 2 + 17;
+    for (id_type i = 0; i < num; ++i) {
+        const id_type id = (i * 1000003) % num;
+        index.set(id, location_for(id));
+    }
+    index.sort(pool);
+
+    REQUIRE(std::is_sorted(index.cbegin(), index.cend()));
+    REQUIRE(index.size() == num);
+    for (id_type id = 0; id < num; id += 1001) {
+        REQUIRE(index.get(id) == location_for(id));
+    }
+}
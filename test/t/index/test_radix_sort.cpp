@@ -0,0 +1,149 @@
+#include "catch.hpp"
+
+#include <osmium/index/detail/radix_sort.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+using element_type = std::pair<uint64_t, uint32_t>;
+
+namespace {
+
+    std::vector<element_type> create_data(std::size_t size, uint64_t id_factor, uint64_t id_modulo) {
+        std::vector<element_type> data;
+        data.reserve(size);
+        uint64_t n = 1;
+        for (std::size_t i = 0; i < size; ++i) {
+            n = n * 6364136223846793005ULL + 1442695040888963407ULL;
+            data.emplace_back((n >> 16U) % id_modulo * id_factor, static_cast<uint32_t>(n >> 40U));
+        }
+        return data;
+    }
+
+    void check_sort(std::vector<element_type> data, osmium::thread::Pool& pool) {
+        std::vector<element_type> expected{data};
+        std::sort(expected.begin(), expected.end());
+
+        std::vector<element_type> default_pool{data};
+        osmium::index::detail::radix_sort(default_pool.begin(), default_pool.end(), osmium::index::detail::sort_key_first{});
+        REQUIRE(default_pool == expected);
+
+        osmium::index::detail::radix_sort(data.begin(), data.end(), osmium::index::detail::sort_key_first{}, pool);
+        REQUIRE(data == expected);
+    }
+
+} // anonymous namespace
+
+TEST_CASE("Radix sort gives same result as std::sort") {
+    osmium::thread::Pool pool{3};
+
+    SECTION("empty") {
+        check_sort({}, pool);
+    }
+
+    SECTION("small") {
+        check_sort(create_data(1000, 1, 100), pool);
+    }
+
+    SECTION("node ids") {
+        check_sort(create_data(300000, 1, 10000000000ULL), pool);
+    }
+
+    SECTION("many duplicate ids") {
+        check_sort(create_data(300000, 1, 1000), pool);
+    }
+
+    SECTION("all ids the same") {
+        check_sort(create_data(300000, 1, 1), pool);
+    }
+
+    SECTION("ids with low bits all the same") {
+        check_sort(create_data(300000, 1ULL << 20U, 1ULL << 30U), pool);
+    }
+
+    SECTION("full range of ids") {
+        std::vector<element_type> data{create_data(300000, 1, std::numeric_limits<uint64_t>::max())};
+        data.emplace_back(std::numeric_limits<uint64_t>::max(), 1);
+        data.emplace_back(0, 2);
+        check_sort(data, pool);
+    }
+
+    SECTION("buckets larger than max bucket size") {
+        // all but one id end up in the first bucket
+        std::vector<element_type> data{create_data(osmium::index::detail::max_radix_sort_bucket_size + 100000, 1, 10000000000ULL)};
+        data.emplace_back(std::numeric_limits<uint64_t>::max(), 1);
+        check_sort(data, pool);
+    }
+
+    SECTION("already sorted") {
+        std::vector<element_type> data{create_data(300000, 1, 10000000000ULL)};
+        std::sort(data.begin(), data.end());
+        check_sort(data, pool);
+    }
+}
+
+TEST_CASE("Radix sort with key function") {
+    struct entry {
+        uint32_t id;
+        int value;
+
+        entry(uint32_t i, int v) :
+            id(i),
+            value(v) {
+        }
+
+        bool operator<(const entry& other) const noexcept {
+            return id < other.id;
+        }
+    };
+
+    std::vector<entry> data;
+    for (uint32_t i = 0; i < 200000; ++i) {
+        data.emplace_back((i * 7919U) % 100003U, static_cast<int>(i));
+    }
+
+    osmium::thread::Pool pool{2};
+    osmium::index::detail::radix_sort(data.begin(), data.end(), [](const entry& e) {
+        return uint64_t(e.id);
+    }, pool);
+
+    REQUIRE(std::is_sorted(data.cbegin(), data.cend()));
+    REQUIRE(data.front().id == 0);
+    REQUIRE(data.back().id == 100002);
+}
+
+TEST_CASE("Radix sort called from a task in the same pool") {
+    osmium::thread::Pool pool{1};
+    std::vector<element_type> data{create_data(300000, 1, 10000000000ULL)};
+    std::vector<element_type> expected{data};
+    std::sort(expected.begin(), expected.end());
+
+    auto future = pool.submit([&data, &pool]() {
+        osmium::index::detail::radix_sort(data.begin(), data.end(), osmium::index::detail::sort_key_first{}, pool);
+    });
+    future.get();
+
+    REQUIRE(data == expected);
+}
+
+TEST_CASE("Radix sort with signed ids") {
+    std::vector<std::pair<int64_t, uint32_t>> data;
+    for (uint32_t i = 0; i < 200000; ++i) {
+        data.emplace_back(static_cast<int64_t>((i * 7919U) % 100003U) - 50000, i);
+    }
+    data.emplace_back(std::numeric_limits<int64_t>::min(), 0);
+    data.emplace_back(std::numeric_limits<int64_t>::max(), 0);
+
+    std::vector<std::pair<int64_t, uint32_t>> expected{data};
+    std::sort(expected.begin(), expected.end());
+
+    osmium::thread::Pool pool{2};
+    osmium::index::detail::radix_sort(data.begin(), data.end(), osmium::index::detail::sort_key_first{}, pool);
+
+    REQUIRE(data == expected);
+}
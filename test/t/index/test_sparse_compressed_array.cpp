@@ -0,0 +1,117 @@
+#include "catch.hpp"
+
+#include <osmium/index/map/sparse_compressed_array.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using id_type = osmium::unsigned_object_id_type;
+using index_type = osmium::index::map::SparseCompressedArray<id_type, osmium::Location>;
+
+namespace {
+
+    // Mostly dense ids with some gaps and locations close to the previous
+    // one like in an OSM extract.
+    std::vector<std::pair<id_type, osmium::Location>> create_data(std::size_t size) {
+        std::vector<std::pair<id_type, osmium::Location>> data;
+        data.reserve(size);
+        uint64_t n = 1;
+        id_type id = 1000000;
+        int32_t x = 100000000;
+        int32_t y = 500000000;
+        for (std::size_t i = 0; i < size; ++i) {
+            n = n * 6364136223846793005ULL + 1442695040888963407ULL;
+            id += (n >> 60U) == 0 ? (n >> 40U) % 1000 + 1 : 1;
+            x += static_cast<int32_t>((n >> 20U) % 2001) - 1000;
+            y += static_cast<int32_t>((n >> 32U) % 2001) - 1000;
+            data.emplace_back(id, osmium::Location{x, y});
+        }
+        return data;
+    }
+
+    void check_all(const index_type& index, const std::vector<std::pair<id_type, osmium::Location>>& data) {
+        for (const auto& element : data) {
+            REQUIRE(index.get(element.first) == element.second);
+            REQUIRE_FALSE(index.get_noexcept(element.first - 1) == element.second);
+        }
+        REQUIRE_FALSE(index.get_noexcept(0));
+        REQUIRE_FALSE(index.get_noexcept(data.front().first - 1));
+        REQUIRE_FALSE(index.get_noexcept(data.back().first + 1));
+    }
+
+} // anonymous namespace
+
+TEST_CASE("SparseCompressedArray with ids in order") {
+    const auto data = create_data(100000);
+
+    index_type index;
+    for (const auto& element : data) {
+        index.set(element.first, element.second);
+    }
+    REQUIRE(index.size() == data.size());
+
+    check_all(index, data);
+    index.sort();
+    check_all(index, data);
+
+    // much smaller than the uncompressed data
+    REQUIRE(index.used_memory() < data.size() * 7);
+}
+
+TEST_CASE("SparseCompressedArray with ids out of order") {
+    const auto data = create_data(10000);
+
+    index_type index;
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        const auto& element = data[(i * 7919) % data.size()];
+        index.set(element.first, element.second);
+    }
+    REQUIRE(index.size() == data.size());
+
+    index.sort();
+    REQUIRE(index.size() == data.size());
+    check_all(index, data);
+}
+
+TEST_CASE("SparseCompressedArray with extreme values") {
+    index_type index;
+
+    const osmium::Location loc1{-180.0, -90.0};
+    const osmium::Location loc2{180.0, 90.0};
+    const osmium::Location undefined{};
+
+    std::vector<std::pair<id_type, osmium::Location>> data;
+    for (id_type i = 0; i < 300; ++i) {
+        data.emplace_back(i * 1000000000000ULL + 1, i % 3 == 0 ? loc1 : i % 3 == 1 ? loc2 : undefined);
+    }
+    for (const auto& element : data) {
+        index.set(element.first, element.second);
+    }
+
+    for (const auto& element : data) {
+        REQUIRE(index.get_noexcept(element.first) == element.second);
+    }
+    REQUIRE_FALSE(index.get_noexcept(2));
+}
+
+TEST_CASE("SparseCompressedArray gives same results as SparseMemArray") {
+    auto data = create_data(5000);
+    data.emplace_back(1000005, osmium::Location{1, 1}); // duplicate id out of order
+
+    index_type index;
+    osmium::index::map::SparseMemArray<id_type, osmium::Location> expected;
+    for (const auto& element : data) {
+        index.set(element.first, element.second);
+        expected.set(element.first, element.second);
+    }
+    index.sort();
+    expected.sort();
+
+    for (id_type id = 999990; id < data[4990].first; ++id) {
+        REQUIRE(index.get_noexcept(id) == expected.get_noexcept(id));
+    }
+}
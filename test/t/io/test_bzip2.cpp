@@ -3,11 +3,51 @@
 #include "utils.hpp"
 
 #include <osmium/io/bzip2_compression.hpp>
+#include <osmium/thread/memory_budget.hpp>
+#include <osmium/thread/pool.hpp>
 
+#include <cstddef>
 #include <fcntl.h>
 #include <string>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+static std::string create_test_data(std::size_t size, unsigned int seed) {
+    std::string data;
+    data.reserve(size);
+    unsigned int n = seed;
+    while (data.size() < size) {
+        n = n * 1103515245U + 12345U;
+        data += static_cast<char>((n >> 16U) & 0xffU);
+    }
+    return data;
+}
+
+static std::string bzip2_compress(std::string data) {
+    std::string output(data.size() + data.size() / 100 + 600, '\0');
+    auto size = static_cast<unsigned int>(output.size());
+    const int result = BZ2_bzBuffToBuffCompress(&output[0], &size, &data[0], static_cast<unsigned int>(data.size()), 9, 0, 0);
+    REQUIRE(result == BZ_OK);
+    output.resize(size);
+    return output;
+}
+
+static void write_file(const std::string& filename, const std::string& data) {
+    const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666); // NOLINT(hicpp-signed-bitwise)
+    REQUIRE(fd > 0);
+    REQUIRE(::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    ::close(fd);
+}
+
+static std::string read_all(osmium::io::Decompressor& decomp) {
+    std::string all;
+    for (std::string data = decomp.read(); !data.empty(); data = decomp.read()) {
+        all += data;
+    }
+    return all;
+}
 
 TEST_CASE("Read bzip2-compressed file") {
     const std::string input_file = with_data_dir("t/io/data_bzip2.txt.bz2");
@@ -29,3 +69,96 @@ TEST_CASE("Read bzip2-compressed file") {
     REQUIRE("TESTDATA\n" == all);
 }
 
+
+TEST_CASE("Read bzip2-compressed file with parallel decompressor") {
+    const std::string input_file = with_data_dir("t/io/data_bzip2.txt.bz2");
+
+    const int fd = ::open(input_file.c_str(), O_RDONLY);
+    REQUIRE(fd > 0);
+
+    osmium::thread::Pool pool{4};
+    osmium::io::ParallelBzip2Decompressor decomp{fd, pool};
+    REQUIRE(read_all(decomp) == "TESTDATA\n");
+}
+
+TEST_CASE("Read multistream bzip2 file with parallel decompressor") {
+    const std::string filename{"test-bzip2-multistream.bz2"};
+
+    std::string data;
+    std::string compressed;
+    for (unsigned int i = 0; i < 40; ++i) {
+        const std::string stream_data{create_test_data(100 * 1000, i + 1)};
+        data += stream_data;
+        compressed += bzip2_compress(stream_data);
+    }
+    REQUIRE(compressed.size() > 2 * 1024 * 1024);
+
+    osmium::thread::Pool pool{4};
+
+    SECTION("complete file") {
+        write_file(filename, compressed);
+
+        {
+            const int fd = ::open(filename.c_str(), O_RDONLY);
+            REQUIRE(fd > 0);
+            osmium::io::ParallelBzip2Decompressor decomp{fd, pool};
+            REQUIRE(read_all(decomp) == data);
+            REQUIRE(decomp.offset() == compressed.size());
+        }
+
+        {
+            const int fd = ::open(filename.c_str(), O_RDONLY);
+            REQUIRE(fd > 0);
+            osmium::io::Bzip2Decompressor decomp{fd};
+            REQUIRE(read_all(decomp) == data);
+        }
+    }
+
+    SECTION("with exhausted memory budget") {
+        write_file(filename, compressed);
+
+        auto& budget = osmium::thread::MemoryBudget::default_instance();
+        const std::size_t limit = budget.limit();
+        const std::size_t used = budget.used();
+        budget.set_limit(1);
+
+        {
+            const int fd = ::open(filename.c_str(), O_RDONLY);
+            REQUIRE(fd > 0);
+            osmium::io::ParallelBzip2Decompressor decomp{fd, pool};
+            const std::string first{decomp.read()};
+            REQUIRE_FALSE(first.empty());
+            REQUIRE(budget.used() > used);
+            REQUIRE(first + read_all(decomp) == data);
+        }
+
+        REQUIRE(budget.used() == used);
+        budget.set_limit(limit);
+    }
+
+    SECTION("truncated file") {
+        write_file(filename, compressed.substr(0, compressed.size() - 100));
+
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        REQUIRE(fd > 0);
+        osmium::io::ParallelBzip2Decompressor decomp{fd, pool};
+        REQUIRE_THROWS_AS(read_all(decomp), const osmium::bzip2_error&);
+    }
+}
+
+TEST_CASE("Read large single stream bzip2 file with parallel decompressor") {
+    const std::string filename{"test-bzip2-single-stream.bz2"};
+
+    // no stream headers in the first 4 MByte, so it falls back to
+    // sequential decompression
+    const std::string data{create_test_data(5 * 1024 * 1024, 1)};
+    const std::string compressed{bzip2_compress(data) + bzip2_compress("END\n")};
+    write_file(filename, compressed);
+
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    REQUIRE(fd > 0);
+    osmium::thread::Pool pool{4};
+    osmium::io::ParallelBzip2Decompressor decomp{fd, pool};
+    REQUIRE(read_all(decomp) == data + "END\n");
+    REQUIRE(decomp.offset() == compressed.size());
+}
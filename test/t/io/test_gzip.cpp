@@ -0,0 +1,162 @@
+#include "catch.hpp"
+
+#include "utils.hpp"
+
+#include <osmium/io/gzip_compression.hpp>
+#include <osmium/io/xml_input.hpp>
+#include <osmium/io/xml_output.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/object.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <cstddef>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+static std::string create_test_data(std::size_t size) {
+    std::string data;
+    unsigned int n = 1;
+    while (data.size() < size) {
+        n = n * 1103515245U + 12345U;
+        data += "<node id=\"" + std::to_string(n % 100000) + "\"/>\n";
+    }
+    data.resize(size);
+    return data;
+}
+
+static std::string decompress_file(const std::string& filename) {
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    REQUIRE(fd > 0);
+
+    std::string all;
+    osmium::io::GzipDecompressor decomp{fd};
+    for (std::string data = decomp.read(); !data.empty(); data = decomp.read()) {
+        all += data;
+    }
+    return all;
+}
+
+static std::string decompress_buffer(const std::string& compressed) {
+    std::string all;
+    osmium::io::GzipBufferDecompressor decomp{compressed.data(), compressed.size()};
+    for (std::string data = decomp.read(); !data.empty(); data = decomp.read()) {
+        all += data;
+    }
+    return all;
+}
+
+static std::string read_raw(const std::string& filename) {
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    REQUIRE(fd > 0);
+    std::string all;
+    char buffer[4096];
+    while (true) {
+        const auto nread = ::read(fd, buffer, sizeof(buffer));
+        REQUIRE(nread >= 0);
+        if (nread == 0) {
+            break;
+        }
+        all.append(buffer, static_cast<std::size_t>(nread));
+    }
+    ::close(fd);
+    return all;
+}
+
+TEST_CASE("Parallel gzip compression") {
+    const std::string filename{"test-gzip-parallel.gz"};
+    osmium::thread::Pool pool{4};
+
+    std::vector<std::string> pieces;
+
+    SECTION("no data") {
+    }
+
+    SECTION("small piece") {
+        pieces.emplace_back("TESTDATA\n");
+    }
+
+    SECTION("many small pieces") {
+        const std::string data{create_test_data(1000 * 1000)};
+        for (std::size_t offset = 0; offset < data.size(); offset += 1000) {
+            pieces.push_back(data.substr(offset, 1000));
+        }
+    }
+
+    SECTION("large pieces") {
+        pieces.push_back(create_test_data(1000 * 1000));
+        pieces.push_back(create_test_data(300 * 1000));
+        pieces.emplace_back();
+        pieces.push_back(create_test_data(128 * 1024));
+    }
+
+    std::string all;
+    {
+        const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666); // NOLINT(hicpp-signed-bitwise)
+        REQUIRE(fd > 0);
+        osmium::io::ParallelGzipCompressor comp{fd, osmium::io::fsync::no, pool};
+        for (const auto& piece : pieces) {
+            comp.write(piece);
+            all += piece;
+        }
+        comp.close();
+    }
+
+    REQUIRE(decompress_file(filename) == all);
+    REQUIRE(decompress_buffer(read_raw(filename)) == all);
+}
+
+TEST_CASE("Parallel gzip compression has good compression ratio") {
+    const std::string data{create_test_data(2 * 1000 * 1000)};
+    osmium::thread::Pool pool{4};
+
+    {
+        const int fd = ::open("test-gzip-serial.gz", O_WRONLY | O_CREAT | O_TRUNC, 0666); // NOLINT(hicpp-signed-bitwise)
+        REQUIRE(fd > 0);
+        osmium::io::GzipCompressor comp{fd, osmium::io::fsync::no};
+        comp.write(data);
+        comp.close();
+    }
+
+    {
+        const int fd = ::open("test-gzip-parallel.gz", O_WRONLY | O_CREAT | O_TRUNC, 0666); // NOLINT(hicpp-signed-bitwise)
+        REQUIRE(fd > 0);
+        osmium::io::ParallelGzipCompressor comp{fd, osmium::io::fsync::no, pool};
+        comp.write(data);
+        comp.close();
+    }
+
+    const auto serial_size = read_raw("test-gzip-serial.gz").size();
+    const auto parallel_size = read_raw("test-gzip-parallel.gz").size();
+    REQUIRE(parallel_size < serial_size * 101 / 100);
+}
+
+TEST_CASE("Write gzip compressed XML with parallel compression") {
+    osmium::io::Reader reader{with_data_dir("t/io/data.osm")};
+    osmium::memory::Buffer buffer = reader.read();
+    REQUIRE(buffer);
+    reader.close();
+
+    osmium::io::File file{"test-gzip-parallel.osm.gz"};
+    file.set("parallel_compression", true);
+    {
+        osmium::io::Writer writer{file, osmium::io::overwrite::allow};
+        writer(std::move(buffer));
+        writer.close();
+    }
+
+    osmium::io::Reader reader_check{"test-gzip-parallel.osm.gz"};
+    osmium::memory::Buffer buffer_check = reader_check.read();
+    REQUIRE(buffer_check);
+    REQUIRE(buffer_check.select<osmium::OSMObject>().cbegin()->id() == 1);
+}
+
+TEST_CASE("Compression factory creates parallel compressor") {
+    const auto& factory = osmium::io::CompressionFactory::instance();
+    REQUIRE(factory.has_parallel_compressor(osmium::io::file_compression::gzip));
+    REQUIRE_FALSE(factory.has_parallel_compressor(osmium::io::file_compression::none));
+}
@@ -0,0 +1,63 @@
+#include "catch.hpp"
+
+#include <osmium/io/detail/packed_varint.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+static void add_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80U) {
+        out += static_cast<char>((value & 0x7fU) | 0x80U);
+        value >>= 7U;
+    }
+    out += static_cast<char>(value);
+}
+
+static std::string encode_delta(const std::vector<int64_t>& values) {
+    std::string out;
+    int64_t last = 0;
+    for (const auto value : values) {
+        const int64_t delta = value - last;
+        last = value;
+        add_varint(out, (static_cast<uint64_t>(delta) << 1U) ^ static_cast<uint64_t>(delta >> 63));
+    }
+    return out;
+}
+
+static std::vector<int64_t> decode(const std::string& data) {
+    std::vector<int64_t> out{99, 98, 97};
+    osmium::io::detail::decode_packed_sint64_delta(data.data(), data.data() + data.size(), out);
+    return out;
+}
+
+TEST_CASE("Decode empty packed field") {
+    REQUIRE(decode("").empty());
+}
+
+TEST_CASE("Decode packed field with single byte varints") {
+    std::vector<int64_t> values;
+    for (int64_t i = 1; i <= 100; ++i) {
+        values.push_back(i * 3);
+    }
+    REQUIRE(decode(encode_delta(values)) == values);
+}
+
+TEST_CASE("Decode packed field with mixed varints") {
+    const std::vector<int64_t> values{
+        1, 2, 3, 1000000, 1000001, -5, 17, 18, 19, 20, 21, 22, 23, 24,
+        9223372036854775807LL, 0, -4611686018427387904LL, 25, 26, 27, 28
+    };
+    REQUIRE(decode(encode_delta(values)) == values);
+}
+
+TEST_CASE("Decode packed field with truncated varint") {
+    std::string data = encode_delta({1, 2, 3, 4, 5, 6, 7, 8, 9, 100000});
+    data.resize(data.size() - 1);
+    REQUIRE_THROWS_AS(decode(data), const osmium::pbf_error&);
+}
+
+TEST_CASE("Decode packed field with overlong varint") {
+    const std::string data(11, '\xff');
+    REQUIRE_THROWS_AS(decode(data), const osmium::pbf_error&);
+}
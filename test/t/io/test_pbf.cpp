@@ -2,9 +2,31 @@
 
 #include "utils.hpp"
 
+#include <osmium/builder/attr.hpp>
+#include <osmium/handler.hpp>
+#include <osmium/handler/node_locations_for_ways.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+#include <osmium/io/node_location_reader.hpp>
 #include <osmium/io/pbf_input.hpp>
+#include <osmium/io/pbf_output.hpp>
 #include <osmium/io/reader.hpp>
+#include <osmium/osm/box.hpp>
 #include <osmium/osm/object.hpp>
+#include <osmium/parallel_visitor.hpp>
+#include <osmium/thread/memory_budget.hpp>
+#include <osmium/visitor.hpp>
+
+#include <protozero/pbf_builder.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 
 /**
  * Osmosis writes PBF with changeset=-1 if its input file did not contain the changeset field.
@@ -43,3 +65,746 @@ TEST_CASE("Read PBF file with version=-1 and changeset=-1 and DenseNodes (writte
     REQUIRE(object.version() == 0);
     REQUIRE(object.changeset() == 0);
 }
+
+static void write_pbf_with_blob_index(const std::string& filename, const char* index_option, const char* compression = "zlib", const char* compression_level = "") {
+    osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+
+    for (int i = 1; i <= 20000; ++i) {
+        osmium::builder::add_node(buffer,
+            osmium::builder::attr::_id(i),
+            osmium::builder::attr::_location(i * 0.001, 1.0)
+        );
+    }
+
+    for (int i = 1; i <= 10; ++i) {
+        osmium::builder::add_way(buffer,
+            osmium::builder::attr::_id(i),
+            osmium::builder::attr::_nodes({i, i + 1})
+        );
+    }
+
+    for (int i = 1; i <= 5; ++i) {
+        osmium::builder::add_relation(buffer,
+            osmium::builder::attr::_id(i),
+            osmium::builder::attr::_member(osmium::item_type::way, i, "outer")
+        );
+    }
+
+    osmium::io::File file{filename, "pbf"};
+    file.set("pbf_blob_index", index_option);
+    file.set("pbf_compression", compression);
+    file.set("pbf_compression_level", compression_level);
+    osmium::io::Writer writer{file, osmium::io::overwrite::allow};
+    writer(std::move(buffer));
+    writer.close();
+}
+
+struct CountNWRHandler : public osmium::handler::Handler {
+
+    int nodes = 0;
+    int ways = 0;
+    int relations = 0;
+    osmium::object_id_type min_node_id = std::numeric_limits<osmium::object_id_type>::max();
+    osmium::object_id_type max_node_id = 0;
+
+    void node(const osmium::Node& node) noexcept {
+        ++nodes;
+        min_node_id = std::min(min_node_id, node.id());
+        max_node_id = std::max(max_node_id, node.id());
+    }
+
+    void way(const osmium::Way& /*way*/) noexcept {
+        ++ways;
+    }
+
+    void relation(const osmium::Relation& /*relation*/) noexcept {
+        ++relations;
+    }
+
+}; // struct CountNWRHandler
+
+static void write_pbf_with_tags(const std::string& filename, const char* dense_nodes, const char* add_metadata) {
+    osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+
+    for (int i = 1; i <= 1000; ++i) {
+        if (i % 10 == 0) {
+            osmium::builder::add_node(buffer,
+                osmium::builder::attr::_id(i),
+                osmium::builder::attr::_version(i),
+                osmium::builder::attr::_location(i * 0.001, 1.0),
+                osmium::builder::attr::_tag("amenity", "bench"),
+                osmium::builder::attr::_tag("name", "foo")
+            );
+        } else if (i % 2 == 0) {
+            osmium::builder::add_node(buffer,
+                osmium::builder::attr::_id(i),
+                osmium::builder::attr::_version(i),
+                osmium::builder::attr::_location(i * 0.001, 1.0),
+                osmium::builder::attr::_tag("created_by", "test")
+            );
+        } else {
+            osmium::builder::add_node(buffer,
+                osmium::builder::attr::_id(i),
+                osmium::builder::attr::_version(i),
+                osmium::builder::attr::_location(i * 0.001, 1.0)
+            );
+        }
+    }
+
+    for (int i = 1; i <= 10; ++i) {
+        osmium::builder::add_way(buffer,
+            osmium::builder::attr::_id(i),
+            osmium::builder::attr::_nodes({i, i + 1}),
+            osmium::builder::attr::_tag(i % 2 ? "building" : "highway", "yes")
+        );
+    }
+
+    for (int i = 1; i <= 5; ++i) {
+        osmium::builder::add_relation(buffer,
+            osmium::builder::attr::_id(i),
+            osmium::builder::attr::_member(osmium::item_type::way, i, "outer"),
+            osmium::builder::attr::_tag("type", "multipolygon")
+        );
+    }
+
+    osmium::io::File file{filename, "pbf"};
+    file.set("pbf_dense_nodes", dense_nodes);
+    file.set("add_metadata", add_metadata);
+    osmium::io::Writer writer{file, osmium::io::overwrite::allow};
+    writer(std::move(buffer));
+    writer.close();
+}
+
+TEST_CASE("Read PBF file with blob index using type filter") {
+    const std::string filename{"test-pbf-blob-index-types.osm.pbf"};
+    write_pbf_with_blob_index(filename, "true");
+
+    osmium::io::Reader reader{filename, osmium::osm_entity_bits::relation};
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    REQUIRE(handler.nodes == 0);
+    REQUIRE(handler.ways == 0);
+    REQUIRE(handler.relations == 5);
+}
+
+TEST_CASE("Read PBF file with blob index using id range filter") {
+    const std::string filename{"test-pbf-blob-index-ids.osm.pbf"};
+    write_pbf_with_blob_index(filename, "true");
+
+    osmium::io::Reader reader{filename, osmium::io::id_range{osmium::osm_entity_bits::node, 10000, 10005}};
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    // only the blob containing nodes 8001 to 16000 is read, the nodes in
+    // it are checked one by one
+    REQUIRE(handler.nodes == 6);
+    REQUIRE(handler.min_node_id == 10000);
+    REQUIRE(handler.max_node_id == 10005);
+    REQUIRE(handler.ways == 10);
+    REQUIRE(handler.relations == 5);
+}
+
+TEST_CASE("Read PBF file with blob index using bbox filter") {
+    const std::string filename{"test-pbf-blob-index-bbox.osm.pbf"};
+    write_pbf_with_blob_index(filename, "true");
+
+    osmium::io::Reader reader{filename, osmium::Box{17.5, 0.0, 18.5, 2.0}};
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    // only the blob containing nodes 16001 to 20000 is read, the nodes in
+    // it are checked one by one
+    REQUIRE(handler.nodes == 1001);
+    REQUIRE(handler.min_node_id == 17500);
+    REQUIRE(handler.max_node_id == 18500);
+    REQUIRE(handler.ways == 10);
+    REQUIRE(handler.relations == 5);
+}
+
+TEST_CASE("Read PBF file without blob index using id range filter") {
+    const std::string filename{"test-pbf-no-blob-index.osm.pbf"};
+    write_pbf_with_blob_index(filename, "false");
+
+    osmium::io::Reader reader{filename, osmium::io::id_range{osmium::osm_entity_bits::node, 10000, 10005}};
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    REQUIRE(handler.nodes == 6);
+    REQUIRE(handler.min_node_id == 10000);
+    REQUIRE(handler.max_node_id == 10005);
+    REQUIRE(handler.ways == 10);
+    REQUIRE(handler.relations == 5);
+}
+
+TEST_CASE("Read PBF file using id range filter for ways and relations") {
+    const std::string filename{"test-pbf-ids-ways-relations.osm.pbf"};
+    write_pbf_with_blob_index(filename, "false");
+
+    osmium::io::Reader reader{filename,
+                              osmium::io::id_range{osmium::osm_entity_bits::way, 3, 4},
+                              osmium::io::id_range{osmium::osm_entity_bits::relation, 5, 100}};
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    REQUIRE(handler.nodes == 20000);
+    REQUIRE(handler.ways == 2);
+    REQUIRE(handler.relations == 1);
+}
+
+TEST_CASE("Read PBF file with non-dense nodes using bbox filter") {
+    const std::string filename{"test-pbf-bbox-non-dense.osm.pbf"};
+    write_pbf_with_tags(filename, "false", "true");
+
+    osmium::io::Reader reader{filename, osmium::Box{0.1, 0.0, 0.2, 2.0}};
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    REQUIRE(handler.nodes == 101);
+    REQUIRE(handler.min_node_id == 100);
+    REQUIRE(handler.max_node_id == 200);
+    REQUIRE(handler.ways == 10);
+    REQUIRE(handler.relations == 5);
+}
+
+TEST_CASE("Read PBF file using memory mapping") {
+    const std::string filename{"test-pbf-mmap.osm.pbf"};
+    write_pbf_with_blob_index(filename, "true");
+
+    osmium::io::Reader reader{filename, osmium::io::use_mmap::yes};
+    REQUIRE(reader.file_size() > 0);
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    REQUIRE(handler.nodes == 20000);
+    REQUIRE(handler.ways == 10);
+    REQUIRE(handler.relations == 5);
+    REQUIRE(reader.offset() == reader.file_size());
+}
+
+TEST_CASE("Read PBF file using memory mapping and id range filter") {
+    const std::string filename{"test-pbf-mmap-ids.osm.pbf"};
+    write_pbf_with_blob_index(filename, "true");
+
+    osmium::io::Reader reader{filename, osmium::io::use_mmap::yes, osmium::io::id_range{osmium::osm_entity_bits::node, 10000, 10005}};
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    REQUIRE(handler.nodes == 6);
+    REQUIRE(handler.min_node_id == 10000);
+    REQUIRE(handler.max_node_id == 10005);
+}
+
+TEST_CASE("Closing memory mapped PBF reader early") {
+    const std::string filename{"test-pbf-mmap-close.osm.pbf"};
+    write_pbf_with_blob_index(filename, "false");
+
+    osmium::io::Reader reader{filename, osmium::io::use_mmap::yes};
+    const auto buffer = reader.read();
+    REQUIRE(buffer);
+    reader.close();
+    REQUIRE(reader.eof());
+}
+
+TEST_CASE("Memory mapped PBF reader should fail with nonexistent file") {
+    const std::string filename{with_data_dir("t/io/nonexistent-file.osm.pbf")};
+    REQUIRE_THROWS((osmium::io::Reader{filename, osmium::io::use_mmap::yes}));
+}
+
+static void check_pbf_compression(const char* compression, const char* compression_level = "") {
+    const std::string filename{std::string{"test-pbf-compression-"} + compression + ".osm.pbf"};
+    write_pbf_with_blob_index(filename, "true", compression, compression_level);
+
+    osmium::io::Reader reader{filename};
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    REQUIRE(handler.nodes == 20000);
+    REQUIRE(handler.ways == 10);
+    REQUIRE(handler.relations == 5);
+}
+
+TEST_CASE("Write and read PBF file with different blob compressions") {
+    SECTION("none") {
+        check_pbf_compression("none");
+    }
+    SECTION("zlib") {
+        check_pbf_compression("zlib");
+    }
+    SECTION("zlib with level") {
+        check_pbf_compression("zlib", "1");
+    }
+#ifdef OSMIUM_WITH_LZ4
+    SECTION("lz4") {
+        check_pbf_compression("lz4");
+    }
+    SECTION("lz4 with level") {
+        check_pbf_compression("lz4", "9");
+    }
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+    SECTION("zstd") {
+        check_pbf_compression("zstd");
+    }
+    SECTION("zstd with level") {
+        check_pbf_compression("zstd", "19");
+    }
+#endif
+}
+
+TEST_CASE("Writing PBF file with invalid compression options") {
+    SECTION("unknown compression") {
+        REQUIRE_THROWS_AS(write_pbf_with_blob_index("test-pbf-compression-invalid.osm.pbf", "true", "foo"), const std::invalid_argument&);
+    }
+    SECTION("invalid level") {
+        REQUIRE_THROWS_AS(write_pbf_with_blob_index("test-pbf-compression-invalid.osm.pbf", "true", "zlib", "10"), const std::invalid_argument&);
+    }
+    SECTION("level is not a number") {
+        REQUIRE_THROWS_AS(write_pbf_with_blob_index("test-pbf-compression-invalid.osm.pbf", "true", "zlib", "x"), const std::invalid_argument&);
+    }
+}
+
+TEST_CASE("Read PBF file recycling buffers") {
+    const std::string filename{"test-pbf-recycle.osm.pbf"};
+    write_pbf_with_blob_index(filename, "false");
+
+    osmium::io::Reader reader{filename};
+    CountNWRHandler handler;
+    while (osmium::memory::Buffer buffer = reader.read()) {
+        osmium::apply(buffer, handler);
+        reader.recycle(std::move(buffer));
+    }
+
+    REQUIRE(handler.nodes == 20000);
+    REQUIRE(handler.ways == 10);
+    REQUIRE(handler.relations == 5);
+}
+
+TEST_CASE("Read PBF file unordered") {
+    const std::string filename{"test-pbf-unordered.osm.pbf"};
+    write_pbf_with_blob_index(filename, "false");
+
+    osmium::io::Reader reader{filename, osmium::io::ordered::no};
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+
+    REQUIRE(handler.nodes == 20000);
+    REQUIRE(handler.min_node_id == 1);
+    REQUIRE(handler.max_node_id == 20000);
+    REQUIRE(handler.ways == 10);
+    REQUIRE(handler.relations == 5);
+}
+
+TEST_CASE("Read PBF file unordered with apply_parallel on the reader pool") {
+    // Enough blocks to fill the output queue of the reader.
+    const std::string filename{"test-pbf-unordered-parallel.osm.pbf"};
+    {
+        osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+        for (int i = 1; i <= 400000; ++i) {
+            osmium::builder::add_node(buffer,
+                osmium::builder::attr::_id(i),
+                osmium::builder::attr::_location(1.0, 1.0)
+            );
+        }
+        osmium::io::Writer writer{filename, osmium::io::overwrite::allow};
+        writer(std::move(buffer));
+        writer.close();
+    }
+
+    osmium::thread::Pool pool{1};
+    osmium::io::Reader reader{filename, pool, osmium::io::ordered::no};
+    int nodes = 0;
+    osmium::apply_parallel(reader,
+        []() { return CountNWRHandler{}; },
+        [&nodes](const CountNWRHandler& handler) { nodes += handler.nodes; },
+        pool);
+
+    REQUIRE(nodes == 400000);
+}
+
+TEST_CASE("Reader metrics for PBF file") {
+    const std::string filename{"test-pbf-metrics.osm.pbf"};
+    write_pbf_with_blob_index(filename, "true");
+
+    SECTION("all blobs") {
+        osmium::io::Reader reader{filename};
+        CountNWRHandler handler;
+        osmium::apply(reader, handler);
+
+        const auto metrics = reader.metrics();
+        REQUIRE(metrics.bytes_read == reader.file_size());
+        REQUIRE(metrics.blobs_inflated > 0);
+        REQUIRE(metrics.blobs_skipped == 0);
+        REQUIRE(metrics.buffers_produced == metrics.blobs_inflated);
+        REQUIRE(metrics.inflate_time.count() > 0);
+        REQUIRE(metrics.decode_time.count() > 0);
+    }
+
+    SECTION("skipping blobs") {
+        osmium::io::Reader reader{filename, osmium::osm_entity_bits::relation};
+        CountNWRHandler handler;
+        osmium::apply(reader, handler);
+        REQUIRE(handler.relations == 5);
+
+        const auto metrics = reader.metrics();
+        REQUIRE(metrics.blobs_inflated == 1);
+        REQUIRE(metrics.blobs_skipped > 0);
+    }
+
+    SECTION("memory mapped") {
+        osmium::io::Reader reader{filename, osmium::io::use_mmap::yes};
+        CountNWRHandler handler;
+        osmium::apply(reader, handler);
+
+        const auto metrics = reader.metrics();
+        REQUIRE(metrics.bytes_read == reader.file_size());
+        REQUIRE(metrics.read_time.count() == 0);
+        // only the end of data marker, no data
+        REQUIRE(metrics.input_queue.pushes == 1);
+    }
+
+    SECTION("uncompressed blobs") {
+        const std::string filename_none{"test-pbf-metrics-none.osm.pbf"};
+        write_pbf_with_blob_index(filename_none, "true", "none");
+        osmium::io::Reader reader{filename_none};
+        CountNWRHandler handler;
+        osmium::apply(reader, handler);
+
+        const auto metrics = reader.metrics();
+        REQUIRE(metrics.blobs_inflated == 0);
+        REQUIRE(metrics.buffers_produced > 0);
+    }
+}
+
+TEST_CASE("Reader metrics can be sampled while reading") {
+    const std::string filename{"test-pbf-metrics-sample.osm.pbf"};
+    write_pbf_with_blob_index(filename, "false");
+
+    osmium::io::Reader reader{filename, osmium::io::ordered::no};
+
+    std::atomic<bool> done{false};
+    bool monotonic = true;
+    std::thread sampler{[&reader, &done, &monotonic] {
+        uint64_t last_bytes_read = 0;
+        while (!done) {
+            const auto metrics = reader.metrics();
+            if (metrics.bytes_read < last_bytes_read) {
+                monotonic = false;
+            }
+            last_bytes_read = metrics.bytes_read;
+            std::this_thread::yield();
+        }
+    }};
+
+    CountNWRHandler handler;
+    osmium::apply(reader, handler);
+    done = true;
+    sampler.join();
+
+    REQUIRE(monotonic);
+    REQUIRE(handler.nodes == 20000);
+    REQUIRE(reader.metrics().bytes_read == reader.file_size());
+}
+
+TEST_CASE("Write PBF file from many small buffers") {
+    const std::string filename{"test-pbf-small-buffers.osm.pbf"};
+
+    {
+        osmium::io::File file{filename, "pbf"};
+        file.set("pbf_blob_index", "false");
+        osmium::thread::Pool pool{4};
+        osmium::io::Writer writer{file, pool, osmium::io::overwrite::allow};
+
+        for (int i = 0; i < 20; ++i) {
+            osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+            for (int j = 1; j <= 1000; ++j) {
+                osmium::builder::add_node(buffer,
+                    osmium::builder::attr::_id(i * 1000 + j),
+                    osmium::builder::attr::_location(j * 0.001, 1.0),
+                    osmium::builder::attr::_tag("n", std::to_string(i).c_str())
+                );
+            }
+            if (i == 19) {
+                osmium::builder::add_way(buffer,
+                    osmium::builder::attr::_id(1),
+                    osmium::builder::attr::_nodes({1, 2})
+                );
+            }
+            writer(std::move(buffer));
+        }
+        writer.close();
+    }
+
+    osmium::io::Reader reader{filename};
+    CountNWRHandler handler;
+    osmium::object_id_type last_id = 0;
+    bool ordered = true;
+    while (osmium::memory::Buffer buffer = reader.read()) {
+        for (const auto& node : buffer.select<osmium::Node>()) {
+            if (node.id() != last_id + 1) {
+                ordered = false;
+            }
+            last_id = node.id();
+        }
+        osmium::apply(buffer, handler);
+    }
+
+    REQUIRE(ordered);
+    REQUIRE(handler.nodes == 20000);
+    REQUIRE(handler.ways == 1);
+
+    // blocks span buffers: 8000 + 8000 + 4000 nodes and the way
+    REQUIRE(reader.metrics().blobs_inflated == 4);
+}
+
+TEST_CASE("Write and read PBF file with tiny memory budget") {
+    auto& budget = osmium::thread::MemoryBudget::default_instance();
+    const std::size_t old_limit = budget.limit();
+    budget.set_limit(1);
+
+    const std::string filename{"test-pbf-budget.osm.pbf"};
+    write_pbf_with_blob_index(filename, "false");
+
+    for (const auto ordered : {osmium::io::ordered::yes, osmium::io::ordered::no}) {
+        osmium::io::Reader reader{filename, ordered};
+        CountNWRHandler handler;
+        osmium::apply(reader, handler);
+        reader.close();
+
+        REQUIRE(handler.nodes == 20000);
+        REQUIRE(handler.ways == 10);
+        REQUIRE(handler.relations == 5);
+    }
+
+    budget.set_limit(old_limit);
+}
+
+static void check_pbf_key_filter(const char* dense_nodes, const char* add_metadata) {
+    const std::string filename{std::string{"test-pbf-key-filter-"} + dense_nodes + "-" + add_metadata + ".osm.pbf"};
+    write_pbf_with_tags(filename, dense_nodes, add_metadata);
+
+    const osmium::io::key_filter filter{[](const char* key) {
+        return !std::strcmp(key, "amenity") || !std::strcmp(key, "highway");
+    }, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way};
+
+    osmium::io::Reader reader{filename, filter};
+    CountNWRHandler handler;
+    while (osmium::memory::Buffer buffer = reader.read()) {
+        for (const auto& node : buffer.select<osmium::Node>()) {
+            REQUIRE(node.id() % 10 == 0);
+            REQUIRE(node.location() == osmium::Location(node.id() * 0.001, 1.0));
+            if (std::strcmp(add_metadata, "true") == 0) {
+                REQUIRE(node.version() == static_cast<osmium::object_version_type>(node.id()));
+            }
+            REQUIRE(node.tags().size() == 2);
+        }
+        for (const auto& way : buffer.select<osmium::Way>()) {
+            REQUIRE(way.id() % 2 == 0);
+        }
+        osmium::apply(buffer, handler);
+    }
+
+    REQUIRE(handler.nodes == 100);
+    REQUIRE(handler.min_node_id == 10);
+    REQUIRE(handler.max_node_id == 1000);
+    REQUIRE(handler.ways == 5);
+    REQUIRE(handler.relations == 5);
+}
+
+TEST_CASE("Read PBF file with key filter") {
+    SECTION("dense nodes with metadata") {
+        check_pbf_key_filter("true", "true");
+    }
+    SECTION("dense nodes without metadata") {
+        check_pbf_key_filter("true", "false");
+    }
+    SECTION("non-dense nodes") {
+        check_pbf_key_filter("false", "true");
+    }
+}
+
+static void check_node_location_reader(const char* index_option) {
+    const std::string filename{std::string{"test-pbf-node-locations-"} + index_option + ".osm.pbf"};
+    write_pbf_with_blob_index(filename, index_option);
+
+    osmium::io::NodeLocationReader reader{filename};
+
+    osmium::object_id_type expected_id = 1;
+    osmium::NodeLocationBatch batch;
+    while (!(batch = reader.read()).empty()) {
+        REQUIRE(batch.ids().size() == batch.locations().size());
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            REQUIRE(batch.id(i) == expected_id);
+            REQUIRE(batch.location(i) == osmium::Location(expected_id * 0.001, 1.0));
+            ++expected_id;
+        }
+    }
+
+    REQUIRE(expected_id == 20001);
+    REQUIRE(reader.eof());
+    reader.close();
+}
+
+TEST_CASE("Read node locations from PBF file") {
+    SECTION("with blob index") {
+        check_node_location_reader("true");
+    }
+    SECTION("without blob index") {
+        check_node_location_reader("false");
+    }
+}
+
+TEST_CASE("Read node locations from PBF file with non-dense nodes") {
+    const std::string filename{"test-pbf-node-locations-non-dense.osm.pbf"};
+    write_pbf_with_tags(filename, "false", "true");
+
+    osmium::io::NodeLocationReader reader{filename};
+
+    std::size_t count = 0;
+    osmium::NodeLocationBatch batch;
+    while (!(batch = reader.read()).empty()) {
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            REQUIRE(batch.location(i) == osmium::Location(batch.id(i) * 0.001, 1.0));
+        }
+        count += batch.size();
+    }
+
+    REQUIRE(count == 1000);
+}
+
+static void check_node_location_reader_history(const char* dense_nodes) {
+    const std::string filename{std::string{"test-pbf-node-locations-history-"} + dense_nodes + ".osh.pbf"};
+    {
+        osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+        for (int i = 1; i <= 100; ++i) {
+            osmium::builder::add_node(buffer,
+                osmium::builder::attr::_id(i),
+                osmium::builder::attr::_version(1),
+                osmium::builder::attr::_location(i * 0.001, 1.0)
+            );
+            osmium::builder::add_node(buffer,
+                osmium::builder::attr::_id(i),
+                osmium::builder::attr::_version(2),
+                osmium::builder::attr::_deleted()
+            );
+        }
+        osmium::io::File file{filename};
+        file.set("pbf_dense_nodes", dense_nodes);
+        osmium::io::Writer writer{file, osmium::io::overwrite::allow};
+        writer(std::move(buffer));
+        writer.close();
+    }
+
+    osmium::io::NodeLocationReader reader{filename};
+
+    std::size_t count = 0;
+    osmium::NodeLocationBatch batch;
+    while (!(batch = reader.read()).empty()) {
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            REQUIRE(batch.location(i) == osmium::Location(batch.id(i) * 0.001, 1.0));
+        }
+        count += batch.size();
+    }
+
+    REQUIRE(count == 100);
+}
+
+TEST_CASE("Read node locations from PBF history file skipping deleted nodes") {
+    SECTION("dense nodes") {
+        check_node_location_reader_history("true");
+    }
+    SECTION("non-dense nodes") {
+        check_node_location_reader_history("false");
+    }
+}
+
+// Create a raw blob with a PrimitiveBlock containing node 1 at lat=3 lon=7
+// (in units of the default granularity of 100 nanodegrees) with the
+// latitude offset set to 1 degree and the longitude offset set to 2
+// degrees.
+static std::string create_blob_with_offsets(bool dense_nodes) {
+    using namespace osmium::io::detail; // NOLINT(google-build-using-namespace)
+
+    const std::vector<int64_t> ids{1};
+    const std::vector<int64_t> lats{3};
+    const std::vector<int64_t> lons{7};
+
+    std::string block;
+    {
+        protozero::pbf_builder<OSMFormat::PrimitiveBlock> pbf_block{block};
+        {
+            protozero::pbf_builder<OSMFormat::StringTable> pbf_stringtable{pbf_block, OSMFormat::PrimitiveBlock::required_StringTable_stringtable};
+            pbf_stringtable.add_bytes(OSMFormat::StringTable::repeated_bytes_s, "");
+        }
+        {
+            protozero::pbf_builder<OSMFormat::PrimitiveGroup> pbf_group{pbf_block, OSMFormat::PrimitiveBlock::repeated_PrimitiveGroup_primitivegroup};
+            if (dense_nodes) {
+                protozero::pbf_builder<OSMFormat::DenseNodes> pbf_dense{pbf_group, OSMFormat::PrimitiveGroup::optional_DenseNodes_dense};
+                pbf_dense.add_packed_sint64(OSMFormat::DenseNodes::packed_sint64_id, ids.cbegin(), ids.cend());
+                pbf_dense.add_packed_sint64(OSMFormat::DenseNodes::packed_sint64_lat, lats.cbegin(), lats.cend());
+                pbf_dense.add_packed_sint64(OSMFormat::DenseNodes::packed_sint64_lon, lons.cbegin(), lons.cend());
+            } else {
+                protozero::pbf_builder<OSMFormat::Node> pbf_node{pbf_group, OSMFormat::PrimitiveGroup::repeated_Node_nodes};
+                pbf_node.add_sint64(OSMFormat::Node::required_sint64_id, ids.front());
+                pbf_node.add_sint64(OSMFormat::Node::required_sint64_lat, lats.front());
+                pbf_node.add_sint64(OSMFormat::Node::required_sint64_lon, lons.front());
+            }
+        }
+        pbf_block.add_int64(OSMFormat::PrimitiveBlock::optional_int64_lat_offset, 1000000000);
+        pbf_block.add_int64(OSMFormat::PrimitiveBlock::optional_int64_lon_offset, 2000000000);
+    }
+
+    std::string blob;
+    protozero::pbf_builder<FileFormat::Blob> pbf_blob{blob};
+    pbf_blob.add_bytes(FileFormat::Blob::optional_bytes_raw, block);
+    return blob;
+}
+
+static void check_decoders_with_offsets(bool dense_nodes) {
+    const osmium::Location expected{2.0000007, 1.0000003};
+
+    std::string blob{create_blob_with_offsets(dense_nodes)};
+
+    osmium::io::detail::PBFDataBlobDecoder decoder{osmium::io::detail::data_view{blob.data(), blob.size()}, osmium::osm_entity_bits::node, osmium::io::read_meta::no};
+    const osmium::memory::Buffer buffer{decoder()};
+    const auto& node = buffer.get<osmium::Node>(0);
+    REQUIRE(node.id() == 1);
+    REQUIRE(node.location() == expected);
+
+    osmium::io::detail::PBFNodeLocationDecoder location_decoder{std::move(blob)};
+    const osmium::NodeLocationBatch batch{location_decoder()};
+    REQUIRE(batch.size() == 1);
+    REQUIRE(batch.id(0) == 1);
+    REQUIRE(batch.location(0) == expected);
+}
+
+TEST_CASE("Decoders apply latitude and longitude offsets of the block") {
+    SECTION("dense nodes") {
+        check_decoders_with_offsets(true);
+    }
+    SECTION("non-dense nodes") {
+        check_decoders_with_offsets(false);
+    }
+}
+
+TEST_CASE("Fill location index from node locations batches") {
+    const std::string filename{"test-pbf-node-locations-index.osm.pbf"};
+    write_pbf_with_blob_index(filename, "false");
+
+    using index_type = osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location>;
+    index_type index;
+    osmium::handler::NodeLocationsForWays<index_type> location_handler{index};
+
+    osmium::io::NodeLocationReader reader{filename};
+    osmium::NodeLocationBatch batch;
+    while (!(batch = reader.read()).empty()) {
+        location_handler.node_locations(batch);
+    }
+
+    REQUIRE(index.size() == 20000);
+    REQUIRE(location_handler.get_node_location(1234) == osmium::Location(1.234, 1.0));
+}
+
+TEST_CASE("Node location reader on non-PBF file") {
+    REQUIRE_THROWS(osmium::io::NodeLocationReader{with_data_dir("t/io/data.osm")});
+}
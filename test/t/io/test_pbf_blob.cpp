@@ -0,0 +1,304 @@
+#include "catch.hpp"
+
+#include "utils.hpp"
+
+#include <osmium/builder/attr.hpp>
+#include <osmium/handler.hpp>
+#include <osmium/io/detail/pbf_blob_splitter.hpp>
+#include <osmium/io/pbf_blob_reader.hpp>
+#include <osmium/io/pbf_input.hpp>
+#include <osmium/io/pbf_output.hpp>
+#include <osmium/io/reader.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/io/xml_output.hpp>
+#include <osmium/visitor.hpp>
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    struct CountIdsHandler : public osmium::handler::Handler {
+
+        std::vector<osmium::object_id_type> node_ids;
+        std::vector<osmium::object_id_type> way_ids;
+
+        void node(const osmium::Node& node) {
+            node_ids.push_back(node.id());
+        }
+
+        void way(const osmium::Way& way) {
+            way_ids.push_back(way.id());
+        }
+
+    }; // struct CountIdsHandler
+
+    void write_test_file(const std::string& filename, bool blob_index) {
+        osmium::io::File file{filename, "pbf"};
+        file.set("pbf_blob_index", blob_index ? "true" : "false");
+
+        osmium::io::Header header;
+        header.set("generator", "test_pbf_blob");
+        osmium::io::Writer writer{file, header, osmium::io::overwrite::allow};
+
+        osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+        for (int i = 1; i <= 10000; ++i) {
+            osmium::builder::add_node(buffer,
+                osmium::builder::attr::_id(i),
+                osmium::builder::attr::_location(i * 0.001, 1.0)
+            );
+        }
+        for (int i = 1; i <= 10; ++i) {
+            osmium::builder::add_way(buffer,
+                osmium::builder::attr::_id(i),
+                osmium::builder::attr::_nodes({i, i + 1})
+            );
+        }
+        writer(std::move(buffer));
+        writer.close();
+    }
+
+    CountIdsHandler read_ids(const std::string& filename) {
+        CountIdsHandler handler;
+        osmium::io::Reader reader{filename};
+        osmium::apply(reader, handler);
+        reader.close();
+        return handler;
+    }
+
+    void copy_blob_by_blob(bool blob_index) {
+        const std::string filename{"test-pbf-blob-in.osm.pbf"};
+        const std::string copy{"test-pbf-blob-out.osm.pbf"};
+        write_test_file(filename, blob_index);
+
+        int count = 0;
+        {
+            osmium::io::PBFBlobReader blob_reader{filename};
+            REQUIRE(blob_reader.header().get("generator") == "test_pbf_blob");
+
+            osmium::io::Writer writer{copy, blob_reader.header(), osmium::io::overwrite::allow};
+            while (osmium::io::pbf_blob blob = blob_reader.read()) {
+                if (blob_index) {
+                    REQUIRE(blob.entities() != osmium::osm_entity_bits::nothing);
+                } else {
+                    REQUIRE(blob.entities() == osmium::osm_entity_bits::nothing);
+                }
+                writer(std::move(blob));
+                ++count;
+            }
+            writer.close();
+            REQUIRE(blob_reader.bytes_read() > 0);
+        }
+
+        // 8000 nodes per block: 2 node blocks, 1 way block
+        REQUIRE(count == 3);
+
+        const auto original = read_ids(filename);
+        const auto copied = read_ids(copy);
+        REQUIRE(copied.node_ids.size() == 10000);
+        REQUIRE(copied.way_ids.size() == 10);
+        REQUIRE(copied.node_ids == original.node_ids);
+        REQUIRE(copied.way_ids == original.way_ids);
+
+        osmium::io::Reader reader{copy};
+        REQUIRE(reader.header().get("generator") == "test_pbf_blob");
+        reader.close();
+    }
+
+} // anonymous namespace
+
+TEST_CASE("Copy PBF file blob by blob") {
+    SECTION("with blob index") {
+        copy_blob_by_blob(true);
+    }
+    SECTION("without blob index") {
+        copy_blob_by_blob(false);
+    }
+}
+
+TEST_CASE("Detect entities in PBF blobs without index") {
+    const std::string filename{"test-pbf-blob-detect.osm.pbf"};
+    write_test_file(filename, false);
+
+    osmium::io::PBFBlobReader blob_reader{filename, osmium::io::detect_entities::yes};
+    std::vector<osmium::osm_entity_bits::type> entities;
+    while (osmium::io::pbf_blob blob = blob_reader.read()) {
+        entities.push_back(blob.entities());
+    }
+
+    REQUIRE(entities.size() == 3);
+    REQUIRE(entities[0] == osmium::osm_entity_bits::node);
+    REQUIRE(entities[1] == osmium::osm_entity_bits::node);
+    REQUIRE(entities[2] == osmium::osm_entity_bits::way);
+}
+
+TEST_CASE("Split PBF file by entity type using blobs") {
+    const std::string filename{"test-pbf-blob-split-in.osm.pbf"};
+    const std::string ways{"test-pbf-blob-split-ways.osm.pbf"};
+    write_test_file(filename, true);
+
+    {
+        osmium::io::PBFBlobReader blob_reader{filename};
+        osmium::io::Writer writer{ways, blob_reader.header(), osmium::io::overwrite::allow};
+        while (osmium::io::pbf_blob blob = blob_reader.read()) {
+            if (blob.entities() & osmium::osm_entity_bits::way) {
+                writer(std::move(blob));
+            }
+        }
+        writer.close();
+    }
+
+    const auto result = read_ids(ways);
+    REQUIRE(result.node_ids.empty());
+    REQUIRE(result.way_ids.size() == 10);
+}
+
+TEST_CASE("Mix buffers and blobs in Writer") {
+    const std::string filename{"test-pbf-blob-mix-in.osm.pbf"};
+    const std::string output{"test-pbf-blob-mix-out.osm.pbf"};
+    write_test_file(filename, true);
+
+    {
+        osmium::io::PBFBlobReader blob_reader{filename};
+        osmium::io::Writer writer{output, blob_reader.header(), osmium::io::overwrite::allow};
+
+        osmium::memory::Buffer buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+        osmium::builder::add_node(buffer,
+            osmium::builder::attr::_id(20000),
+            osmium::builder::attr::_location(1.0, 1.0)
+        );
+        writer(std::move(buffer));
+
+        while (osmium::io::pbf_blob blob = blob_reader.read()) {
+            writer(std::move(blob));
+        }
+        writer.close();
+    }
+
+    const auto result = read_ids(output);
+    REQUIRE(result.node_ids.size() == 10001);
+    REQUIRE(result.node_ids.front() == 20000);
+    REQUIRE(result.node_ids.back() == 10000);
+    REQUIRE(result.way_ids.size() == 10);
+}
+
+TEST_CASE("Writing PBF blob to non-PBF file fails") {
+    const std::string filename{"test-pbf-blob-xml-in.osm.pbf"};
+    write_test_file(filename, true);
+
+    osmium::io::PBFBlobReader blob_reader{filename};
+    osmium::io::pbf_blob blob = blob_reader.read();
+    REQUIRE(blob);
+
+    osmium::io::Writer writer{"test-pbf-blob-out.osm", osmium::io::overwrite::allow};
+    REQUIRE_THROWS_AS(writer(std::move(blob)), const osmium::io_error&);
+}
+
+TEST_CASE("PBFBlobReader only reads PBF files") {
+    REQUIRE_THROWS_AS(osmium::io::PBFBlobReader{with_data_dir("t/io/data.osm")}, const osmium::io_error&);
+}
+
+TEST_CASE("PBFBlobReader throws on missing file") {
+    REQUIRE_THROWS_AS(osmium::io::PBFBlobReader{"test-pbf-blob-does-not-exist.osm.pbf"}, const std::system_error&);
+}
+
+TEST_CASE("PBFBlobReader reads PBF file written by Osmosis") {
+    osmium::io::PBFBlobReader blob_reader{with_data_dir("t/io/data_pbf_version-1.osm.pbf"), osmium::io::detect_entities::yes};
+    osmium::io::pbf_blob blob = blob_reader.read();
+    REQUIRE(blob);
+    REQUIRE(blob.entities() == osmium::osm_entity_bits::node);
+    REQUIRE_FALSE(blob_reader.read());
+}
+
+namespace {
+
+    std::string read_whole_file(const std::string& filename) {
+        std::ifstream in{filename, std::ios::binary};
+        return std::string{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    }
+
+    std::vector<std::string> split_blobs(osmium::io::detail::PBFBlobSplitter& splitter) {
+        std::vector<std::string> blobs;
+        osmium::io::detail::pbf_blob_index index;
+        REQUIRE(splitter.next("OSMHeader", index) > 0);
+        while (splitter.next("OSMData", index) > 0) {
+            const auto data = splitter.raw_blob();
+            REQUIRE(splitter.blob().size() == data.size() - splitter.header_size());
+            blobs.emplace_back(data.data(), data.size());
+        }
+        return blobs;
+    }
+
+} // anonymous namespace
+
+TEST_CASE("PBFBlobSplitter returns the same blobs for all chunk sizes") {
+    const std::string filename{"test-pbf-blob-splitter.osm.pbf"};
+    write_test_file(filename, true);
+    const std::string input{read_whole_file(filename)};
+
+    osmium::io::detail::PBFBlobSplitter mapped_splitter{input.data(), input.size()};
+    const auto expected = split_blobs(mapped_splitter);
+    REQUIRE(expected.size() > 1);
+    REQUIRE(mapped_splitter.offset() == input.size());
+
+    for (const std::size_t chunk_size : {1, 7, 4096, 1024 * 1024}) {
+        std::size_t pos = 0;
+        osmium::io::detail::PBFBlobSplitter splitter{[&]() {
+            const std::string chunk{input.substr(pos, chunk_size)};
+            pos += chunk.size();
+            return chunk;
+        }};
+        REQUIRE(split_blobs(splitter) == expected);
+        REQUIRE(splitter.offset() == input.size());
+    }
+}
+
+TEST_CASE("PBFBlobSplitter skips blobs that are not accessed") {
+    const std::string filename{"test-pbf-blob-splitter-skip.osm.pbf"};
+    write_test_file(filename, true);
+    const std::string input{read_whole_file(filename)};
+
+    std::size_t pos = 0;
+    osmium::io::detail::PBFBlobSplitter splitter{[&]() {
+        const std::string chunk{input.substr(pos, 100)};
+        pos += chunk.size();
+        return chunk;
+    }};
+
+    osmium::io::detail::pbf_blob_index index;
+    REQUIRE(splitter.next("OSMHeader", index) > 0);
+    std::size_t count = 0;
+    while (splitter.next("OSMData", index) > 0) {
+        ++count;
+    }
+    REQUIRE(count > 1);
+    REQUIRE(splitter.offset() == input.size());
+}
+
+TEST_CASE("PBFBlobSplitter detects truncated data") {
+    const std::string filename{"test-pbf-blob-splitter-truncated.osm.pbf"};
+    write_test_file(filename, true);
+    const std::string input{read_whole_file(filename)};
+
+    osmium::io::detail::pbf_blob_index index;
+
+    SECTION("empty input") {
+        osmium::io::detail::PBFBlobSplitter splitter{input.data(), 0};
+        REQUIRE(splitter.next("OSMHeader", index) == 0);
+    }
+
+    SECTION("in size field") {
+        osmium::io::detail::PBFBlobSplitter splitter{input.data(), 2};
+        REQUIRE_THROWS_AS(splitter.next("OSMHeader", index), const osmium::pbf_error&);
+    }
+
+    SECTION("in blob data") {
+        osmium::io::detail::PBFBlobSplitter splitter{input.data(), input.size() - 1};
+        REQUIRE_THROWS_AS(split_blobs(splitter), const osmium::pbf_error&);
+    }
+}
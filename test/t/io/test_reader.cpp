@@ -4,12 +4,18 @@
 
 #include <osmium/handler.hpp>
 #include <osmium/io/any_compression.hpp>
+#include <osmium/io/detail/queue_util.hpp>
 #include <osmium/io/pbf_input.hpp>
 #include <osmium/io/xml_input.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/util/file.hpp>
 #include <osmium/visitor.hpp>
 
+#include <chrono>
+#include <future>
 #include <stdexcept>
+#include <string>
+#include <thread>
 
 struct CountHandler : public osmium::handler::Handler {
 
@@ -152,6 +158,25 @@ TEST_CASE("Reader should work with a buffer with bzip2-compressed data") {
     REQUIRE(handler.count == 1);
 }
 
+TEST_CASE("Reader should work with bzip2-compressed file") {
+    osmium::io::File file{with_data_dir("t/io/data.osm.bz2")};
+
+    SECTION("with parallel decompression") {
+        file.set("parallel_decompression", true);
+    }
+
+    SECTION("without parallel decompression") {
+    }
+
+    osmium::io::Reader reader{file};
+    CountHandler handler;
+
+    REQUIRE(handler.count == 0);
+    osmium::apply(reader, handler);
+    REQUIRE(handler.count == 1);
+    REQUIRE(reader.offset() == reader.file_size());
+}
+
 TEST_CASE("Reader should decode zero node positions in history (XML)") {
     osmium::io::Reader reader{with_data_dir("t/io/deleted_nodes.osh"),
                               osmium::osm_entity_bits::node};
@@ -258,3 +283,49 @@ TEST_CASE("Can not read after close") {
     REQUIRE_THROWS_AS(reader.read(), const osmium::io_error&);
 }
 
+TEST_CASE("Reader metrics") {
+    const std::string filename{with_data_dir("t/io/data.osm")};
+    osmium::io::Reader reader{filename};
+
+    REQUIRE(reader.metrics().buffers_produced == 0);
+
+    CountHandler handler;
+    osmium::apply(reader, handler);
+    REQUIRE(handler.count > 0);
+
+    const auto metrics = reader.metrics();
+    REQUIRE(metrics.bytes_read == osmium::util::file_size(filename));
+    REQUIRE(metrics.buffers_produced > 0);
+    REQUIRE(metrics.blobs_inflated == 0);
+    REQUIRE(metrics.decode_time.count() == 0);
+
+    // data and end of data marker
+    REQUIRE(metrics.input_queue.pushes >= 2);
+    REQUIRE(metrics.output_queue.pushes == metrics.buffers_produced + 1);
+    REQUIRE(metrics.output_queue.pops == metrics.output_queue.pushes);
+}
+
+TEST_CASE("Waiting for results in the output queue counts as blocked popping") {
+    osmium::io::detail::future_string_queue_type queue{10, "test"};
+    osmium::io::detail::queue_wrapper<std::string> wrapper{queue};
+
+    std::promise<std::string> promise;
+    queue.push(promise.get_future());
+    osmium::io::detail::add_end_of_data_to_queue(queue);
+
+    std::thread thread{[&promise]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        promise.set_value("foo");
+    }};
+
+    REQUIRE(wrapper.pop() == "foo");
+    thread.join();
+
+    REQUIRE(wrapper.pop().empty());
+    REQUIRE(wrapper.has_reached_end_of_data());
+
+    const auto stats = wrapper.stats();
+    REQUIRE(stats.pops == 2);
+    REQUIRE(stats.empty == 1);
+    REQUIRE(stats.pop_wait >= std::chrono::milliseconds{10});
+}
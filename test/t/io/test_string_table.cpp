@@ -6,81 +6,6 @@
 #include <iterator>
 #include <string>
 
-TEST_CASE("Empty StringStore") {
-    const osmium::io::detail::StringStore ss{100};
-
-    REQUIRE(ss.begin() == ss.end());
-    REQUIRE(ss.get_chunk_size() == 100);
-    REQUIRE(ss.get_chunk_count() == 1);
-}
-
-TEST_CASE("Add zero-length string to StringStore") {
-    osmium::io::detail::StringStore ss{100};
-
-    const char* s1 = ss.add("");
-    REQUIRE(std::string{s1}.empty());
-
-    auto it = ss.begin();
-    REQUIRE(s1 == *it);
-    REQUIRE(std::string{*it}.empty());
-    REQUIRE(++it == ss.end());
-
-    REQUIRE(ss.get_chunk_count() == 1);
-}
-
-TEST_CASE("Add strings to StringStore") {
-    osmium::io::detail::StringStore ss{100};
-
-    const char* s1 = ss.add("foo");
-    const char* s2 = ss.add("bar");
-    REQUIRE(s1 != s2);
-    REQUIRE(std::string{s1} == "foo");
-    REQUIRE(std::string{s2} == "bar");
-
-    auto it = ss.begin();
-    REQUIRE(s1 == *it++);
-    REQUIRE(s2 == *it++);
-    REQUIRE(it == ss.end());
-
-    ss.clear();
-    REQUIRE(ss.begin() == ss.end());
-}
-
-TEST_CASE("Add zero-length string and longer strings to StringStore") {
-    osmium::io::detail::StringStore ss{100};
-
-    ss.add("");
-    ss.add("xxx");
-    ss.add("yyyyy");
-
-    auto it = ss.begin();
-    REQUIRE(std::string{*it++}.empty());
-    REQUIRE(std::string{*it++} == "xxx");
-    REQUIRE(std::string{*it++} == "yyyyy");
-    REQUIRE(it == ss.end());
-}
-
-TEST_CASE("Add many strings to StringStore") {
-    osmium::io::detail::StringStore ss{100};
-
-    for (const char* teststring : {"", "a", "abc", "abcd", "abcde"}) {
-        int i = 0;
-        for (; i < 200; ++i) {
-            ss.add(teststring);
-        }
-
-        for (const char* s : ss) {
-            REQUIRE(std::string{s} == teststring);
-            --i;
-        }
-
-        REQUIRE(i == 0);
-        REQUIRE(ss.get_chunk_count() > 1);
-        ss.clear();
-        REQUIRE(ss.get_chunk_count() == 1);
-    }
-}
-
 TEST_CASE("Empty StringTable") {
     const osmium::io::detail::StringTable st;
 
@@ -138,3 +63,80 @@ TEST_CASE("Lots of strings in string table so chunk overflows") {
     REQUIRE(it == st.end());
 }
 
+TEST_CASE("Reorder StringTable by frequency") {
+    osmium::io::detail::StringTable st;
+
+    const auto foo = st.add("foo");
+    const auto bar = st.add("bar");
+    const auto baz = st.add("baz");
+    REQUIRE(st.add("baz") == baz);
+    REQUIRE(st.add("bar") == bar);
+    REQUIRE(st.add("baz") == baz);
+
+    REQUIRE(st.index(foo) == foo);
+    REQUIRE(st.index(bar) == bar);
+    REQUIRE(st.index(baz) == baz);
+
+    st.reorder_by_frequency();
+    REQUIRE(st.size() == 4);
+
+    REQUIRE(st.index(0) == 0);
+    REQUIRE(st.index(baz) == 1);
+    REQUIRE(st.index(bar) == 2);
+    REQUIRE(st.index(foo) == 3);
+
+    auto it = st.begin();
+    REQUIRE(std::string{} == *it);
+    REQUIRE(it.length() == 0);
+    ++it;
+    REQUIRE(std::string{"baz"} == *it);
+    REQUIRE(it.length() == 3);
+    ++it;
+    REQUIRE(std::string{"bar"} == *it++);
+    REQUIRE(std::string{"foo"} == *it++);
+    REQUIRE(it == st.end());
+
+    st.clear();
+    REQUIRE(st.size() == 1);
+    REQUIRE(st.add("foo") == 1);
+    REQUIRE(st.index(1) == 1);
+}
+
+TEST_CASE("Frequent strings in large StringTable get small indexes") {
+    osmium::io::detail::StringTable st{100};
+
+    const int n = 10000;
+    for (int i = 0; i < n; ++i) {
+        const auto s = std::to_string(i);
+        REQUIRE(st.add(s.c_str()) == i + 1);
+    }
+
+    // make the last strings the most frequent ones
+    for (int i = n - 100; i < n; ++i) {
+        const auto s = std::to_string(i);
+        for (int j = i; j < n; ++j) {
+            REQUIRE(st.add(s.c_str()) == i + 1);
+        }
+    }
+
+    st.reorder_by_frequency();
+    REQUIRE(st.size() == n + 1);
+
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(st.index(n - 100 + i + 1) == i + 1);
+    }
+
+    // the other strings keep their order
+    REQUIRE(st.index(1) == 101);
+    REQUIRE(st.index(n - 100) == n);
+
+    auto it = st.begin();
+    REQUIRE(std::string{} == *it++);
+    for (int i = n - 100; i < n; ++i) {
+        REQUIRE(osmium::detail::str_to_int<int>(*it++) == i);
+    }
+    for (int i = 0; i < n - 100; ++i) {
+        REQUIRE(osmium::detail::str_to_int<int>(*it++) == i);
+    }
+    REQUIRE(it == st.end());
+}
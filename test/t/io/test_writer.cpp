@@ -7,6 +7,7 @@
 #include <osmium/io/xml_input.hpp>
 #include <osmium/io/xml_output.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/util/file.hpp>
 
 #include <algorithm>
 #include <iterator>
@@ -81,6 +82,26 @@ TEST_CASE("Writer: Successful writes writing buffer") {
     REQUIRE(buffer_check.select<osmium::OSMObject>().cbegin()->id() == 1);
 }
 
+TEST_CASE("Writer metrics") {
+    auto buffer = get_buffer();
+
+    const std::string filename = "test-writer-out-metrics.osm";
+    osmium::io::Writer writer{filename, osmium::io::overwrite::allow};
+    REQUIRE(writer.metrics().buffers_written == 0);
+
+    writer(std::move(buffer));
+    writer.close();
+
+    const auto metrics = writer.metrics();
+    REQUIRE(metrics.buffers_written == 1);
+    REQUIRE(metrics.bytes_written == osmium::util::file_size(filename));
+    REQUIRE(metrics.encode_time.count() > 0);
+
+    // header, data, footer, and end of data marker
+    REQUIRE(metrics.output_queue.pushes >= 4);
+    REQUIRE(metrics.output_queue.pops == metrics.output_queue.pushes);
+}
+
 TEST_CASE("Writer: Successful writes writing items") {
     auto buffer = get_buffer();
 
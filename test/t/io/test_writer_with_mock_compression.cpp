@@ -6,10 +6,25 @@
 #include <osmium/io/xml_input.hpp>
 #include <osmium/io/xml_output.hpp>
 
+#include <fcntl.h>
 #include <stdexcept>
 #include <string>
 #include <utility>
 
+#ifndef _WIN32
+# include <unistd.h>
+#else
+# include <io.h>
+#endif
+
+// The lowest file descriptor not in use.
+static int next_fd() {
+    const int fd = ::open(with_data_dir("t/io/data.osm").c_str(), O_RDONLY);
+    REQUIRE(fd >= 0);
+    ::close(fd);
+    return fd;
+}
+
 class MockCompressor : public osmium::io::Compressor {
 
     std::string m_fail_in;
@@ -69,6 +84,7 @@ TEST_CASE("Write with mock compressor") {
     SECTION("fail on construction") {
 
         fail_in = "constructor";
+        const int fd = next_fd();
 
         REQUIRE_THROWS_AS([&](){
             osmium::io::Writer writer("test-writer-mock-fail-on-construction.osm.gz", header, osmium::io::overwrite::allow);
@@ -76,6 +92,9 @@ TEST_CASE("Write with mock compressor") {
             writer.close();
         }(), const std::logic_error&);
 
+        // file descriptor of the output file was closed
+        REQUIRE(next_fd() == fd);
+
     }
 
     SECTION("fail on write") {
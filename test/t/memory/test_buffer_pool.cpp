@@ -0,0 +1,76 @@
+#include "catch.hpp"
+
+#include <osmium/builder/attr.hpp>
+#include <osmium/memory/buffer_pool.hpp>
+
+#include <array>
+#include <utility>
+
+using namespace osmium::builder::attr; // NOLINT(google-build-using-namespace)
+
+TEST_CASE("Empty buffer pool allocates new buffers") {
+    osmium::memory::BufferPool pool;
+
+    const auto buffer = pool.get(10000);
+    REQUIRE(buffer);
+    REQUIRE(buffer.capacity() >= 10000);
+    REQUIRE(buffer.committed() == 0);
+    REQUIRE(pool.allocations_avoided() == 0);
+}
+
+TEST_CASE("Buffer pool reuses buffers") {
+    osmium::memory::BufferPool pool;
+
+    auto buffer = pool.get(10000);
+    osmium::builder::add_node(buffer, _id(1));
+    const auto* data = buffer.data();
+
+    pool.put(std::move(buffer));
+    REQUIRE(pool.size() == 1);
+
+    const auto buffer2 = pool.get(10000);
+    REQUIRE(buffer2.data() == data);
+    REQUIRE(buffer2.committed() == 0);
+    REQUIRE(buffer2.is_reusable());
+    REQUIRE(pool.size() == 0);
+    REQUIRE(pool.allocations_avoided() == 1);
+}
+
+TEST_CASE("Buffer pool doesn't keep buffers that can't be reused") {
+    osmium::memory::BufferPool pool;
+
+    SECTION("invalid buffer") {
+        pool.put(osmium::memory::Buffer{});
+    }
+
+    SECTION("buffer without auto_grow") {
+        pool.put(osmium::memory::Buffer{1000, osmium::memory::Buffer::auto_grow::no});
+    }
+
+    SECTION("buffer with external memory") {
+        std::array<unsigned char, 128> data;
+        pool.put(osmium::memory::Buffer{data.data(), data.size(), 0});
+    }
+
+    REQUIRE(pool.size() == 0);
+}
+
+TEST_CASE("Buffer pool has maximum size") {
+    osmium::memory::BufferPool pool{2};
+
+    pool.put(osmium::memory::Buffer{1000});
+    pool.put(osmium::memory::Buffer{1000});
+    pool.put(osmium::memory::Buffer{1000});
+
+    REQUIRE(pool.size() == 2);
+}
+
+TEST_CASE("Buffer pool doesn't keep buffers larger than maximum capacity") {
+    osmium::memory::BufferPool pool{2, 2000};
+
+    pool.put(osmium::memory::Buffer{1000});
+    REQUIRE(pool.size() == 1);
+
+    pool.put(osmium::memory::Buffer{4000});
+    REQUIRE(pool.size() == 1);
+}
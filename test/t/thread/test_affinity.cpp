@@ -0,0 +1,51 @@
+#include "catch.hpp"
+
+#include <osmium/thread/affinity.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("Parse CPU lists") {
+    REQUIRE(osmium::thread::parse_cpu_list("").empty());
+    REQUIRE(osmium::thread::parse_cpu_list("3") == std::vector<int>({3}));
+    REQUIRE(osmium::thread::parse_cpu_list("0-3") == std::vector<int>({0, 1, 2, 3}));
+    REQUIRE(osmium::thread::parse_cpu_list("0-1,8,10-11\n") == std::vector<int>({0, 1, 8, 10, 11}));
+    REQUIRE(osmium::thread::parse_cpu_list("5,1,5") == std::vector<int>({1, 5}));
+}
+
+TEST_CASE("Parse invalid CPU lists") {
+    REQUIRE_THROWS_AS(osmium::thread::parse_cpu_list("x"), const std::invalid_argument&);
+    REQUIRE_THROWS_AS(osmium::thread::parse_cpu_list("1-"), const std::invalid_argument&);
+    REQUIRE_THROWS_AS(osmium::thread::parse_cpu_list("3-1"), const std::invalid_argument&);
+    REQUIRE_THROWS_AS(osmium::thread::parse_cpu_list("1;2"), const std::invalid_argument&);
+    REQUIRE_THROWS_AS(osmium::thread::parse_cpu_list("-1"), const std::invalid_argument&);
+}
+
+TEST_CASE("Resolve CPU settings") {
+    REQUIRE(osmium::thread::resolve_cpu_setting("").empty());
+    REQUIRE(osmium::thread::resolve_cpu_setting("2-3") == std::vector<int>({2, 3}));
+    REQUIRE_THROWS_AS(osmium::thread::resolve_cpu_setting("nodex"), const std::invalid_argument&);
+    REQUIRE_THROWS_AS(osmium::thread::resolve_cpu_setting("node"), const std::invalid_argument&);
+
+    // The result depends on the machine, but if the NUMA node of the
+    // current CPU is known, the CPU must be in the list for it.
+    const int cpu = osmium::thread::current_cpu();
+    const auto local = osmium::thread::resolve_cpu_setting("local");
+    if (cpu >= 0 && !local.empty()) {
+        REQUIRE(std::find(local.begin(), local.end(), cpu) != local.end());
+    }
+}
+
+TEST_CASE("Pool with CPU affinity") {
+    const int cpu = osmium::thread::current_cpu();
+    if (cpu >= 0) {
+        osmium::thread::Pool pool{2, 0, std::vector<int>{cpu}};
+        REQUIRE(pool.cpus() == std::vector<int>{cpu});
+        auto future = pool.submit([]() {
+            return osmium::thread::current_cpu();
+        });
+        REQUIRE(future.get() == cpu);
+    }
+}
@@ -0,0 +1,78 @@
+#include "catch.hpp"
+
+#include <osmium/thread/memory_budget.hpp>
+
+#include <atomic>
+#include <thread>
+
+TEST_CASE("Memory budget without limit is never exhausted") {
+    osmium::thread::MemoryBudget budget;
+    REQUIRE(budget.limit() == 0);
+    budget.charge(1000000);
+    REQUIRE(budget.used() == 1000000);
+    REQUIRE_FALSE(budget.exhausted());
+    budget.wait_for_room([]() {
+        return true;
+    });
+    budget.release(1000000);
+    REQUIRE(budget.used() == 0);
+}
+
+TEST_CASE("Memory budget with limit") {
+    osmium::thread::MemoryBudget budget{100};
+    REQUIRE(budget.limit() == 100);
+    budget.charge(99);
+    REQUIRE_FALSE(budget.exhausted());
+    budget.charge(1);
+    REQUIRE(budget.exhausted());
+
+    // does not block if the condition is false
+    budget.wait_for_room([]() {
+        return false;
+    });
+
+    budget.set_limit(0);
+    REQUIRE_FALSE(budget.exhausted());
+    budget.set_limit(100);
+    REQUIRE(budget.exhausted());
+    budget.release(50);
+    REQUIRE_FALSE(budget.exhausted());
+}
+
+TEST_CASE("Memory budget blocks until memory is released") {
+    osmium::thread::MemoryBudget budget{10};
+    budget.charge(20);
+
+    std::atomic<bool> done{false};
+    std::thread thread{[&budget, &done]() {
+        budget.wait_for_room([]() {
+            return true;
+        });
+        done = true;
+    }};
+
+    budget.release(5);
+    budget.release(10);
+    thread.join();
+
+    REQUIRE(done);
+    REQUIRE(budget.used() == 5);
+}
+
+TEST_CASE("Memory budget wakes up waiting thread when condition changes") {
+    osmium::thread::MemoryBudget budget{10};
+    budget.charge(20);
+
+    std::atomic<bool> queue_empty{false};
+    std::thread thread{[&budget, &queue_empty]() {
+        budget.wait_for_room([&queue_empty]() {
+            return !queue_empty;
+        });
+    }};
+
+    queue_empty = true;
+    budget.release(0);
+    thread.join();
+
+    REQUIRE(budget.exhausted());
+}
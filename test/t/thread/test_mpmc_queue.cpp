@@ -0,0 +1,166 @@
+#include "catch.hpp"
+
+#include <osmium/thread/mpmc_queue.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Basic use of MPMC queue") {
+    osmium::thread::MPMCQueue<int> queue;
+    REQUIRE(queue.empty());
+    REQUIRE(queue.max_size() == osmium::thread::MPMCQueue<int>::default_max_size);
+    queue.push(22);
+    REQUIRE_FALSE(queue.empty());
+    REQUIRE(queue.size() == 1);
+    int value = 0;
+    queue.wait_and_pop(value);
+    REQUIRE(value == 22);
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("MPMC queue keeps order and respects max size") {
+    osmium::thread::MPMCQueue<int> queue{3, "MPMC queue of max size 3"};
+    REQUIRE(queue.name() == "MPMC queue of max size 3");
+
+    int value = 0;
+    REQUIRE_FALSE(queue.try_pop(value));
+
+    for (int n = 1; n <= 3; ++n) {
+        REQUIRE(queue.try_push(n));
+    }
+    REQUIRE(queue.size() == 3);
+
+    value = 4;
+    REQUIRE_FALSE(queue.try_push(value));
+    REQUIRE(value == 4);
+
+    for (int n = 1; n <= 3; ++n) {
+        REQUIRE(queue.try_pop(value));
+        REQUIRE(value == n);
+    }
+    REQUIRE(queue.empty());
+    REQUIRE_FALSE(queue.try_pop(value));
+
+    // wrap around the ring buffer several times
+    for (int n = 0; n < 10; ++n) {
+        queue.push(n);
+        queue.push(n + 100);
+        queue.wait_and_pop(value);
+        REQUIRE(value == n);
+        queue.wait_and_pop(value);
+        REQUIRE(value == n + 100);
+    }
+}
+
+TEST_CASE("MPMC queue with move-only type") {
+    osmium::thread::MPMCQueue<std::unique_ptr<int>> queue{2};
+    queue.push(std::unique_ptr<int>{new int{17}});
+    std::unique_ptr<int> value;
+    queue.wait_and_pop(value);
+    REQUIRE(value);
+    REQUIRE(*value == 17);
+}
+
+TEST_CASE("MPMC queue with several producers and consumers") {
+    osmium::thread::MPMCQueue<int> queue{4};
+
+    const int num_producers = 4;
+    const int num_consumers = 3;
+    const int per_producer = 10000;
+
+    std::vector<int64_t> sums(num_consumers, 0);
+    std::vector<int> counts(num_consumers, 0);
+
+    std::vector<std::thread> threads;
+    for (int c = 0; c < num_consumers; ++c) {
+        threads.emplace_back([&queue, &sums, &counts, c] {
+            while (true) {
+                int value = 0;
+                queue.wait_and_pop(value);
+                if (value < 0) {
+                    return;
+                }
+                sums[c] += value;
+                ++counts[c];
+            }
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < num_producers; ++p) {
+        producers.emplace_back([&queue] {
+            for (int n = 1; n <= per_producer; ++n) {
+                queue.push(n);
+            }
+        });
+    }
+
+    for (auto& thread : producers) {
+        thread.join();
+    }
+
+    // one end marker for each consumer
+    for (int c = 0; c < num_consumers; ++c) {
+        queue.push(-1);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    int64_t sum = 0;
+    int count = 0;
+    for (int c = 0; c < num_consumers; ++c) {
+        sum += sums[c];
+        count += counts[c];
+    }
+
+    REQUIRE(count == num_producers * per_producer);
+    REQUIRE(sum == int64_t(num_producers) * per_producer * (per_producer + 1) / 2);
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("MPMC queue keeps statistics") {
+    osmium::thread::MPMCQueue<int> queue{2};
+
+    int value = 1;
+    REQUIRE(queue.try_push(value));
+    queue.push(2);
+    value = 3;
+    REQUIRE_FALSE(queue.try_push(value));
+    queue.wait_and_pop(value);
+    REQUIRE(queue.try_pop(value));
+    REQUIRE_FALSE(queue.try_pop(value));
+
+    auto stats = queue.stats();
+    REQUIRE(stats.pushes == 2);
+    REQUIRE(stats.full == 0);
+    REQUIRE(stats.pops == 2);
+    REQUIRE(stats.empty == 0);
+    REQUIRE(stats.largest_size >= 1);
+    REQUIRE(stats.largest_size <= 2);
+    REQUIRE(stats.push_wait.count() == 0);
+    REQUIRE(stats.pop_wait.count() == 0);
+
+    std::thread thread{[&queue] {
+        int n = 0;
+        queue.wait_and_pop(n);
+    }};
+
+    // wait until the thread is blocked on the empty queue
+    while (queue.stats().empty == 0) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    queue.push(4);
+    thread.join();
+
+    stats = queue.stats();
+    REQUIRE(stats.pops == 3);
+    REQUIRE(stats.empty == 1);
+    REQUIRE(stats.pop_wait >= std::chrono::milliseconds{5});
+}
+
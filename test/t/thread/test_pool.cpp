@@ -3,7 +3,12 @@
 #include <osmium/thread/pool.hpp>
 #include <osmium/util/compatibility.hpp>
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <future>
 #include <stdexcept>
+#include <vector>
 
 struct test_job_with_result {
     int operator()() const {
@@ -105,3 +110,125 @@ TEST_CASE("can throw from job in user provided thread pool") {
     REQUIRE_THROWS_AS(future.get(), const std::runtime_error&);
 }
 
+
+TEST_CASE("function wrapper with small and large functions") {
+    int small_result = 0;
+    osmium::thread::function_wrapper small{[&small_result]() {
+        small_result = 1;
+    }};
+
+    std::array<int, 100> data{};
+    data[99] = 5;
+    int large_result = 0;
+    osmium::thread::function_wrapper large{[data, &large_result]() {
+        large_result = data[99];
+    }};
+
+    osmium::thread::function_wrapper moved{std::move(large)};
+    REQUIRE_FALSE(large);
+    REQUIRE(moved);
+
+    small = std::move(moved);
+    REQUIRE_FALSE(small());
+    REQUIRE(small_result == 0);
+    REQUIRE(large_result == 5);
+
+    osmium::thread::function_wrapper shutdown{0};
+    REQUIRE(shutdown());
+}
+
+TEST_CASE("can submit detached jobs to thread pool") {
+    std::atomic<int> count{0};
+    std::promise<void> done;
+    auto future = done.get_future();
+
+    // declared after the variables used in the jobs, so that it is
+    // destructed (and all jobs are finished) first
+    osmium::thread::Pool pool{4};
+
+    const int num_jobs = 1000;
+    for (int i = 0; i < num_jobs; ++i) {
+        pool.submit_detached([&count, &done]() {
+            if (++count == num_jobs) {
+                done.set_value();
+            }
+        });
+    }
+
+    future.wait();
+    REQUIRE(count == num_jobs);
+}
+
+TEST_CASE("exceptions in detached jobs are ignored") {
+    osmium::thread::Pool pool{2};
+    pool.submit_detached(test_job_throw{});
+    auto future = pool.submit(test_job_with_result{});
+    REQUIRE(future.get() == 42);
+}
+
+TEST_CASE("jobs in thread pool can submit more jobs") {
+    std::atomic<int> count{0};
+    std::promise<void> done;
+    auto future = done.get_future();
+
+    // declared after the variables used in the jobs, so that it is
+    // destructed (and all jobs are finished) first
+    osmium::thread::Pool pool{4};
+
+    const int num_outer = 10;
+    const int num_inner = 100;
+
+    for (int i = 0; i < num_outer; ++i) {
+        pool.submit_detached([&pool, &count, &done]() {
+            std::vector<std::function<void()>> jobs;
+            for (int j = 0; j < num_inner; ++j) {
+                jobs.emplace_back([&count, &done]() {
+                    if (++count == num_outer * num_inner) {
+                        done.set_value();
+                    }
+                });
+            }
+            pool.submit_detached(jobs.begin(), jobs.end());
+        });
+    }
+
+    future.wait();
+    REQUIRE(count == num_outer * num_inner);
+}
+
+static int fibonacci_in_pool(osmium::thread::Pool& pool, int n) {
+    if (n < 2) {
+        return n;
+    }
+    auto future = pool.submit([&pool, n]() {
+        return fibonacci_in_pool(pool, n - 1);
+    });
+    const int result = fibonacci_in_pool(pool, n - 2);
+    pool.wait(future);
+    return result + future.get();
+}
+
+TEST_CASE("jobs in thread pool can wait for jobs they submitted") {
+    SECTION("one thread") {
+        osmium::thread::Pool pool{1};
+        auto future = pool.submit([&pool]() {
+            return fibonacci_in_pool(pool, 15);
+        });
+        REQUIRE(future.get() == 610);
+    }
+
+    SECTION("several threads") {
+        osmium::thread::Pool pool{4};
+        auto future = pool.submit([&pool]() {
+            return fibonacci_in_pool(pool, 18);
+        });
+        REQUIRE(future.get() == 2584);
+    }
+}
+
+TEST_CASE("waiting for a future outside the pool") {
+    osmium::thread::Pool pool{2};
+    auto future = pool.submit(test_job_with_result{});
+    pool.wait(future);
+    REQUIRE(future.get() == 42);
+}
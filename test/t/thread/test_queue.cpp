@@ -2,6 +2,9 @@
 
 #include <osmium/thread/queue.hpp>
 
+#include <chrono>
+#include <thread>
+
 TEST_CASE("Basic use of thread-safe queue") {
     osmium::thread::Queue<int> queue;
     REQUIRE(queue.empty());
@@ -18,3 +21,50 @@ TEST_CASE("Queue can have max elements and can be named") {
     osmium::thread::Queue<int> queue{100, "Queue of max size 100"};
 }
 
+
+TEST_CASE("Queue keeps statistics") {
+    osmium::thread::Queue<int> queue{10};
+
+    for (int n = 1; n <= 3; ++n) {
+        queue.push(n);
+    }
+    int value = 0;
+    queue.wait_and_pop(value);
+    REQUIRE(queue.try_pop(value));
+    REQUIRE(queue.try_pop(value));
+    REQUIRE_FALSE(queue.try_pop(value));
+
+    const auto stats = queue.stats();
+    REQUIRE(stats.pushes == 3);
+    REQUIRE(stats.full == 0);
+    REQUIRE(stats.pops == 3);
+    REQUIRE(stats.empty == 0);
+    REQUIRE(stats.largest_size == 3);
+    REQUIRE(stats.push_wait.count() == 0);
+    REQUIRE(stats.pop_wait.count() == 0);
+}
+
+TEST_CASE("Queue statistics count time blocked in push") {
+    osmium::thread::Queue<int> queue{1};
+    queue.push(1);
+
+    std::thread thread{[&queue] {
+        queue.push(2);
+    }};
+
+    // wait until the thread is blocked
+    while (queue.stats().full == 0) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{5});
+
+    int value = 0;
+    queue.wait_and_pop(value);
+    thread.join();
+
+    const auto stats = queue.stats();
+    REQUIRE(stats.pushes == 2);
+    REQUIRE(stats.full == 1);
+    REQUIRE(stats.largest_size == 1);
+    REQUIRE(stats.push_wait >= std::chrono::milliseconds{5});
+}
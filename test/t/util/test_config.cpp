@@ -81,3 +81,28 @@ TEST_CASE("get_max_queue_size") {
     REQUIRE(osmium::config::get_max_queue_size("NAME", 7) == 3);
 }
 
+
+TEST_CASE("get_cpus") {
+    osmium::detail::env = nullptr;
+    REQUIRE(osmium::config::get_cpus("POOL").empty());
+    REQUIRE(osmium::detail::name == "OSMIUM_POOL_CPUS");
+    osmium::detail::env = "0-3,8";
+    REQUIRE(osmium::config::get_cpus("IO") == "0-3,8");
+    REQUIRE(osmium::detail::name == "OSMIUM_IO_CPUS");
+}
+
+TEST_CASE("get_pool_nice") {
+    osmium::detail::env = nullptr;
+    REQUIRE(osmium::config::get_pool_nice() == 0);
+    REQUIRE(osmium::detail::name == "OSMIUM_POOL_NICE");
+    osmium::detail::env = "5";
+    REQUIRE(osmium::config::get_pool_nice() == 5);
+}
+
+TEST_CASE("get_memory_budget") {
+    osmium::detail::env = nullptr;
+    REQUIRE(osmium::config::get_memory_budget() == 0);
+    REQUIRE(osmium::detail::name == "OSMIUM_MEMORY_BUDGET_MB");
+    osmium::detail::env = "3";
+    REQUIRE(osmium::config::get_memory_budget() == 3 * 1024 * 1024);
+}